@@ -0,0 +1,429 @@
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "err.h"
+#include "utils.h"
+#include "bgzf.h"
+#include "reads.h"
+#include "bam-file.h"
+
+
+/************************************************************************/
+/*                        HELPER FUNCTIONS                              */
+/************************************************************************/
+
+UTILS_NAMED_CALLOC_FUNCTION(pchar, char *)
+
+
+static const char _bamCigarOps[] = "MIDNSHP=X";
+static const char _bamBases[] = "=ACMGRSVTWYHKDBN";
+static char _bamRNextSame[] = "=";
+static char _bamStar[] = "*";
+
+
+static uint16_t _le16(const uint8_t *Data)
+{
+	return (uint16_t)(Data[0] | (Data[1] << 8));
+}
+
+
+static uint32_t _le32(const uint8_t *Data)
+{
+	return ((uint32_t)Data[0] | ((uint32_t)Data[1] << 8) | ((uint32_t)Data[2] << 16) | ((uint32_t)Data[3] << 24));
+}
+
+
+static ERR_VALUE _bam_reserve(void **Buffer, size_t *AllocLength, const size_t Length)
+{
+	void *tmp = NULL;
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	if (*AllocLength < Length) {
+		size_t newLength = max(Length, 2 * (*AllocLength));
+
+		ret = utils_malloc(newLength, &tmp);
+		if (ret == ERR_SUCCESS) {
+			if (*Buffer != NULL)
+				utils_free(*Buffer);
+
+			*Buffer = tmp;
+			*AllocLength = newLength;
+		}
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _bam_read_int32(PBGZF_FILE File, int32_t *Value)
+{
+	uint8_t data[4];
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = bgzf_read(File, data, sizeof(data));
+	if (ret == ERR_SUCCESS)
+		*Value = (int32_t)_le32(data);
+
+	return ret;
+}
+
+
+static ERR_VALUE _bam_read_header(PBAM_FILE File)
+{
+	char magic[4];
+	int32_t textLength = 0;
+	int32_t nameLength = 0;
+	int32_t refLength = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = bgzf_read(&File->Bgzf, magic, sizeof(magic));
+	if (ret == ERR_SUCCESS && memcmp(magic, "BAM\1", sizeof(magic)) != 0)
+		ret = ERR_BAM_INVALID_HEADER;
+
+	if (ret == ERR_SUCCESS)
+		ret = _bam_read_int32(&File->Bgzf, &textLength);
+
+	if (ret == ERR_SUCCESS && textLength < 0)
+		ret = ERR_BAM_INVALID_HEADER;
+
+	if (ret == ERR_SUCCESS) {
+		ret = utils_calloc_char(textLength + 1, &File->HeaderText);
+		if (ret == ERR_SUCCESS)
+			ret = bgzf_read(&File->Bgzf, File->HeaderText, textLength);
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = _bam_read_int32(&File->Bgzf, &File->ReferenceCount);
+
+	if (ret == ERR_SUCCESS && File->ReferenceCount < 0)
+		ret = ERR_BAM_INVALID_HEADER;
+
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc_pchar(File->ReferenceCount + 1, &File->ReferenceNames);
+
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc_uint32_t(File->ReferenceCount + 1, &File->ReferenceLengths);
+
+	for (int32_t i = 0; i < File->ReferenceCount; ++i) {
+		ret = _bam_read_int32(&File->Bgzf, &nameLength);
+		if (ret == ERR_SUCCESS && nameLength <= 0)
+			ret = ERR_BAM_INVALID_HEADER;
+
+		if (ret == ERR_SUCCESS)
+			ret = utils_calloc_char(nameLength + 1, File->ReferenceNames + i);
+
+		if (ret == ERR_SUCCESS)
+			ret = bgzf_read(&File->Bgzf, File->ReferenceNames[i], nameLength);
+
+		if (ret == ERR_SUCCESS)
+			ret = _bam_read_int32(&File->Bgzf, &refLength);
+
+		if (ret != ERR_SUCCESS)
+			break;
+
+		File->ReferenceLengths[i] = (uint32_t)refLength;
+	}
+
+	if (ret == ERR_NO_MORE_ENTRIES)
+		ret = ERR_BAM_INVALID_HEADER;
+
+	return ret;
+}
+
+
+static void _bam_free_header(PBAM_FILE File)
+{
+	if (File->ReferenceNames != NULL) {
+		for (int32_t i = 0; i < File->ReferenceCount; ++i) {
+			if (File->ReferenceNames[i] != NULL)
+				utils_free(File->ReferenceNames[i]);
+		}
+
+		utils_free(File->ReferenceNames);
+	}
+
+	if (File->ReferenceLengths != NULL)
+		utils_free(File->ReferenceLengths);
+
+	if (File->HeaderText != NULL)
+		utils_free(File->HeaderText);
+
+	return;
+}
+
+
+static char *_bam_reference_name(const BAM_FILE *File, const int32_t RefID)
+{
+	return (0 <= RefID && RefID < File->ReferenceCount) ? File->ReferenceNames[RefID] : _bamStar;
+}
+
+
+/** Returns the size of a tag value of the given fixed-size type, or zero for other types. */
+static size_t _bam_tag_value_size(const char Type)
+{
+	size_t ret = 0;
+
+	switch (Type) {
+		case 'A':
+		case 'c':
+		case 'C':
+			ret = 1;
+			break;
+		case 's':
+		case 'S':
+			ret = 2;
+			break;
+		case 'i':
+		case 'I':
+		case 'f':
+			ret = 4;
+			break;
+	}
+
+	return ret;
+}
+
+
+/** Picks the MD and NM tags from the auxiliary data of a record. Parsing stops at the first malformed tag. */
+static void _bam_read_tags(const uint8_t *Aux, const uint8_t *End, PONE_READ_EXTENSION Extension)
+{
+	const uint8_t *value = NULL;
+	const uint8_t *stop = NULL;
+	size_t size = 0;
+	uint32_t count = 0;
+
+	while (End - Aux >= 3 && (Extension->MD == NULL || !Extension->HasNM)) {
+		value = Aux + 3;
+		size = _bam_tag_value_size(Aux[2]);
+		if (size == 0) {
+			switch (Aux[2]) {
+				case 'Z':
+				case 'H':
+					stop = (const uint8_t *)memchr(value, '\0', End - value);
+					if (stop != NULL)
+						size = stop - value + 1;
+					break;
+				case 'B':
+					if (End - value >= 5) {
+						count = _le32(value + 1);
+						size = _bam_tag_value_size(value[0]);
+						if (size > 0 && count <= (size_t)(End - value - 5) / size)
+							size = 5 + count * size;
+						else size = 0;
+					}
+					break;
+			}
+		}
+
+		if (size == 0 || size > (size_t)(End - value))
+			break;
+
+		if (Aux[0] == 'M' && Aux[1] == 'D' && Aux[2] == 'Z')
+			Extension->MD = (char *)value;
+		else if (Aux[0] == 'N' && Aux[1] == 'M')
+			Extension->HasNM = bam_tag_int(Aux[2], value, size, &Extension->NM) && Extension->NM >= 0;
+
+		Aux = value + size;
+	}
+
+	return;
+}
+
+
+/************************************************************************/
+/*                        PUBLIC FUNCTIONS                              */
+/************************************************************************/
+
+
+/** Converts a tag value of one of the BAM integer types. */
+boolean bam_tag_int(const char Type, const uint8_t *Value, const size_t Length, int32_t *Result)
+{
+	boolean ret = (_bam_tag_value_size(Type) <= Length);
+
+	if (ret) {
+		switch (Type) {
+			case 'c':
+				*Result = (int8_t)Value[0];
+				break;
+			case 'C':
+				*Result = Value[0];
+				break;
+			case 's':
+				*Result = (int16_t)_le16(Value);
+				break;
+			case 'S':
+				*Result = _le16(Value);
+				break;
+			case 'i':
+			case 'I':
+				*Result = (int32_t)_le32(Value);
+				break;
+			default:
+				ret = FALSE;
+				break;
+		}
+	}
+
+	return ret;
+}
+
+
+ERR_VALUE bam_open(const char *FileName, PBAM_FILE File)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(File, 0, sizeof(BAM_FILE));
+	ret = bgzf_open(FileName, &File->Bgzf);
+	if (ret == ERR_SUCCESS) {
+		ret = _bam_read_header(File);
+		if (ret != ERR_SUCCESS) {
+			_bam_free_header(File);
+			bgzf_close(&File->Bgzf);
+		}
+	}
+
+	return ret;
+}
+
+
+/** Returns the index of the reference sequence of the given name, or -1 if the header does not contain it. */
+int32_t bam_reference_index(const BAM_FILE *File, const char *Name)
+{
+	int32_t ret = -1;
+
+	for (int32_t i = 0; i < File->ReferenceCount; ++i) {
+		if (strcmp(File->ReferenceNames[i], Name) == 0) {
+			ret = i;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+
+/** Reads the fixed-size part of the next record. The caller must then call either bam_read_record() or bam_skip_record(). */
+ERR_VALUE bam_read_core(PBAM_FILE File, PBAM_RECORD_CORE Core)
+{
+	uint8_t data[4 + BAM_RECORD_CORE_SIZE];
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = bgzf_read(&File->Bgzf, data, sizeof(data));
+	if (ret == ERR_SUCCESS) {
+		Core->BlockSize = _le32(data);
+		Core->RefID = (int32_t)_le32(data + 4);
+		Core->Pos = (int32_t)_le32(data + 8);
+		Core->ReadNameLength = data[12];
+		Core->MapQ = data[13];
+		Core->Bin = _le16(data + 14);
+		Core->CigarOpCount = _le16(data + 16);
+		Core->Flags = _le16(data + 18);
+		Core->SequenceLength = _le32(data + 20);
+		Core->NextRefID = (int32_t)_le32(data + 24);
+		Core->NextPos = (int32_t)_le32(data + 28);
+		Core->TLen = (int32_t)_le32(data + 32);
+		if (Core->BlockSize < BAM_RECORD_CORE_SIZE + Core->ReadNameLength + 4 * (uint32_t)Core->CigarOpCount + (Core->SequenceLength + 1) / 2 + Core->SequenceLength)
+			ret = ERR_BAM_INVALID_RECORD;
+	}
+
+	return ret;
+}
+
+
+ERR_VALUE bam_skip_record(PBAM_FILE File, const BAM_RECORD_CORE *Core)
+{
+	return bgzf_skip(&File->Bgzf, Core->BlockSize - BAM_RECORD_CORE_SIZE);
+}
+
+
+/** Reads the variable-length part of the record and fills the read with pointers into buffers of the file. The read is valid
+    until the next record is read. */
+ERR_VALUE bam_read_record(PBAM_FILE File, const BAM_RECORD_CORE *Core, PONE_READ Read, PONE_READ_EXTENSION Extension)
+{
+	const size_t dataLength = Core->BlockSize - BAM_RECORD_CORE_SIZE;
+	const size_t textLength = 11 * (size_t)Core->CigarOpCount + 2 + 2 * ((size_t)Core->SequenceLength + 1);
+	const uint8_t *cigar = NULL;
+	const uint8_t *seq = NULL;
+	const uint8_t *qual = NULL;
+	char *text = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = _bam_reserve((void **)&File->Record, &File->RecordAllocLength, dataLength);
+	if (ret == ERR_SUCCESS)
+		ret = _bam_reserve((void **)&File->Text, &File->TextAllocLength, textLength);
+
+	if (ret == ERR_SUCCESS)
+		ret = bgzf_read(&File->Bgzf, File->Record, dataLength);
+
+	if (ret == ERR_SUCCESS) {
+		memset(Read, 0, sizeof(ONE_READ));
+		memset(Extension, 0, sizeof(ONE_READ_EXTENSION));
+		Read->Extension = Extension;
+		Read->Pos = (uint64_t)(int64_t)Core->Pos;
+		Read->PosQuality = Core->MapQ;
+		Extension->Flags.Value = Core->Flags;
+		Extension->RName = _bam_reference_name(File, Core->RefID);
+		if (Core->NextRefID == -1)
+			Extension->RNext = _bamStar;
+		else if (Core->NextRefID == Core->RefID)
+			Extension->RNext = _bamRNextSame;
+		else Extension->RNext = _bam_reference_name(File, Core->NextRefID);
+
+		Extension->PNext = (uint64_t)((int64_t)Core->NextPos + 1);
+		Extension->TLen = Core->TLen;
+		Extension->TemplateName = (char *)File->Record;
+		Extension->TemplateName[Core->ReadNameLength > 0 ? Core->ReadNameLength - 1 : 0] = '\0';
+		cigar = File->Record + Core->ReadNameLength;
+		seq = cigar + 4 * (size_t)Core->CigarOpCount;
+		qual = seq + ((size_t)Core->SequenceLength + 1) / 2;
+
+		text = File->Text;
+		Extension->CIGAR = text;
+		if (Core->CigarOpCount > 0) {
+			for (uint16_t i = 0; i < Core->CigarOpCount; ++i) {
+				const uint32_t op = _le32(cigar + 4 * (size_t)i);
+
+				text += sprintf(text, "%u%c", op >> 4, ((op & 0xf) < sizeof(_bamCigarOps) - 1) ? _bamCigarOps[op & 0xf] : '?');
+			}
+		} else *text++ = '*';
+
+		*text++ = '\0';
+		Read->ReadSequence = text;
+		Read->ReadSequenceLen = Core->SequenceLength;
+		for (uint32_t i = 0; i < Core->SequenceLength / 2; ++i) {
+			*text++ = _bamBases[seq[i] >> 4];
+			*text++ = _bamBases[seq[i] & 0xf];
+		}
+
+		if (Core->SequenceLength % 2 != 0)
+			*text++ = _bamBases[seq[Core->SequenceLength / 2] >> 4];
+
+		*text++ = '\0';
+		Read->Quality = (uint8_t *)text;
+		if (Core->SequenceLength > 0 && qual[0] == 0xff)
+			memset(text, 0, Core->SequenceLength);
+		else memcpy(text, qual, Core->SequenceLength);
+
+		text[Core->SequenceLength] = '\0';
+		_bam_read_tags(qual + Core->SequenceLength, File->Record + dataLength, Extension);
+	} else if (ret == ERR_NO_MORE_ENTRIES)
+		ret = ERR_BAM_INVALID_RECORD;
+
+	return ret;
+}
+
+
+void bam_close(PBAM_FILE File)
+{
+	if (File->Text != NULL)
+		utils_free(File->Text);
+
+	if (File->Record != NULL)
+		utils_free(File->Record);
+
+	_bam_free_header(File);
+	bgzf_close(&File->Bgzf);
+
+	return;
+}
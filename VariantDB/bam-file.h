@@ -0,0 +1,60 @@
+
+#ifndef __BAM_FILE_H__
+#define __BAM_FILE_H__
+
+
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+#include "bgzf.h"
+#include "reads.h"
+
+
+/** Size of the fixed part of a BAM alignment record (without the block_size field). */
+#define BAM_RECORD_CORE_SIZE				32
+
+/** The fixed-size part of a BAM alignment record. */
+typedef struct _BAM_RECORD_CORE {
+	/** Length of the record (without this field). */
+	uint32_t BlockSize;
+	int32_t RefID;
+	/** 0-based leftmost position (-1 for unmapped reads). */
+	int32_t Pos;
+	uint8_t ReadNameLength;
+	uint8_t MapQ;
+	uint16_t Bin;
+	uint16_t CigarOpCount;
+	uint16_t Flags;
+	uint32_t SequenceLength;
+	int32_t NextRefID;
+	int32_t NextPos;
+	int32_t TLen;
+} BAM_RECORD_CORE, *PBAM_RECORD_CORE;
+
+typedef struct _BAM_FILE {
+	BGZF_FILE Bgzf;
+	/** The SAM header text (null-terminated). */
+	char *HeaderText;
+	int32_t ReferenceCount;
+	char **ReferenceNames;
+	uint32_t *ReferenceLengths;
+	/** Variable-length part of the current record. */
+	uint8_t *Record;
+	size_t RecordAllocLength;
+	/** Decoded CIGAR, sequence and qualities of the current record. */
+	char *Text;
+	size_t TextAllocLength;
+} BAM_FILE, *PBAM_FILE;
+
+
+ERR_VALUE bam_open(const char *FileName, PBAM_FILE File);
+int32_t bam_reference_index(const BAM_FILE *File, const char *Name);
+ERR_VALUE bam_read_core(PBAM_FILE File, PBAM_RECORD_CORE Core);
+ERR_VALUE bam_skip_record(PBAM_FILE File, const BAM_RECORD_CORE *Core);
+ERR_VALUE bam_read_record(PBAM_FILE File, const BAM_RECORD_CORE *Core, PONE_READ Read, PONE_READ_EXTENSION Extension);
+boolean bam_tag_int(const char Type, const uint8_t *Value, const size_t Length, int32_t *Result);
+void bam_close(PBAM_FILE File);
+
+
+
+#endif
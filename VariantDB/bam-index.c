@@ -0,0 +1,394 @@
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "err.h"
+#include "utils.h"
+#include "file-utils.h"
+#include "gen_dym_array.h"
+#include "bgzf.h"
+#include "bam-index.h"
+
+
+/************************************************************************/
+/*                        HELPER FUNCTIONS                              */
+/************************************************************************/
+
+UTILS_TYPED_CALLOC_FUNCTION(BAM_INDEX_CHUNK)
+UTILS_TYPED_CALLOC_FUNCTION(BAM_INDEX_BIN)
+UTILS_TYPED_CALLOC_FUNCTION(BAM_INDEX_REFERENCE)
+
+
+/** Parameters of the BAI binning scheme (16 kbp leaves, 5 levels). */
+#define BAI_MIN_SHIFT						14
+#define BAI_DEPTH							5
+#define BAI_LINEAR_SHIFT					14
+
+
+typedef struct _INDEX_CURSOR {
+	const uint8_t *Data;
+	const uint8_t *End;
+} INDEX_CURSOR, *PINDEX_CURSOR;
+
+
+static ERR_VALUE _cursor_read(PINDEX_CURSOR Cursor, void *Buffer, const size_t Length)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if ((size_t)(Cursor->End - Cursor->Data) >= Length) {
+		memcpy(Buffer, Cursor->Data, Length);
+		Cursor->Data += Length;
+		ret = ERR_SUCCESS;
+	} else ret = ERR_BAM_INVALID_INDEX;
+
+	return ret;
+}
+
+
+static ERR_VALUE _cursor_uint32(PINDEX_CURSOR Cursor, uint32_t *Value)
+{
+	uint8_t data[4];
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = _cursor_read(Cursor, data, sizeof(data));
+	if (ret == ERR_SUCCESS)
+		*Value = ((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+
+	return ret;
+}
+
+
+static ERR_VALUE _cursor_uint64(PINDEX_CURSOR Cursor, uint64_t *Value)
+{
+	uint32_t low = 0;
+	uint32_t high = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = _cursor_uint32(Cursor, &low);
+	if (ret == ERR_SUCCESS)
+		ret = _cursor_uint32(Cursor, &high);
+
+	if (ret == ERR_SUCCESS)
+		*Value = ((uint64_t)high << 32) | low;
+
+	return ret;
+}
+
+
+static int _bin_comparator(const void *A, const void *B)
+{
+	const BAM_INDEX_BIN *a = (const BAM_INDEX_BIN *)A;
+	const BAM_INDEX_BIN *b = (const BAM_INDEX_BIN *)B;
+
+	return (a->Bin < b->Bin) ? -1 : ((a->Bin > b->Bin) ? 1 : 0);
+}
+
+
+static int _chunk_comparator(const void *A, const void *B)
+{
+	const BAM_INDEX_CHUNK *a = (const BAM_INDEX_CHUNK *)A;
+	const BAM_INDEX_CHUNK *b = (const BAM_INDEX_CHUNK *)B;
+
+	return (a->Begin < b->Begin) ? -1 : ((a->Begin > b->Begin) ? 1 : 0);
+}
+
+
+static ERR_VALUE _index_parse_reference(PINDEX_CURSOR Cursor, const boolean Csi, PBAM_INDEX_REFERENCE Reference)
+{
+	uint32_t binCount = 0;
+	PBAM_INDEX_BIN bin = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = _cursor_uint32(Cursor, &binCount);
+	if (ret == ERR_SUCCESS && binCount > 0) {
+		ret = utils_calloc_BAM_INDEX_BIN(binCount, &Reference->Bins);
+		if (ret == ERR_SUCCESS)
+			Reference->BinCount = binCount;
+	}
+
+	for (uint32_t i = 0; i < Reference->BinCount; ++i) {
+		bin = Reference->Bins + i;
+		ret = _cursor_uint32(Cursor, &bin->Bin);
+		if (ret == ERR_SUCCESS && Csi)
+			ret = _cursor_uint64(Cursor, &bin->LOffset);
+
+		if (ret == ERR_SUCCESS)
+			ret = _cursor_uint32(Cursor, &bin->ChunkCount);
+
+		if (ret == ERR_SUCCESS && bin->ChunkCount > 0) {
+			if ((size_t)(Cursor->End - Cursor->Data) / (2 * sizeof(uint64_t)) >= bin->ChunkCount)
+				ret = utils_calloc_BAM_INDEX_CHUNK(bin->ChunkCount, &bin->Chunks);
+			else ret = ERR_BAM_INVALID_INDEX;
+
+			if (ret != ERR_SUCCESS)
+				bin->ChunkCount = 0;
+		}
+
+		for (uint32_t j = 0; j < bin->ChunkCount; ++j) {
+			ret = _cursor_uint64(Cursor, &bin->Chunks[j].Begin);
+			if (ret == ERR_SUCCESS)
+				ret = _cursor_uint64(Cursor, &bin->Chunks[j].End);
+
+			if (ret != ERR_SUCCESS)
+				break;
+		}
+
+		if (ret != ERR_SUCCESS)
+			break;
+	}
+
+	if (ret == ERR_SUCCESS && !Csi) {
+		ret = _cursor_uint32(Cursor, &Reference->IntervalCount);
+		if (ret == ERR_SUCCESS && Reference->IntervalCount > 0) {
+			if ((size_t)(Cursor->End - Cursor->Data) / sizeof(uint64_t) >= Reference->IntervalCount)
+				ret = utils_calloc_uint64_t(Reference->IntervalCount, &Reference->Intervals);
+			else ret = ERR_BAM_INVALID_INDEX;
+
+			if (ret != ERR_SUCCESS)
+				Reference->IntervalCount = 0;
+		}
+
+		for (uint32_t i = 0; i < Reference->IntervalCount; ++i) {
+			ret = _cursor_uint64(Cursor, Reference->Intervals + i);
+			if (ret != ERR_SUCCESS)
+				break;
+		}
+	}
+
+	if (ret == ERR_SUCCESS && Reference->BinCount > 0)
+		qsort(Reference->Bins, Reference->BinCount, sizeof(BAM_INDEX_BIN), _bin_comparator);
+
+	return ret;
+}
+
+
+static ERR_VALUE _index_parse(const uint8_t *Data, const size_t Length, PBAM_INDEX Index)
+{
+	INDEX_CURSOR cursor;
+	uint32_t tmp32 = 0;
+	boolean csi = FALSE;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	cursor.Data = Data;
+	cursor.End = Data + Length;
+	ret = ERR_SUCCESS;
+	if (Length >= 4 && memcmp(Data, "BAI\1", 4) == 0) {
+		Index->MinShift = BAI_MIN_SHIFT;
+		Index->Depth = BAI_DEPTH;
+	} else if (Length >= 4 && memcmp(Data, "CSI\1", 4) == 0)
+		csi = TRUE;
+	else ret = ERR_BAM_INVALID_INDEX;
+
+	cursor.Data += 4;
+	if (ret == ERR_SUCCESS && csi) {
+		ret = _cursor_uint32(&cursor, &tmp32);
+		if (ret == ERR_SUCCESS) {
+			Index->MinShift = (int32_t)tmp32;
+			ret = _cursor_uint32(&cursor, &tmp32);
+		}
+
+		if (ret == ERR_SUCCESS) {
+			Index->Depth = (int32_t)tmp32;
+			ret = _cursor_uint32(&cursor, &tmp32);
+		}
+
+		if (ret == ERR_SUCCESS) {
+			if ((size_t)(cursor.End - cursor.Data) >= tmp32)
+				cursor.Data += tmp32;
+			else ret = ERR_BAM_INVALID_INDEX;
+		}
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = _cursor_uint32(&cursor, &tmp32);
+
+	if (ret == ERR_SUCCESS && tmp32 > 0) {
+		ret = utils_calloc_BAM_INDEX_REFERENCE(tmp32, &Index->References);
+		if (ret == ERR_SUCCESS)
+			Index->ReferenceCount = (int32_t)tmp32;
+	}
+
+	for (int32_t i = 0; i < Index->ReferenceCount; ++i) {
+		ret = _index_parse_reference(&cursor, csi, Index->References + i);
+		if (ret != ERR_SUCCESS)
+			break;
+	}
+
+	return ret;
+}
+
+
+static const BAM_INDEX_BIN *_index_find_bin(const BAM_INDEX_REFERENCE *Reference, const uint32_t Bin)
+{
+	BAM_INDEX_BIN key;
+
+	key.Bin = Bin;
+
+	return (Reference->BinCount > 0) ? (const BAM_INDEX_BIN *)bsearch(&key, Reference->Bins, Reference->BinCount, sizeof(BAM_INDEX_BIN), _bin_comparator) : NULL;
+}
+
+
+/** Returns the lowest virtual offset a record overlapping the given position can start at. */
+static uint64_t _index_min_offset(const BAM_INDEX *Index, const BAM_INDEX_REFERENCE *Reference, const uint64_t Start)
+{
+	const BAM_INDEX_BIN *bin = NULL;
+	uint32_t binNumber = 0;
+	uint64_t ret = 0;
+
+	if (Reference->Intervals != NULL) {
+		const uint64_t window = Start >> BAI_LINEAR_SHIFT;
+
+		if (window < Reference->IntervalCount)
+			ret = Reference->Intervals[window];
+		else if (Reference->IntervalCount > 0)
+			ret = Reference->Intervals[Reference->IntervalCount - 1];
+	} else {
+		binNumber = (uint32_t)((((uint64_t)1 << (3 * Index->Depth)) - 1) / 7 + (Start >> Index->MinShift));
+		while (TRUE) {
+			bin = _index_find_bin(Reference, binNumber);
+			if (bin != NULL || binNumber == 0)
+				break;
+
+			binNumber = (binNumber - 1) >> 3;
+		}
+
+		if (bin != NULL)
+			ret = bin->LOffset;
+	}
+
+	return ret;
+}
+
+
+/************************************************************************/
+/*                        PUBLIC FUNCTIONS                              */
+/************************************************************************/
+
+
+/** Loads the index of the given BAM file. The index is looked up as <file>.bai, <file without .bam>.bai and <file>.csi. */
+ERR_VALUE bam_index_load(const char *BamFileName, PBAM_INDEX Index)
+{
+	char *indexName = NULL;
+	const size_t nameLength = strlen(BamFileName);
+	uint8_t *data = NULL;
+	size_t dataLength = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(Index, 0, sizeof(BAM_INDEX));
+	ret = utils_calloc_char(nameLength + 5, &indexName);
+	if (ret == ERR_SUCCESS) {
+		sprintf(indexName, "%s.bai", BamFileName);
+		ret = utils_file_read(indexName, (char **)&data, &dataLength);
+		if (ret != ERR_SUCCESS && nameLength > 4 && strcmp(BamFileName + nameLength - 4, ".bam") == 0) {
+			strcpy(indexName + nameLength - 4, ".bai");
+			ret = utils_file_read(indexName, (char **)&data, &dataLength);
+		}
+
+		if (ret != ERR_SUCCESS) {
+			sprintf(indexName, "%s.csi", BamFileName);
+			ret = bgzf_file_read(indexName, &data, &dataLength);
+		}
+
+		if (ret == ERR_SUCCESS) {
+			ret = _index_parse(data, dataLength, Index);
+			if (ret != ERR_SUCCESS)
+				bam_index_free(Index);
+
+			utils_free(data);
+		}
+
+		utils_free(indexName);
+	}
+
+	return ret;
+}
+
+
+/** Computes sorted, non-overlapping chunks that contain all records of the given reference overlapping [Start; End). */
+ERR_VALUE bam_index_query(const BAM_INDEX *Index, const int32_t RefID, const uint64_t Start, const uint64_t End, PGEN_ARRAY_BAM_INDEX_CHUNK Chunks)
+{
+	const BAM_INDEX_REFERENCE *ref = NULL;
+	const BAM_INDEX_BIN *bin = NULL;
+	uint64_t minOffset = 0;
+	uint64_t lastPos = 0;
+	uint64_t maxPos = 0;
+	size_t count = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	dym_array_clear_BAM_INDEX_CHUNK(Chunks);
+	ret = ERR_SUCCESS;
+	if (0 <= RefID && RefID < Index->ReferenceCount && Start < End) {
+		ref = Index->References + RefID;
+		maxPos = ((uint64_t)1 << (Index->MinShift + 3 * Index->Depth)) - 1;
+		lastPos = min(End - 1, maxPos);
+		minOffset = _index_min_offset(Index, ref, Start);
+		for (int32_t level = 0; level <= Index->Depth; ++level) {
+			const int shift = Index->MinShift + 3 * (Index->Depth - level);
+			const uint32_t firstBin = (uint32_t)((((uint64_t)1 << (3 * level)) - 1) / 7);
+
+			for (uint64_t b = (Start >> shift); b <= (lastPos >> shift); ++b) {
+				bin = _index_find_bin(ref, firstBin + (uint32_t)b);
+				if (bin != NULL) {
+					for (uint32_t i = 0; i < bin->ChunkCount; ++i) {
+						if (bin->Chunks[i].End > minOffset) {
+							ret = dym_array_push_back_BAM_INDEX_CHUNK(Chunks, bin->Chunks[i]);
+							if (ret != ERR_SUCCESS)
+								break;
+						}
+					}
+				}
+
+				if (ret != ERR_SUCCESS)
+					break;
+			}
+
+			if (ret != ERR_SUCCESS)
+				break;
+		}
+
+		if (ret == ERR_SUCCESS && gen_array_size(Chunks) > 0) {
+			qsort(Chunks->Data, gen_array_size(Chunks), sizeof(BAM_INDEX_CHUNK), _chunk_comparator);
+			count = 1;
+			for (size_t i = 1; i < gen_array_size(Chunks); ++i) {
+				PBAM_INDEX_CHUNK last = Chunks->Data + count - 1;
+
+				if (Chunks->Data[i].Begin <= last->End)
+					last->End = max(last->End, Chunks->Data[i].End);
+				else Chunks->Data[count++] = Chunks->Data[i];
+			}
+
+			Chunks->ValidLength = count;
+			if (Chunks->Data[0].Begin < minOffset)
+				Chunks->Data[0].Begin = minOffset;
+		}
+	}
+
+	return ret;
+}
+
+
+void bam_index_free(PBAM_INDEX Index)
+{
+	PBAM_INDEX_REFERENCE ref = NULL;
+
+	for (int32_t i = 0; i < Index->ReferenceCount; ++i) {
+		ref = Index->References + i;
+		for (uint32_t j = 0; j < ref->BinCount; ++j) {
+			if (ref->Bins[j].Chunks != NULL)
+				utils_free(ref->Bins[j].Chunks);
+		}
+
+		if (ref->Bins != NULL)
+			utils_free(ref->Bins);
+
+		if (ref->Intervals != NULL)
+			utils_free(ref->Intervals);
+	}
+
+	if (Index->References != NULL)
+		utils_free(Index->References);
+
+	memset(Index, 0, sizeof(BAM_INDEX));
+
+	return;
+}
@@ -0,0 +1,53 @@
+
+#ifndef __BAM_INDEX_H__
+#define __BAM_INDEX_H__
+
+
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+#include "gen_dym_array.h"
+
+
+/** A range of BGZF virtual offsets containing records of one bin. */
+typedef struct _BAM_INDEX_CHUNK {
+	uint64_t Begin;
+	uint64_t End;
+} BAM_INDEX_CHUNK, *PBAM_INDEX_CHUNK;
+
+GEN_ARRAY_TYPEDEF(BAM_INDEX_CHUNK);
+GEN_ARRAY_IMPLEMENTATION(BAM_INDEX_CHUNK)
+
+typedef struct _BAM_INDEX_BIN {
+	uint32_t Bin;
+	/** Virtual offset of the first record overlapping the bin (CSI only). */
+	uint64_t LOffset;
+	uint32_t ChunkCount;
+	PBAM_INDEX_CHUNK Chunks;
+} BAM_INDEX_BIN, *PBAM_INDEX_BIN;
+
+typedef struct _BAM_INDEX_REFERENCE {
+	/** Bins sorted by their numbers. */
+	uint32_t BinCount;
+	PBAM_INDEX_BIN Bins;
+	/** The linear index (BAI only): virtual offsets of the first records overlapping 16 kbp windows. */
+	uint32_t IntervalCount;
+	uint64_t *Intervals;
+} BAM_INDEX_REFERENCE, *PBAM_INDEX_REFERENCE;
+
+/** A BAI or CSI index of a coordinate-sorted BAM file. */
+typedef struct _BAM_INDEX {
+	int32_t MinShift;
+	int32_t Depth;
+	int32_t ReferenceCount;
+	PBAM_INDEX_REFERENCE References;
+} BAM_INDEX, *PBAM_INDEX;
+
+
+ERR_VALUE bam_index_load(const char *BamFileName, PBAM_INDEX Index);
+ERR_VALUE bam_index_query(const BAM_INDEX *Index, const int32_t RefID, const uint64_t Start, const uint64_t End, PGEN_ARRAY_BAM_INDEX_CHUNK Chunks);
+void bam_index_free(PBAM_INDEX Index);
+
+
+
+#endif
@@ -0,0 +1,718 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifndef _MSC_VER
+#include <pthread.h>
+#endif
+#include "err.h"
+#include "utils.h"
+#include "file-utils.h"
+#include "kthread.h"
+#include "bgzf.h"
+
+
+/************************************************************************/
+/*                        HELPER FUNCTIONS                              */
+/************************************************************************/
+
+
+static uint16_t _le16(const uint8_t *Data)
+{
+	return (uint16_t)(Data[0] | (Data[1] << 8));
+}
+
+
+static uint32_t _le32(const uint8_t *Data)
+{
+	return ((uint32_t)Data[0] | ((uint32_t)Data[1] << 8) | ((uint32_t)Data[2] << 16) | ((uint32_t)Data[3] << 24));
+}
+
+
+/** Reads one compressed block from the current file position. Returns ERR_NO_MORE_ENTRIES at the end of the file. */
+static ERR_VALUE _bgzf_read_compressed_block(FILE *Stream, uint8_t *Buffer, size_t *Length)
+{
+	size_t bytesRead = 0;
+	size_t blockSize = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	bytesRead = fread(Buffer, 1, BGZF_BLOCK_HEADER_SIZE, Stream);
+	if (bytesRead == BGZF_BLOCK_HEADER_SIZE) {
+		if (bgzf_is_bgzf(Buffer, bytesRead)) {
+			blockSize = (size_t)_le16(Buffer + 16) + 1;
+			if (blockSize > BGZF_BLOCK_HEADER_SIZE + BGZF_BLOCK_FOOTER_SIZE) {
+				ret = utils_fread(Buffer + BGZF_BLOCK_HEADER_SIZE, 1, blockSize - BGZF_BLOCK_HEADER_SIZE, Stream);
+				if (ret == ERR_SUCCESS)
+					*Length = blockSize;
+			} else ret = ERR_BGZF_INVALID_BLOCK;
+		} else ret = ERR_BGZF_INVALID_BLOCK;
+	} else if (bytesRead == 0 && feof(Stream))
+		ret = ERR_NO_MORE_ENTRIES;
+	else ret = ERR_IO_ERROR;
+
+	return ret;
+}
+
+
+#ifndef _MSC_VER
+
+/** A group of consecutive blocks travelling through the decompression pipeline. */
+typedef struct _BGZF_BATCH {
+	struct _BGZF_BATCH *Next;
+	/** Number of blocks read into the batch. */
+	size_t Count;
+	/** Index of the next block to be handed to the consumer. */
+	size_t Current;
+	/** Result of reading the block that follows the last one (ERR_NO_MORE_ENTRIES at the end of the file). */
+	ERR_VALUE Status;
+	/** Compressed blocks followed by the inflated ones, BGZF_MAX_BLOCK_SIZE bytes each. */
+	uint8_t *Compressed;
+	uint8_t *Blocks;
+	size_t CompressedLengths[BGZF_PIPELINE_BATCH_SIZE];
+	size_t BlockLengths[BGZF_PIPELINE_BATCH_SIZE];
+	ERR_VALUE BlockStatus[BGZF_PIPELINE_BATCH_SIZE];
+} BGZF_BATCH, *PBGZF_BATCH;
+
+/** Reads compressed blocks, inflates them in parallel and queues them in the file order. The pipeline
+    runs in its own thread; the consumer takes whole batches from the Ready queue and returns them to
+    the Free list. */
+typedef struct _BGZF_PIPELINE {
+	FILE *Stream;
+	uint32_t Workers;
+	void *ForPool;
+	pthread_t Thread;
+	pthread_mutex_t Mutex;
+	pthread_cond_t Cond;
+	PBGZF_BATCH Ready;
+	PBGZF_BATCH ReadyTail;
+	size_t ReadyCount;
+	PBGZF_BATCH Free;
+	/** The batch being consumed (accessed by the consumer only). */
+	PBGZF_BATCH Current;
+	/** Set by the reading stage when no further blocks can be read. */
+	boolean StreamDone;
+	/** Set when the pipeline thread has finished. */
+	boolean Finished;
+	/** Set by the consumer to stop the pipeline early. */
+	boolean Terminate;
+	ERR_VALUE Error;
+} BGZF_PIPELINE, *PBGZF_PIPELINE;
+
+#endif
+
+static uint32_t _bgzfWorkers = 1;
+
+
+static ERR_VALUE _bgzf_load_next_block_sequential(PBGZF_FILE File)
+{
+	size_t compressedLength = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	File->BlockAddress = File->NextBlockAddress;
+	File->BlockOffset = 0;
+	File->BlockLength = 0;
+	ret = _bgzf_read_compressed_block(File->Stream, File->CompressedBlock, &compressedLength);
+	if (ret == ERR_SUCCESS) {
+		File->NextBlockAddress += compressedLength;
+		File->CompressedBytesRead += compressedLength;
+		ret = bgzf_inflate_block(File->CompressedBlock, compressedLength, File->Block, &File->BlockLength);
+		if (ret == ERR_SUCCESS)
+			File->BytesRead += File->BlockLength;
+	} else if (ret == ERR_NO_MORE_ENTRIES)
+		File->EndOfFile = TRUE;
+
+	return ret;
+}
+
+#ifndef _MSC_VER
+
+static void _bgzf_batch_free(PBGZF_BATCH Batch)
+{
+	utils_free(Batch->Compressed);
+	utils_free(Batch);
+
+	return;
+}
+
+
+static void _bgzf_batch_list_free(PBGZF_BATCH List)
+{
+	PBGZF_BATCH next = NULL;
+
+	while (List != NULL) {
+		next = List->Next;
+		_bgzf_batch_free(List);
+		List = next;
+	}
+
+	return;
+}
+
+
+static PBGZF_BATCH _bgzf_pipeline_get_free_batch(PBGZF_PIPELINE Pipeline)
+{
+	PBGZF_BATCH ret = NULL;
+
+	pthread_mutex_lock(&Pipeline->Mutex);
+	ret = Pipeline->Free;
+	if (ret != NULL)
+		Pipeline->Free = ret->Next;
+
+	pthread_mutex_unlock(&Pipeline->Mutex);
+	if (ret == NULL) {
+		if (utils_malloc(sizeof(BGZF_BATCH), (void **)&ret) == ERR_SUCCESS) {
+			if (utils_malloc(2 * BGZF_PIPELINE_BATCH_SIZE * BGZF_MAX_BLOCK_SIZE, (void **)&ret->Compressed) == ERR_SUCCESS)
+				ret->Blocks = ret->Compressed + BGZF_PIPELINE_BATCH_SIZE * BGZF_MAX_BLOCK_SIZE;
+			else {
+				utils_free(ret);
+				ret = NULL;
+			}
+		}
+	}
+
+	return ret;
+}
+
+
+static void _bgzf_pipeline_inflate(void *Data, long Index, int ThreadNo)
+{
+	PBGZF_BATCH batch = (PBGZF_BATCH)Data;
+
+	batch->BlockStatus[Index] = bgzf_inflate_block(batch->Compressed + Index * BGZF_MAX_BLOCK_SIZE, batch->CompressedLengths[Index], batch->Blocks + Index * BGZF_MAX_BLOCK_SIZE, batch->BlockLengths + Index);
+
+	return;
+}
+
+
+static void *_bgzf_pipeline_step(void *Shared, int Step, void *In)
+{
+	PBGZF_PIPELINE p = (PBGZF_PIPELINE)Shared;
+	PBGZF_BATCH batch = (PBGZF_BATCH)In;
+	void *ret = NULL;
+
+	switch (Step) {
+		case 0:
+			if (!p->StreamDone && !p->Terminate) {
+				batch = _bgzf_pipeline_get_free_batch(p);
+				if (batch != NULL) {
+					batch->Next = NULL;
+					batch->Count = 0;
+					batch->Current = 0;
+					batch->Status = ERR_SUCCESS;
+					while (batch->Count < BGZF_PIPELINE_BATCH_SIZE) {
+						batch->Status = _bgzf_read_compressed_block(p->Stream, batch->Compressed + batch->Count * BGZF_MAX_BLOCK_SIZE, batch->CompressedLengths + batch->Count);
+						if (batch->Status != ERR_SUCCESS) {
+							p->StreamDone = TRUE;
+							break;
+						}
+
+						++batch->Count;
+					}
+
+					ret = batch;
+				} else {
+					p->Error = ERR_OUT_OF_MEMORY;
+					p->StreamDone = TRUE;
+				}
+			}
+			break;
+		case 1:
+			kt_forpool(p->ForPool, _bgzf_pipeline_inflate, batch, (long)batch->Count);
+			ret = batch;
+			break;
+		case 2:
+			pthread_mutex_lock(&p->Mutex);
+			while (p->ReadyCount >= BGZF_PIPELINE_QUEUE_LENGTH && !p->Terminate)
+				pthread_cond_wait(&p->Cond, &p->Mutex);
+
+			if (!p->Terminate) {
+				if (p->ReadyTail != NULL)
+					p->ReadyTail->Next = batch;
+				else p->Ready = batch;
+
+				p->ReadyTail = batch;
+				++p->ReadyCount;
+			} else {
+				batch->Next = p->Free;
+				p->Free = batch;
+			}
+
+			pthread_cond_broadcast(&p->Cond);
+			pthread_mutex_unlock(&p->Mutex);
+			ret = batch;
+			break;
+	}
+
+	return ret;
+}
+
+
+static void *_bgzf_pipeline_thread(void *Context)
+{
+	PBGZF_PIPELINE p = (PBGZF_PIPELINE)Context;
+
+	kt_pipeline(3, _bgzf_pipeline_step, p, 3);
+	pthread_mutex_lock(&p->Mutex);
+	p->Finished = TRUE;
+	pthread_cond_broadcast(&p->Cond);
+	pthread_mutex_unlock(&p->Mutex);
+
+	return NULL;
+}
+
+
+/** Hands the next inflated block of the pipeline to the file. */
+static ERR_VALUE _bgzf_pipeline_next_block(PBGZF_FILE File)
+{
+	PBGZF_PIPELINE p = File->Pipeline;
+	PBGZF_BATCH batch = p->Current;
+	size_t index = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	File->BlockAddress = File->NextBlockAddress;
+	File->BlockOffset = 0;
+	File->BlockLength = 0;
+	ret = ERR_SUCCESS;
+	if (batch != NULL && batch->Current == batch->Count) {
+		ret = batch->Status;
+		if (ret == ERR_SUCCESS) {
+			pthread_mutex_lock(&p->Mutex);
+			batch->Next = p->Free;
+			p->Free = batch;
+			p->Current = NULL;
+			batch = NULL;
+			pthread_mutex_unlock(&p->Mutex);
+		}
+	}
+
+	if (ret == ERR_SUCCESS && batch == NULL) {
+		pthread_mutex_lock(&p->Mutex);
+		while (p->Ready == NULL && !p->Finished)
+			pthread_cond_wait(&p->Cond, &p->Mutex);
+
+		batch = p->Ready;
+		if (batch != NULL) {
+			p->Ready = batch->Next;
+			if (p->Ready == NULL)
+				p->ReadyTail = NULL;
+
+			--p->ReadyCount;
+			p->Current = batch;
+			pthread_cond_broadcast(&p->Cond);
+		} else ret = (p->Error != ERR_SUCCESS) ? p->Error : ERR_NO_MORE_ENTRIES;
+
+		pthread_mutex_unlock(&p->Mutex);
+		if (batch != NULL && batch->Count == 0)
+			ret = batch->Status;
+	}
+
+	if (ret == ERR_SUCCESS) {
+		index = batch->Current;
+		++batch->Current;
+		File->NextBlockAddress += batch->CompressedLengths[index];
+		File->CompressedBytesRead += batch->CompressedLengths[index];
+		ret = batch->BlockStatus[index];
+		if (ret == ERR_SUCCESS) {
+			File->BlockLength = batch->BlockLengths[index];
+			memcpy(File->Block, batch->Blocks + index * BGZF_MAX_BLOCK_SIZE, File->BlockLength);
+			File->BytesRead += File->BlockLength;
+		}
+	}
+
+	if (ret == ERR_NO_MORE_ENTRIES)
+		File->EndOfFile = TRUE;
+
+	return ret;
+}
+
+
+static void _bgzf_pipeline_stop(PBGZF_FILE File)
+{
+	PBGZF_PIPELINE p = File->Pipeline;
+
+	pthread_mutex_lock(&p->Mutex);
+	p->Terminate = TRUE;
+	pthread_cond_broadcast(&p->Cond);
+	pthread_mutex_unlock(&p->Mutex);
+	pthread_join(p->Thread, NULL);
+	kt_forpool_destroy(p->ForPool);
+	if (p->Current != NULL)
+		_bgzf_batch_free(p->Current);
+
+	_bgzf_batch_list_free(p->Ready);
+	_bgzf_batch_list_free(p->Free);
+	pthread_cond_destroy(&p->Cond);
+	pthread_mutex_destroy(&p->Mutex);
+	utils_free(p);
+	File->Pipeline = NULL;
+
+	return;
+}
+
+#endif
+
+
+static ERR_VALUE _bgzf_load_next_block(PBGZF_FILE File)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+#ifndef _MSC_VER
+	if (File->Pipeline != NULL)
+		ret = _bgzf_pipeline_next_block(File);
+	else ret = _bgzf_load_next_block_sequential(File);
+#else
+	ret = _bgzf_load_next_block_sequential(File);
+#endif
+
+	return ret;
+}
+
+
+/** Makes sure the current block contains unread data (empty blocks, such as the EOF marker, are skipped). */
+static ERR_VALUE _bgzf_ensure_data(PBGZF_FILE File)
+{
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	while (ret == ERR_SUCCESS && File->BlockOffset == File->BlockLength) {
+		if (!File->EndOfFile)
+			ret = _bgzf_load_next_block(File);
+		else ret = ERR_NO_MORE_ENTRIES;
+	}
+
+	return ret;
+}
+
+
+/************************************************************************/
+/*                        PUBLIC FUNCTIONS                              */
+/************************************************************************/
+
+
+/** Checks whether the data starts with a gzip header carrying the BGZF (BC) extra subfield. */
+boolean bgzf_is_bgzf(const uint8_t *Data, const size_t Length)
+{
+	return (Length >= BGZF_BLOCK_HEADER_SIZE &&
+		Data[0] == 31 && Data[1] == 139 && Data[2] == 8 && (Data[3] & 4) != 0 &&
+		_le16(Data + 10) == 6 && Data[12] == 'B' && Data[13] == 'C' && _le16(Data + 14) == 2);
+}
+
+
+/** Decompresses one whole BGZF block. The output buffer must hold BGZF_MAX_BLOCK_SIZE bytes. */
+ERR_VALUE bgzf_inflate_block(const uint8_t *Compressed, const size_t CompressedLength, uint8_t *Block, size_t *BlockLength)
+{
+	z_stream zs;
+	uint32_t crc = 0;
+	uint32_t isize = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	isize = _le32(Compressed + CompressedLength - 4);
+	crc = _le32(Compressed + CompressedLength - 8);
+	if (isize <= BGZF_MAX_BLOCK_SIZE) {
+		memset(&zs, 0, sizeof(zs));
+		zs.next_in = (Bytef *)(Compressed + BGZF_BLOCK_HEADER_SIZE);
+		zs.avail_in = (uInt)(CompressedLength - BGZF_BLOCK_HEADER_SIZE - BGZF_BLOCK_FOOTER_SIZE);
+		zs.next_out = Block;
+		zs.avail_out = BGZF_MAX_BLOCK_SIZE;
+		if (inflateInit2(&zs, -15) == Z_OK) {
+			if (inflate(&zs, Z_FINISH) == Z_STREAM_END && zs.total_out == isize) {
+				if (crc32(crc32(0L, Z_NULL, 0), Block, isize) == crc) {
+					*BlockLength = isize;
+					ret = ERR_SUCCESS;
+				} else ret = ERR_BGZF_INVALID_BLOCK;
+			} else ret = ERR_BGZF_INFLATE_FAILED;
+
+			inflateEnd(&zs);
+		} else ret = ERR_BGZF_INFLATE_FAILED;
+	} else ret = ERR_BGZF_INVALID_BLOCK;
+
+	return ret;
+}
+
+
+/** Sets the number of threads inflating blocks of the files read through the pipeline. */
+void bgzf_set_workers(const uint32_t Count)
+{
+	_bgzfWorkers = (Count > 0) ? Count : 1;
+
+	return;
+}
+
+
+ERR_VALUE bgzf_open(const char *FileName, PBGZF_FILE File)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(File, 0, sizeof(BGZF_FILE));
+	ret = utils_calloc_uint8_t(2 * BGZF_MAX_BLOCK_SIZE, &File->Block);
+	if (ret == ERR_SUCCESS) {
+		File->CompressedBlock = File->Block + BGZF_MAX_BLOCK_SIZE;
+		ret = utils_fopen(FileName, FOPEN_MODE_READ, &File->Stream);
+		if (ret != ERR_SUCCESS)
+			utils_free(File->Block);
+	}
+
+	return ret;
+}
+
+
+/** Opens a BGZF file from a stream whose first block header (BGZF_BLOCK_HEADER_SIZE bytes) has already been
+    read, so that pipes can be decompressed without reopening them. The first block is inflated immediately.
+    The stream is owned by the file if the function succeeds. */
+ERR_VALUE bgzf_open_stream(FILE *Stream, const uint8_t *Header, PBGZF_FILE File)
+{
+	size_t blockSize = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(File, 0, sizeof(BGZF_FILE));
+	ret = utils_calloc_uint8_t(2 * BGZF_MAX_BLOCK_SIZE, &File->Block);
+	if (ret == ERR_SUCCESS) {
+		File->CompressedBlock = File->Block + BGZF_MAX_BLOCK_SIZE;
+		File->Stream = Stream;
+		blockSize = (size_t)_le16(Header + 16) + 1;
+		if (bgzf_is_bgzf(Header, BGZF_BLOCK_HEADER_SIZE) && blockSize > BGZF_BLOCK_HEADER_SIZE + BGZF_BLOCK_FOOTER_SIZE) {
+			memcpy(File->CompressedBlock, Header, BGZF_BLOCK_HEADER_SIZE);
+			ret = utils_fread(File->CompressedBlock + BGZF_BLOCK_HEADER_SIZE, 1, blockSize - BGZF_BLOCK_HEADER_SIZE, Stream);
+			if (ret == ERR_SUCCESS)
+				ret = bgzf_inflate_block(File->CompressedBlock, blockSize, File->Block, &File->BlockLength);
+
+			if (ret == ERR_SUCCESS) {
+				File->NextBlockAddress = blockSize;
+				File->CompressedBytesRead = blockSize;
+				File->BytesRead = File->BlockLength;
+			}
+		} else ret = ERR_BGZF_INVALID_BLOCK;
+
+		if (ret != ERR_SUCCESS)
+			utils_free(File->Block);
+	}
+
+	return ret;
+}
+
+
+/** Starts inflating the blocks ahead of the reader in a background pipeline. Does nothing if only one worker
+    is configured. Intended for files read sequentially; seeking stops the pipeline. The current block is
+    consumed before the pipeline output. */
+ERR_VALUE bgzf_pipeline_start(PBGZF_FILE File)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+#ifndef _MSC_VER
+	PBGZF_PIPELINE p = NULL;
+#endif
+
+	ret = ERR_SUCCESS;
+#ifndef _MSC_VER
+	if (_bgzfWorkers > 1 && File->Pipeline == NULL && !File->EndOfFile) {
+		ret = utils_calloc(1, sizeof(BGZF_PIPELINE), (void **)&p);
+		if (ret == ERR_SUCCESS) {
+			p->Stream = File->Stream;
+			p->Workers = _bgzfWorkers;
+			p->Error = ERR_SUCCESS;
+			pthread_mutex_init(&p->Mutex, NULL);
+			pthread_cond_init(&p->Cond, NULL);
+			p->ForPool = kt_forpool_init((int)p->Workers);
+			File->Pipeline = p;
+			if (pthread_create(&p->Thread, NULL, _bgzf_pipeline_thread, p) != 0) {
+				kt_forpool_destroy(p->ForPool);
+				pthread_cond_destroy(&p->Cond);
+				pthread_mutex_destroy(&p->Mutex);
+				utils_free(p);
+				File->Pipeline = NULL;
+				ret = ERR_INTERNAL_ERROR;
+			}
+		}
+	}
+#endif
+
+	return ret;
+}
+
+
+/** Reads exactly Length bytes. ERR_NO_MORE_ENTRIES is returned if the file ends before any byte is read. */
+ERR_VALUE bgzf_read(PBGZF_FILE File, void *Buffer, const size_t Length)
+{
+	size_t copyLength = 0;
+	size_t remaining = Length;
+	uint8_t *target = (uint8_t *)Buffer;
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	while (ret == ERR_SUCCESS && remaining > 0) {
+		ret = _bgzf_ensure_data(File);
+		if (ret == ERR_SUCCESS) {
+			copyLength = min(remaining, File->BlockLength - File->BlockOffset);
+			memcpy(target, File->Block + File->BlockOffset, copyLength);
+			File->BlockOffset += copyLength;
+			target += copyLength;
+			remaining -= copyLength;
+		} else if (ret == ERR_NO_MORE_ENTRIES && remaining < Length)
+			ret = ERR_IO_ERROR;
+	}
+
+	return ret;
+}
+
+
+/** Reads at most Length bytes. *ReadLength is zero at the end of the file. */
+ERR_VALUE bgzf_read_partial(PBGZF_FILE File, void *Buffer, const size_t Length, size_t *ReadLength)
+{
+	size_t copyLength = 0;
+	size_t remaining = Length;
+	uint8_t *target = (uint8_t *)Buffer;
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	while (ret == ERR_SUCCESS && remaining > 0) {
+		ret = _bgzf_ensure_data(File);
+		if (ret == ERR_SUCCESS) {
+			copyLength = min(remaining, File->BlockLength - File->BlockOffset);
+			memcpy(target, File->Block + File->BlockOffset, copyLength);
+			File->BlockOffset += copyLength;
+			target += copyLength;
+			remaining -= copyLength;
+		}
+	}
+
+	if (ret == ERR_NO_MORE_ENTRIES)
+		ret = ERR_SUCCESS;
+
+	if (ret == ERR_SUCCESS)
+		*ReadLength = Length - remaining;
+
+	return ret;
+}
+
+
+ERR_VALUE bgzf_skip(PBGZF_FILE File, size_t Length)
+{
+	size_t skipLength = 0;
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	while (ret == ERR_SUCCESS && Length > 0) {
+		ret = _bgzf_ensure_data(File);
+		if (ret == ERR_SUCCESS) {
+			skipLength = min(Length, File->BlockLength - File->BlockOffset);
+			File->BlockOffset += skipLength;
+			Length -= skipLength;
+		} else if (ret == ERR_NO_MORE_ENTRIES)
+			ret = ERR_IO_ERROR;
+	}
+
+	return ret;
+}
+
+
+/** Moves to the given virtual offset. The block is reloaded only if the offset lies outside the current one. */
+ERR_VALUE bgzf_seek(PBGZF_FILE File, const uint64_t VOffset)
+{
+	const uint64_t blockAddress = bgzf_voffset_block(VOffset);
+	const size_t blockOffset = (size_t)bgzf_voffset_offset(VOffset);
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+#ifndef _MSC_VER
+	if (File->Pipeline != NULL)
+		_bgzf_pipeline_stop(File);
+#endif
+
+	if (blockAddress != File->BlockAddress || File->BlockLength == 0) {
+#ifdef _MSC_VER
+		if (_fseeki64(File->Stream, (__int64)blockAddress, SEEK_SET) != 0)
+#else
+		if (fseeko(File->Stream, (off_t)blockAddress, SEEK_SET) != 0)
+#endif
+			ret = ERR_IO_ERROR;
+
+		if (ret == ERR_SUCCESS) {
+			File->NextBlockAddress = blockAddress;
+			File->EndOfFile = FALSE;
+			ret = _bgzf_load_next_block(File);
+			if (ret == ERR_NO_MORE_ENTRIES && blockOffset == 0)
+				ret = ERR_SUCCESS;
+		}
+	}
+
+	if (ret == ERR_SUCCESS) {
+		if (blockOffset <= File->BlockLength)
+			File->BlockOffset = blockOffset;
+		else ret = ERR_BGZF_INVALID_BLOCK;
+	}
+
+	return ret;
+}
+
+
+/** Returns the virtual offset of the current position. */
+uint64_t bgzf_tell(const BGZF_FILE *File)
+{
+	uint64_t ret = 0;
+
+	if (File->BlockOffset < File->BlockLength)
+		ret = bgzf_make_voffset(File->BlockAddress, File->BlockOffset);
+	else ret = bgzf_make_voffset(File->NextBlockAddress, 0);
+
+	return ret;
+}
+
+
+/** Decompresses a whole BGZF file into memory. */
+ERR_VALUE bgzf_file_read(const char *FileName, uint8_t **Data, size_t *Length)
+{
+	BGZF_FILE file;
+	uint8_t *tmpData = NULL;
+	uint8_t *newData = NULL;
+	size_t tmpLength = 0;
+	size_t allocLength = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = bgzf_open(FileName, &file);
+	if (ret == ERR_SUCCESS) {
+		while (ret == ERR_SUCCESS) {
+			ret = _bgzf_load_next_block(&file);
+			if (ret == ERR_SUCCESS && tmpLength + file.BlockLength > allocLength) {
+				allocLength = max(2 * allocLength, tmpLength + file.BlockLength);
+				ret = utils_malloc(allocLength, (void **)&newData);
+				if (ret == ERR_SUCCESS) {
+					if (tmpData != NULL) {
+						memcpy(newData, tmpData, tmpLength);
+						utils_free(tmpData);
+					}
+
+					tmpData = newData;
+				}
+			}
+
+			if (ret == ERR_SUCCESS) {
+				memcpy(tmpData + tmpLength, file.Block, file.BlockLength);
+				tmpLength += file.BlockLength;
+			}
+		}
+
+		if (ret == ERR_NO_MORE_ENTRIES)
+			ret = (tmpLength > 0) ? ERR_SUCCESS : ERR_BGZF_INVALID_BLOCK;
+
+		if (ret == ERR_SUCCESS) {
+			*Data = tmpData;
+			*Length = tmpLength;
+		}
+
+		if (ret != ERR_SUCCESS && tmpData != NULL)
+			utils_free(tmpData);
+
+		bgzf_close(&file);
+	}
+
+	return ret;
+}
+
+
+void bgzf_close(PBGZF_FILE File)
+{
+#ifndef _MSC_VER
+	if (File->Pipeline != NULL)
+		_bgzf_pipeline_stop(File);
+
+#endif
+	utils_fclose(File->Stream);
+	utils_free(File->Block);
+
+	return;
+}
@@ -0,0 +1,74 @@
+
+#ifndef __BGZF_H__
+#define __BGZF_H__
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+
+
+/** Maximum size of one BGZF block (both compressed and uncompressed). */
+#define BGZF_MAX_BLOCK_SIZE					0x10000
+/** Size of the BGZF block header (gzip header with the BC extra subfield). */
+#define BGZF_BLOCK_HEADER_SIZE				18
+/** Size of the gzip footer (CRC32 and ISIZE). */
+#define BGZF_BLOCK_FOOTER_SIZE				8
+
+/** Virtual file offset: compressed block address in the upper 48 bits, offset within the uncompressed block in the lower 16 bits. */
+#define bgzf_make_voffset(aBlockAddress, aBlockOffset)		(((uint64_t)(aBlockAddress) << 16) | ((aBlockOffset) & 0xffff))
+#define bgzf_voffset_block(aVOffset)						((aVOffset) >> 16)
+#define bgzf_voffset_offset(aVOffset)						((aVOffset) & 0xffff)
+
+/** Number of blocks read and inflated together by the decompression pipeline. */
+#define BGZF_PIPELINE_BATCH_SIZE			64
+/** Maximum number of inflated batches waiting for the consumer. */
+#define BGZF_PIPELINE_QUEUE_LENGTH			2
+
+struct _BGZF_PIPELINE;
+
+/** A sequentially read BGZF (blocked gzip) file, used by BAM and bgzip-compressed text files. */
+typedef struct _BGZF_FILE {
+	FILE *Stream;
+	/** The current uncompressed block. */
+	uint8_t *Block;
+	/** Number of valid bytes in the current block. */
+	size_t BlockLength;
+	/** Read position within the current block. */
+	size_t BlockOffset;
+	/** File offset of the current block. */
+	uint64_t BlockAddress;
+	/** File offset of the next block. */
+	uint64_t NextBlockAddress;
+	/** Buffer for one compressed block. */
+	uint8_t *CompressedBlock;
+	boolean EndOfFile;
+	/** Number of compressed bytes read from the file. */
+	uint64_t CompressedBytesRead;
+	/** Number of uncompressed bytes produced. */
+	uint64_t BytesRead;
+	/** Background decompression pipeline (NULL if the blocks are inflated by the reading thread). */
+	struct _BGZF_PIPELINE *Pipeline;
+} BGZF_FILE, *PBGZF_FILE;
+
+
+boolean bgzf_is_bgzf(const uint8_t *Data, const size_t Length);
+ERR_VALUE bgzf_inflate_block(const uint8_t *Compressed, const size_t CompressedLength, uint8_t *Block, size_t *BlockLength);
+
+void bgzf_set_workers(const uint32_t Count);
+ERR_VALUE bgzf_open(const char *FileName, PBGZF_FILE File);
+ERR_VALUE bgzf_open_stream(FILE *Stream, const uint8_t *Header, PBGZF_FILE File);
+ERR_VALUE bgzf_pipeline_start(PBGZF_FILE File);
+ERR_VALUE bgzf_read(PBGZF_FILE File, void *Buffer, const size_t Length);
+ERR_VALUE bgzf_read_partial(PBGZF_FILE File, void *Buffer, const size_t Length, size_t *ReadLength);
+ERR_VALUE bgzf_skip(PBGZF_FILE File, size_t Length);
+ERR_VALUE bgzf_seek(PBGZF_FILE File, const uint64_t VOffset);
+uint64_t bgzf_tell(const BGZF_FILE *File);
+void bgzf_close(PBGZF_FILE File);
+
+ERR_VALUE bgzf_file_read(const char *FileName, uint8_t **Data, size_t *Length);
+
+
+
+#endif
@@ -0,0 +1,708 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "err.h"
+#include "utils.h"
+#include "rans.h"
+#include "cram-codec.h"
+
+
+/************************************************************************/
+/*                        HELPER FUNCTIONS                              */
+/************************************************************************/
+
+UTILS_TYPED_CALLOC_FUNCTION(CRAM_CODEC)
+
+
+static ERR_VALUE _cram_reserve(uint8_t **Buffer, size_t *AllocLength, const size_t Length)
+{
+	uint8_t *tmp = NULL;
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	if (*AllocLength < Length || *Buffer == NULL) {
+		size_t newLength = max(max(Length, 2 * (*AllocLength)), 64);
+
+		ret = utils_malloc(newLength, (void **)&tmp);
+		if (ret == ERR_SUCCESS) {
+			if (*Buffer != NULL)
+				utils_free(*Buffer);
+
+			*Buffer = tmp;
+			*AllocLength = newLength;
+		}
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_read_bit(PCRAM_BLOCK Core, uint32_t *Bit)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (Core != NULL && Core->Offset < Core->Length) {
+		*Bit = (Core->Data[Core->Offset] >> (7 - Core->BitOffset)) & 1;
+		++Core->BitOffset;
+		if (Core->BitOffset == 8) {
+			Core->BitOffset = 0;
+			++Core->Offset;
+		}
+
+		ret = ERR_SUCCESS;
+	} else ret = ERR_CRAM_INVALID_RECORD;
+
+	return ret;
+}
+
+
+/** Reads up to 32 bits of the core data block, the most significant bit first. */
+static ERR_VALUE _cram_read_bits(PCRAM_BLOCK Core, const uint32_t Count, uint32_t *Value)
+{
+	uint32_t bit = 0;
+	uint32_t value = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	for (uint32_t i = 0; i < Count; ++i) {
+		ret = _cram_read_bit(Core, &bit);
+		if (ret != ERR_SUCCESS)
+			break;
+
+		value = (value << 1) | bit;
+	}
+
+	if (ret == ERR_SUCCESS)
+		*Value = value;
+
+	return ret;
+}
+
+
+/** Assigns the canonical codes: symbols are ordered by the code length and value, each code is the previous
+    one plus one, shifted left by the difference of the lengths. */
+static ERR_VALUE _cram_huffman_build(PCRAM_CODEC Codec)
+{
+	int32_t tmpSymbol = 0;
+	uint32_t tmpLength = 0;
+	uint32_t code = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	for (int32_t i = 1; i < Codec->SymbolCount; ++i) {
+		for (int32_t j = i; j > 0; --j) {
+			if (Codec->CodeLengths[j - 1] < Codec->CodeLengths[j] ||
+				(Codec->CodeLengths[j - 1] == Codec->CodeLengths[j] && Codec->Symbols[j - 1] <= Codec->Symbols[j]))
+				break;
+
+			tmpSymbol = Codec->Symbols[j];
+			Codec->Symbols[j] = Codec->Symbols[j - 1];
+			Codec->Symbols[j - 1] = tmpSymbol;
+			tmpLength = Codec->CodeLengths[j];
+			Codec->CodeLengths[j] = Codec->CodeLengths[j - 1];
+			Codec->CodeLengths[j - 1] = tmpLength;
+		}
+	}
+
+	ret = ERR_SUCCESS;
+	for (int32_t i = 0; i < Codec->SymbolCount; ++i) {
+		if (Codec->CodeLengths[i] > 31) {
+			ret = ERR_CRAM_UNSUPPORTED_CODEC;
+			break;
+		}
+
+		if (i > 0)
+			code = (code + 1) << (Codec->CodeLengths[i] - Codec->CodeLengths[i - 1]);
+
+		Codec->Codes[i] = code;
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_huffman_decode(PCRAM_CODEC Codec, PCRAM_BLOCK Core, int32_t *Value)
+{
+	uint32_t code = 0;
+	uint32_t length = 0;
+	uint32_t bit = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_CRAM_INVALID_RECORD;
+	for (int32_t i = 0; i < Codec->SymbolCount; ++i) {
+		while (length < Codec->CodeLengths[i]) {
+			ret = _cram_read_bit(Core, &bit);
+			if (ret != ERR_SUCCESS)
+				break;
+
+			code = (code << 1) | bit;
+			++length;
+		}
+
+		if (length < Codec->CodeLengths[i])
+			break;
+
+		if (code == Codec->Codes[i]) {
+			*Value = Codec->Symbols[i];
+			ret = ERR_SUCCESS;
+			break;
+		}
+
+		ret = ERR_CRAM_INVALID_RECORD;
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_codec_read_nested(PCRAM_CURSOR Cursor, PCRAM_CODEC *Codec)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_calloc_CRAM_CODEC(1, Codec);
+	if (ret == ERR_SUCCESS)
+		ret = cram_codec_read(Cursor, *Codec);
+
+	return ret;
+}
+
+
+/************************************************************************/
+/*                        PUBLIC FUNCTIONS                              */
+/************************************************************************/
+
+
+/** Reads an ITF8 integer: the number of leading one bits of the first byte gives the number of bytes that follow. */
+ERR_VALUE cram_read_itf8(PCRAM_CURSOR Cursor, int32_t *Value)
+{
+	const uint8_t *d = Cursor->Data;
+	const size_t available = Cursor->End - Cursor->Data;
+	size_t length = 0;
+	uint32_t value = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (available > 0) {
+		if (d[0] < 0x80)
+			length = 1;
+		else if (d[0] < 0xc0)
+			length = 2;
+		else if (d[0] < 0xe0)
+			length = 3;
+		else if (d[0] < 0xf0)
+			length = 4;
+		else length = 5;
+
+		if (length <= available) {
+			if (length < 5) {
+				value = d[0] & (0xff >> length);
+				for (size_t i = 1; i < length; ++i)
+					value = (value << 8) | d[i];
+			} else value = ((uint32_t)(d[0] & 0x0f) << 28) | ((uint32_t)d[1] << 20) | ((uint32_t)d[2] << 12) | ((uint32_t)d[3] << 4) | (d[4] & 0x0f);
+
+			*Value = (int32_t)value;
+			Cursor->Data += length;
+			ret = ERR_SUCCESS;
+		} else ret = ERR_CRAM_INVALID_BLOCK;
+	} else ret = ERR_CRAM_INVALID_BLOCK;
+
+	return ret;
+}
+
+
+/** Reads an LTF8 integer, the 64-bit variant of ITF8 taking up to 9 bytes. */
+ERR_VALUE cram_read_ltf8(PCRAM_CURSOR Cursor, int64_t *Value)
+{
+	const uint8_t *d = Cursor->Data;
+	const size_t available = Cursor->End - Cursor->Data;
+	size_t length = 1;
+	uint64_t value = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (available > 0) {
+		while (length < 9 && (d[0] & (0x80 >> (length - 1))) != 0)
+			++length;
+
+		if (length <= available) {
+			value = (length < 8) ? (d[0] & (0xff >> length)) : 0;
+			for (size_t i = 1; i < length; ++i)
+				value = (value << 8) | d[i];
+
+			*Value = (int64_t)value;
+			Cursor->Data += length;
+			ret = ERR_SUCCESS;
+		} else ret = ERR_CRAM_INVALID_BLOCK;
+	} else ret = ERR_CRAM_INVALID_BLOCK;
+
+	return ret;
+}
+
+
+ERR_VALUE cram_read_byte(PCRAM_CURSOR Cursor, uint8_t *Value)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (Cursor->Data < Cursor->End) {
+		*Value = *Cursor->Data;
+		++Cursor->Data;
+		ret = ERR_SUCCESS;
+	} else ret = ERR_CRAM_INVALID_BLOCK;
+
+	return ret;
+}
+
+
+/** Reads a little-endian 32-bit integer. */
+ERR_VALUE cram_read_int32(PCRAM_CURSOR Cursor, int32_t *Value)
+{
+	const uint8_t *d = Cursor->Data;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (Cursor->End - Cursor->Data >= 4) {
+		*Value = (int32_t)((uint32_t)d[0] | ((uint32_t)d[1] << 8) | ((uint32_t)d[2] << 16) | ((uint32_t)d[3] << 24));
+		Cursor->Data += 4;
+		ret = ERR_SUCCESS;
+	} else ret = ERR_CRAM_INVALID_BLOCK;
+
+	return ret;
+}
+
+
+ERR_VALUE cram_skip(PCRAM_CURSOR Cursor, const size_t Length)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if ((size_t)(Cursor->End - Cursor->Data) >= Length) {
+		Cursor->Data += Length;
+		ret = ERR_SUCCESS;
+	} else ret = ERR_CRAM_INVALID_BLOCK;
+
+	return ret;
+}
+
+
+/** Parses the block at the cursor and decompresses its data. Raw blocks are not copied, so the block is valid only while
+    the buffer being parsed exists. If Checksum is set (CRAM 3), the CRC32 that follows the block is verified. */
+ERR_VALUE cram_block_read(PCRAM_CURSOR Cursor, const boolean Checksum, PCRAM_BLOCK Block)
+{
+	const uint8_t *start = Cursor->Data;
+	const uint8_t *compressed = NULL;
+	uint8_t method = 0;
+	uint8_t contentType = 0;
+	int32_t compressedLength = 0;
+	int32_t rawLength = 0;
+	int32_t crc = 0;
+	z_stream zs;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = cram_read_byte(Cursor, &method);
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_byte(Cursor, &contentType);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(Cursor, &Block->ContentID);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(Cursor, &compressedLength);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(Cursor, &rawLength);
+
+	if (ret == ERR_SUCCESS && (compressedLength < 0 || rawLength < 0))
+		ret = ERR_CRAM_INVALID_BLOCK;
+
+	if (ret == ERR_SUCCESS) {
+		compressed = Cursor->Data;
+		ret = cram_skip(Cursor, compressedLength);
+	}
+
+	if (ret == ERR_SUCCESS && Checksum) {
+		ret = cram_read_int32(Cursor, &crc);
+		if (ret == ERR_SUCCESS && (uint32_t)crc != crc32(0L, start, (uInt)(compressed + compressedLength - start)))
+			ret = ERR_CRAM_INVALID_BLOCK;
+	}
+
+	if (ret == ERR_SUCCESS) {
+		Block->Method = (ECRAMBlockMethod)method;
+		Block->ContentType = (ECRAMBlockContent)contentType;
+		Block->Offset = 0;
+		Block->BitOffset = 0;
+		switch (Block->Method) {
+			case cbmRaw:
+				Block->Data = compressed;
+				Block->Length = compressedLength;
+				break;
+			case cbmGzip:
+				ret = _cram_reserve(&Block->Buffer, &Block->BufferAllocLength, rawLength);
+				if (ret == ERR_SUCCESS) {
+					memset(&zs, 0, sizeof(zs));
+					zs.next_in = (Bytef *)compressed;
+					zs.avail_in = (uInt)compressedLength;
+					zs.next_out = Block->Buffer;
+					zs.avail_out = (uInt)rawLength;
+					if (inflateInit2(&zs, 15 + 32) == Z_OK) {
+						if (inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.total_out != (uLong)rawLength)
+							ret = ERR_CRAM_INVALID_BLOCK;
+
+						inflateEnd(&zs);
+					} else ret = ERR_CRAM_INVALID_BLOCK;
+				}
+				break;
+			case cbmRans:
+				ret = _cram_reserve(&Block->Buffer, &Block->BufferAllocLength, rawLength);
+				if (ret == ERR_SUCCESS)
+					ret = rans_decompress(compressed, compressedLength, Block->Buffer, rawLength);
+				break;
+			default:
+				ret = ERR_CRAM_UNSUPPORTED_CODEC;
+				break;
+		}
+
+		if (ret == ERR_SUCCESS && Block->Method != cbmRaw) {
+			Block->Data = Block->Buffer;
+			Block->Length = rawLength;
+		}
+	}
+
+	return ret;
+}
+
+
+void cram_block_free(PCRAM_BLOCK Block)
+{
+	if (Block->Buffer != NULL)
+		utils_free(Block->Buffer);
+
+	memset(Block, 0, sizeof(CRAM_BLOCK));
+
+	return;
+}
+
+
+/** Reads an encoding (its identifier, parameter length and parameters) from a compression header. */
+ERR_VALUE cram_codec_read(PCRAM_CURSOR Cursor, PCRAM_CODEC Codec)
+{
+	int32_t encoding = 0;
+	int32_t length = 0;
+	int32_t count = 0;
+	CRAM_CURSOR params;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(Codec, 0, sizeof(CRAM_CODEC));
+	ret = cram_read_itf8(Cursor, &encoding);
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(Cursor, &length);
+
+	if (ret == ERR_SUCCESS && length < 0)
+		ret = ERR_CRAM_INVALID_BLOCK;
+
+	if (ret == ERR_SUCCESS) {
+		params.Data = Cursor->Data;
+		params.End = Cursor->Data + length;
+		ret = cram_skip(Cursor, length);
+	}
+
+	if (ret == ERR_SUCCESS) {
+		Codec->Encoding = (ECRAMEncoding)encoding;
+		switch (Codec->Encoding) {
+			case ceNull:
+				break;
+			case ceExternal:
+				ret = cram_read_itf8(&params, &Codec->Parameter);
+				break;
+			case ceHuffman:
+				ret = cram_read_itf8(&params, &Codec->SymbolCount);
+				if (ret == ERR_SUCCESS && Codec->SymbolCount <= 0)
+					ret = ERR_CRAM_INVALID_BLOCK;
+
+				if (ret == ERR_SUCCESS)
+					ret = utils_calloc_int32_t(Codec->SymbolCount, &Codec->Symbols);
+
+				if (ret == ERR_SUCCESS)
+					ret = utils_calloc_uint32_t(Codec->SymbolCount, &Codec->CodeLengths);
+
+				if (ret == ERR_SUCCESS)
+					ret = utils_calloc_uint32_t(Codec->SymbolCount, &Codec->Codes);
+
+				for (int32_t i = 0; ret == ERR_SUCCESS && i < Codec->SymbolCount; ++i)
+					ret = cram_read_itf8(&params, Codec->Symbols + i);
+
+				if (ret == ERR_SUCCESS)
+					ret = cram_read_itf8(&params, &count);
+
+				if (ret == ERR_SUCCESS && count != Codec->SymbolCount)
+					ret = ERR_CRAM_INVALID_BLOCK;
+
+				for (int32_t i = 0; ret == ERR_SUCCESS && i < Codec->SymbolCount; ++i)
+					ret = cram_read_itf8(&params, (int32_t *)Codec->CodeLengths + i);
+
+				if (ret == ERR_SUCCESS)
+					ret = _cram_huffman_build(Codec);
+				break;
+			case ceByteArrayLength:
+				ret = _cram_codec_read_nested(&params, &Codec->LengthCodec);
+				if (ret == ERR_SUCCESS)
+					ret = _cram_codec_read_nested(&params, &Codec->ValueCodec);
+				break;
+			case ceByteArrayStop:
+				ret = cram_read_byte(&params, &Codec->StopByte);
+				if (ret == ERR_SUCCESS)
+					ret = cram_read_itf8(&params, &Codec->Parameter);
+				break;
+			case ceBeta:
+			case ceSubexp:
+				ret = cram_read_itf8(&params, &Codec->Offset);
+				if (ret == ERR_SUCCESS)
+					ret = cram_read_itf8(&params, &Codec->Parameter);
+
+				if (ret == ERR_SUCCESS && (Codec->Parameter < 0 || Codec->Parameter > 32))
+					ret = ERR_CRAM_UNSUPPORTED_CODEC;
+				break;
+			case ceGamma:
+				ret = cram_read_itf8(&params, &Codec->Offset);
+				break;
+			default:
+				ret = ERR_CRAM_UNSUPPORTED_CODEC;
+				break;
+		}
+	}
+
+	return ret;
+}
+
+
+/** Finds the external blocks the codec reads from among the blocks of a slice. */
+void cram_codec_bind(PCRAM_CODEC Codec, PCRAM_BLOCK Blocks, const size_t Count)
+{
+	Codec->Block = NULL;
+	if (Codec->Encoding == ceExternal || Codec->Encoding == ceByteArrayStop) {
+		for (size_t i = 0; i < Count; ++i) {
+			if (Blocks[i].ContentType == cbcExternalData && Blocks[i].ContentID == Codec->Parameter) {
+				Codec->Block = Blocks + i;
+				break;
+			}
+		}
+	}
+
+	if (Codec->LengthCodec != NULL)
+		cram_codec_bind(Codec->LengthCodec, Blocks, Count);
+
+	if (Codec->ValueCodec != NULL)
+		cram_codec_bind(Codec->ValueCodec, Blocks, Count);
+
+	return;
+}
+
+
+ERR_VALUE cram_codec_decode_int(PCRAM_CODEC Codec, PCRAM_BLOCK Core, int32_t *Value)
+{
+	CRAM_CURSOR cursor;
+	uint32_t bit = 0;
+	uint32_t count = 0;
+	uint32_t bits = 0;
+	uint32_t value = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	switch (Codec->Encoding) {
+		case ceExternal:
+			if (Codec->Block != NULL) {
+				cursor.Data = Codec->Block->Data + Codec->Block->Offset;
+				cursor.End = Codec->Block->Data + Codec->Block->Length;
+				ret = cram_read_itf8(&cursor, Value);
+				if (ret == ERR_SUCCESS)
+					Codec->Block->Offset = cursor.Data - Codec->Block->Data;
+				else ret = ERR_CRAM_INVALID_RECORD;
+			} else ret = ERR_CRAM_INVALID_RECORD;
+			break;
+		case ceHuffman:
+			ret = _cram_huffman_decode(Codec, Core, Value);
+			break;
+		case ceBeta:
+			ret = _cram_read_bits(Core, Codec->Parameter, &value);
+			if (ret == ERR_SUCCESS)
+				*Value = (int32_t)(value - Codec->Offset);
+			break;
+		case ceSubexp:
+			do {
+				ret = _cram_read_bit(Core, &bit);
+				count += bit;
+			} while (ret == ERR_SUCCESS && bit != 0 && count < 32);
+
+			if (ret == ERR_SUCCESS) {
+				bits = (count == 0) ? Codec->Parameter : count + Codec->Parameter - 1;
+				if (bits < 32) {
+					ret = _cram_read_bits(Core, bits, &value);
+					if (ret == ERR_SUCCESS) {
+						if (count > 0)
+							value |= (1u << bits);
+
+						*Value = (int32_t)(value - Codec->Offset);
+					}
+				} else ret = ERR_CRAM_INVALID_RECORD;
+			}
+			break;
+		case ceGamma:
+			do {
+				ret = _cram_read_bit(Core, &bit);
+				count += (1 - bit);
+			} while (ret == ERR_SUCCESS && bit == 0 && count < 32);
+
+			if (ret == ERR_SUCCESS && count < 32) {
+				ret = _cram_read_bits(Core, count, &value);
+				if (ret == ERR_SUCCESS)
+					*Value = (int32_t)(((1u << count) | value) - Codec->Offset);
+			} else if (ret == ERR_SUCCESS)
+				ret = ERR_CRAM_INVALID_RECORD;
+			break;
+		default:
+			ret = ERR_CRAM_UNSUPPORTED_CODEC;
+			break;
+	}
+
+	return ret;
+}
+
+
+ERR_VALUE cram_codec_decode_byte(PCRAM_CODEC Codec, PCRAM_BLOCK Core, uint8_t *Value)
+{
+	int32_t value = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (Codec->Encoding == ceExternal) {
+		if (Codec->Block != NULL && Codec->Block->Offset < Codec->Block->Length) {
+			*Value = Codec->Block->Data[Codec->Block->Offset];
+			++Codec->Block->Offset;
+			ret = ERR_SUCCESS;
+		} else ret = ERR_CRAM_INVALID_RECORD;
+	} else {
+		ret = cram_codec_decode_int(Codec, Core, &value);
+		if (ret == ERR_SUCCESS)
+			*Value = (uint8_t)value;
+	}
+
+	return ret;
+}
+
+
+/** Decodes a byte array. The previous content of the Bytes structure is replaced. */
+ERR_VALUE cram_codec_decode_bytes(PCRAM_CODEC Codec, PCRAM_BLOCK Core, PCRAM_BYTES Bytes)
+{
+	PCRAM_BLOCK block = NULL;
+	const uint8_t *data = NULL;
+	const uint8_t *stop = NULL;
+	int32_t length = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	Bytes->Length = 0;
+	switch (Codec->Encoding) {
+		case ceByteArrayLength:
+			ret = cram_codec_decode_int(Codec->LengthCodec, Core, &length);
+			if (ret == ERR_SUCCESS && length < 0)
+				ret = ERR_CRAM_INVALID_RECORD;
+
+			if (ret == ERR_SUCCESS)
+				ret = _cram_reserve(&Bytes->Data, &Bytes->AllocLength, length);
+
+			if (ret == ERR_SUCCESS) {
+				block = Codec->ValueCodec->Block;
+				if (Codec->ValueCodec->Encoding == ceExternal) {
+					if (block != NULL && block->Length - block->Offset >= (size_t)length) {
+						memcpy(Bytes->Data, block->Data + block->Offset, length);
+						block->Offset += length;
+					} else ret = ERR_CRAM_INVALID_RECORD;
+				} else {
+					for (int32_t i = 0; i < length; ++i) {
+						ret = cram_codec_decode_byte(Codec->ValueCodec, Core, Bytes->Data + i);
+						if (ret != ERR_SUCCESS)
+							break;
+					}
+				}
+
+				if (ret == ERR_SUCCESS)
+					Bytes->Length = length;
+			}
+			break;
+		case ceByteArrayStop:
+			block = Codec->Block;
+			ret = ERR_CRAM_INVALID_RECORD;
+			if (block != NULL && block->Offset < block->Length) {
+				data = block->Data + block->Offset;
+				stop = (const uint8_t *)memchr(data, Codec->StopByte, block->Length - block->Offset);
+				if (stop != NULL) {
+					ret = _cram_reserve(&Bytes->Data, &Bytes->AllocLength, stop - data);
+					if (ret == ERR_SUCCESS) {
+						memcpy(Bytes->Data, data, stop - data);
+						Bytes->Length = stop - data;
+						block->Offset += Bytes->Length + 1;
+					}
+				}
+			}
+			break;
+		default:
+			ret = ERR_CRAM_UNSUPPORTED_CODEC;
+			break;
+	}
+
+	return ret;
+}
+
+
+void cram_codec_free(PCRAM_CODEC Codec)
+{
+	if (Codec->LengthCodec != NULL) {
+		cram_codec_free(Codec->LengthCodec);
+		utils_free(Codec->LengthCodec);
+	}
+
+	if (Codec->ValueCodec != NULL) {
+		cram_codec_free(Codec->ValueCodec);
+		utils_free(Codec->ValueCodec);
+	}
+
+	if (Codec->Codes != NULL)
+		utils_free(Codec->Codes);
+
+	if (Codec->CodeLengths != NULL)
+		utils_free(Codec->CodeLengths);
+
+	if (Codec->Symbols != NULL)
+		utils_free(Codec->Symbols);
+
+	memset(Codec, 0, sizeof(CRAM_CODEC));
+
+	return;
+}
+
+
+/** Makes room for Length bytes, keeping the current content. */
+ERR_VALUE cram_bytes_reserve(PCRAM_BYTES Bytes, const size_t Length)
+{
+	uint8_t *tmp = NULL;
+	size_t newLength = 0;
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	if (Bytes->AllocLength < Length || Bytes->Data == NULL) {
+		newLength = max(max(Length, 2 * Bytes->AllocLength), 64);
+		ret = utils_malloc(newLength, (void **)&tmp);
+		if (ret == ERR_SUCCESS) {
+			if (Bytes->Data != NULL) {
+				memcpy(tmp, Bytes->Data, Bytes->Length);
+				utils_free(Bytes->Data);
+			}
+
+			Bytes->Data = tmp;
+			Bytes->AllocLength = newLength;
+		}
+	}
+
+	return ret;
+}
+
+
+void cram_bytes_free(PCRAM_BYTES Bytes)
+{
+	if (Bytes->Data != NULL)
+		utils_free(Bytes->Data);
+
+	memset(Bytes, 0, sizeof(CRAM_BYTES));
+
+	return;
+}
@@ -0,0 +1,112 @@
+
+#ifndef __CRAM_CODEC_H__
+#define __CRAM_CODEC_H__
+
+
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+
+
+/** Compression methods of CRAM blocks. */
+typedef enum _ECRAMBlockMethod {
+	cbmRaw = 0,
+	cbmGzip = 1,
+	cbmBzip2 = 2,
+	cbmLzma = 3,
+	cbmRans = 4,
+} ECRAMBlockMethod, *PECRAMBlockMethod;
+
+/** Types of the content of CRAM blocks. */
+typedef enum _ECRAMBlockContent {
+	cbcFileHeader = 0,
+	cbcCompressionHeader = 1,
+	cbcSliceHeader = 2,
+	cbcExternalData = 4,
+	cbcCoreData = 5,
+} ECRAMBlockContent, *PECRAMBlockContent;
+
+/** Encodings of the CRAM data series. */
+typedef enum _ECRAMEncoding {
+	ceNull = 0,
+	ceExternal = 1,
+	ceGolomb = 2,
+	ceHuffman = 3,
+	ceByteArrayLength = 4,
+	ceByteArrayStop = 5,
+	ceBeta = 6,
+	ceSubexp = 7,
+	ceGolombRice = 8,
+	ceGamma = 9,
+} ECRAMEncoding, *PECRAMEncoding;
+
+/** Position within a memory buffer being parsed. */
+typedef struct _CRAM_CURSOR {
+	const uint8_t *Data;
+	const uint8_t *End;
+} CRAM_CURSOR, *PCRAM_CURSOR;
+
+typedef struct _CRAM_BLOCK {
+	ECRAMBlockMethod Method;
+	ECRAMBlockContent ContentType;
+	int32_t ContentID;
+	/** Uncompressed data, either pointing into the container or to Buffer. */
+	const uint8_t *Data;
+	size_t Length;
+	/** Read position (in bytes) and, for the core data block, the number of bits consumed from the byte at that position. */
+	size_t Offset;
+	uint32_t BitOffset;
+	/** Storage of the decompressed data, kept for the next block read into this structure. */
+	uint8_t *Buffer;
+	size_t BufferAllocLength;
+} CRAM_BLOCK, *PCRAM_BLOCK;
+
+/** A growable byte string decoded from a byte array data series. */
+typedef struct _CRAM_BYTES {
+	uint8_t *Data;
+	size_t Length;
+	size_t AllocLength;
+} CRAM_BYTES, *PCRAM_BYTES;
+
+typedef struct _CRAM_CODEC {
+	ECRAMEncoding Encoding;
+	/** Content ID of the external block, or the number of bits of the beta encoding, or the k of the subexponential one. */
+	int32_t Parameter;
+	/** Value subtracted from the decoded integers (beta, gamma and subexponential encodings). */
+	int32_t Offset;
+	uint8_t StopByte;
+	/** Canonical Huffman code, ordered by code length and symbol value. */
+	int32_t SymbolCount;
+	int32_t *Symbols;
+	uint32_t *CodeLengths;
+	uint32_t *Codes;
+	/** Encodings of the lengths and values of byte arrays. */
+	struct _CRAM_CODEC *LengthCodec;
+	struct _CRAM_CODEC *ValueCodec;
+	/** The external block of the current slice, set by cram_codec_bind(). */
+	PCRAM_BLOCK Block;
+} CRAM_CODEC, *PCRAM_CODEC;
+
+
+ERR_VALUE cram_read_itf8(PCRAM_CURSOR Cursor, int32_t *Value);
+ERR_VALUE cram_read_ltf8(PCRAM_CURSOR Cursor, int64_t *Value);
+ERR_VALUE cram_read_byte(PCRAM_CURSOR Cursor, uint8_t *Value);
+ERR_VALUE cram_read_int32(PCRAM_CURSOR Cursor, int32_t *Value);
+ERR_VALUE cram_skip(PCRAM_CURSOR Cursor, const size_t Length);
+
+ERR_VALUE cram_block_read(PCRAM_CURSOR Cursor, const boolean Checksum, PCRAM_BLOCK Block);
+void cram_block_free(PCRAM_BLOCK Block);
+
+ERR_VALUE cram_codec_read(PCRAM_CURSOR Cursor, PCRAM_CODEC Codec);
+void cram_codec_bind(PCRAM_CODEC Codec, PCRAM_BLOCK Blocks, const size_t Count);
+ERR_VALUE cram_codec_decode_int(PCRAM_CODEC Codec, PCRAM_BLOCK Core, int32_t *Value);
+ERR_VALUE cram_codec_decode_byte(PCRAM_CODEC Codec, PCRAM_BLOCK Core, uint8_t *Value);
+ERR_VALUE cram_codec_decode_bytes(PCRAM_CODEC Codec, PCRAM_BLOCK Core, PCRAM_BYTES Bytes);
+void cram_codec_free(PCRAM_CODEC Codec);
+
+ERR_VALUE cram_bytes_reserve(PCRAM_BYTES Bytes, const size_t Length);
+void cram_bytes_free(PCRAM_BYTES Bytes);
+
+
+
+#endif
@@ -0,0 +1,1507 @@
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <zlib.h>
+#include "err.h"
+#include "utils.h"
+#include "file-utils.h"
+#include "reads.h"
+#include "input-file.h"
+#include "cram-codec.h"
+#include "bam-file.h"
+#include "cram-file.h"
+
+
+/************************************************************************/
+/*                        HELPER FUNCTIONS                              */
+/************************************************************************/
+
+UTILS_NAMED_CALLOC_FUNCTION(pchar, char *)
+UTILS_TYPED_CALLOC_FUNCTION(CRAM_BLOCK)
+UTILS_TYPED_CALLOC_FUNCTION(CRAM_CODEC)
+
+
+/** Two-letter names of the data series, in the order of ECRAMDataSeries. */
+static const char _cramDataSeriesNames[] = "BFCFRIRLAPRGRNMFNSNPTSNFTLFNFCFPDLBBQQBSINRSPDHCSCMQBAQS";
+static const char _cramBases[] = "ACGTN";
+static char _cramRNextSame[] = "=";
+static char _cramStar[] = "*";
+
+
+typedef struct _CRAM_CONTAINER_HEADER {
+	int32_t Length;
+	int32_t RefID;
+	int32_t Start;
+	int32_t Span;
+	int32_t RecordCount;
+	int64_t RecordCounter;
+	int64_t BaseCount;
+	int32_t BlockCount;
+} CRAM_CONTAINER_HEADER, *PCRAM_CONTAINER_HEADER;
+
+typedef enum _ECRAMRegionRelation {
+	crrBefore,
+	crrInside,
+	crrAfter,
+} ECRAMRegionRelation, *PECRAMRegionRelation;
+
+/** CIGAR operation being extended while the features of a record are decoded. */
+typedef struct _CRAM_CIGAR {
+	PCRAM_BYTES Text;
+	char Operation;
+	uint32_t Length;
+} CRAM_CIGAR, *PCRAM_CIGAR;
+
+
+static uint32_t _le32(const uint8_t *Data)
+{
+	return ((uint32_t)Data[0] | ((uint32_t)Data[1] << 8) | ((uint32_t)Data[2] << 16) | ((uint32_t)Data[3] << 24));
+}
+
+
+static uint32_t _cram_base_index(const char Base)
+{
+	uint32_t ret = 4;
+
+	switch (Base) {
+		case 'A': ret = 0; break;
+		case 'C': ret = 1; break;
+		case 'G': ret = 2; break;
+		case 'T': ret = 3; break;
+	}
+
+	return ret;
+}
+
+
+static char *_cram_reference_name(const CRAM_FILE *File, const int32_t RefID)
+{
+	return (0 <= RefID && RefID < File->ReferenceCount) ? File->ReferenceNames[RefID] : _cramStar;
+}
+
+
+static ERR_VALUE _cram_seek_forward(PCRAM_FILE File, const size_t Length)
+{
+	ERR_VALUE ret = ERR_SUCCESS;
+
+#ifdef _MSC_VER
+	if (_fseeki64(File->Stream, (__int64)Length, SEEK_CUR) != 0)
+#else
+	if (fseeko(File->Stream, (off_t)Length, SEEK_CUR) != 0)
+#endif
+		ret = ERR_IO_ERROR;
+
+	return ret;
+}
+
+
+/** Appends bytes read from the file to the container header buffer. Returns ERR_NO_MORE_ENTRIES if the file ends before
+    the first byte of the header. */
+static ERR_VALUE _cram_stream_read(PCRAM_FILE File, const size_t Length)
+{
+	PCRAM_BYTES header = &File->ContainerHeader;
+	size_t bytesRead = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = cram_bytes_reserve(header, header->Length + Length);
+	if (ret == ERR_SUCCESS) {
+		bytesRead = fread(header->Data + header->Length, 1, Length, File->Stream);
+		if (bytesRead == Length) {
+			header->Length += Length;
+			File->BytesRead += Length;
+		} else if (bytesRead == 0 && header->Length == 0 && feof(File->Stream))
+			ret = ERR_NO_MORE_ENTRIES;
+		else ret = ERR_CRAM_INVALID_CONTAINER;
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_stream_itf8(PCRAM_FILE File, int32_t *Value)
+{
+	const size_t start = File->ContainerHeader.Length;
+	size_t length = 1;
+	uint8_t first = 0;
+	CRAM_CURSOR cursor;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = _cram_stream_read(File, 1);
+	if (ret == ERR_SUCCESS) {
+		first = File->ContainerHeader.Data[start];
+		while (length < 5 && (first & (0x80 >> (length - 1))) != 0)
+			++length;
+
+		if (length > 1)
+			ret = _cram_stream_read(File, length - 1);
+	}
+
+	if (ret == ERR_SUCCESS) {
+		cursor.Data = File->ContainerHeader.Data + start;
+		cursor.End = File->ContainerHeader.Data + File->ContainerHeader.Length;
+		ret = cram_read_itf8(&cursor, Value);
+	}
+
+	if (ret == ERR_NO_MORE_ENTRIES || ret == ERR_CRAM_INVALID_BLOCK)
+		ret = ERR_CRAM_INVALID_CONTAINER;
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_stream_ltf8(PCRAM_FILE File, int64_t *Value)
+{
+	const size_t start = File->ContainerHeader.Length;
+	size_t length = 1;
+	uint8_t first = 0;
+	CRAM_CURSOR cursor;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = _cram_stream_read(File, 1);
+	if (ret == ERR_SUCCESS) {
+		first = File->ContainerHeader.Data[start];
+		while (length < 9 && (first & (0x80 >> (length - 1))) != 0)
+			++length;
+
+		if (length > 1)
+			ret = _cram_stream_read(File, length - 1);
+	}
+
+	if (ret == ERR_SUCCESS) {
+		cursor.Data = File->ContainerHeader.Data + start;
+		cursor.End = File->ContainerHeader.Data + File->ContainerHeader.Length;
+		ret = cram_read_ltf8(&cursor, Value);
+	}
+
+	if (ret == ERR_NO_MORE_ENTRIES || ret == ERR_CRAM_INVALID_BLOCK)
+		ret = ERR_CRAM_INVALID_CONTAINER;
+
+	return ret;
+}
+
+
+/** Reads the header of the next container, including its slice offsets (landmarks). Returns ERR_NO_MORE_ENTRIES at the
+    end of the file. */
+static ERR_VALUE _cram_read_container_header(PCRAM_FILE File, PCRAM_CONTAINER_HEADER Header)
+{
+	uint8_t crc[4];
+	int32_t *tmpLandmarks = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	File->ContainerHeader.Length = 0;
+	ret = _cram_stream_read(File, 4);
+	if (ret == ERR_SUCCESS) {
+		Header->Length = (int32_t)_le32(File->ContainerHeader.Data);
+		if (Header->Length < 0)
+			ret = ERR_CRAM_INVALID_CONTAINER;
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_stream_itf8(File, &Header->RefID);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_stream_itf8(File, &Header->Start);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_stream_itf8(File, &Header->Span);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_stream_itf8(File, &Header->RecordCount);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_stream_ltf8(File, &Header->RecordCounter);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_stream_ltf8(File, &Header->BaseCount);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_stream_itf8(File, &Header->BlockCount);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_stream_itf8(File, &File->LandmarkCount);
+
+	if (ret == ERR_SUCCESS && File->LandmarkCount < 0)
+		ret = ERR_CRAM_INVALID_CONTAINER;
+
+	if (ret == ERR_SUCCESS && File->LandmarkAllocCount < File->LandmarkCount) {
+		ret = utils_calloc_int32_t(File->LandmarkCount, &tmpLandmarks);
+		if (ret == ERR_SUCCESS) {
+			if (File->Landmarks != NULL)
+				utils_free(File->Landmarks);
+
+			File->Landmarks = tmpLandmarks;
+			File->LandmarkAllocCount = File->LandmarkCount;
+		}
+	}
+
+	for (int32_t i = 0; ret == ERR_SUCCESS && i < File->LandmarkCount; ++i)
+		ret = _cram_stream_itf8(File, File->Landmarks + i);
+
+	if (ret == ERR_SUCCESS && File->MajorVersion >= 3) {
+		if (fread(crc, 1, sizeof(crc), File->Stream) == sizeof(crc)) {
+			File->BytesRead += sizeof(crc);
+			if (_le32(crc) != crc32(0L, File->ContainerHeader.Data, (uInt)File->ContainerHeader.Length))
+				ret = ERR_CRAM_INVALID_CONTAINER;
+		} else ret = ERR_CRAM_INVALID_CONTAINER;
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_load_container(PCRAM_FILE File, const CRAM_CONTAINER_HEADER *Header)
+{
+	uint8_t *tmp = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	if (File->ContainerAllocLength < (size_t)Header->Length || File->Container == NULL) {
+		ret = utils_malloc(max((size_t)Header->Length, 2 * File->ContainerAllocLength) + 1, (void **)&tmp);
+		if (ret == ERR_SUCCESS) {
+			if (File->Container != NULL)
+				utils_free(File->Container);
+
+			File->Container = tmp;
+			File->ContainerAllocLength = max((size_t)Header->Length, 2 * File->ContainerAllocLength) + 1;
+		}
+	}
+
+	if (ret == ERR_SUCCESS) {
+		File->ContainerLength = Header->Length;
+		if (fread(File->Container, 1, Header->Length, File->Stream) == (size_t)Header->Length)
+			File->BytesRead += Header->Length;
+		else ret = ERR_CRAM_INVALID_CONTAINER;
+	}
+
+	for (int32_t i = 0; ret == ERR_SUCCESS && i < File->LandmarkCount; ++i) {
+		if (File->Landmarks[i] < 0 || File->Landmarks[i] >= Header->Length)
+			ret = ERR_CRAM_INVALID_CONTAINER;
+	}
+
+	return ret;
+}
+
+
+static ECRAMRegionRelation _cram_region_relation(const CRAM_FILE *File, const int32_t RefID, const int32_t Start, const int32_t Span)
+{
+	const int64_t start = (Start > 0) ? (int64_t)Start - 1 : 0;
+	ECRAMRegionRelation ret = crrInside;
+
+	if (File->RegionRefID != -1 && RefID != -2) {
+		if (RefID == -1 || RefID > File->RegionRefID)
+			ret = crrAfter;
+		else if (RefID < File->RegionRefID)
+			ret = crrBefore;
+		else if ((uint64_t)start >= File->RegionEnd)
+			ret = crrAfter;
+		else if ((uint64_t)(start + max(Span, 0)) <= File->RegionStart)
+			ret = crrBefore;
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_read_header(PCRAM_FILE File)
+{
+	uint8_t definition[CRAM_FILE_DEFINITION_SIZE];
+	CRAM_CONTAINER_HEADER header;
+	CRAM_CURSOR cursor;
+	int32_t textLength = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_fread(definition, 1, sizeof(definition), File->Stream);
+	if (ret == ERR_SUCCESS) {
+		File->BytesRead += sizeof(definition);
+		File->MajorVersion = definition[4];
+		File->MinorVersion = definition[5];
+		if (memcmp(definition, "CRAM", 4) != 0 || File->MajorVersion < 2 || File->MajorVersion > 3)
+			ret = ERR_CRAM_INVALID_HEADER;
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_read_container_header(File, &header);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_load_container(File, &header);
+
+	if (ret == ERR_SUCCESS) {
+		cursor.Data = File->Container;
+		cursor.End = File->Container + File->ContainerLength;
+		ret = cram_block_read(&cursor, File->MajorVersion >= 3, &File->HeaderBlock);
+	}
+
+	if (ret == ERR_SUCCESS && File->HeaderBlock.ContentType != cbcFileHeader)
+		ret = ERR_CRAM_INVALID_HEADER;
+
+	if (ret == ERR_SUCCESS) {
+		cursor.Data = File->HeaderBlock.Data;
+		cursor.End = File->HeaderBlock.Data + File->HeaderBlock.Length;
+		ret = cram_read_int32(&cursor, &textLength);
+		if (ret == ERR_SUCCESS && (textLength < 0 || (size_t)textLength > (size_t)(cursor.End - cursor.Data)))
+			ret = ERR_CRAM_INVALID_HEADER;
+	}
+
+	if (ret == ERR_SUCCESS) {
+		ret = utils_calloc_char(textLength + 1, &File->HeaderText);
+		if (ret == ERR_SUCCESS)
+			memcpy(File->HeaderText, cursor.Data, textLength);
+
+		File->LandmarkCount = 0;
+		File->NextSlice = 0;
+	}
+
+	if (ret == ERR_NO_MORE_ENTRIES || ret == ERR_CRAM_INVALID_BLOCK || ret == ERR_CRAM_INVALID_CONTAINER)
+		ret = ERR_CRAM_INVALID_HEADER;
+
+	return ret;
+}
+
+
+/** Collects names of the reference sequences from the @SQ lines of the SAM header. */
+static ERR_VALUE _cram_read_reference_names(PCRAM_FILE File)
+{
+	const char *line = File->HeaderText;
+	const char *lineEnd = NULL;
+	const char *name = NULL;
+	size_t nameLength = 0;
+	int32_t count = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	while (*line != '\0') {
+		if (strncmp(line, "@SQ\t", 4) == 0)
+			++count;
+
+		lineEnd = strchr(line, '\n');
+		line = (lineEnd != NULL) ? lineEnd + 1 : line + strlen(line);
+	}
+
+	ret = utils_calloc_pchar(count + 1, &File->ReferenceNames);
+	line = File->HeaderText;
+	while (ret == ERR_SUCCESS && *line != '\0') {
+		lineEnd = strchr(line, '\n');
+		if (lineEnd == NULL)
+			lineEnd = line + strlen(line);
+
+		if (strncmp(line, "@SQ\t", 4) == 0) {
+			name = line;
+			do {
+				name = (const char *)memchr(name + 1, '\t', lineEnd - name - 1);
+			} while (name != NULL && strncmp(name, "\tSN:", 4) != 0);
+
+			if (name != NULL) {
+				name += 4;
+				nameLength = 0;
+				while (name + nameLength < lineEnd && name[nameLength] != '\t' && name[nameLength] != '\r')
+					++nameLength;
+
+				ret = utils_calloc_char(nameLength + 1, File->ReferenceNames + File->ReferenceCount);
+				if (ret == ERR_SUCCESS) {
+					memcpy(File->ReferenceNames[File->ReferenceCount], name, nameLength);
+					++File->ReferenceCount;
+				}
+			} else ret = ERR_CRAM_INVALID_HEADER;
+		}
+
+		line = (*lineEnd != '\0') ? lineEnd + 1 : lineEnd;
+	}
+
+	return ret;
+}
+
+
+static void _cram_compression_header_free(PCRAM_COMPRESSION_HEADER Header)
+{
+	for (size_t i = 0; i < cdsMax; ++i)
+		cram_codec_free(Header->DataSeries + i);
+
+	if (Header->TagCodecs != NULL) {
+		for (int32_t i = 0; i < Header->TagCodecCount; ++i)
+			cram_codec_free(Header->TagCodecs + i);
+
+		utils_free(Header->TagCodecs);
+	}
+
+	if (Header->TagKeys != NULL)
+		utils_free(Header->TagKeys);
+
+	if (Header->TagLineCounts != NULL)
+		utils_free(Header->TagLineCounts);
+
+	if (Header->TagLineOffsets != NULL)
+		utils_free(Header->TagLineOffsets);
+
+	if (Header->TagDictionary != NULL)
+		utils_free(Header->TagDictionary);
+
+	memset(Header, 0, sizeof(CRAM_COMPRESSION_HEADER));
+
+	return;
+}
+
+
+/** Splits the tag dictionary into lines; each line is a sequence of 3-byte keys terminated by a zero byte. */
+static ERR_VALUE _cram_parse_tag_dictionary(PCRAM_COMPRESSION_HEADER Header, PCRAM_CURSOR Cursor)
+{
+	int32_t length = 0;
+	size_t offset = 0;
+	int32_t lineCount = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = cram_read_itf8(Cursor, &length);
+	if (ret == ERR_SUCCESS && (length < 0 || length > Cursor->End - Cursor->Data))
+		ret = ERR_CRAM_INVALID_BLOCK;
+
+	if (ret == ERR_SUCCESS) {
+		ret = utils_calloc_uint8_t(length + 1, &Header->TagDictionary);
+		if (ret == ERR_SUCCESS) {
+			memcpy(Header->TagDictionary, Cursor->Data, length);
+			Header->TagDictionaryLength = length;
+			Cursor->Data += length;
+		}
+	}
+
+	for (size_t i = 0; ret == ERR_SUCCESS && i < Header->TagDictionaryLength; ++i) {
+		if (Header->TagDictionary[i] == 0)
+			++lineCount;
+		else i += 2;
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc_size_t(lineCount + 1, &Header->TagLineOffsets);
+
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc_size_t(lineCount + 1, &Header->TagLineCounts);
+
+	if (ret == ERR_SUCCESS) {
+		offset = 0;
+		Header->TagLineCount = 0;
+		while (Header->TagLineCount < lineCount) {
+			Header->TagLineOffsets[Header->TagLineCount] = offset;
+			while (offset < Header->TagDictionaryLength && Header->TagDictionary[offset] != 0) {
+				++Header->TagLineCounts[Header->TagLineCount];
+				offset += 3;
+			}
+
+			++offset;
+			++Header->TagLineCount;
+		}
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_parse_compression_header(PCRAM_FILE File, const CRAM_BLOCK *Block)
+{
+	PCRAM_COMPRESSION_HEADER header = &File->CompressionHeader;
+	CRAM_CURSOR cursor;
+	CRAM_CURSOR map;
+	CRAM_CODEC codec;
+	int32_t mapSize = 0;
+	int32_t count = 0;
+	uint8_t key[2];
+	uint8_t flag = 0;
+	uint8_t matrix[5];
+	const char *series = NULL;
+	size_t k = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	_cram_compression_header_free(header);
+	File->CompressionHeaderValid = FALSE;
+	header->ReadNamesIncluded = TRUE;
+	header->PositionsDelta = TRUE;
+	header->ReferenceRequired = TRUE;
+	for (uint32_t r = 0; r < 5; ++r) {
+		k = 0;
+		for (uint32_t b = 0; b < 5; ++b) {
+			if (b != r)
+				header->Substitutions[r][k++] = _cramBases[b];
+		}
+	}
+
+	cursor.Data = Block->Data;
+	cursor.End = Block->Data + Block->Length;
+	ret = cram_read_itf8(&cursor, &mapSize);
+	if (ret == ERR_SUCCESS && (mapSize < 0 || mapSize > cursor.End - cursor.Data))
+		ret = ERR_CRAM_INVALID_BLOCK;
+
+	if (ret == ERR_SUCCESS) {
+		map.Data = cursor.Data;
+		map.End = cursor.Data + mapSize;
+		cursor.Data += mapSize;
+		ret = cram_read_itf8(&map, &count);
+	}
+
+	for (int32_t i = 0; ret == ERR_SUCCESS && i < count; ++i) {
+		ret = cram_read_byte(&map, key);
+		if (ret == ERR_SUCCESS)
+			ret = cram_read_byte(&map, key + 1);
+
+		if (ret == ERR_SUCCESS) {
+			if (memcmp(key, "RN", 2) == 0 || memcmp(key, "AP", 2) == 0 || memcmp(key, "RR", 2) == 0) {
+				ret = cram_read_byte(&map, &flag);
+				if (key[0] == 'R' && key[1] == 'N')
+					header->ReadNamesIncluded = (flag != 0);
+				else if (key[0] == 'A')
+					header->PositionsDelta = (flag != 0);
+				else header->ReferenceRequired = (flag != 0);
+			} else if (memcmp(key, "SM", 2) == 0) {
+				for (size_t j = 0; ret == ERR_SUCCESS && j < sizeof(matrix); ++j)
+					ret = cram_read_byte(&map, matrix + j);
+
+				for (uint32_t r = 0; ret == ERR_SUCCESS && r < 5; ++r) {
+					k = 0;
+					for (uint32_t b = 0; b < 5; ++b) {
+						if (b != r) {
+							header->Substitutions[r][(matrix[r] >> (6 - 2 * k)) & 3] = _cramBases[b];
+							++k;
+						}
+					}
+				}
+			} else if (memcmp(key, "TD", 2) == 0)
+				ret = _cram_parse_tag_dictionary(header, &map);
+			else ret = ERR_CRAM_INVALID_BLOCK;
+		}
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &mapSize);
+
+	if (ret == ERR_SUCCESS && (mapSize < 0 || mapSize > cursor.End - cursor.Data))
+		ret = ERR_CRAM_INVALID_BLOCK;
+
+	if (ret == ERR_SUCCESS) {
+		map.Data = cursor.Data;
+		map.End = cursor.Data + mapSize;
+		cursor.Data += mapSize;
+		ret = cram_read_itf8(&map, &count);
+	}
+
+	for (int32_t i = 0; ret == ERR_SUCCESS && i < count; ++i) {
+		ret = cram_read_byte(&map, key);
+		if (ret == ERR_SUCCESS)
+			ret = cram_read_byte(&map, key + 1);
+
+		if (ret == ERR_SUCCESS)
+			ret = cram_codec_read(&map, &codec);
+
+		if (ret == ERR_SUCCESS) {
+			series = _cramDataSeriesNames;
+			while (*series != '\0' && (series[0] != key[0] || series[1] != key[1]))
+				series += 2;
+
+			if (*series != '\0') {
+				k = (series - _cramDataSeriesNames) / 2;
+				cram_codec_free(header->DataSeries + k);
+				header->DataSeries[k] = codec;
+			} else cram_codec_free(&codec);
+		} else cram_codec_free(&codec);
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &mapSize);
+
+	if (ret == ERR_SUCCESS && (mapSize < 0 || mapSize > cursor.End - cursor.Data))
+		ret = ERR_CRAM_INVALID_BLOCK;
+
+	if (ret == ERR_SUCCESS) {
+		map.Data = cursor.Data;
+		map.End = cursor.Data + mapSize;
+		ret = cram_read_itf8(&map, &count);
+		if (ret == ERR_SUCCESS && count < 0)
+			ret = ERR_CRAM_INVALID_BLOCK;
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc_int32_t(count + 1, &header->TagKeys);
+
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc_CRAM_CODEC(count + 1, &header->TagCodecs);
+
+	for (int32_t i = 0; ret == ERR_SUCCESS && i < count; ++i) {
+		ret = cram_read_itf8(&map, header->TagKeys + i);
+		if (ret == ERR_SUCCESS)
+			ret = cram_codec_read(&map, header->TagCodecs + i);
+
+		header->TagCodecCount = i + 1;
+	}
+
+	if (ret == ERR_SUCCESS)
+		File->CompressionHeaderValid = TRUE;
+	else _cram_compression_header_free(header);
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_parse_slice_header(const CRAM_BLOCK *Block, PCRAM_SLICE_HEADER Slice)
+{
+	CRAM_CURSOR cursor;
+	int32_t count = 0;
+	int32_t id = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	cursor.Data = Block->Data;
+	cursor.End = Block->Data + Block->Length;
+	ret = (Block->ContentType == cbcSliceHeader) ? ERR_SUCCESS : ERR_CRAM_INVALID_CONTAINER;
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &Slice->RefID);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &Slice->Start);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &Slice->Span);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &Slice->RecordCount);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_ltf8(&cursor, &Slice->RecordCounter);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &Slice->BlockCount);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &count);
+
+	for (int32_t i = 0; ret == ERR_SUCCESS && i < count; ++i)
+		ret = cram_read_itf8(&cursor, &id);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_read_itf8(&cursor, &Slice->EmbeddedReferenceID);
+
+	if (ret == ERR_SUCCESS && (Slice->RecordCount < 0 || Slice->BlockCount < 0))
+		ret = ERR_CRAM_INVALID_CONTAINER;
+
+	if (ret == ERR_CRAM_INVALID_BLOCK)
+		ret = ERR_CRAM_INVALID_CONTAINER;
+
+	return ret;
+}
+
+
+/** Copies reference bases to the read. Bases outside the known reference are reported as N. */
+static void _cram_copy_reference(PCRAM_FILE File, const int32_t RefID, const int64_t Pos, char *Bases, const size_t Length)
+{
+	const char *sequence = NULL;
+	int64_t start = 0;
+	int64_t length = 0;
+	int64_t index = 0;
+
+	if (File->EmbeddedReference != NULL && RefID == File->Slice.RefID) {
+		sequence = (const char *)File->EmbeddedReference->Data;
+		start = (int64_t)File->Slice.Start - 1;
+		length = File->EmbeddedReference->Length;
+	} else if (File->Reference != NULL && RefID == File->ReferenceID) {
+		sequence = File->Reference->Sequence;
+		start = (int64_t)File->Reference->StartPos;
+		length = File->Reference->Length;
+	} else if (!File->MissingReferenceReported && File->CompressionHeader.ReferenceRequired) {
+		fprintf(stderr, "[WARNING]: The reference sequence %s is not loaded, reads aligned to it get N bases\n", _cram_reference_name(File, RefID));
+		File->MissingReferenceReported = TRUE;
+	}
+
+	for (size_t i = 0; i < Length; ++i) {
+		index = Pos + (int64_t)i - start;
+		Bases[i] = (sequence != NULL && 0 <= index && index < length) ? (char)toupper(sequence[index]) : 'N';
+	}
+
+	return;
+}
+
+
+static ERR_VALUE _cram_cigar_flush(PCRAM_CIGAR Cigar)
+{
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	if (Cigar->Length > 0) {
+		ret = cram_bytes_reserve(Cigar->Text, Cigar->Text->Length + 16);
+		if (ret == ERR_SUCCESS)
+			Cigar->Text->Length += sprintf((char *)Cigar->Text->Data + Cigar->Text->Length, "%u%c", Cigar->Length, Cigar->Operation);
+
+		Cigar->Length = 0;
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_cigar_push(PCRAM_CIGAR Cigar, const char Operation, const uint32_t Length)
+{
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	if (Length > 0) {
+		if (Cigar->Operation != Operation) {
+			ret = _cram_cigar_flush(Cigar);
+			Cigar->Operation = Operation;
+		}
+
+		Cigar->Length += Length;
+	}
+
+	return ret;
+}
+
+
+/** Reconstructs the bases and the CIGAR of a mapped read from its read features (substitutions, insertions, deletions,
+    clips...) and the reference. Bases between the features match the reference. */
+static ERR_VALUE _cram_decode_features(PCRAM_FILE File, PCRAM_BLOCK Core, const int32_t RefID, const int32_t Pos, const uint32_t ReadLength, PCRAM_CIGAR Cigar, int64_t *End)
+{
+	PCRAM_CODEC ds = File->CompressionHeader.DataSeries;
+	char *seq = (char *)File->Sequence.Data;
+	uint8_t *qual = File->Quality.Data;
+	PCRAM_BYTES bytes = &File->Bytes;
+	int32_t featureCount = 0;
+	int32_t featurePos = 0;
+	int32_t delta = 0;
+	int32_t length = 0;
+	uint32_t target = 0;
+	uint32_t readPos = 0;
+	int64_t refPos = (int64_t)Pos - 1;
+	uint8_t code = 0;
+	uint8_t value = 0;
+	uint8_t quality = 0;
+	char refBase = 'N';
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = cram_codec_decode_int(ds + cdsFeatureCount, Core, &featureCount);
+	for (int32_t i = 0; ret == ERR_SUCCESS && i < featureCount; ++i) {
+		ret = cram_codec_decode_byte(ds + cdsFeatureCode, Core, &code);
+		if (ret == ERR_SUCCESS)
+			ret = cram_codec_decode_int(ds + cdsFeaturePosition, Core, &delta);
+
+		if (ret == ERR_SUCCESS) {
+			featurePos += delta;
+			if (featurePos < 1 || (uint32_t)featurePos > ReadLength + 1)
+				ret = ERR_CRAM_INVALID_RECORD;
+		}
+
+		if (ret == ERR_SUCCESS) {
+			target = (uint32_t)featurePos - 1;
+			if (readPos < target) {
+				_cram_copy_reference(File, RefID, refPos, seq + readPos, target - readPos);
+				ret = _cram_cigar_push(Cigar, 'M', target - readPos);
+				refPos += target - readPos;
+				readPos = target;
+			}
+		}
+
+		if (ret == ERR_SUCCESS) {
+			switch (code) {
+				case 'X':
+					ret = cram_codec_decode_byte(ds + cdsBaseSubstitution, Core, &value);
+					if (ret == ERR_SUCCESS && readPos < ReadLength) {
+						_cram_copy_reference(File, RefID, refPos, &refBase, 1);
+						seq[readPos++] = File->CompressionHeader.Substitutions[_cram_base_index(refBase)][value & 3];
+						++refPos;
+						ret = _cram_cigar_push(Cigar, 'M', 1);
+					} else if (ret == ERR_SUCCESS)
+						ret = ERR_CRAM_INVALID_RECORD;
+					break;
+				case 'B':
+					ret = cram_codec_decode_byte(ds + cdsBase, Core, &value);
+					if (ret == ERR_SUCCESS)
+						ret = cram_codec_decode_byte(ds + cdsQualityScore, Core, &quality);
+
+					if (ret == ERR_SUCCESS && readPos < ReadLength) {
+						seq[readPos] = (char)value;
+						qual[readPos] = quality;
+						++readPos;
+						++refPos;
+						ret = _cram_cigar_push(Cigar, 'M', 1);
+					} else if (ret == ERR_SUCCESS)
+						ret = ERR_CRAM_INVALID_RECORD;
+					break;
+				case 'b':
+				case 'I':
+				case 'S':
+					ret = cram_codec_decode_bytes(ds + ((code == 'b') ? cdsStretchOfBases : ((code == 'I') ? cdsInsertion : cdsSoftClip)), Core, bytes);
+					if (ret == ERR_SUCCESS && readPos + bytes->Length <= ReadLength) {
+						memcpy(seq + readPos, bytes->Data, bytes->Length);
+						readPos += (uint32_t)bytes->Length;
+						if (code == 'b')
+							refPos += bytes->Length;
+
+						ret = _cram_cigar_push(Cigar, (code == 'b') ? 'M' : code, (uint32_t)bytes->Length);
+					} else if (ret == ERR_SUCCESS)
+						ret = ERR_CRAM_INVALID_RECORD;
+					break;
+				case 'q':
+					ret = cram_codec_decode_bytes(ds + cdsStretchOfQualities, Core, bytes);
+					if (ret == ERR_SUCCESS && target + bytes->Length <= ReadLength)
+						memcpy(qual + target, bytes->Data, bytes->Length);
+					else if (ret == ERR_SUCCESS)
+						ret = ERR_CRAM_INVALID_RECORD;
+					break;
+				case 'Q':
+					ret = cram_codec_decode_byte(ds + cdsQualityScore, Core, &quality);
+					if (ret == ERR_SUCCESS && target < ReadLength)
+						qual[target] = quality;
+					else if (ret == ERR_SUCCESS)
+						ret = ERR_CRAM_INVALID_RECORD;
+					break;
+				case 'i':
+					ret = cram_codec_decode_byte(ds + cdsBase, Core, &value);
+					if (ret == ERR_SUCCESS && readPos < ReadLength) {
+						seq[readPos++] = (char)value;
+						ret = _cram_cigar_push(Cigar, 'I', 1);
+					} else if (ret == ERR_SUCCESS)
+						ret = ERR_CRAM_INVALID_RECORD;
+					break;
+				case 'D':
+				case 'N':
+				case 'P':
+				case 'H':
+					ret = cram_codec_decode_int(ds + ((code == 'D') ? cdsDeletionLength : ((code == 'N') ? cdsReferenceSkip : ((code == 'P') ? cdsPadding : cdsHardClip))), Core, &length);
+					if (ret == ERR_SUCCESS && length >= 0) {
+						if (code == 'D' || code == 'N')
+							refPos += length;
+
+						ret = _cram_cigar_push(Cigar, code, (uint32_t)length);
+					} else if (ret == ERR_SUCCESS)
+						ret = ERR_CRAM_INVALID_RECORD;
+					break;
+				default:
+					ret = ERR_CRAM_INVALID_RECORD;
+					break;
+			}
+		}
+	}
+
+	if (ret == ERR_SUCCESS && readPos < ReadLength) {
+		_cram_copy_reference(File, RefID, refPos, seq + readPos, ReadLength - readPos);
+		ret = _cram_cigar_push(Cigar, 'M', ReadLength - readPos);
+		refPos += ReadLength - readPos;
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_cigar_flush(Cigar);
+
+	if (ret == ERR_SUCCESS)
+		*End = refPos;
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_text_append(PCRAM_FILE File, const void *Data, const size_t Length, size_t *Offset)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = cram_bytes_reserve(&File->Text, File->Text.Length + Length + 1);
+	if (ret == ERR_SUCCESS) {
+		*Offset = File->Text.Length;
+		memcpy(File->Text.Data + File->Text.Length, Data, Length);
+		File->Text.Data[File->Text.Length + Length] = '\0';
+		File->Text.Length += Length + 1;
+	}
+
+	return ret;
+}
+
+
+/** Decodes the tags of a record. Only MD and NM are kept, the other tags are read just to keep the data streams in sync. */
+static ERR_VALUE _cram_decode_tags(PCRAM_FILE File, PCRAM_BLOCK Core, PCRAM_RECORD Record)
+{
+	PCRAM_COMPRESSION_HEADER header = &File->CompressionHeader;
+	const uint8_t *key = NULL;
+	int32_t tagLine = 0;
+	int32_t tagKey = 0;
+	int32_t index = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = cram_codec_decode_int(header->DataSeries + cdsTagLine, Core, &tagLine);
+	if (ret == ERR_SUCCESS && (tagLine < 0 || tagLine >= header->TagLineCount))
+		ret = (header->TagLineCount == 0 && tagLine == 0) ? ERR_SUCCESS : ERR_CRAM_INVALID_RECORD;
+
+	if (ret == ERR_SUCCESS && tagLine < header->TagLineCount) {
+		key = header->TagDictionary + header->TagLineOffsets[tagLine];
+		for (size_t i = 0; ret == ERR_SUCCESS && i < header->TagLineCounts[tagLine]; ++i) {
+			tagKey = (key[0] << 16) | (key[1] << 8) | key[2];
+			for (index = 0; index < header->TagCodecCount; ++index) {
+				if (header->TagKeys[index] == tagKey)
+					break;
+			}
+
+			if (index < header->TagCodecCount)
+				ret = cram_codec_decode_bytes(header->TagCodecs + index, Core, &File->Bytes);
+			else ret = ERR_CRAM_INVALID_RECORD;
+
+			if (ret == ERR_SUCCESS && key[0] == 'M' && key[1] == 'D' && key[2] == 'Z') {
+				ret = _cram_text_append(File, File->Bytes.Data, strnlen((char *)File->Bytes.Data, File->Bytes.Length), &Record->MDOffset);
+				Record->HasMD = (ret == ERR_SUCCESS);
+			} else if (ret == ERR_SUCCESS && key[0] == 'N' && key[1] == 'M')
+				Record->Extension.HasNM = bam_tag_int((char)key[2], File->Bytes.Data, File->Bytes.Length, &Record->Extension.NM) && Record->Extension.NM >= 0;
+
+			key += 3;
+		}
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_decode_record(PCRAM_FILE File, PCRAM_BLOCK Core, const int32_t Index, int32_t *LastPos, PCRAM_RECORD Record)
+{
+	PCRAM_COMPRESSION_HEADER header = &File->CompressionHeader;
+	PCRAM_CODEC ds = header->DataSeries;
+	int32_t bamFlags = 0;
+	int32_t cramFlags = 0;
+	int32_t readLength = 0;
+	int32_t pos = 0;
+	int32_t value = 0;
+	int32_t mateFlags = 0;
+	boolean nameDecoded = FALSE;
+	uint8_t mapQ = 0;
+	char generatedName[32];
+	CRAM_CIGAR cigar;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(Record, 0, sizeof(CRAM_RECORD));
+	Record->RefID = File->Slice.RefID;
+	Record->NextSegment = -1;
+	Record->Extension.RNext = _cramStar;
+	ret = cram_codec_decode_int(ds + cdsBamFlags, Core, &bamFlags);
+	if (ret == ERR_SUCCESS)
+		ret = cram_codec_decode_int(ds + cdsCramFlags, Core, &cramFlags);
+
+	if (ret == ERR_SUCCESS && File->Slice.RefID == -2)
+		ret = cram_codec_decode_int(ds + cdsReferenceID, Core, &Record->RefID);
+
+	if (ret == ERR_SUCCESS) {
+		ret = cram_codec_decode_int(ds + cdsReadLength, Core, &readLength);
+		if (ret == ERR_SUCCESS && readLength < 0)
+			ret = ERR_CRAM_INVALID_RECORD;
+	}
+
+	if (ret == ERR_SUCCESS) {
+		ret = cram_codec_decode_int(ds + cdsAlignmentStart, Core, &pos);
+		if (ret == ERR_SUCCESS && header->PositionsDelta) {
+			pos += *LastPos;
+			*LastPos = pos;
+		}
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_codec_decode_int(ds + cdsReadGroup, Core, &value);
+
+	if (ret == ERR_SUCCESS && header->ReadNamesIncluded) {
+		ret = cram_codec_decode_bytes(ds + cdsReadName, Core, &File->Bytes);
+		if (ret == ERR_SUCCESS) {
+			ret = _cram_text_append(File, File->Bytes.Data, File->Bytes.Length, &Record->NameOffset);
+			nameDecoded = TRUE;
+		}
+	}
+
+	if (ret == ERR_SUCCESS && (cramFlags & CRAM_FLAG_DETACHED) != 0) {
+		ret = cram_codec_decode_int(ds + cdsMateFlags, Core, &mateFlags);
+		if (ret == ERR_SUCCESS) {
+			if ((mateFlags & 1) != 0)
+				bamFlags |= 0x20;
+
+			if ((mateFlags & 2) != 0)
+				bamFlags |= 0x8;
+		}
+
+		if (ret == ERR_SUCCESS && !header->ReadNamesIncluded) {
+			ret = cram_codec_decode_bytes(ds + cdsReadName, Core, &File->Bytes);
+			if (ret == ERR_SUCCESS) {
+				ret = _cram_text_append(File, File->Bytes.Data, File->Bytes.Length, &Record->NameOffset);
+				nameDecoded = TRUE;
+			}
+		}
+
+		if (ret == ERR_SUCCESS)
+			ret = cram_codec_decode_int(ds + cdsMateReferenceID, Core, &value);
+
+		if (ret == ERR_SUCCESS) {
+			if (value == -1)
+				Record->Extension.RNext = _cramStar;
+			else if (value == Record->RefID)
+				Record->Extension.RNext = _cramRNextSame;
+			else Record->Extension.RNext = _cram_reference_name(File, value);
+
+			ret = cram_codec_decode_int(ds + cdsMatePosition, Core, &value);
+			if (ret == ERR_SUCCESS)
+				Record->Extension.PNext = (uint64_t)(int64_t)value;
+		}
+
+		if (ret == ERR_SUCCESS)
+			ret = cram_codec_decode_int(ds + cdsTemplateSize, Core, &Record->Extension.TLen);
+	} else if (ret == ERR_SUCCESS && (cramFlags & CRAM_FLAG_MATE_DOWNSTREAM) != 0) {
+		ret = cram_codec_decode_int(ds + cdsDistanceToMate, Core, &value);
+		if (ret == ERR_SUCCESS && value >= 0)
+			Record->NextSegment = Index + value + 1;
+	}
+
+	if (ret == ERR_SUCCESS && !nameDecoded) {
+		sprintf(generatedName, "%lld", (long long)(File->Slice.RecordCounter + Index + 1));
+		ret = _cram_text_append(File, generatedName, strlen(generatedName), &Record->NameOffset);
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_decode_tags(File, Core, Record);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_bytes_reserve(&File->Sequence, readLength + 1);
+
+	if (ret == ERR_SUCCESS)
+		ret = cram_bytes_reserve(&File->Quality, readLength + 1);
+
+	if (ret == ERR_SUCCESS) {
+		memset(File->Quality.Data, 0xff, readLength);
+		File->Cigar.Length = 0;
+		cigar.Text = &File->Cigar;
+		cigar.Operation = '\0';
+		cigar.Length = 0;
+		if ((bamFlags & 0x4) == 0) {
+			ret = _cram_decode_features(File, Core, Record->RefID, pos, readLength, &cigar, &Record->End);
+			if (ret == ERR_SUCCESS)
+				ret = cram_codec_decode_int(ds + cdsMappingQuality, Core, &value);
+
+			if (ret == ERR_SUCCESS)
+				mapQ = (uint8_t)value;
+		} else {
+			ret = cram_bytes_reserve(&File->Cigar, 2);
+			if (ret == ERR_SUCCESS) {
+				File->Cigar.Data[0] = '*';
+				File->Cigar.Length = 1;
+			}
+
+			for (int32_t i = 0; ret == ERR_SUCCESS && i < readLength; ++i) {
+				if ((cramFlags & CRAM_FLAG_NO_SEQUENCE) == 0)
+					ret = cram_codec_decode_byte(ds + cdsBase, Core, File->Sequence.Data + i);
+				else File->Sequence.Data[i] = 'N';
+			}
+
+			Record->End = pos;
+		}
+	}
+
+	for (int32_t i = 0; ret == ERR_SUCCESS && (cramFlags & CRAM_FLAG_QUALITY_ARRAY) != 0 && i < readLength; ++i)
+		ret = cram_codec_decode_byte(ds + cdsQualityScore, Core, File->Quality.Data + i);
+
+	if (ret == ERR_SUCCESS) {
+		for (int32_t i = 0; i < readLength; ++i) {
+			if (File->Quality.Data[i] == 0xff)
+				File->Quality.Data[i] = 0;
+		}
+
+		if ((cramFlags & CRAM_FLAG_NO_SEQUENCE) != 0)
+			readLength = 0;
+
+		ret = _cram_text_append(File, File->Cigar.Data, File->Cigar.Length, &Record->CigarOffset);
+	}
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_text_append(File, File->Sequence.Data, readLength, &Record->SequenceOffset);
+
+	if (ret == ERR_SUCCESS)
+		ret = _cram_text_append(File, File->Quality.Data, readLength, &Record->QualityOffset);
+
+	if (ret == ERR_SUCCESS) {
+		Record->Read.Pos = (uint64_t)((int64_t)pos - 1);
+		Record->Read.PosQuality = mapQ;
+		Record->Read.ReadSequenceLen = readLength;
+		Record->Extension.Flags.Value = (uint16_t)bamFlags;
+		Record->Extension.RName = _cram_reference_name(File, Record->RefID);
+	} else if (ret == ERR_CRAM_INVALID_BLOCK)
+		ret = ERR_CRAM_INVALID_RECORD;
+
+	return ret;
+}
+
+
+static void _cram_set_mate(PCRAM_RECORD Record, const CRAM_RECORD *Mate, const CRAM_FILE *File)
+{
+	if (Mate->RefID == -1)
+		Record->Extension.RNext = _cramStar;
+	else if (Mate->RefID == Record->RefID)
+		Record->Extension.RNext = _cramRNextSame;
+	else Record->Extension.RNext = _cram_reference_name(File, Mate->RefID);
+
+	Record->Extension.PNext = Mate->Read.Pos + 1;
+	if ((Mate->Extension.Flags.Value & 0x10) != 0)
+		Record->Extension.Flags.Value |= 0x20;
+
+	if ((Mate->Extension.Flags.Value & 0x4) != 0)
+		Record->Extension.Flags.Value |= 0x8;
+
+	return;
+}
+
+
+/** Fills the mate fields of segments whose mates are stored later in the same slice. Each segment points to the next one,
+    the last segment points back to the first. The template length is computed for templates aligned to one reference. */
+static void _cram_resolve_mates(PCRAM_FILE File)
+{
+	const size_t count = gen_array_size(&File->Records);
+	PCRAM_RECORD records = File->Records.Data;
+	PCRAM_RECORD r = NULL;
+	int32_t next = 0;
+	int64_t left = 0;
+	int64_t right = 0;
+	boolean sameReference = TRUE;
+	boolean leftmostSeen = FALSE;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (records[i].NextSegment >= (int32_t)count)
+			records[i].NextSegment = -1;
+
+		if (records[i].NextSegment >= 0)
+			records[records[i].NextSegment].HasPreviousSegment = TRUE;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		if (records[i].NextSegment >= 0 && !records[i].HasPreviousSegment) {
+			r = records + i;
+			left = (int64_t)r->Read.Pos + 1;
+			right = r->End;
+			sameReference = ((r->Extension.Flags.Value & 0x4) == 0);
+			while (r->NextSegment >= 0) {
+				next = r->NextSegment;
+				_cram_set_mate(r, records + next, File);
+				r = records + next;
+				left = min(left, (int64_t)r->Read.Pos + 1);
+				right = max(right, r->End);
+				sameReference &= (r->RefID == records[i].RefID && (r->Extension.Flags.Value & 0x4) == 0);
+			}
+
+			_cram_set_mate(r, records + i, File);
+			r = records + i;
+			leftmostSeen = FALSE;
+			do {
+				r->Extension.TLen = 0;
+				if (sameReference) {
+					if (!leftmostSeen && (int64_t)r->Read.Pos + 1 == left) {
+						r->Extension.TLen = (int32_t)(right - left + 1);
+						leftmostSeen = TRUE;
+					} else r->Extension.TLen = -(int32_t)(right - left + 1);
+				}
+
+				r = (r->NextSegment >= 0) ? records + r->NextSegment : NULL;
+			} while (r != NULL);
+		}
+	}
+
+	return;
+}
+
+
+static ERR_VALUE _cram_decode_slice(PCRAM_FILE File)
+{
+	PCRAM_BLOCK core = NULL;
+	PCRAM_RECORD r = NULL;
+	CRAM_RECORD record;
+	int32_t lastPos = File->Slice.Start;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	File->EmbeddedReference = NULL;
+	for (size_t i = 0; i < File->BlockCount; ++i) {
+		if (File->Blocks[i].ContentType == cbcCoreData)
+			core = File->Blocks + i;
+		else if (File->Blocks[i].ContentType == cbcExternalData && File->Blocks[i].ContentID == File->Slice.EmbeddedReferenceID)
+			File->EmbeddedReference = File->Blocks + i;
+	}
+
+	for (size_t i = 0; i < cdsMax; ++i)
+		cram_codec_bind(File->CompressionHeader.DataSeries + i, File->Blocks, File->BlockCount);
+
+	for (int32_t i = 0; i < File->CompressionHeader.TagCodecCount; ++i)
+		cram_codec_bind(File->CompressionHeader.TagCodecs + i, File->Blocks, File->BlockCount);
+
+	dym_array_clear_CRAM_RECORD(&File->Records);
+	File->NextRecord = 0;
+	File->Text.Length = 0;
+	ret = ERR_SUCCESS;
+	for (int32_t i = 0; i < File->Slice.RecordCount; ++i) {
+		ret = _cram_decode_record(File, core, i, &lastPos, &record);
+		if (ret == ERR_SUCCESS)
+			ret = dym_array_push_back_CRAM_RECORD(&File->Records, record);
+
+		if (ret != ERR_SUCCESS)
+			break;
+	}
+
+	if (ret == ERR_SUCCESS) {
+		_cram_resolve_mates(File);
+		for (size_t i = 0; i < gen_array_size(&File->Records); ++i) {
+			r = dym_array_item_CRAM_RECORD(&File->Records, i);
+			r->Read.Extension = &r->Extension;
+			r->Extension.TemplateName = (char *)File->Text.Data + r->NameOffset;
+			r->Extension.CIGAR = (char *)File->Text.Data + r->CigarOffset;
+			if (r->HasMD)
+				r->Extension.MD = (char *)File->Text.Data + r->MDOffset;
+			r->Read.ReadSequence = (char *)File->Text.Data + r->SequenceOffset;
+			r->Read.Quality = File->Text.Data + r->QualityOffset;
+		}
+	} else dym_array_clear_CRAM_RECORD(&File->Records);
+
+	return ret;
+}
+
+
+/** Loads the next container holding records that may lie in the region. Returns ERR_NO_MORE_ENTRIES at the end of the
+    file, or, for coordinate-sorted files, after the region. */
+static ERR_VALUE _cram_next_container(PCRAM_FILE File)
+{
+	CRAM_CONTAINER_HEADER header;
+	CRAM_CURSOR cursor;
+	ECRAMRegionRelation relation = crrInside;
+	boolean loaded = FALSE;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	File->LandmarkCount = 0;
+	File->NextSlice = 0;
+	do {
+		ret = _cram_read_container_header(File, &header);
+		if (ret == ERR_SUCCESS) {
+			relation = _cram_region_relation(File, header.RefID, header.Start, header.Span);
+			if (relation == crrAfter && File->Sorted)
+				ret = ERR_NO_MORE_ENTRIES;
+			else if (relation != crrInside || header.RecordCount == 0 || File->LandmarkCount == 0)
+				ret = _cram_seek_forward(File, header.Length);
+			else {
+				ret = _cram_load_container(File, &header);
+				if (ret == ERR_SUCCESS) {
+					cursor.Data = File->Container;
+					cursor.End = File->Container + File->ContainerLength;
+					ret = cram_block_read(&cursor, File->MajorVersion >= 3, &File->HeaderBlock);
+					if (ret == ERR_SUCCESS && File->HeaderBlock.ContentType != cbcCompressionHeader)
+						ret = ERR_CRAM_INVALID_CONTAINER;
+
+					if (ret == ERR_SUCCESS)
+						ret = _cram_parse_compression_header(File, &File->HeaderBlock);
+
+					loaded = (ret == ERR_SUCCESS);
+				}
+			}
+		}
+	} while (ret == ERR_SUCCESS && !loaded);
+
+	if (ret == ERR_CRAM_INVALID_BLOCK)
+		ret = ERR_CRAM_INVALID_CONTAINER;
+
+	return ret;
+}
+
+
+static ERR_VALUE _cram_reserve_blocks(PCRAM_FILE File, const size_t Count)
+{
+	PCRAM_BLOCK tmp = NULL;
+	ERR_VALUE ret = ERR_SUCCESS;
+
+	if (File->BlockAllocCount < Count) {
+		ret = utils_calloc_CRAM_BLOCK(Count, &tmp);
+		if (ret == ERR_SUCCESS) {
+			if (File->Blocks != NULL) {
+				memcpy(tmp, File->Blocks, File->BlockAllocCount * sizeof(CRAM_BLOCK));
+				utils_free(File->Blocks);
+			}
+
+			File->Blocks = tmp;
+			File->BlockAllocCount = Count;
+		}
+	}
+
+	return ret;
+}
+
+
+/** Decodes the next slice that may contain reads from the region. */
+static ERR_VALUE _cram_next_slice(PCRAM_FILE File)
+{
+	CRAM_CURSOR cursor;
+	boolean decoded = FALSE;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	do {
+		if (File->NextSlice >= File->LandmarkCount)
+			ret = _cram_next_container(File);
+
+		if (ret == ERR_SUCCESS) {
+			cursor.Data = File->Container + File->Landmarks[File->NextSlice];
+			cursor.End = (File->NextSlice + 1 < File->LandmarkCount) ? File->Container + File->Landmarks[File->NextSlice + 1] : File->Container + File->ContainerLength;
+			++File->NextSlice;
+			if (cursor.Data > cursor.End)
+				ret = ERR_CRAM_INVALID_CONTAINER;
+		}
+
+		if (ret == ERR_SUCCESS)
+			ret = cram_block_read(&cursor, File->MajorVersion >= 3, &File->HeaderBlock);
+
+		if (ret == ERR_SUCCESS)
+			ret = _cram_parse_slice_header(&File->HeaderBlock, &File->Slice);
+
+		if (ret == ERR_SUCCESS) {
+			switch (_cram_region_relation(File, File->Slice.RefID, File->Slice.Start, File->Slice.Span)) {
+				case crrAfter:
+					if (File->Sorted)
+						ret = ERR_NO_MORE_ENTRIES;
+					break;
+				case crrInside:
+					ret = _cram_reserve_blocks(File, File->Slice.BlockCount);
+					File->BlockCount = 0;
+					while (ret == ERR_SUCCESS && File->BlockCount < (size_t)File->Slice.BlockCount) {
+						ret = cram_block_read(&cursor, File->MajorVersion >= 3, File->Blocks + File->BlockCount);
+						if (ret == ERR_SUCCESS)
+							++File->BlockCount;
+					}
+
+					if (ret == ERR_SUCCESS)
+						ret = _cram_decode_slice(File);
+
+					decoded = (ret == ERR_SUCCESS);
+					break;
+				default:
+					break;
+			}
+		}
+	} while (ret == ERR_SUCCESS && !decoded);
+
+	if (ret == ERR_CRAM_INVALID_BLOCK)
+		ret = ERR_CRAM_INVALID_CONTAINER;
+
+	return ret;
+}
+
+
+/************************************************************************/
+/*                        PUBLIC FUNCTIONS                              */
+/************************************************************************/
+
+
+boolean cram_is_cram(const char *FileName)
+{
+	FILE *f = NULL;
+	char magic[4];
+	boolean ret = FALSE;
+
+	if (utils_fopen(FileName, FOPEN_MODE_READ, &f) == ERR_SUCCESS) {
+		ret = (fread(magic, 1, sizeof(magic), f) == sizeof(magic) && memcmp(magic, "CRAM", sizeof(magic)) == 0);
+		utils_fclose(f);
+	}
+
+	return ret;
+}
+
+
+/** Opens a CRAM file and reads its header. Bases of reads aligned to the given reference sequence are reconstructed from
+    it; the reference must stay loaded until the file is closed. */
+ERR_VALUE cram_open(const char *FileName, const REFSEQ_DATA *Reference, PCRAM_FILE File)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(File, 0, sizeof(CRAM_FILE));
+	File->Reference = Reference;
+	File->ReferenceID = -1;
+	File->RegionRefID = -1;
+	dym_array_init_CRAM_RECORD(&File->Records, 140);
+	ret = utils_fopen(FileName, FOPEN_MODE_READ, &File->Stream);
+	if (ret == ERR_SUCCESS) {
+		ret = _cram_read_header(File);
+		if (ret == ERR_SUCCESS)
+			ret = _cram_read_reference_names(File);
+
+		if (ret == ERR_SUCCESS && Reference != NULL && Reference->Name != NULL)
+			File->ReferenceID = cram_reference_index(File, Reference->Name);
+
+		if (ret != ERR_SUCCESS)
+			cram_close(File);
+	} else dym_array_finit_CRAM_RECORD(&File->Records);
+
+	return ret;
+}
+
+
+/** Returns the index of the reference sequence of the given name, or -1 if the header does not contain it. */
+int32_t cram_reference_index(const CRAM_FILE *File, const char *Name)
+{
+	int32_t ret = -1;
+
+	for (int32_t i = 0; i < File->ReferenceCount; ++i) {
+		if (strcmp(File->ReferenceNames[i], Name) == 0) {
+			ret = i;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+
+/** Restricts reading to containers and slices overlapping the region. If the file is coordinate-sorted, reading stops
+    at the first container that starts after the region. */
+void cram_set_region(PCRAM_FILE File, const int32_t RefID, const uint64_t Start, const uint64_t End, const boolean Sorted)
+{
+	File->RegionRefID = RefID;
+	File->RegionStart = Start;
+	File->RegionEnd = End;
+	File->Sorted = Sorted;
+
+	return;
+}
+
+
+/** Returns the next record. The read is valid until the next call; ERR_NO_MORE_ENTRIES is returned at the end of the input. */
+ERR_VALUE cram_read_record(PCRAM_FILE File, PONE_READ *Read)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	while (ret == ERR_SUCCESS && File->NextRecord >= gen_array_size(&File->Records))
+		ret = _cram_next_slice(File);
+
+	if (ret == ERR_SUCCESS) {
+		*Read = &dym_array_item_CRAM_RECORD(&File->Records, File->NextRecord)->Read;
+		++File->NextRecord;
+		++File->RecordsRead;
+	}
+
+	return ret;
+}
+
+
+void cram_close(PCRAM_FILE File)
+{
+	_cram_compression_header_free(&File->CompressionHeader);
+	for (size_t i = 0; i < File->BlockAllocCount; ++i)
+		cram_block_free(File->Blocks + i);
+
+	if (File->Blocks != NULL)
+		utils_free(File->Blocks);
+
+	cram_block_free(&File->HeaderBlock);
+	cram_bytes_free(&File->Quality);
+	cram_bytes_free(&File->Sequence);
+	cram_bytes_free(&File->Cigar);
+	cram_bytes_free(&File->Bytes);
+	cram_bytes_free(&File->Text);
+	cram_bytes_free(&File->ContainerHeader);
+	dym_array_finit_CRAM_RECORD(&File->Records);
+	if (File->Landmarks != NULL)
+		utils_free(File->Landmarks);
+
+	if (File->Container != NULL)
+		utils_free(File->Container);
+
+	if (File->ReferenceNames != NULL) {
+		for (int32_t i = 0; i < File->ReferenceCount; ++i)
+			utils_free(File->ReferenceNames[i]);
+
+		utils_free(File->ReferenceNames);
+	}
+
+	if (File->HeaderText != NULL)
+		utils_free(File->HeaderText);
+
+	if (File->Stream != NULL)
+		utils_fclose(File->Stream);
+
+	return;
+}
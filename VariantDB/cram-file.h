@@ -0,0 +1,166 @@
+
+#ifndef __CRAM_FILE_H__
+#define __CRAM_FILE_H__
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+#include "gen_dym_array.h"
+#include "reads.h"
+#include "input-file.h"
+#include "cram-codec.h"
+
+
+/** Size of the CRAM file definition (magic, version and file ID). */
+#define CRAM_FILE_DEFINITION_SIZE			26
+
+/** Data series of CRAM records. */
+typedef enum _ECRAMDataSeries {
+	cdsBamFlags,
+	cdsCramFlags,
+	cdsReferenceID,
+	cdsReadLength,
+	cdsAlignmentStart,
+	cdsReadGroup,
+	cdsReadName,
+	cdsMateFlags,
+	cdsMateReferenceID,
+	cdsMatePosition,
+	cdsTemplateSize,
+	cdsDistanceToMate,
+	cdsTagLine,
+	cdsFeatureCount,
+	cdsFeatureCode,
+	cdsFeaturePosition,
+	cdsDeletionLength,
+	cdsStretchOfBases,
+	cdsStretchOfQualities,
+	cdsBaseSubstitution,
+	cdsInsertion,
+	cdsReferenceSkip,
+	cdsPadding,
+	cdsHardClip,
+	cdsSoftClip,
+	cdsMappingQuality,
+	cdsBase,
+	cdsQualityScore,
+	cdsMax,
+} ECRAMDataSeries, *PECRAMDataSeries;
+
+/** Bits of the CRAM-specific record flags (the CF data series). */
+#define CRAM_FLAG_QUALITY_ARRAY				0x1
+#define CRAM_FLAG_DETACHED					0x2
+#define CRAM_FLAG_MATE_DOWNSTREAM			0x4
+#define CRAM_FLAG_NO_SEQUENCE				0x8
+
+typedef struct _CRAM_COMPRESSION_HEADER {
+	boolean ReadNamesIncluded;
+	boolean PositionsDelta;
+	boolean ReferenceRequired;
+	/** Bases substituting a reference base (A, C, G, T, N) for each of the four substitution codes. */
+	char Substitutions[5][4];
+	/** Tag dictionary: every line lists 3-byte keys (tag name and type) of the tags of a record. */
+	uint8_t *TagDictionary;
+	size_t TagDictionaryLength;
+	size_t *TagLineOffsets;
+	size_t *TagLineCounts;
+	int32_t TagLineCount;
+	CRAM_CODEC DataSeries[cdsMax];
+	int32_t *TagKeys;
+	CRAM_CODEC *TagCodecs;
+	int32_t TagCodecCount;
+} CRAM_COMPRESSION_HEADER, *PCRAM_COMPRESSION_HEADER;
+
+typedef struct _CRAM_RECORD {
+	ONE_READ Read;
+	ONE_READ_EXTENSION Extension;
+	int32_t RefID;
+	/** 1-based position of the last reference base covered by the alignment. */
+	int64_t End;
+	/** Index of the next segment of the template within the slice, or -1. */
+	int32_t NextSegment;
+	boolean HasPreviousSegment;
+	/** Offsets of the strings of the record within the text buffer of the slice. */
+	size_t NameOffset;
+	size_t CigarOffset;
+	size_t SequenceOffset;
+	size_t QualityOffset;
+	size_t MDOffset;
+	boolean HasMD;
+} CRAM_RECORD, *PCRAM_RECORD;
+
+typedef struct _CRAM_SLICE_HEADER {
+	int32_t RefID;
+	int32_t Start;
+	int32_t Span;
+	int32_t RecordCount;
+	int64_t RecordCounter;
+	int32_t BlockCount;
+	/** Content ID of the block holding the reference of the slice, or -1. */
+	int32_t EmbeddedReferenceID;
+} CRAM_SLICE_HEADER, *PCRAM_SLICE_HEADER;
+
+GEN_ARRAY_TYPEDEF(CRAM_RECORD);
+GEN_ARRAY_IMPLEMENTATION(CRAM_RECORD)
+
+typedef struct _CRAM_FILE {
+	FILE *Stream;
+	uint8_t MajorVersion;
+	uint8_t MinorVersion;
+	/** The SAM header text (null-terminated). */
+	char *HeaderText;
+	int32_t ReferenceCount;
+	char **ReferenceNames;
+	/** The reference sequence loaded in memory and its index among the references of the file (-1 if not present). */
+	const REFSEQ_DATA *Reference;
+	int32_t ReferenceID;
+	/** If RegionRefID is not -1, containers and slices not overlapping the region are skipped. */
+	int32_t RegionRefID;
+	uint64_t RegionStart;
+	uint64_t RegionEnd;
+	boolean Sorted;
+	/** Data of the current container (without its header). */
+	uint8_t *Container;
+	size_t ContainerAllocLength;
+	size_t ContainerLength;
+	CRAM_BYTES ContainerHeader;
+	int32_t *Landmarks;
+	int32_t LandmarkCount;
+	int32_t LandmarkAllocCount;
+	int32_t NextSlice;
+	CRAM_COMPRESSION_HEADER CompressionHeader;
+	boolean CompressionHeaderValid;
+	/** Compression header or slice header being parsed. */
+	CRAM_BLOCK HeaderBlock;
+	/** Header and blocks of the current slice. */
+	CRAM_SLICE_HEADER Slice;
+	CRAM_BLOCK *Blocks;
+	size_t BlockCount;
+	size_t BlockAllocCount;
+	const CRAM_BLOCK *EmbeddedReference;
+	boolean MissingReferenceReported;
+	/** Decoded records of the current slice and their strings. */
+	GEN_ARRAY_CRAM_RECORD Records;
+	size_t NextRecord;
+	CRAM_BYTES Text;
+	CRAM_BYTES Bytes;
+	CRAM_BYTES Cigar;
+	CRAM_BYTES Sequence;
+	CRAM_BYTES Quality;
+	uint64_t BytesRead;
+	uint64_t RecordsRead;
+} CRAM_FILE, *PCRAM_FILE;
+
+
+boolean cram_is_cram(const char *FileName);
+ERR_VALUE cram_open(const char *FileName, const REFSEQ_DATA *Reference, PCRAM_FILE File);
+int32_t cram_reference_index(const CRAM_FILE *File, const char *Name);
+void cram_set_region(PCRAM_FILE File, const int32_t RefID, const uint64_t Start, const uint64_t End, const boolean Sorted);
+ERR_VALUE cram_read_record(PCRAM_FILE File, PONE_READ *Read);
+void cram_close(PCRAM_FILE File);
+
+
+
+#endif
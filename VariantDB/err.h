@@ -73,6 +73,17 @@ typedef int ERR_VALUE;
 #define ERR_REF_REPEATS							62
 #define ERR_PLOT_FINISHED						63
 
+#define ERR_BGZF_INVALID_BLOCK					64
+#define ERR_BGZF_INFLATE_FAILED					65
+#define ERR_BAM_INVALID_HEADER					66
+#define ERR_BAM_INVALID_RECORD					67
+#define ERR_BAM_INVALID_INDEX					68
+#define ERR_CRAM_INVALID_HEADER					69
+#define ERR_CRAM_INVALID_CONTAINER				70
+#define ERR_CRAM_INVALID_BLOCK					71
+#define ERR_CRAM_UNSUPPORTED_CODEC				72
+#define ERR_CRAM_INVALID_RECORD					73
+
 
 
 #endif 
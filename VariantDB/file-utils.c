@@ -1,14 +1,22 @@
 
 #ifdef _WIN32
 #include <Windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #else
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #endif
+#ifndef _MSC_VER
+#include <pthread.h>
+#endif
+#include <omp.h>
 #include "err.h"
 #include "utils.h"
 #include "file-utils.h"
+#include "bgzf.h"
 
 
 
@@ -77,6 +85,28 @@ void utils_file_unmap(PFUTILS_MAPPED_FILE Handle)
 
 
 
+/** Checks whether the name stands for the standard input. */
+boolean utils_file_is_stdin(const char *FileName)
+{
+	return (strcmp(FileName, FUTILS_STDIN_NAME) == 0);
+}
+
+
+/** Checks whether the file is a regular file. Pipes, process substitutions and the standard input are
+    not, they can be read only once and only sequentially. */
+boolean utils_file_is_seekable(const char *FileName)
+{
+	struct stat st;
+	boolean ret = FALSE;
+
+	if (!utils_file_is_stdin(FileName) && stat(FileName, &st) == 0)
+		ret = ((st.st_mode & S_IFMT) == S_IFREG);
+
+	return ret;
+}
+
+
+/** Opens the file. The standard input is returned for FUTILS_STDIN_NAME opened for reading. */
 ERR_VALUE utils_fopen(const char *FileName, const uint32_t Mode, FILE **Stream)
 {
 	FILE *tmpStream = NULL;
@@ -101,7 +131,14 @@ ERR_VALUE utils_fopen(const char *FileName, const uint32_t Mode, FILE **Stream)
 	};
 
 #pragma warning(disable : 4996)
-	tmpStream = fopen(FileName, strModes[Mode]);
+	if (utils_file_is_stdin(FileName) && (Mode & FOPEN_MODE_READ) != 0) {
+#ifdef _WIN32
+		if ((Mode & FOPEN_MODE_TEXT) == 0)
+			_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		tmpStream = stdin;
+	} else tmpStream = fopen(FileName, strModes[Mode]);
+
 	if (tmpStream != NULL) {
 		*Stream = tmpStream;
 		ret = ERR_SUCCESS;
@@ -142,6 +179,383 @@ ERR_VALUE utils_file_read_line(FILE *File, char *Buffer, size_t MaxSize)
 }
 
 
+#ifndef _MSC_VER
+
+/** Reads the stream in a background thread into two buffers that are alternately filled by the thread
+    and drained by the line reader. */
+typedef struct _FUTILS_READ_AHEAD {
+	FILE *Stream;
+	pthread_t Thread;
+	pthread_mutex_t Mutex;
+	pthread_cond_t Cond;
+	char *Buffers[2];
+	size_t BufferSize;
+	/** Number of valid bytes in each buffer, valid when the buffer is marked as full. */
+	size_t Lengths[2];
+	boolean Full[2];
+	/** The buffer being drained and the read position within it (accessed by the consumer only). */
+	size_t Current;
+	size_t Offset;
+	/** Set by the thread after the last buffer has been filled. */
+	boolean Finished;
+	/** Set by the consumer to stop the thread early. */
+	boolean Terminate;
+	ERR_VALUE Error;
+} FUTILS_READ_AHEAD, *PFUTILS_READ_AHEAD;
+
+
+static void *_read_ahead_thread(void *Context)
+{
+	PFUTILS_READ_AHEAD ra = (PFUTILS_READ_AHEAD)Context;
+	size_t index = 0;
+	size_t bytesRead = 0;
+	boolean done = FALSE;
+
+	while (!done) {
+		pthread_mutex_lock(&ra->Mutex);
+		while (ra->Full[index] && !ra->Terminate)
+			pthread_cond_wait(&ra->Cond, &ra->Mutex);
+
+		done = ra->Terminate;
+		pthread_mutex_unlock(&ra->Mutex);
+		if (!done) {
+			bytesRead = fread(ra->Buffers[index], sizeof(char), ra->BufferSize, ra->Stream);
+			pthread_mutex_lock(&ra->Mutex);
+			ra->Lengths[index] = bytesRead;
+			ra->Full[index] = TRUE;
+			if (bytesRead < ra->BufferSize) {
+				if (ferror(ra->Stream))
+					ra->Error = ERR_IO_ERROR;
+
+				done = TRUE;
+			}
+
+			pthread_cond_broadcast(&ra->Cond);
+			pthread_mutex_unlock(&ra->Mutex);
+			index ^= 1;
+		}
+	}
+
+	pthread_mutex_lock(&ra->Mutex);
+	ra->Finished = TRUE;
+	pthread_cond_broadcast(&ra->Cond);
+	pthread_mutex_unlock(&ra->Mutex);
+
+	return NULL;
+}
+
+
+static ERR_VALUE _read_ahead_start(PFUTILS_LINE_READER Reader)
+{
+	PFUTILS_READ_AHEAD ra = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_calloc(1, sizeof(FUTILS_READ_AHEAD), (void **)&ra);
+	if (ret == ERR_SUCCESS) {
+		ra->Stream = Reader->Stream;
+		ra->BufferSize = Reader->BufferSize;
+		ra->Error = ERR_SUCCESS;
+		ret = utils_calloc_char(2 * ra->BufferSize, &ra->Buffers[0]);
+		if (ret == ERR_SUCCESS) {
+			ra->Buffers[1] = ra->Buffers[0] + ra->BufferSize;
+			pthread_mutex_init(&ra->Mutex, NULL);
+			pthread_cond_init(&ra->Cond, NULL);
+			if (pthread_create(&ra->Thread, NULL, _read_ahead_thread, ra) == 0)
+				Reader->ReadAhead = ra;
+			else {
+				pthread_cond_destroy(&ra->Cond);
+				pthread_mutex_destroy(&ra->Mutex);
+				utils_free(ra->Buffers[0]);
+				ret = ERR_INTERNAL_ERROR;
+			}
+		}
+
+		if (ret != ERR_SUCCESS)
+			utils_free(ra);
+	}
+
+	return ret;
+}
+
+
+/** Copies at most Length bytes of the data read ahead. *EndOfFile is set when no more data will come. */
+static ERR_VALUE _read_ahead_read(PFUTILS_READ_AHEAD ReadAhead, char *Buffer, const size_t Length, size_t *ReadLength, boolean *EndOfFile)
+{
+	size_t copyLength = 0;
+	size_t index = ReadAhead->Current;
+	boolean available = FALSE;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	*ReadLength = 0;
+	*EndOfFile = FALSE;
+	while (*ReadLength < Length && !*EndOfFile) {
+		pthread_mutex_lock(&ReadAhead->Mutex);
+		while (!ReadAhead->Full[index] && !ReadAhead->Finished)
+			pthread_cond_wait(&ReadAhead->Cond, &ReadAhead->Mutex);
+
+		available = ReadAhead->Full[index];
+		pthread_mutex_unlock(&ReadAhead->Mutex);
+		if (available) {
+			copyLength = min(Length - *ReadLength, ReadAhead->Lengths[index] - ReadAhead->Offset);
+			memcpy(Buffer + *ReadLength, ReadAhead->Buffers[index] + ReadAhead->Offset, copyLength);
+			*ReadLength += copyLength;
+			ReadAhead->Offset += copyLength;
+			if (ReadAhead->Offset == ReadAhead->Lengths[index]) {
+				*EndOfFile = (ReadAhead->Lengths[index] < ReadAhead->BufferSize);
+				pthread_mutex_lock(&ReadAhead->Mutex);
+				ReadAhead->Full[index] = FALSE;
+				pthread_cond_broadcast(&ReadAhead->Cond);
+				pthread_mutex_unlock(&ReadAhead->Mutex);
+				ReadAhead->Offset = 0;
+				index ^= 1;
+				ReadAhead->Current = index;
+			}
+		} else *EndOfFile = TRUE;
+	}
+
+	if (*EndOfFile)
+		ret = ReadAhead->Error;
+
+	return ret;
+}
+
+
+static void _read_ahead_stop(PFUTILS_LINE_READER Reader)
+{
+	PFUTILS_READ_AHEAD ra = Reader->ReadAhead;
+
+	pthread_mutex_lock(&ra->Mutex);
+	ra->Terminate = TRUE;
+	pthread_cond_broadcast(&ra->Cond);
+	pthread_mutex_unlock(&ra->Mutex);
+	pthread_join(ra->Thread, NULL);
+	pthread_cond_destroy(&ra->Cond);
+	pthread_mutex_destroy(&ra->Mutex);
+	utils_free(ra->Buffers[0]);
+	utils_free(ra);
+	Reader->ReadAhead = NULL;
+
+	return;
+}
+
+#endif
+
+
+static ERR_VALUE _line_reader_fill(PFUTILS_LINE_READER Reader)
+{
+	size_t bytesRead = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (Reader->Position > 0) {
+		memmove(Reader->Buffer, Reader->Buffer + Reader->Position, (Reader->ValidLength - Reader->Position)*sizeof(char));
+		Reader->ValidLength -= Reader->Position;
+		Reader->Position = 0;
+	}
+
+	ret = ERR_SUCCESS;
+	if (!Reader->EndOfFile && Reader->ValidLength < Reader->BufferSize) {
+		if (Reader->Bgzf != NULL) {
+			ret = bgzf_read_partial(Reader->Bgzf, Reader->Buffer + Reader->ValidLength, Reader->BufferSize - Reader->ValidLength, &bytesRead);
+			Reader->EndOfFile = (bytesRead < Reader->BufferSize - Reader->ValidLength);
+		}
+#ifndef _MSC_VER
+		else if (Reader->ReadAhead != NULL)
+			ret = _read_ahead_read(Reader->ReadAhead, Reader->Buffer + Reader->ValidLength, Reader->BufferSize - Reader->ValidLength, &bytesRead, &Reader->EndOfFile);
+#endif
+		else {
+			bytesRead = fread(Reader->Buffer + Reader->ValidLength, sizeof(char), Reader->BufferSize - Reader->ValidLength, Reader->Stream);
+			if (ferror(Reader->Stream))
+				ret = ERR_IO_ERROR;
+
+			Reader->EndOfFile = (feof(Reader->Stream) || bytesRead == 0);
+		}
+
+		Reader->ValidLength += bytesRead;
+		Reader->BytesRead += bytesRead;
+	}
+
+	return ret;
+}
+
+
+/** Doubles the buffer of the reader so that a line longer than the current buffer fits. The buffer must not
+    contain read lines (the Position is zero after _line_reader_fill()). */
+static ERR_VALUE _line_reader_grow(PFUTILS_LINE_READER Reader)
+{
+	char *buffer = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_calloc_char(2 * Reader->BufferSize + 1, &buffer);
+	if (ret == ERR_SUCCESS) {
+		memcpy(buffer, Reader->Buffer, Reader->ValidLength*sizeof(char));
+		utils_free(Reader->Buffer);
+		Reader->Buffer = buffer;
+		Reader->BufferSize *= 2;
+	}
+
+	return ret;
+}
+
+
+ERR_VALUE utils_line_reader_open(const char *FileName, const size_t BufferSize, PFUTILS_LINE_READER Reader)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(Reader, 0, sizeof(FUTILS_LINE_READER));
+	Reader->BufferSize = (BufferSize > 0) ? BufferSize : FUTILS_LINE_READER_DEFAULT_BUFFER_SIZE;
+	ret = utils_calloc_char(Reader->BufferSize + 1, &Reader->Buffer);
+	if (ret == ERR_SUCCESS) {
+		ret = utils_fopen(FileName, FOPEN_MODE_READ, &Reader->Stream);
+		if (ret == ERR_SUCCESS) {
+			Reader->StartTime = omp_get_wtime();
+			Reader->ValidLength = fread(Reader->Buffer, sizeof(char), min(Reader->BufferSize, BGZF_BLOCK_HEADER_SIZE), Reader->Stream);
+			if (bgzf_is_bgzf((uint8_t *)Reader->Buffer, Reader->ValidLength)) {
+				Reader->ValidLength = 0;
+				ret = utils_malloc(sizeof(BGZF_FILE), (void **)&Reader->Bgzf);
+				if (ret == ERR_SUCCESS) {
+					ret = bgzf_open_stream(Reader->Stream, (uint8_t *)Reader->Buffer, Reader->Bgzf);
+					if (ret == ERR_SUCCESS) {
+						Reader->Stream = NULL;
+						ret = bgzf_pipeline_start(Reader->Bgzf);
+						if (ret != ERR_SUCCESS)
+							bgzf_close(Reader->Bgzf);
+					}
+
+					if (ret != ERR_SUCCESS)
+						utils_free(Reader->Bgzf);
+				}
+
+				if (ret != ERR_SUCCESS && Reader->Stream != NULL)
+					utils_fclose(Reader->Stream);
+			} else {
+				Reader->BytesRead = Reader->ValidLength;
+				Reader->EndOfFile = (Reader->ValidLength < min(Reader->BufferSize, BGZF_BLOCK_HEADER_SIZE));
+#ifndef _MSC_VER
+				/* If the read-ahead thread cannot be started, _line_reader_fill() reads the stream by fread(). */
+				if (!Reader->EndOfFile && _read_ahead_start(Reader) != ERR_SUCCESS)
+					Reader->ReadAhead = NULL;
+#endif
+			}
+		}
+
+		if (ret != ERR_SUCCESS)
+			utils_free(Reader->Buffer);
+	}
+
+	return ret;
+}
+
+
+/** Returns the next line (null-terminated, without the line terminator). The line points into the buffer
+    of the reader and is valid until the next call. Lines longer than the buffer make it grow, so there is
+    no limit on the line length; the buffer keeps its size until the reader is closed. */
+ERR_VALUE utils_line_reader_next(PFUTILS_LINE_READER Reader, char **Line, size_t *Length)
+{
+	char *lineStart = NULL;
+	char *lineEnd = NULL;
+	size_t len = 0;
+	size_t searched = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	lineStart = Reader->Buffer + Reader->Position;
+	lineEnd = (char *)memchr(lineStart, '\n', Reader->ValidLength - Reader->Position);
+	if (lineEnd == NULL && !Reader->EndOfFile) {
+		searched = Reader->ValidLength - Reader->Position;
+		ret = _line_reader_fill(Reader);
+		while (ret == ERR_SUCCESS) {
+			/* Only the newly read data need to be searched for the line terminator. */
+			lineEnd = (char *)memchr(Reader->Buffer + searched, '\n', Reader->ValidLength - searched);
+			if (lineEnd != NULL || Reader->EndOfFile)
+				break;
+
+			searched = Reader->ValidLength;
+			if (Reader->ValidLength == Reader->BufferSize)
+				ret = _line_reader_grow(Reader);
+
+			if (ret == ERR_SUCCESS)
+				ret = _line_reader_fill(Reader);
+		}
+
+		lineStart = Reader->Buffer;
+	}
+
+	if (ret == ERR_SUCCESS) {
+		if (lineEnd != NULL) {
+			len = lineEnd - lineStart;
+			Reader->Position += len + 1;
+		} else {
+			len = Reader->ValidLength - Reader->Position;
+			Reader->Position = Reader->ValidLength;
+			if (len == 0)
+				ret = ERR_NO_MORE_ENTRIES;
+		}
+	}
+
+	if (ret == ERR_SUCCESS) {
+		if (len > 0 && lineStart[len - 1] == '\r')
+			--len;
+
+		lineStart[len] = '\0';
+		++Reader->LinesRead;
+		*Line = lineStart;
+		*Length = len;
+	}
+
+	return ret;
+}
+
+
+/** Returns the unread part of the buffer. It may end with an incomplete line. */
+void utils_line_reader_peek(const FUTILS_LINE_READER *Reader, const char **Data, size_t *Length)
+{
+	*Data = Reader->Buffer + Reader->Position;
+	*Length = Reader->ValidLength - Reader->Position;
+
+	return;
+}
+
+
+/** Discards the given number of bytes of the data returned by utils_line_reader_peek(). */
+void utils_line_reader_skip(PFUTILS_LINE_READER Reader, const size_t Length)
+{
+	Reader->Position += min(Length, Reader->ValidLength - Reader->Position);
+
+	return;
+}
+
+
+/** Returns the average read speed (bytes per second) since the file was opened. */
+double utils_line_reader_throughput(const FUTILS_LINE_READER *Reader)
+{
+	double ret = 0;
+	const double elapsed = omp_get_wtime() - Reader->StartTime;
+
+	if (elapsed > 0)
+		ret = (double)Reader->BytesRead / elapsed;
+
+	return ret;
+}
+
+
+void utils_line_reader_close(PFUTILS_LINE_READER Reader)
+{
+#ifndef _MSC_VER
+	if (Reader->ReadAhead != NULL)
+		_read_ahead_stop(Reader);
+
+#endif
+	if (Reader->Bgzf != NULL) {
+		bgzf_close(Reader->Bgzf);
+		utils_free(Reader->Bgzf);
+	} else utils_fclose(Reader->Stream);
+
+	utils_free(Reader->Buffer);
+
+	return;
+}
+
 
 ERR_VALUE utils_fwrite(const void *Buffer, const size_t Size, const size_t Count, FILE *Stream)
 {
@@ -155,9 +569,10 @@ ERR_VALUE utils_fwrite(const void *Buffer, const size_t Size, const size_t Count
 }
 
 
+/** Closes the file. The standard input is left open. */
 ERR_VALUE utils_fclose(FILE *Stream)
 {
-	return (fclose(Stream) == 0) ? ERR_SUCCESS : ERR_IO_ERROR;
+	return (Stream == stdin || fclose(Stream) == 0) ? ERR_SUCCESS : ERR_IO_ERROR;
 }
 
 
@@ -255,6 +670,29 @@ ERR_VALUE utils_split(const char *String, char Delimiter, PPOINTER_ARRAY_char Ar
 }
 
 
+/** Splits the String in place into at most MaxFields fields, replacing the delimiters by null characters.
+    The last field keeps the rest of the string, so the columns the caller does not need are neither scanned
+    nor copied. Returns the number of fields stored in Fields. */
+size_t utils_split_in_place(char *String, const char Delimiter, char **Fields, const size_t MaxFields)
+{
+	char *end = NULL;
+	size_t ret = 0;
+
+	while (ret < MaxFields && String != NULL) {
+		Fields[ret] = String;
+		++ret;
+		end = (ret < MaxFields) ? strchr(String, Delimiter) : NULL;
+		String = NULL;
+		if (end != NULL) {
+			*end = '\0';
+			String = end + 1;
+		}
+	}
+
+	return ret;
+}
+
+
 void utils_split_free(PPOINTER_ARRAY_char Array)
 {
 	for (size_t i = 0; i < pointer_array_size(Array); ++i) {
@@ -13,6 +13,9 @@
 #define FOPEN_MODE_APPEND			4
 #define FOPEN_MODE_TEXT				8
 
+/** File name standing for the standard input. */
+#define FUTILS_STDIN_NAME			"-"
+
 typedef struct _FUILTS_MAPPED_FILE {
 	void *Address;
 	uint64_t Size;
@@ -22,16 +25,55 @@ typedef struct _FUILTS_MAPPED_FILE {
 ERR_VALUE utils_file_map(const char *FileName, PFUTILS_MAPPED_FILE Handle);
 void utils_file_unmap(PFUTILS_MAPPED_FILE Handle);
 
+/** Default initial size of the line reader buffer, in bytes. The buffer grows to fit longer lines. */
+#define FUTILS_LINE_READER_DEFAULT_BUFFER_SIZE		(4*1024*1024)
+
+struct _BGZF_FILE;
+struct _FUTILS_READ_AHEAD;
+
+/** Reads a text file line by line through a large refillable buffer. bgzip-compressed files are
+    decompressed transparently. Uncompressed input is read ahead by a background thread, so pipes
+    and the standard input can be consumed while the producer keeps writing. */
+typedef struct _FUTILS_LINE_READER {
+	FILE *Stream;
+	/** The BGZF file if the input is compressed (Stream is NULL in that case). */
+	struct _BGZF_FILE *Bgzf;
+	/** The background reader of uncompressed input (NULL if the buffer is filled by the calling thread). */
+	struct _FUTILS_READ_AHEAD *ReadAhead;
+	/** The buffer (one byte larger than BufferSize to allow null-termination of the last line). */
+	char *Buffer;
+	size_t BufferSize;
+	/** Start of the first unread line within the buffer. */
+	size_t Position;
+	/** Number of valid bytes in the buffer. */
+	size_t ValidLength;
+	boolean EndOfFile;
+	/** Total number of (uncompressed) bytes obtained from the stream. */
+	uint64_t BytesRead;
+	uint64_t LinesRead;
+	/** Time of opening the file (in seconds, omp_get_wtime()). */
+	double StartTime;
+} FUTILS_LINE_READER, *PFUTILS_LINE_READER;
+
 #define utils_in_mapped(aHandle, aPointer)	((uintptr_t)(aHandle.Address) <= (uintptr_t)(aPointer) && (uintptr_t)(aPointer) < (uintptr_t)(aHandle).Address + (uintptr_t)(aHandle).Size)
 
 ERR_VALUE utils_file_read(const char *FileName, char **Data, size_t *DataLength);
 
+boolean utils_file_is_stdin(const char *FileName);
+boolean utils_file_is_seekable(const char *FileName);
 ERR_VALUE utils_fopen(const char *FileName, const uint32_t Mode, FILE **Stream);
 ERR_VALUE utils_fread(void *Buffer, const size_t Size, const size_t Count, FILE *Stream);
 ERR_VALUE utils_file_read_line(FILE *File, char *Buffer, size_t MaxSize);
+ERR_VALUE utils_line_reader_open(const char *FileName, const size_t BufferSize, PFUTILS_LINE_READER Reader);
+ERR_VALUE utils_line_reader_next(PFUTILS_LINE_READER Reader, char **Line, size_t *Length);
+void utils_line_reader_peek(const FUTILS_LINE_READER *Reader, const char **Data, size_t *Length);
+void utils_line_reader_skip(PFUTILS_LINE_READER Reader, const size_t Length);
+double utils_line_reader_throughput(const FUTILS_LINE_READER *Reader);
+void utils_line_reader_close(PFUTILS_LINE_READER Reader);
 ERR_VALUE utils_fwrite(const void *Buffer, const size_t Size, const size_t Count, FILE *Stream);
 ERR_VALUE utils_fclose(FILE *Stream);
 ERR_VALUE utils_split(const char *String, char Delimiter, PPOINTER_ARRAY_char Array);
+size_t utils_split_in_place(char *String, const char Delimiter, char **Fields, const size_t MaxFields);
 void utils_split_free(PPOINTER_ARRAY_char Array);
 
 
@@ -2,12 +2,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <inttypes.h>
+#include <omp.h>
 #include "err.h"
 #include "utils.h"
 #include "file-utils.h"
 #include "options.h"
 #include "gen_dym_array.h"
 #include "reads.h"
+#include "read-kernels.h"
+#include "bgzf.h"
+#include "bam-file.h"
+#include "bam-index.h"
+#include "cram-file.h"
+#include "kthread.h"
 #include "input-file.h"
 
 
@@ -19,6 +27,72 @@ UTILS_TYPED_CALLOC_FUNCTION(ONE_READ)
 UTILS_TYPED_CALLOC_FUNCTION(ACTIVE_REGION)
 
 
+/** Throughput lines of the readers are printed only if set (input_set_verbose()). */
+static boolean _verbose = FALSE;
+
+/** Number of bytes of a memory-mapped SAM file parsed by one thread at a time. */
+#define INPUT_SAM_CHUNK_SIZE				(4*1024*1024)
+
+/** A read parsed from a memory-mapped SAM file. Extension pointer of the read is set just before the callback. */
+typedef struct _SAM_PARSED_READ {
+	ONE_READ Read;
+	ONE_READ_EXTENSION Extension;
+} SAM_PARSED_READ, *PSAM_PARSED_READ;
+
+GEN_ARRAY_TYPEDEF(SAM_PARSED_READ);
+GEN_ARRAY_IMPLEMENTATION(SAM_PARSED_READ)
+
+/** A newline-aligned range of a memory-mapped SAM file, together with the reads parsed from it. */
+typedef struct _SAM_CHUNK {
+	const char *Start;
+	size_t Length;
+	/** Writable copy of the range; the parsed reads point into it. */
+	char *Text;
+	size_t TextAllocLength;
+	GEN_ARRAY_SAM_PARSED_READ Reads;
+	uint64_t LineCount;
+	ERR_VALUE Status;
+} SAM_CHUNK, *PSAM_CHUNK;
+
+/** Number of leading columns read from VCF (CHROM to QUAL) and BED (chrom to chromEnd) lines. */
+#define VCF_FIELD_COUNT						6
+#define BED_FIELD_COUNT						3
+
+/** Granularity of the search for the region in a memory-mapped coordinate-sorted SAM file. */
+#define INPUT_SAM_SEARCH_GRANULARITY		(64*1024)
+
+/** Sort order of a SAM/BAM file, taken from its header. */
+typedef struct _SAM_SORT_INFO {
+	/** The header contains @HD SO:coordinate. */
+	boolean Sorted;
+	/** Names of the reference sequences (@SQ SN), in the header order. */
+	POINTER_ARRAY_char Contigs;
+	/** Index of the region contig, -1 if the order cannot be used. */
+	int32_t TargetIndex;
+	/** Result of the last contig lookup. */
+	int32_t LastIndex;
+} SAM_SORT_INFO, *PSAM_SORT_INFO;
+
+typedef enum _ESAMRegionRelation {
+	srrBefore,
+	srrInside,
+	srrAfter,
+	srrUnknown,
+} ESAMRegionRelation, *PESAMRegionRelation;
+
+typedef struct _READ_BATCH_CONTEXT {
+	PINPUT_READ_BATCH Batch;
+	INPUT_READ_BATCH_CALLBACK *Callback;
+	void *Context;
+} READ_BATCH_CONTEXT, *PREAD_BATCH_CONTEXT;
+
+typedef struct _SAM_PARSE_CONTEXT {
+	PSAM_CHUNK Chunks;
+	const CONFIDENT_REGION *Region;
+	const INPUT_READ_OPTIONS *Options;
+} SAM_PARSE_CONTEXT, *PSAM_PARSE_CONTEXT;
+
+
 static const char *_read_line(const char *LineStart)
 {
 	while (*LineStart != '\n' && *LineStart != '\r' && *LineStart != 26 && *LineStart != '\0')
@@ -39,6 +113,879 @@ static const char *_advance_to_next_line(const char *LineEnd)
 typedef const char * cchar;
 
 
+static void _report_throughput(const char *FileName, const FUTILS_LINE_READER *Reader)
+{
+	if (_verbose)
+		fprintf(stderr, "[INFO]: %s: %" PRIu64 " bytes, %" PRIu64 " lines read (%.2lf MB/s)\n", FileName, Reader->BytesRead, Reader->LinesRead, utils_line_reader_throughput(Reader) / (1024 * 1024));
+
+	return;
+}
+
+
+static boolean _input_read_accepted(const uint64_t Pos, const uint8_t PosQuality, const READ_FLAGS Flags, const INPUT_READ_OPTIONS *Options)
+{
+	return !(PosQuality < Options->MinMapQ || Pos == (uint64_t)-1 ||
+		(Flags.Value & Options->FlagMask) != 0);
+}
+
+
+/** Decides about a read whose view contains only the fields filled by read_view_from_sam_line_core(). */
+static boolean _sam_read_prefilter(const ONE_READ *Read, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options)
+{
+	return (Region == NULL || (strcmp(Region->Chrom, Read->Extension->RName) == 0 && Region->Start <= Read->Pos && Read->Pos < Region->End)) &&
+		_input_read_accepted(Read->Pos, Read->PosQuality, Read->Extension->Flags, Options);
+}
+
+
+static boolean _sam_header_is_sorted(const char *Line, const size_t Length)
+{
+	boolean ret = FALSE;
+
+	if (Length > 4 && memcmp(Line, "@HD\t", 4) == 0) {
+		for (size_t i = 3; i + 14 <= Length; ++i) {
+			if (memcmp(Line + i, "\tSO:coordinate", 14) == 0 && (i + 14 == Length || Line[i + 14] == '\t' || Line[i + 14] == '\r' || Line[i + 14] == '\n')) {
+				ret = TRUE;
+				break;
+			}
+		}
+	}
+
+	return ret;
+}
+
+
+static void _sam_sort_info_init(PSAM_SORT_INFO Info)
+{
+	memset(Info, 0, sizeof(SAM_SORT_INFO));
+	pointer_array_init_char(&Info->Contigs, 140);
+	Info->TargetIndex = -1;
+	Info->LastIndex = -1;
+
+	return;
+}
+
+
+static void _sam_sort_info_finit(PSAM_SORT_INFO Info)
+{
+	utils_split_free(&Info->Contigs);
+	pointer_array_finit_char(&Info->Contigs);
+
+	return;
+}
+
+
+/** Processes one header line (not necessarily null-terminated). */
+static ERR_VALUE _sam_sort_info_add_line(PSAM_SORT_INFO Info, const char *Line, const size_t Length)
+{
+	const char *name = NULL;
+	size_t nameLength = 0;
+	char *tmp = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	if (_sam_header_is_sorted(Line, Length))
+		Info->Sorted = TRUE;
+	else if (Length > 4 && memcmp(Line, "@SQ\t", 4) == 0) {
+		for (size_t i = 3; i + 4 <= Length; ++i) {
+			if (memcmp(Line + i, "\tSN:", 4) == 0) {
+				name = Line + i + 4;
+				while (name + nameLength < Line + Length && name[nameLength] != '\t' && name[nameLength] != '\r' && name[nameLength] != '\n')
+					++nameLength;
+
+				break;
+			}
+		}
+
+		if (name != NULL) {
+			ret = utils_malloc(nameLength + 1, (void **)&tmp);
+			if (ret == ERR_SUCCESS) {
+				memcpy(tmp, name, nameLength);
+				tmp[nameLength] = '\0';
+				ret = pointer_array_push_back_char(&Info->Contigs, tmp);
+				if (ret != ERR_SUCCESS)
+					utils_free(tmp);
+			}
+		}
+	}
+
+	return ret;
+}
+
+
+static int32_t _sam_sort_info_contig(PSAM_SORT_INFO Info, const char *Name, const size_t Length)
+{
+	int32_t ret = -1;
+	const char *c = NULL;
+
+	if (Info->LastIndex != -1) {
+		c = Info->Contigs.Data[Info->LastIndex];
+		if (strncmp(c, Name, Length) == 0 && c[Length] == '\0')
+			ret = Info->LastIndex;
+	}
+
+	for (size_t i = 0; ret == -1 && i < pointer_array_size(&Info->Contigs); ++i) {
+		c = Info->Contigs.Data[i];
+		if (strncmp(c, Name, Length) == 0 && c[Length] == '\0') {
+			ret = (int32_t)i;
+			Info->LastIndex = ret;
+		}
+	}
+
+	return ret;
+}
+
+
+/** Called after the header has been read. The order is used only for sorted files containing the region contig. */
+static void _sam_sort_info_set_region(PSAM_SORT_INFO Info, const char *FileName, const CONFIDENT_REGION *Region)
+{
+	Info->TargetIndex = -1;
+	if (Info->Sorted && Region != NULL) {
+		Info->TargetIndex = _sam_sort_info_contig(Info, Region->Chrom, strlen(Region->Chrom));
+		if (Info->TargetIndex != -1)
+			fprintf(stderr, "[INFO]: %s: coordinate-sorted, reading stops after the region\n", FileName);
+	}
+
+	return;
+}
+
+
+/** Determines the relation of an alignment to the region. Unmapped alignments (RNAME "*") are sorted last. */
+static ESAMRegionRelation _sam_sort_info_relation(PSAM_SORT_INFO Info, const char *RName, const size_t RNameLength, const uint64_t Pos, const uint64_t Start, const uint64_t End)
+{
+	int32_t index = 0;
+	ESAMRegionRelation ret = srrUnknown;
+
+	if (Info->TargetIndex != -1) {
+		if (RNameLength == 1 && *RName == '*')
+			index = INT32_MAX;
+		else index = _sam_sort_info_contig(Info, RName, RNameLength);
+
+		if (index == -1)
+			ret = srrUnknown;
+		else if (index < Info->TargetIndex || (index == Info->TargetIndex && Pos < Start))
+			ret = srrBefore;
+		else if (index > Info->TargetIndex || Pos >= End)
+			ret = srrAfter;
+		else ret = srrInside;
+	}
+
+	return ret;
+}
+
+
+/** Extracts RNAME and POS (converted to 0-based) from a SAM line that need not be null-terminated. */
+static boolean _sam_line_key(const char *Line, const size_t Length, const char **RName, size_t *RNameLength, uint64_t *Pos)
+{
+	const char *end = Line + Length;
+	const char *field = Line;
+	uint64_t pos = 0;
+	boolean ret = FALSE;
+
+	for (int i = 0; i < 2 && field != NULL; ++i) {
+		field = (const char *)memchr(field, '\t', end - field);
+		if (field != NULL)
+			++field;
+	}
+
+	if (field != NULL) {
+		*RName = field;
+		field = (const char *)memchr(field, '\t', end - field);
+		if (field != NULL) {
+			*RNameLength = field - *RName;
+			++field;
+			while (field < end && '0' <= *field && *field <= '9') {
+				pos = pos * 10 + (*field - '0');
+				++field;
+			}
+
+			*Pos = pos - 1;
+			ret = (field < end && *field == '\t');
+		}
+	}
+
+	return ret;
+}
+
+
+/** Returns the start of the first line beginning at Offset or later, or End. */
+static size_t _sam_next_line(const char *Data, const size_t Offset, const size_t End)
+{
+	const char *nl = NULL;
+	size_t ret = End;
+
+	if (Offset == 0 || Data[Offset - 1] == '\n')
+		ret = Offset;
+	else {
+		nl = (const char *)memchr(Data + Offset, '\n', End - Offset);
+		if (nl != NULL)
+			ret = (size_t)(nl - Data) + 1;
+	}
+
+	return ret;
+}
+
+
+/** Bisects the lines of a memory-mapped coordinate-sorted SAM file in [Begin; End). On return, all lines
+    starting before *Low lie before (target contig, Pos) and all lines starting at *High or later do not.
+    *Low is a line start. Returns FALSE if a contig missing from the header is encountered. */
+static boolean _sam_mapped_search(const char *Data, const size_t Begin, const size_t End, PSAM_SORT_INFO Info, const uint64_t Pos, size_t *Low, size_t *High)
+{
+	size_t lo = Begin;
+	size_t hi = End;
+	size_t mid = 0;
+	size_t lineStart = 0;
+	const char *lineEnd = NULL;
+	const char *rname = NULL;
+	size_t rnameLength = 0;
+	uint64_t linePos = 0;
+	boolean ret = TRUE;
+
+	while (ret && hi - lo > INPUT_SAM_SEARCH_GRANULARITY) {
+		mid = lo + (hi - lo) / 2;
+		lineStart = _sam_next_line(Data, mid, End);
+		if (lineStart < hi) {
+			lineEnd = (const char *)memchr(Data + lineStart, '\n', End - lineStart);
+			ret = _sam_line_key(Data + lineStart, ((lineEnd != NULL) ? (size_t)(lineEnd - Data) : End) - lineStart, &rname, &rnameLength, &linePos);
+			if (ret) {
+				switch (_sam_sort_info_relation(Info, rname, rnameLength, linePos, Pos, (uint64_t)-1)) {
+					case srrBefore:
+						lo = lineStart;
+						break;
+					case srrUnknown:
+						ret = FALSE;
+						break;
+					default:
+						hi = mid;
+						break;
+				}
+			}
+		} else hi = mid;
+	}
+
+	*Low = lo;
+	*High = hi;
+
+	return ret;
+}
+
+
+/** Skips the buffered lines of a coordinate-sorted SAM file that lie before the region. Only the last complete
+    line in the buffer is examined; if it lies before the region, so do all lines preceding it. */
+static void _sam_skip_buffered(PFUTILS_LINE_READER Reader, PSAM_SORT_INFO Info, const CONFIDENT_REGION *Region)
+{
+	const char *data = NULL;
+	size_t length = 0;
+	size_t lastEnd = 0;
+	size_t lastStart = 0;
+	const char *rname = NULL;
+	size_t rnameLength = 0;
+	uint64_t pos = 0;
+
+	utils_line_reader_peek(Reader, &data, &length);
+	lastEnd = length;
+	while (lastEnd > 0 && data[lastEnd - 1] != '\n')
+		--lastEnd;
+
+	if (lastEnd > 0) {
+		lastStart = lastEnd - 1;
+		while (lastStart > 0 && data[lastStart - 1] != '\n')
+			--lastStart;
+
+		if (_sam_line_key(data + lastStart, lastEnd - lastStart, &rname, &rnameLength, &pos) &&
+			_sam_sort_info_relation(Info, rname, rnameLength, pos, Region->Start, Region->End) == srrBefore)
+			utils_line_reader_skip(Reader, lastEnd);
+	}
+
+	return;
+}
+
+
+static boolean _input_is_bgzf(const char *FileName)
+{
+	FILE *f = NULL;
+	uint8_t header[BGZF_BLOCK_HEADER_SIZE];
+	boolean ret = FALSE;
+
+	if (utils_fopen(FileName, FOPEN_MODE_READ, &f) == ERR_SUCCESS) {
+		ret = (fread(header, 1, sizeof(header), f) == sizeof(header) && bgzf_is_bgzf(header, sizeof(header)));
+		utils_fclose(f);
+	}
+
+	return ret;
+}
+
+
+static boolean _input_is_bam(const char *FileName)
+{
+	BGZF_FILE f;
+	char magic[4];
+	boolean ret = FALSE;
+
+	if (bgzf_open(FileName, &f) == ERR_SUCCESS) {
+		ret = (bgzf_read(&f, magic, sizeof(magic)) == ERR_SUCCESS && memcmp(magic, "BAM\1", sizeof(magic)) == 0);
+		bgzf_close(&f);
+	}
+
+	return ret;
+}
+
+
+/** Tells whether the first line read from a stream is the start of a BAM (after decompression) or CRAM file,
+    which can be read only from seekable files. */
+static boolean _input_is_binary_alignment(const char *Line, const size_t Length)
+{
+	return (Length >= 4 && (memcmp(Line, "BAM\1", 4) == 0 || memcmp(Line, "CRAM", 4) == 0));
+}
+
+
+static void _sam_parse_chunk(void *Data, long Index, size_t ThreadNo)
+{
+	PSAM_PARSE_CONTEXT ctx = (PSAM_PARSE_CONTEXT)Data;
+	PSAM_CHUNK chunk = ctx->Chunks + Index;
+	const CONFIDENT_REGION *region = ctx->Region;
+	char *line = NULL;
+	char *lineEnd = NULL;
+	char *textEnd = NULL;
+	char *rest = NULL;
+	SAM_PARSED_READ r;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	dym_array_clear_SAM_PARSED_READ(&chunk->Reads);
+	chunk->LineCount = 0;
+	ret = ERR_SUCCESS;
+	if (chunk->TextAllocLength < chunk->Length + 1) {
+		if (chunk->Text != NULL)
+			utils_free(chunk->Text);
+
+		chunk->TextAllocLength = 0;
+		ret = utils_malloc(chunk->Length + 1, (void **)&chunk->Text);
+		if (ret == ERR_SUCCESS)
+			chunk->TextAllocLength = chunk->Length + 1;
+		else chunk->Text = NULL;
+	}
+
+	if (ret == ERR_SUCCESS) {
+		memcpy(chunk->Text, chunk->Start, chunk->Length);
+		chunk->Text[chunk->Length] = '\0';
+		line = chunk->Text;
+		textEnd = chunk->Text + chunk->Length;
+		while (ret == ERR_SUCCESS && line < textEnd) {
+			lineEnd = (char *)memchr(line, '\n', textEnd - line);
+			if (lineEnd == NULL)
+				lineEnd = textEnd;
+
+			*lineEnd = '\0';
+			if (lineEnd > line && lineEnd[-1] == '\r')
+				lineEnd[-1] = '\0';
+
+			++chunk->LineCount;
+			if (*line != '@' && *line != '\0') {
+				ret = read_view_from_sam_line_core(line, &r.Read, &r.Extension, &rest);
+				if (ret == ERR_SUCCESS && _sam_read_prefilter(&r.Read, region, ctx->Options)) {
+					ret = read_view_from_sam_line_rest(rest, &r.Read, &r.Extension);
+					if (ret == ERR_SUCCESS) {
+						if (region != NULL)
+							read_adjust(&r.Read, region->Start, region->End - region->Start);
+
+						ret = dym_array_push_back_SAM_PARSED_READ(&chunk->Reads, r);
+					}
+				}
+			}
+
+			line = lineEnd + 1;
+		}
+	}
+
+	chunk->Status = ret;
+
+	return;
+}
+
+
+/** Parses a memory-mapped SAM file in rounds. In each round, every thread parses a newline-aligned range of
+    about INPUT_SAM_CHUNK_SIZE bytes; the accepted reads are then passed to the callback on the calling thread,
+    in the input order. */
+static ERR_VALUE _input_get_reads_sam_mapped(const char *FileName, const FUTILS_MAPPED_FILE *Map, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options, INPUT_READ_CALLBACK *Callback, void *Context)
+{
+	SAM_PARSE_CONTEXT ctx;
+	PSAM_CHUNK chunk = NULL;
+	const char *data = (const char *)Map->Address;
+	const size_t dataSize = (size_t)Map->Size;
+	const char *lineEnd = NULL;
+	size_t offset = 0;
+	size_t end = 0;
+	size_t limit = dataSize;
+	size_t low = 0;
+	size_t high = 0;
+	size_t headerEnd = 0;
+	uint64_t bytesParsed = 0;
+	uint64_t lineCount = 0;
+	double startTime = 0;
+	SAM_SORT_INFO sortInfo;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	startTime = omp_get_wtime();
+	ctx.Region = Region;
+	ctx.Options = Options;
+	_sam_sort_info_init(&sortInfo);
+	ret = ERR_SUCCESS;
+	while (ret == ERR_SUCCESS && offset < dataSize && data[offset] == '@') {
+		end = _sam_next_line(data, offset + 1, dataSize);
+		ret = _sam_sort_info_add_line(&sortInfo, data + offset, end - offset);
+		offset = end;
+	}
+
+	headerEnd = offset;
+	if (ret == ERR_SUCCESS) {
+		_sam_sort_info_set_region(&sortInfo, FileName, Region);
+		if (sortInfo.TargetIndex != -1) {
+			if (_sam_mapped_search(data, headerEnd, dataSize, &sortInfo, Region->Start, &low, &high)) {
+				offset = low;
+				if (_sam_mapped_search(data, low, dataSize, &sortInfo, Region->End, &low, &high)) {
+					lineEnd = (high < dataSize) ? (const char *)memchr(data + high, '\n', dataSize - high) : NULL;
+					limit = (lineEnd != NULL) ? (size_t)(lineEnd - data) + 1 : dataSize;
+				}
+			} else offset = headerEnd;
+		}
+
+		ret = utils_calloc(Options->Threads, sizeof(SAM_CHUNK), (void **)&ctx.Chunks);
+	}
+
+	if (ret == ERR_SUCCESS) {
+		for (uint32_t i = 0; i < Options->Threads; ++i)
+			dym_array_init_SAM_PARSED_READ(&ctx.Chunks[i].Reads, 140);
+
+		while (ret == ERR_SUCCESS && offset < limit) {
+			for (uint32_t i = 0; i < Options->Threads; ++i) {
+				chunk = ctx.Chunks + i;
+				end = min(limit, offset + INPUT_SAM_CHUNK_SIZE);
+				if (end < limit) {
+					lineEnd = (const char *)memchr(data + end, '\n', limit - end);
+					end = (lineEnd != NULL) ? (size_t)(lineEnd - data) + 1 : limit;
+				}
+
+				chunk->Start = data + offset;
+				chunk->Length = end - offset;
+				bytesParsed += chunk->Length;
+				offset = end;
+			}
+
+			kt_for((int)Options->Threads, _sam_parse_chunk, &ctx, (long)Options->Threads);
+			for (uint32_t i = 0; i < Options->Threads; ++i) {
+				chunk = ctx.Chunks + i;
+				ret = chunk->Status;
+				if (ret != ERR_SUCCESS)
+					break;
+
+				lineCount += chunk->LineCount;
+				for (size_t j = 0; j < gen_array_size(&chunk->Reads); ++j) {
+					PSAM_PARSED_READ r = dym_array_item_SAM_PARSED_READ(&chunk->Reads, j);
+
+					r->Read.Extension = &r->Extension;
+					ret = Callback(&r->Read, Context);
+					if (ret != ERR_SUCCESS)
+						break;
+				}
+
+				if (ret != ERR_SUCCESS)
+					break;
+			}
+		}
+
+		if (_verbose)
+			fprintf(stderr, "[INFO]: %s: %" PRIu64 " bytes, %" PRIu64 " lines parsed by %u threads (%.2lf MB/s)\n", FileName, bytesParsed, lineCount, Options->Threads, (double)bytesParsed / (omp_get_wtime() - startTime) / (1024 * 1024));
+		for (uint32_t i = 0; i < Options->Threads; ++i) {
+			dym_array_finit_SAM_PARSED_READ(&ctx.Chunks[i].Reads);
+			if (ctx.Chunks[i].Text != NULL)
+				utils_free(ctx.Chunks[i].Text);
+		}
+
+		utils_free(ctx.Chunks);
+	}
+
+	_sam_sort_info_finit(&sortInfo);
+
+	return ret;
+}
+
+
+static ERR_VALUE _input_get_reads_sam(const char *Filename, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options, INPUT_READ_CALLBACK *Callback, void *Context)
+{
+	char *line = NULL;
+	char *rest = NULL;
+	size_t lineLength = 0;
+	FUTILS_LINE_READER reader;
+	ONE_READ oneRead;
+	ONE_READ_EXTENSION oneReadExtension;
+	SAM_SORT_INFO sortInfo;
+	boolean inHeader = TRUE;
+	ESAMRegionRelation relation = srrUnknown;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	_sam_sort_info_init(&sortInfo);
+	ret = utils_line_reader_open(Filename, 0, &reader);
+	if (ret == ERR_SUCCESS) {
+		while (ret == ERR_SUCCESS) {
+			ret = utils_line_reader_next(&reader, &line, &lineLength);
+			if (ret == ERR_SUCCESS && reader.LinesRead == 1 && _input_is_binary_alignment(line, lineLength)) {
+				fprintf(stderr, "[ERROR]: %s: BAM/CRAM on stdin or a pipe is not supported, pass the file name instead\n", Filename);
+				ret = ERR_NOT_IMPLEMENTED;
+			} else if (ret == ERR_SUCCESS && *line == '@' && inHeader)
+				ret = _sam_sort_info_add_line(&sortInfo, line, lineLength);
+			else if (ret == ERR_SUCCESS && *line != '@' && *line != '\0') {
+				if (inHeader) {
+					_sam_sort_info_set_region(&sortInfo, Filename, Region);
+					inHeader = FALSE;
+				}
+
+				ret = read_view_from_sam_line_core(line, &oneRead, &oneReadExtension, &rest);
+				if (ret == ERR_SUCCESS && sortInfo.TargetIndex != -1) {
+					relation = _sam_sort_info_relation(&sortInfo, oneReadExtension.RName, strlen(oneReadExtension.RName), oneRead.Pos, Region->Start, Region->End);
+					if (relation == srrAfter)
+						ret = ERR_NO_MORE_ENTRIES;
+					else if (relation == srrBefore)
+						_sam_skip_buffered(&reader, &sortInfo, Region);
+				}
+
+				if (ret == ERR_SUCCESS && _sam_read_prefilter(&oneRead, Region, Options)) {
+					ret = read_view_from_sam_line_rest(rest, &oneRead, &oneReadExtension);
+					if (ret == ERR_SUCCESS) {
+						if (Region != NULL)
+							read_adjust(&oneRead, Region->Start, Region->End - Region->Start);
+
+						ret = Callback(&oneRead, Context);
+					}
+				}
+			}
+		}
+
+		if (ret == ERR_NO_MORE_ENTRIES)
+			ret = ERR_SUCCESS;
+
+		_report_throughput(Filename, &reader);
+		utils_line_reader_close(&reader);
+	}
+
+	_sam_sort_info_finit(&sortInfo);
+	
+	return ret;
+}
+
+
+static boolean _bam_header_is_sorted(const char *HeaderText)
+{
+	const char *line = HeaderText;
+	const char *lineEnd = NULL;
+	boolean ret = FALSE;
+
+	while (!ret && *line != '\0') {
+		lineEnd = strchr(line, '\n');
+		if (lineEnd == NULL)
+			lineEnd = line + strlen(line);
+
+		ret = _sam_header_is_sorted(line, lineEnd - line);
+		line = (*lineEnd != '\0') ? lineEnd + 1 : lineEnd;
+	}
+
+	return ret;
+}
+
+
+/** Passes one BAM record to the callback if it lies in the region and passes the filters. Records are
+    filtered by their fixed-size part, so the names, CIGARs and sequences of the rejected ones are skipped
+    without being decoded. */
+static ERR_VALUE _input_bam_process_record(PBAM_FILE Bam, const BAM_RECORD_CORE *Core, const CONFIDENT_REGION *Region, const int32_t RegionRefID, const INPUT_READ_OPTIONS *Options, INPUT_READ_CALLBACK *Callback, void *Context)
+{
+	READ_FLAGS flags;
+	ONE_READ oneRead;
+	ONE_READ_EXTENSION oneReadExtension;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	flags.Value = Core->Flags;
+	if ((Region == NULL || (Core->RefID == RegionRefID && Core->Pos >= 0 && Region->Start <= (uint64_t)Core->Pos && (uint64_t)Core->Pos < Region->End)) &&
+		_input_read_accepted((uint64_t)(int64_t)Core->Pos, Core->MapQ, flags, Options)) {
+		ret = bam_read_record(Bam, Core, &oneRead, &oneReadExtension);
+		if (ret == ERR_SUCCESS) {
+			if (Region != NULL)
+				read_adjust(&oneRead, Region->Start, Region->End - Region->Start);
+
+			ret = Callback(&oneRead, Context);
+		}
+	} else ret = bam_skip_record(Bam, Core);
+
+	return ret;
+}
+
+
+/** Reads the region from a coordinate-sorted BAM file by seeking to the chunks listed by its index. */
+static ERR_VALUE _input_get_reads_bam_indexed(PBAM_FILE Bam, const BAM_INDEX *Index, const CONFIDENT_REGION *Region, const int32_t RegionRefID, const INPUT_READ_OPTIONS *Options, INPUT_READ_CALLBACK *Callback, void *Context, uint64_t *RecordCount)
+{
+	GEN_ARRAY_BAM_INDEX_CHUNK chunks;
+	BAM_RECORD_CORE core;
+	boolean regionEnd = FALSE;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	dym_array_init_BAM_INDEX_CHUNK(&chunks, 140);
+	ret = bam_index_query(Index, RegionRefID, Region->Start, Region->End, &chunks);
+	for (size_t i = 0; i < gen_array_size(&chunks); ++i) {
+		const BAM_INDEX_CHUNK *c = dym_array_const_item_BAM_INDEX_CHUNK(&chunks, i);
+
+		ret = bgzf_seek(&Bam->Bgzf, c->Begin);
+		while (ret == ERR_SUCCESS && bgzf_tell(&Bam->Bgzf) < c->End) {
+			ret = bam_read_core(Bam, &core);
+			if (ret == ERR_SUCCESS) {
+				++(*RecordCount);
+				regionEnd = (core.RefID != RegionRefID || (core.Pos >= 0 && (uint64_t)core.Pos >= Region->End));
+				if (!regionEnd)
+					ret = _input_bam_process_record(Bam, &core, Region, RegionRefID, Options, Callback, Context);
+			}
+
+			if (regionEnd)
+				break;
+		}
+
+		if (ret == ERR_NO_MORE_ENTRIES)
+			ret = ERR_SUCCESS;
+
+		if (ret != ERR_SUCCESS || regionEnd)
+			break;
+	}
+
+	dym_array_finit_BAM_INDEX_CHUNK(&chunks);
+
+	return ret;
+}
+
+
+/** Reads alignments from a BAM file. If a region is given and the file is indexed, only the parts of the
+    file overlapping the region are decompressed. */
+static ERR_VALUE _input_get_reads_bam(const char *FileName, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options, INPUT_READ_CALLBACK *Callback, void *Context)
+{
+	BAM_FILE bam;
+	BAM_INDEX index;
+	BAM_RECORD_CORE core;
+	int32_t regionRefID = -1;
+	boolean sorted = FALSE;
+	uint64_t recordCount = 0;
+	double startTime = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	startTime = omp_get_wtime();
+	ret = bam_open(FileName, &bam);
+	if (ret == ERR_SUCCESS) {
+		if (Region != NULL)
+			regionRefID = bam_reference_index(&bam, Region->Chrom);
+
+		if (Region != NULL && regionRefID != -1 && bam_index_load(FileName, &index) == ERR_SUCCESS) {
+			fprintf(stderr, "[INFO]: %s: using the index to read %s:%llu-%llu\n", FileName, Region->Chrom, Region->Start, Region->End);
+			ret = _input_get_reads_bam_indexed(&bam, &index, Region, regionRefID, Options, Callback, Context, &recordCount);
+			bam_index_free(&index);
+		} else if (Region == NULL || regionRefID != -1) {
+			sorted = (regionRefID != -1 && _bam_header_is_sorted(bam.HeaderText));
+			if (sorted)
+				fprintf(stderr, "[INFO]: %s: coordinate-sorted, reading stops after the region\n", FileName);
+
+			ret = bgzf_pipeline_start(&bam.Bgzf);
+			while (ret == ERR_SUCCESS) {
+				ret = bam_read_core(&bam, &core);
+				if (ret == ERR_SUCCESS) {
+					++recordCount;
+					if (sorted && (core.RefID < 0 || core.RefID > regionRefID || (core.RefID == regionRefID && core.Pos >= 0 && (uint64_t)core.Pos >= Region->End)))
+						ret = ERR_NO_MORE_ENTRIES;
+					else ret = _input_bam_process_record(&bam, &core, Region, regionRefID, Options, Callback, Context);
+				}
+			}
+
+			if (ret == ERR_NO_MORE_ENTRIES)
+				ret = ERR_SUCCESS;
+		}
+
+		if (_verbose)
+			fprintf(stderr, "[INFO]: %s: %" PRIu64 " bytes, %" PRIu64 " BAM records read (%.2lf MB/s)\n", FileName, bam.Bgzf.CompressedBytesRead, recordCount, (double)bam.Bgzf.CompressedBytesRead / (omp_get_wtime() - startTime) / (1024 * 1024));
+		bam_close(&bam);
+	}
+
+	return ret;
+}
+
+
+/** Reads alignments from a CRAM file, reconstructing their bases from the reference given in the options. Containers
+    not overlapping the region are skipped without being decompressed. */
+static ERR_VALUE _input_get_reads_cram(const char *FileName, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options, INPUT_READ_CALLBACK *Callback, void *Context)
+{
+	CRAM_FILE cram;
+	PONE_READ read = NULL;
+	int32_t regionRefID = -1;
+	boolean sorted = FALSE;
+	double startTime = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	startTime = omp_get_wtime();
+	ret = cram_open(FileName, Options->Reference, &cram);
+	if (ret == ERR_SUCCESS) {
+		if (Region != NULL) {
+			regionRefID = cram_reference_index(&cram, Region->Chrom);
+			sorted = (regionRefID != -1 && _bam_header_is_sorted(cram.HeaderText));
+			if (sorted)
+				fprintf(stderr, "[INFO]: %s: coordinate-sorted, reading stops after the region\n", FileName);
+
+			if (regionRefID != -1)
+				cram_set_region(&cram, regionRefID, Region->Start, Region->End, sorted);
+		}
+
+		if (Region == NULL || regionRefID != -1) {
+			while (ret == ERR_SUCCESS) {
+				ret = cram_read_record(&cram, &read);
+				if (ret == ERR_SUCCESS &&
+					(Region == NULL || (strcmp(read->Extension->RName, Region->Chrom) == 0 && Region->Start <= read->Pos && read->Pos < Region->End)) &&
+					_input_read_accepted(read->Pos, read->PosQuality, read->Extension->Flags, Options)) {
+					if (Region != NULL)
+						read_adjust(read, Region->Start, Region->End - Region->Start);
+
+					ret = Callback(read, Context);
+				}
+			}
+
+			if (ret == ERR_NO_MORE_ENTRIES)
+				ret = ERR_SUCCESS;
+		}
+
+		if (_verbose)
+			fprintf(stderr, "[INFO]: %s: %" PRIu64 " bytes, %" PRIu64 " CRAM records read (%.2lf MB/s)\n", FileName, cram.BytesRead, cram.RecordsRead, (double)cram.BytesRead / (omp_get_wtime() - startTime) / (1024 * 1024));
+		cram_close(&cram);
+	}
+
+	return ret;
+}
+
+
+/** Reserves space for Length more items of a batch storage array, at least doubling its size when it grows. */
+#define _read_batch_reserve(aDataType, aArray, aLength)		\
+	(((aArray)->ValidLength + (aLength) <= (aArray)->AllocLength) ? ERR_SUCCESS :	\
+		dym_array_reserve_##aDataType((aArray), max((aArray)->ValidLength + (aLength), 2 * (aArray)->AllocLength)))
+
+
+static ERR_VALUE _read_batch_append_string(PINPUT_READ_BATCH Batch, const char *String, size_t *Offset)
+{
+	size_t length = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	*Offset = (size_t)-1;
+	if (String != NULL) {
+		length = strlen(String) + 1;
+		ret = _read_batch_reserve(char, &Batch->Text, length);
+		if (ret == ERR_SUCCESS) {
+			*Offset = gen_array_size(&Batch->Text);
+			memcpy(Batch->Text.Data + *Offset, String, length*sizeof(char));
+			Batch->Text.ValidLength += length;
+		}
+	}
+
+	return ret;
+}
+
+
+static char *_read_batch_string(const INPUT_READ_BATCH *Batch, const size_t Offset)
+{
+	return (Offset != (size_t)-1) ? Batch->Text.Data + Offset : NULL;
+}
+
+
+/** Copies a read to the end of the batch. The pointers of the read are set by _read_batch_flush(), since the storage
+    of the batch may move while the batch is being filled. */
+static ERR_VALUE _read_batch_append(PINPUT_READ_BATCH Batch, const ONE_READ *Read)
+{
+	const size_t offset = Batch->Offsets[Batch->Count];
+	PINPUT_READ_BATCH_STRINGS strings = Batch->Strings + Batch->Count;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = _read_batch_reserve(char, &Batch->Bases, Read->ReadSequenceLen);
+	if (ret == ERR_SUCCESS)
+		ret = _read_batch_reserve(uint8_t, &Batch->Qualities, Read->ReadSequenceLen);
+
+	if (ret == ERR_SUCCESS)
+		ret = _read_batch_append_string(Batch, Read->Extension->TemplateName, &strings->TemplateName);
+
+	if (ret == ERR_SUCCESS)
+		ret = _read_batch_append_string(Batch, Read->Extension->RName, &strings->RName);
+
+	if (ret == ERR_SUCCESS)
+		ret = _read_batch_append_string(Batch, Read->Extension->CIGAR, &strings->CIGAR);
+
+	if (ret == ERR_SUCCESS)
+		ret = _read_batch_append_string(Batch, Read->Extension->RNext, &strings->RNext);
+
+	if (ret == ERR_SUCCESS)
+		ret = _read_batch_append_string(Batch, Read->Extension->MD, &strings->MD);
+
+	if (ret == ERR_SUCCESS) {
+		memcpy(Batch->Bases.Data + offset, Read->ReadSequence, Read->ReadSequenceLen*sizeof(char));
+		memcpy(Batch->Qualities.Data + offset, Read->Quality, Read->ReadSequenceLen*sizeof(uint8_t));
+		Batch->Bases.ValidLength += Read->ReadSequenceLen;
+		Batch->Qualities.ValidLength += Read->ReadSequenceLen;
+		Batch->Reads[Batch->Count] = *Read;
+		Batch->Extensions[Batch->Count] = *Read->Extension;
+		++Batch->Count;
+		Batch->Offsets[Batch->Count] = offset + Read->ReadSequenceLen;
+	}
+
+	return ret;
+}
+
+
+/** Points the reads of the batch to its storage, passes the batch to the callback and empties it. */
+static ERR_VALUE _read_batch_flush(PREAD_BATCH_CONTEXT Context)
+{
+	PINPUT_READ_BATCH batch = Context->Batch;
+	const INPUT_READ_BATCH_STRINGS *strings = batch->Strings;
+	PONE_READ read = batch->Reads;
+	PONE_READ_EXTENSION extension = batch->Extensions;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	if (batch->Count > 0) {
+		if (batch->NormalizeBases)
+			read_kernels_normalize_bases(batch->Bases.Data, gen_array_size(&batch->Bases));
+
+		for (size_t i = 0; i < batch->Count; ++i) {
+			read->ReadSequence = batch->Bases.Data + batch->Offsets[i];
+			read->Quality = batch->Qualities.Data + batch->Offsets[i];
+			read->Extension = extension;
+			extension->TemplateName = _read_batch_string(batch, strings->TemplateName);
+			extension->RName = _read_batch_string(batch, strings->RName);
+			extension->CIGAR = _read_batch_string(batch, strings->CIGAR);
+			extension->RNext = _read_batch_string(batch, strings->RNext);
+			extension->MD = _read_batch_string(batch, strings->MD);
+			++read;
+			++extension;
+			++strings;
+		}
+
+		ret = Context->Callback(batch, Context->Context);
+		batch->Count = 0;
+		dym_array_clear_char(&batch->Bases);
+		dym_array_clear_uint8_t(&batch->Qualities);
+		dym_array_clear_char(&batch->Text);
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _on_batch_read(const ONE_READ *Read, void *Context)
+{
+	PREAD_BATCH_CONTEXT ctx = (PREAD_BATCH_CONTEXT)Context;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = _read_batch_append(ctx->Batch, Read);
+	if (ret == ERR_SUCCESS && ctx->Batch->Count == ctx->Batch->Capacity)
+		ret = _read_batch_flush(ctx);
+
+	return ret;
+}
+
+
 static boolean _fasta_read_seq_raw(char *Start, size_t Length, char **SeqStart, char **SeqEnd, cchar *Description, size_t *DescriptionLength)
 {
 	boolean ret = FALSE;
@@ -245,38 +1192,120 @@ void fasta_free(PFASTA_FILE FastaRecord)
 }
 
 
-ERR_VALUE input_get_reads(const char *Filename, const CONFIDENT_REGION *Region, INPUT_READ_CALLBACK *Callback, void *Context)
+void input_set_verbose(const boolean Verbose)
 {
-	FILE *f = NULL;
-	char line[4096];
-	ONE_READ oneRead;
-	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+	_verbose = Verbose;
 
-	ret = utils_fopen(Filename, FOPEN_MODE_READ, &f);
-	if (ret == ERR_SUCCESS) {
-		while (ret == ERR_SUCCESS && !feof(f) && !ferror(f)) {
-			ret = utils_file_read_line(f, line, sizeof(line));
-			if (ret == ERR_SUCCESS && *line != '@' && *line != '\0') {
-				ret = read_create_from_sam_line(line, &oneRead);
-				if (ret == ERR_SUCCESS &&
-					((Region == NULL || strcmp(Region->Chrom, oneRead.Extension->RName) == 0) && Region->Start <= oneRead.Pos && oneRead.Pos < Region->End)) {
-					if (!(oneRead.PosQuality < 20 || oneRead.Pos == (uint64_t)-1 ||
-						oneRead.Extension->Flags.Bits.Unmapped ||
-						oneRead.Extension->Flags.Bits.Supplementary ||
-						oneRead.Extension->Flags.Bits.Duplicate ||
-						oneRead.Extension->Flags.Bits.SecondaryAlignment)) {
-						read_adjust(&oneRead, Region->Start, Region->End - Region->Start);
-						ret = Callback(&oneRead, Context);
-					}
+	return;
+}
 
-					_read_destroy_structure(&oneRead);
-				}
-			}
-		}
 
-		utils_fclose(f);
+void input_read_options_init(PINPUT_READ_OPTIONS Options)
+{
+	memset(Options, 0, sizeof(INPUT_READ_OPTIONS));
+	Options->Threads = 1;
+	Options->FlagMask = INPUT_READ_DEFAULT_FLAG_MASK;
+	Options->MinMapQ = INPUT_READ_DEFAULT_MIN_MAPQ;
+
+	return;
+}
+
+
+ERR_VALUE input_get_reads(const char *Filename, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options, INPUT_READ_CALLBACK *Callback, void *Context)
+{
+	INPUT_READ_OPTIONS defaultOptions;
+	FUTILS_MAPPED_FILE map;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (Options == NULL) {
+		input_read_options_init(&defaultOptions);
+		Options = &defaultOptions;
 	}
-	
+
+	if (!utils_file_is_seekable(Filename))
+		ret = _input_get_reads_sam(Filename, Region, Options, Callback, Context);
+	else if (cram_is_cram(Filename))
+		ret = _input_get_reads_cram(Filename, Region, Options, Callback, Context);
+	else if (_input_is_bam(Filename))
+		ret = _input_get_reads_bam(Filename, Region, Options, Callback, Context);
+	else if (Options->Threads > 1 && !_input_is_bgzf(Filename) && utils_file_map(Filename, &map) == ERR_SUCCESS) {
+		ret = _input_get_reads_sam_mapped(Filename, &map, Region, Options, Callback, Context);
+		utils_file_unmap(&map);
+	} else ret = _input_get_reads_sam(Filename, Region, Options, Callback, Context);
+
+	return ret;
+}
+
+
+ERR_VALUE input_read_batch_init(const size_t Capacity, PINPUT_READ_BATCH Batch)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(Batch, 0, sizeof(INPUT_READ_BATCH));
+	Batch->Capacity = (Capacity > 0) ? Capacity : INPUT_READ_BATCH_DEFAULT_CAPACITY;
+	dym_array_init_char(&Batch->Bases, 140);
+	dym_array_init_uint8_t(&Batch->Qualities, 140);
+	dym_array_init_char(&Batch->Text, 140);
+	ret = utils_calloc_ONE_READ(Batch->Capacity, &Batch->Reads);
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc(Batch->Capacity, sizeof(ONE_READ_EXTENSION), (void **)&Batch->Extensions);
+
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc_size_t(Batch->Capacity + 1, &Batch->Offsets);
+
+	if (ret == ERR_SUCCESS)
+		ret = utils_calloc(Batch->Capacity, sizeof(INPUT_READ_BATCH_STRINGS), (void **)&Batch->Strings);
+
+	if (ret != ERR_SUCCESS)
+		input_read_batch_finit(Batch);
+
+	return ret;
+}
+
+
+void input_read_batch_finit(PINPUT_READ_BATCH Batch)
+{
+	if (Batch->Strings != NULL)
+		utils_free(Batch->Strings);
+
+	if (Batch->Offsets != NULL)
+		utils_free(Batch->Offsets);
+
+	if (Batch->Extensions != NULL)
+		utils_free(Batch->Extensions);
+
+	if (Batch->Reads != NULL)
+		utils_free(Batch->Reads);
+
+	dym_array_finit_char(&Batch->Text);
+	dym_array_finit_uint8_t(&Batch->Qualities);
+	dym_array_finit_char(&Batch->Bases);
+	memset(Batch, 0, sizeof(INPUT_READ_BATCH));
+
+	return;
+}
+
+
+/** Like input_get_reads(), but the reads are collected into the batch and passed to the callback once it fills up
+    (and once more at the end of the input). The batch can be reused by subsequent calls. */
+ERR_VALUE input_get_read_batches(const char *Filename, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options, PINPUT_READ_BATCH Batch, INPUT_READ_BATCH_CALLBACK *Callback, void *Context)
+{
+	READ_BATCH_CONTEXT ctx;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ctx.Batch = Batch;
+	ctx.Callback = Callback;
+	ctx.Context = Context;
+	Batch->Count = 0;
+	ret = input_get_reads(Filename, Region, Options, _on_batch_read, &ctx);
+	if (ret == ERR_SUCCESS)
+		ret = _read_batch_flush(&ctx);
+
+	Batch->Count = 0;
+	dym_array_clear_char(&Batch->Bases);
+	dym_array_clear_uint8_t(&Batch->Qualities);
+	dym_array_clear_char(&Batch->Text);
+
 	return ret;
 }
 
@@ -500,28 +1529,28 @@ ERR_VALUE input_variant_create(const char *Chrom, const char *ID, unsigned long
 ERR_VALUE input_get_variants(const char *FileName, const VCF_VARIANT_FILTER *Filter, PGEN_ARRAY_VCF_VARIANT Array)
 {
 	size_t altLen = 0;
-	char line[4096];
-	FILE *f = NULL;
+	char *line = NULL;
+	size_t lineLength = 0;
+	FUTILS_LINE_READER reader;
 	ERR_VALUE ret = ERR_INTERNAL_ERROR;
-	POINTER_ARRAY_char fields;
+	char *fields[VCF_FIELD_COUNT + 1];
 	VCF_VARIANT v;
 	unsigned long long pos = 0;
 	unsigned long quality = 0;
 
-	pointer_array_init_char(&fields, 140);
-	ret = utils_fopen(FileName, FOPEN_MODE_READ, &f);
+	ret = utils_line_reader_open(FileName, 0, &reader);
 	if (ret == ERR_SUCCESS) {
-		while (ret == ERR_SUCCESS && !feof(f) && !ferror(f)) {
-			ret = utils_file_read_line(f, line, sizeof(line));
+		while (ret == ERR_SUCCESS) {
+			ret = utils_line_reader_next(&reader, &line, &lineLength);
 			if (ret == ERR_SUCCESS && *line != '\0' && *line != '#') {
-				ret = utils_split(line, '\t', &fields);
-				if (ret == ERR_SUCCESS) {
-					pos = strtoull(fields.Data[1], NULL, 0) - 1;
-					quality = strtoul(fields.Data[5], NULL, 0);
+				/* Only the leading columns are split, the sample columns of wide VCF lines are skipped. */
+				if (utils_split_in_place(line, '\t', fields, VCF_FIELD_COUNT + 1) >= VCF_FIELD_COUNT) {
+					pos = strtoull(fields[1], NULL, 0) - 1;
+					quality = strtoul(fields[5], NULL, 0);
 					
-					char *alt = fields.Data[4];
+					char *alt = fields[4];
 					altLen = strlen(alt);
-					ret = input_variant_create(fields.Data[0], fields.Data[2], pos, fields.Data[3], alt, quality, &v);
+					ret = input_variant_create(fields[0], fields[2], pos, fields[3], alt, quality, &v);
 					if (Filter == NULL || input_variant_in_filter(Filter, &v)) {
 						ret = dym_array_push_back_VCF_VARIANT(Array, v);
 
@@ -529,7 +1558,7 @@ ERR_VALUE input_get_variants(const char *FileName, const VCF_VARIANT_FILTER *Fil
 							for (size_t i = 0; i < altLen; ++i) {
 								if (alt[i] == ',') {
 									v.Alt[i] = '\0';
-									ret = input_variant_create(fields.Data[0], fields.Data[2], pos, fields.Data[3], alt + i + 1, quality, &v);
+									ret = input_variant_create(fields[0], fields[2], pos, fields[3], alt + i + 1, quality, &v);
 									if (ret == ERR_SUCCESS)
 										ret = dym_array_push_back_VCF_VARIANT(Array, v);
 
@@ -543,17 +1572,17 @@ ERR_VALUE input_get_variants(const char *FileName, const VCF_VARIANT_FILTER *Fil
 							}
 						}
 					}
-
-					utils_split_free(&fields);
 				}
 			}
 		}
 
-		utils_fclose(f);
+		if (ret == ERR_NO_MORE_ENTRIES)
+			ret = ERR_SUCCESS;
 
+		_report_throughput(FileName, &reader);
+		utils_line_reader_close(&reader);
 	}
 
-	pointer_array_finit_char(&fields);
 	if (ret == ERR_SUCCESS)
 		qsort(Array->Data, pointer_array_size(Array), sizeof(VCF_VARIANT), _variant_comparator);
 
@@ -717,40 +1746,41 @@ static int _bed_comparator(const CONFIDENT_REGION *A, const CONFIDENT_REGION *B)
 
 ERR_VALUE input_get_bed(const char *FileName, const CONFIDENT_REGION *Area, PGEN_ARRAY_CONFIDENT_REGION Array)
 {
-	char line[4096];
-	FILE *f = NULL;
+	char *line = NULL;
+	size_t lineLength = 0;
+	FUTILS_LINE_READER reader;
 	ERR_VALUE ret = ERR_INTERNAL_ERROR;
-	POINTER_ARRAY_char fields;
+	char *fields[BED_FIELD_COUNT + 1];
 	CONFIDENT_REGION cr;
 
-	pointer_array_init_char(&fields, 140);
-	ret = utils_fopen(FileName, FOPEN_MODE_READ, &f);
+	ret = utils_line_reader_open(FileName, 0, &reader);
 	if (ret == ERR_SUCCESS) {
-		while (ret == ERR_SUCCESS && !feof(f) && !ferror(f)) {
-			ret = utils_file_read_line(f, line, sizeof(line));
+		while (ret == ERR_SUCCESS) {
+			ret = utils_line_reader_next(&reader, &line, &lineLength);
 			if (ret == ERR_SUCCESS && *line != '\0' && *line != '#') {
-				ret = utils_split(line, '\t', &fields);
-				if (ret == ERR_SUCCESS) {
-					cr.Chrom = fields.Data[0];
-					cr.Start = strtoull(fields.Data[1], NULL, 0);
-					cr.End = strtoull(fields.Data[2], NULL, 0);
-					if ((Area == NULL || *Area->Chrom == '\0' || strcmp(cr.Chrom, Area->Chrom) == 0) &&
+				if (utils_split_in_place(line, '\t', fields, BED_FIELD_COUNT + 1) >= BED_FIELD_COUNT) {
+					cr.Start = strtoull(fields[1], NULL, 0);
+					cr.End = strtoull(fields[2], NULL, 0);
+					if ((Area == NULL || *Area->Chrom == '\0' || strcmp(fields[0], Area->Chrom) == 0) &&
 						Area->Start <= cr.Start && cr.End <= Area->End) {
-						ret = dym_array_push_back_CONFIDENT_REGION(Array, cr);
-						if (ret == ERR_SUCCESS)
-							fields.Data[0] = NULL;
+						ret = utils_copy_string(fields[0], &cr.Chrom);
+						if (ret == ERR_SUCCESS) {
+							ret = dym_array_push_back_CONFIDENT_REGION(Array, cr);
+							if (ret != ERR_SUCCESS)
+								utils_free(cr.Chrom);
+						}
 					}
-
-					utils_split_free(&fields);
 				}
 			}
 		}
 
-		utils_fclose(f);
+		if (ret == ERR_NO_MORE_ENTRIES)
+			ret = ERR_SUCCESS;
 
+		_report_throughput(FileName, &reader);
+		utils_line_reader_close(&reader);
 	}
 
-	pointer_array_finit_char(&fields);
 	if (ret == ERR_SUCCESS)
 		qsort(Array->Data, pointer_array_size(Array), sizeof(CONFIDENT_REGION), _bed_comparator);
 	
@@ -38,8 +38,39 @@ typedef struct _REFSEQ_DATA {
 	const char *Name;
 } REFSEQ_DATA, *PREFSEQ_DATA;
 
+/** The read points into the input buffer and is valid only during the callback. Use read_materialize() to keep it. */
 typedef ERR_VALUE (INPUT_READ_CALLBACK)(const ONE_READ *Read, void *Context);
 
+#define INPUT_READ_BATCH_DEFAULT_CAPACITY		4096
+
+/** Offsets of the strings of a batched read within the text storage of its batch (SIZE_MAX if the read has no such string). */
+typedef struct _INPUT_READ_BATCH_STRINGS {
+	size_t TemplateName;
+	size_t RName;
+	size_t CIGAR;
+	size_t RNext;
+	size_t MD;
+} INPUT_READ_BATCH_STRINGS, *PINPUT_READ_BATCH_STRINGS;
+
+/** A reusable batch of reads. Sequences and qualities are stored back to back in Bases and Qualities, read i
+    occupying the range [Offsets[i], Offsets[i + 1]) in both of them. Other strings of the reads are kept in Text.
+    Pointers of the reads refer to the storage of the batch and are valid only during the batch callback. */
+typedef struct _INPUT_READ_BATCH {
+	/** Convert the bases to upper case and IUPAC codes to N before passing the batch to the callback. */
+	boolean NormalizeBases;
+	size_t Capacity;
+	size_t Count;
+	PONE_READ Reads;
+	PONE_READ_EXTENSION Extensions;
+	size_t *Offsets;
+	PINPUT_READ_BATCH_STRINGS Strings;
+	GEN_ARRAY_char Bases;
+	GEN_ARRAY_uint8_t Qualities;
+	GEN_ARRAY_char Text;
+} INPUT_READ_BATCH, *PINPUT_READ_BATCH;
+
+typedef ERR_VALUE (INPUT_READ_BATCH_CALLBACK)(const INPUT_READ_BATCH *Batch, void *Context);
+
 typedef enum _EVCFVariantType {
 	vcfvtUnknown,
 	vcfvtSNP,
@@ -79,6 +110,22 @@ GEN_ARRAY_IMPLEMENTATION(CONFIDENT_REGION)
 POINTER_ARRAY_TYPEDEF(CONFIDENT_REGION);
 POINTER_ARRAY_IMPLEMENTATION(CONFIDENT_REGION)
 
+/** Reads having any of these flags set are ignored by default (unmapped, secondary, duplicate and supplementary). */
+#define INPUT_READ_DEFAULT_FLAG_MASK			0xd04
+#define INPUT_READ_DEFAULT_MIN_MAPQ				20
+
+/** Options of reading the alignment file. */
+typedef struct _INPUT_READ_OPTIONS {
+	/** Number of threads parsing plain SAM input. */
+	uint32_t Threads;
+	/** Reads having any of these flags set are ignored. */
+	uint16_t FlagMask;
+	/** Reads with lower mapping quality are ignored. */
+	uint8_t MinMapQ;
+	/** Reference sequence that CRAM input is decoded against. */
+	const REFSEQ_DATA *Reference;
+} INPUT_READ_OPTIONS, *PINPUT_READ_OPTIONS;
+
 typedef struct _VCF_VARIANT_FILDER {
 	const CONFIDENT_REGION *Regions;
 	size_t RegionCount;
@@ -90,7 +137,13 @@ ERR_VALUE fasta_read_seq(PFASTA_FILE FastaRecord, PREFSEQ_DATA Data);
 void fasta_free_seq(PREFSEQ_DATA Data);
 void fasta_free(PFASTA_FILE FastaRecord);
 
-ERR_VALUE input_get_reads(const char *Filename, const CONFIDENT_REGION *Region, INPUT_READ_CALLBACK *Callback, void *Context);
+/** Prints the throughput of the readers to stderr (off by default). */
+void input_set_verbose(const boolean Verbose);
+void input_read_options_init(PINPUT_READ_OPTIONS Options);
+ERR_VALUE input_get_reads(const char *Filename, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options, INPUT_READ_CALLBACK *Callback, void *Context);
+ERR_VALUE input_read_batch_init(const size_t Capacity, PINPUT_READ_BATCH Batch);
+void input_read_batch_finit(PINPUT_READ_BATCH Batch);
+ERR_VALUE input_get_read_batches(const char *Filename, const CONFIDENT_REGION *Region, const INPUT_READ_OPTIONS *Options, PINPUT_READ_BATCH Batch, INPUT_READ_BATCH_CALLBACK *Callback, void *Context);
 
 ERR_VALUE input_refseq_to_regions(const char *RefSeq, const size_t RefSeqLen, PACTIVE_REGION *Regions, size_t *Count);
 ERR_VALUE input_get_region_by_offset(const PACTIVE_REGION Regions, const size_t Count, const uint64_t Offset, size_t *Index, uint64_t *RegionOffset);
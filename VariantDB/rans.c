@@ -0,0 +1,244 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include "err.h"
+#include "utils.h"
+#include "rans.h"
+
+
+/************************************************************************/
+/*                        HELPER FUNCTIONS                              */
+/************************************************************************/
+
+
+/** Frequencies of the symbols of one context, with a table mapping every slot of the frequency range to its symbol. */
+typedef struct _RANS_SYMBOL_TABLE {
+	uint16_t Frequency[256];
+	uint16_t Cumulative[256];
+	uint8_t Symbol[RANS_TOTAL_FREQUENCY];
+} RANS_SYMBOL_TABLE, *PRANS_SYMBOL_TABLE;
+
+typedef struct _RANS_CURSOR {
+	const uint8_t *Data;
+	const uint8_t *End;
+	boolean Overflow;
+} RANS_CURSOR, *PRANS_CURSOR;
+
+
+static uint32_t _le32(const uint8_t *Data)
+{
+	return ((uint32_t)Data[0] | ((uint32_t)Data[1] << 8) | ((uint32_t)Data[2] << 16) | ((uint32_t)Data[3] << 24));
+}
+
+
+static uint8_t _rans_next_byte(PRANS_CURSOR Cursor)
+{
+	uint8_t ret = 0;
+
+	if (Cursor->Data < Cursor->End) {
+		ret = *Cursor->Data;
+		++Cursor->Data;
+	} else Cursor->Overflow = TRUE;
+
+	return ret;
+}
+
+
+static uint8_t _rans_peek_byte(const RANS_CURSOR *Cursor)
+{
+	return (Cursor->Data < Cursor->End) ? *Cursor->Data : 0;
+}
+
+
+/** Reads the run-length encoded frequency table of one context. Symbols are listed in the increasing order,
+    a symbol following its predecessor is followed by the number of further consecutive symbols that are
+    listed without their values. */
+static ERR_VALUE _rans_read_table(PRANS_CURSOR Cursor, PRANS_SYMBOL_TABLE Table)
+{
+	uint32_t symbol = 0;
+	uint32_t frequency = 0;
+	uint32_t total = 0;
+	uint32_t run = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(Table->Frequency, 0, sizeof(Table->Frequency));
+	memset(Table->Cumulative, 0, sizeof(Table->Cumulative));
+	memset(Table->Symbol, 0, sizeof(Table->Symbol));
+	ret = ERR_SUCCESS;
+	symbol = _rans_next_byte(Cursor);
+	do {
+		frequency = _rans_next_byte(Cursor);
+		if (frequency >= 0x80)
+			frequency = ((frequency & 0x7f) << 8) | _rans_next_byte(Cursor);
+
+		if (symbol < 256 && total + frequency <= RANS_TOTAL_FREQUENCY && !Cursor->Overflow) {
+			Table->Frequency[symbol] = (uint16_t)frequency;
+			Table->Cumulative[symbol] = (uint16_t)total;
+			memset(Table->Symbol + total, (int)symbol, frequency);
+			total += frequency;
+			if (run == 0 && symbol + 1 == _rans_peek_byte(Cursor)) {
+				symbol = _rans_next_byte(Cursor);
+				run = _rans_next_byte(Cursor);
+			} else if (run > 0) {
+				--run;
+				++symbol;
+			} else symbol = _rans_next_byte(Cursor);
+		} else ret = ERR_CRAM_INVALID_BLOCK;
+	} while (ret == ERR_SUCCESS && symbol != 0);
+
+	if (ret == ERR_SUCCESS && Cursor->Overflow)
+		ret = ERR_CRAM_INVALID_BLOCK;
+
+	return ret;
+}
+
+
+static ERR_VALUE _rans_read_states(PRANS_CURSOR Cursor, uint32_t *States)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (Cursor->End - Cursor->Data >= 16) {
+		for (size_t i = 0; i < 4; ++i) {
+			States[i] = _le32(Cursor->Data);
+			Cursor->Data += 4;
+		}
+
+		ret = ERR_SUCCESS;
+	} else ret = ERR_CRAM_INVALID_BLOCK;
+
+	return ret;
+}
+
+
+/** Decodes one symbol and renormalizes the state. */
+static uint8_t _rans_decode_symbol(const RANS_SYMBOL_TABLE *Table, uint32_t *State, PRANS_CURSOR Cursor)
+{
+	const uint32_t slot = *State & (RANS_TOTAL_FREQUENCY - 1);
+	const uint8_t ret = Table->Symbol[slot];
+
+	*State = Table->Frequency[ret] * (*State >> RANS_FREQUENCY_BITS) + slot - Table->Cumulative[ret];
+	while (*State < RANS_STATE_LOWER_BOUND && Cursor->Data < Cursor->End) {
+		*State = (*State << 8) | *Cursor->Data;
+		++Cursor->Data;
+	}
+
+	return ret;
+}
+
+
+/** Order-0 streams interleave four states, the i-th output byte is decoded by the state i % 4. */
+static ERR_VALUE _rans_decompress_order0(PRANS_CURSOR Cursor, uint8_t *Output, const size_t OutputLength)
+{
+	PRANS_SYMBOL_TABLE table = NULL;
+	uint32_t states[4];
+	size_t i = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_malloc(sizeof(RANS_SYMBOL_TABLE), (void **)&table);
+	if (ret == ERR_SUCCESS) {
+		ret = _rans_read_table(Cursor, table);
+		if (ret == ERR_SUCCESS)
+			ret = _rans_read_states(Cursor, states);
+
+		if (ret == ERR_SUCCESS) {
+			for (i = 0; i + 4 <= OutputLength; i += 4) {
+				Output[i] = _rans_decode_symbol(table, states + 0, Cursor);
+				Output[i + 1] = _rans_decode_symbol(table, states + 1, Cursor);
+				Output[i + 2] = _rans_decode_symbol(table, states + 2, Cursor);
+				Output[i + 3] = _rans_decode_symbol(table, states + 3, Cursor);
+			}
+
+			for (size_t j = 0; i + j < OutputLength; ++j)
+				Output[i + j] = _rans_decode_symbol(table, states + j, Cursor);
+		}
+
+		utils_free(table);
+	}
+
+	return ret;
+}
+
+
+/** Order-1 streams split the output into four quarters decoded by separate states, each symbol being
+    decoded in the context of its predecessor. The bytes left over after the fourth quarter are decoded
+    by the last state. */
+static ERR_VALUE _rans_decompress_order1(PRANS_CURSOR Cursor, uint8_t *Output, const size_t OutputLength)
+{
+	PRANS_SYMBOL_TABLE tables = NULL;
+	uint32_t states[4];
+	uint8_t contexts[4];
+	const size_t quarter = OutputLength / 4;
+	uint32_t context = 0;
+	uint32_t run = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_calloc(256, sizeof(RANS_SYMBOL_TABLE), (void **)&tables);
+	if (ret == ERR_SUCCESS) {
+		context = _rans_next_byte(Cursor);
+		do {
+			ret = _rans_read_table(Cursor, tables + context);
+			if (ret == ERR_SUCCESS) {
+				if (run == 0 && context + 1 == _rans_peek_byte(Cursor)) {
+					context = _rans_next_byte(Cursor);
+					run = _rans_next_byte(Cursor);
+				} else if (run > 0) {
+					--run;
+					++context;
+				} else context = _rans_next_byte(Cursor);
+
+				if (context >= 256 || Cursor->Overflow)
+					ret = ERR_CRAM_INVALID_BLOCK;
+			}
+		} while (ret == ERR_SUCCESS && context != 0);
+
+		if (ret == ERR_SUCCESS)
+			ret = _rans_read_states(Cursor, states);
+
+		if (ret == ERR_SUCCESS) {
+			memset(contexts, 0, sizeof(contexts));
+			for (size_t i = 0; i < quarter; ++i) {
+				for (size_t j = 0; j < 4; ++j) {
+					contexts[j] = _rans_decode_symbol(tables + contexts[j], states + j, Cursor);
+					Output[j * quarter + i] = contexts[j];
+				}
+			}
+
+			for (size_t i = 4 * quarter; i < OutputLength; ++i) {
+				contexts[3] = _rans_decode_symbol(tables + contexts[3], states + 3, Cursor);
+				Output[i] = contexts[3];
+			}
+		}
+
+		utils_free(tables);
+	}
+
+	return ret;
+}
+
+
+/************************************************************************/
+/*                        PUBLIC FUNCTIONS                              */
+/************************************************************************/
+
+
+/** Decompresses a rANS 4x8 stream (order 0 or 1) that must expand to exactly OutputLength bytes. */
+ERR_VALUE rans_decompress(const uint8_t *Input, const size_t InputLength, uint8_t *Output, const size_t OutputLength)
+{
+	RANS_CURSOR cursor;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (InputLength >= RANS_HEADER_SIZE && _le32(Input + 1) == InputLength - RANS_HEADER_SIZE && _le32(Input + 5) == OutputLength) {
+		cursor.Data = Input + RANS_HEADER_SIZE;
+		cursor.End = Input + InputLength;
+		cursor.Overflow = FALSE;
+		if (OutputLength == 0)
+			ret = ERR_SUCCESS;
+		else if (Input[0] == 0)
+			ret = _rans_decompress_order0(&cursor, Output, OutputLength);
+		else if (Input[0] == 1)
+			ret = _rans_decompress_order1(&cursor, Output, OutputLength);
+		else ret = ERR_CRAM_INVALID_BLOCK;
+	} else ret = ERR_CRAM_INVALID_BLOCK;
+
+	return ret;
+}
@@ -0,0 +1,24 @@
+
+#ifndef __RANS_H__
+#define __RANS_H__
+
+
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+
+
+/** Size of the header of a rANS 4x8 stream (order byte, compressed and uncompressed sizes). */
+#define RANS_HEADER_SIZE					9
+/** The symbol frequencies of the codec sum up to 1 << RANS_FREQUENCY_BITS. */
+#define RANS_FREQUENCY_BITS					12
+#define RANS_TOTAL_FREQUENCY				(1 << RANS_FREQUENCY_BITS)
+/** Lower bound of the normalized decoder state. */
+#define RANS_STATE_LOWER_BOUND				(1u << 23)
+
+
+ERR_VALUE rans_decompress(const uint8_t *Input, const size_t InputLength, uint8_t *Output, const size_t OutputLength);
+
+
+
+#endif
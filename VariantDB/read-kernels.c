@@ -0,0 +1,415 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "err.h"
+#include "utils.h"
+#include "read-kernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define READ_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define READ_KERNELS_AVX2_FUNCTION
+#else
+#define READ_KERNELS_AVX2_FUNCTION			__attribute__((target("avx2")))
+#endif
+#endif
+
+
+/************************************************************************/
+/*                        HELPER FUNCTIONS                              */
+/************************************************************************/
+
+
+typedef struct _READ_KERNELS {
+	const char *Name;
+	void (*QualityAdd)(uint8_t *Quality, const size_t Length, const uint8_t Value);
+	void (*NormalizeBases)(char *Bases, const size_t Length);
+	size_t (*Mismatches)(const char *A, const char *B, const size_t Length, uint32_t *Positions, const size_t MaxPositions);
+} READ_KERNELS, *PREAD_KERNELS;
+
+
+static void _quality_add_scalar(uint8_t *Quality, const size_t Length, const uint8_t Value)
+{
+	for (size_t i = 0; i < Length; ++i)
+		Quality[i] += Value;
+
+	return;
+}
+
+
+static void _normalize_bases_scalar(char *Bases, const size_t Length)
+{
+	char c = '\0';
+
+	for (size_t i = 0; i < Length; ++i) {
+		c = Bases[i];
+		if (c >= 'a' && c <= 'z')
+			c -= 'a' - 'A';
+
+		if (c >= 'A' && c <= 'Z' && c != 'A' && c != 'C' && c != 'G' && c != 'T')
+			c = 'N';
+
+		Bases[i] = c;
+	}
+
+	return;
+}
+
+
+/** Compares bases from Start to Length, continuing the count of mismatches found so far. */
+static size_t _mismatches_from(const char *A, const char *B, const size_t Start, const size_t Length, uint32_t *Positions, const size_t MaxPositions, size_t Count)
+{
+	for (size_t i = Start; i < Length && Count <= MaxPositions; ++i) {
+		if (A[i] != B[i]) {
+			if (Count < MaxPositions)
+				Positions[Count] = (uint32_t)i;
+
+			++Count;
+		}
+	}
+
+	return Count;
+}
+
+
+static size_t _mismatches_scalar(const char *A, const char *B, const size_t Length, uint32_t *Positions, const size_t MaxPositions)
+{
+	return _mismatches_from(A, B, 0, Length, Positions, MaxPositions, 0);
+}
+
+
+static uint32_t _lowest_bit(const uint32_t Mask)
+{
+	uint32_t ret = 0;
+
+#if defined(_MSC_VER)
+	unsigned long index = 0;
+
+	_BitScanForward(&index, Mask);
+	ret = (uint32_t)index;
+#elif defined(__GNUC__)
+	ret = (uint32_t)__builtin_ctz(Mask);
+#else
+	while ((Mask & (1U << ret)) == 0)
+		++ret;
+#endif
+
+	return ret;
+}
+
+
+/** Records positions of the set bits of a comparison mask covering bases from Offset on. */
+static size_t _mismatches_from_mask(uint32_t Mask, const size_t Offset, uint32_t *Positions, const size_t MaxPositions, size_t Count)
+{
+	while (Mask != 0 && Count <= MaxPositions) {
+		if (Count < MaxPositions)
+			Positions[Count] = (uint32_t)(Offset + _lowest_bit(Mask));
+
+		++Count;
+		Mask &= Mask - 1;
+	}
+
+	return Count;
+}
+
+
+#ifdef READ_KERNELS_X86
+
+static size_t _mismatches_sse2(const char *A, const char *B, const size_t Length, uint32_t *Positions, const size_t MaxPositions)
+{
+	size_t ret = 0;
+	size_t i = 0;
+	uint32_t mask = 0;
+
+	for (i = 0; i + 16 <= Length && ret <= MaxPositions; i += 16) {
+		mask = ~(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(A + i)), _mm_loadu_si128((const __m128i *)(B + i)))) & 0xffff;
+		if (mask != 0)
+			ret = _mismatches_from_mask(mask, i, Positions, MaxPositions, ret);
+	}
+
+	return _mismatches_from(A, B, i, Length, Positions, MaxPositions, ret);
+}
+
+
+static void _quality_add_sse2(uint8_t *Quality, const size_t Length, const uint8_t Value)
+{
+	const __m128i value = _mm_set1_epi8((char)Value);
+	size_t i = 0;
+
+	for (i = 0; i + 16 <= Length; i += 16)
+		_mm_storeu_si128((__m128i *)(Quality + i), _mm_add_epi8(_mm_loadu_si128((const __m128i *)(Quality + i)), value));
+
+	_quality_add_scalar(Quality + i, Length - i, Value);
+
+	return;
+}
+
+
+static void _normalize_bases_sse2(char *Bases, const size_t Length)
+{
+	const __m128i lowerMin = _mm_set1_epi8('a' - 1);
+	const __m128i lowerMax = _mm_set1_epi8('z' + 1);
+	const __m128i upperMin = _mm_set1_epi8('A' - 1);
+	const __m128i upperMax = _mm_set1_epi8('Z' + 1);
+	const __m128i caseBit = _mm_set1_epi8('a' - 'A');
+	const __m128i a = _mm_set1_epi8('A');
+	const __m128i c = _mm_set1_epi8('C');
+	const __m128i g = _mm_set1_epi8('G');
+	const __m128i t = _mm_set1_epi8('T');
+	const __m128i n = _mm_set1_epi8('N');
+	__m128i x;
+	__m128i mask;
+	__m128i keep;
+	size_t i = 0;
+
+	for (i = 0; i + 16 <= Length; i += 16) {
+		x = _mm_loadu_si128((const __m128i *)(Bases + i));
+		mask = _mm_and_si128(_mm_cmpgt_epi8(x, lowerMin), _mm_cmplt_epi8(x, lowerMax));
+		x = _mm_sub_epi8(x, _mm_and_si128(mask, caseBit));
+		mask = _mm_and_si128(_mm_cmpgt_epi8(x, upperMin), _mm_cmplt_epi8(x, upperMax));
+		keep = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, a), _mm_cmpeq_epi8(x, c)), _mm_or_si128(_mm_cmpeq_epi8(x, g), _mm_cmpeq_epi8(x, t)));
+		mask = _mm_andnot_si128(keep, mask);
+		x = _mm_or_si128(_mm_andnot_si128(mask, x), _mm_and_si128(mask, n));
+		_mm_storeu_si128((__m128i *)(Bases + i), x);
+	}
+
+	_normalize_bases_scalar(Bases + i, Length - i);
+
+	return;
+}
+
+
+READ_KERNELS_AVX2_FUNCTION
+static size_t _mismatches_avx2(const char *A, const char *B, const size_t Length, uint32_t *Positions, const size_t MaxPositions)
+{
+	size_t ret = 0;
+	size_t i = 0;
+	uint32_t mask = 0;
+
+	for (i = 0; i + 32 <= Length && ret <= MaxPositions; i += 32) {
+		mask = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(A + i)), _mm256_loadu_si256((const __m256i *)(B + i))));
+		if (mask != 0)
+			ret = _mismatches_from_mask(mask, i, Positions, MaxPositions, ret);
+	}
+
+	return _mismatches_from(A, B, i, Length, Positions, MaxPositions, ret);
+}
+
+
+READ_KERNELS_AVX2_FUNCTION
+static void _quality_add_avx2(uint8_t *Quality, const size_t Length, const uint8_t Value)
+{
+	const __m256i value = _mm256_set1_epi8((char)Value);
+	size_t i = 0;
+
+	for (i = 0; i + 32 <= Length; i += 32)
+		_mm256_storeu_si256((__m256i *)(Quality + i), _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(Quality + i)), value));
+
+	_quality_add_sse2(Quality + i, Length - i, Value);
+
+	return;
+}
+
+
+READ_KERNELS_AVX2_FUNCTION
+static void _normalize_bases_avx2(char *Bases, const size_t Length)
+{
+	const __m256i lowerMin = _mm256_set1_epi8('a' - 1);
+	const __m256i lowerMax = _mm256_set1_epi8('z' + 1);
+	const __m256i upperMin = _mm256_set1_epi8('A' - 1);
+	const __m256i upperMax = _mm256_set1_epi8('Z' + 1);
+	const __m256i caseBit = _mm256_set1_epi8('a' - 'A');
+	const __m256i a = _mm256_set1_epi8('A');
+	const __m256i c = _mm256_set1_epi8('C');
+	const __m256i g = _mm256_set1_epi8('G');
+	const __m256i t = _mm256_set1_epi8('T');
+	const __m256i n = _mm256_set1_epi8('N');
+	__m256i x;
+	__m256i mask;
+	__m256i keep;
+	size_t i = 0;
+
+	for (i = 0; i + 32 <= Length; i += 32) {
+		x = _mm256_loadu_si256((const __m256i *)(Bases + i));
+		mask = _mm256_and_si256(_mm256_cmpgt_epi8(x, lowerMin), _mm256_cmpgt_epi8(lowerMax, x));
+		x = _mm256_sub_epi8(x, _mm256_and_si256(mask, caseBit));
+		mask = _mm256_and_si256(_mm256_cmpgt_epi8(x, upperMin), _mm256_cmpgt_epi8(upperMax, x));
+		keep = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, a), _mm256_cmpeq_epi8(x, c)), _mm256_or_si256(_mm256_cmpeq_epi8(x, g), _mm256_cmpeq_epi8(x, t)));
+		mask = _mm256_andnot_si256(keep, mask);
+		x = _mm256_blendv_epi8(x, n, mask);
+		_mm256_storeu_si256((__m256i *)(Bases + i), x);
+	}
+
+	_normalize_bases_sse2(Bases + i, Length - i);
+
+	return;
+}
+
+
+#else
+
+#define _quality_add_sse2				_quality_add_scalar
+#define _normalize_bases_sse2			_normalize_bases_scalar
+#define _quality_add_avx2				_quality_add_scalar
+#define _normalize_bases_avx2			_normalize_bases_scalar
+#define _mismatches_sse2				_mismatches_scalar
+#define _mismatches_avx2				_mismatches_scalar
+
+#endif
+
+
+static boolean _cpu_supports(const EReadKernelsImplementation Implementation)
+{
+	boolean ret = FALSE;
+
+	switch (Implementation) {
+		case rkiScalar:
+			ret = TRUE;
+			break;
+		case rkiSSE2:
+			ret = utils_cpu_has_feature(ucfSSE2);
+			break;
+		case rkiAVX2:
+			ret = utils_cpu_has_feature(ucfAVX2);
+			break;
+		default:
+			ret = FALSE;
+			break;
+	}
+
+	return ret;
+}
+
+
+static const READ_KERNELS _kernels[rkiMax] = {
+	{ "scalar", _quality_add_scalar, _normalize_bases_scalar, _mismatches_scalar },
+	{ "SSE2", _quality_add_sse2, _normalize_bases_sse2, _mismatches_sse2 },
+	{ "AVX2", _quality_add_avx2, _normalize_bases_avx2, _mismatches_avx2 },
+};
+
+static EReadKernelsImplementation _implementation = rkiScalar;
+
+
+/************************************************************************/
+/*                        PUBLIC FUNCTIONS                              */
+/************************************************************************/
+
+
+void read_kernels_init(void)
+{
+	EReadKernelsImplementation best = rkiScalar;
+
+	for (int i = rkiScalar; i < rkiMax; ++i) {
+		if (_cpu_supports((EReadKernelsImplementation)i))
+			best = (EReadKernelsImplementation)i;
+	}
+
+	_implementation = best;
+
+	return;
+}
+
+
+EReadKernelsImplementation read_kernels_implementation(void)
+{
+	return _implementation;
+}
+
+
+const char *read_kernels_implementation_name(const EReadKernelsImplementation Implementation)
+{
+	return (Implementation < rkiMax) ? _kernels[Implementation].Name : "unknown";
+}
+
+
+void read_kernels_quality_add(uint8_t *Quality, const size_t Length, const uint8_t Value)
+{
+	_kernels[_implementation].QualityAdd(Quality, Length, Value);
+
+	return;
+}
+
+
+void read_kernels_normalize_bases(char *Bases, const size_t Length)
+{
+	_kernels[_implementation].NormalizeBases(Bases, Length);
+
+	return;
+}
+
+
+size_t read_kernels_mismatches(const char *A, const char *B, const size_t Length, uint32_t *Positions, const size_t MaxPositions)
+{
+	return _kernels[_implementation].Mismatches(A, B, Length, Positions, MaxPositions);
+}
+
+
+/** Measures throughput of every implementation supported by the CPU over a buffer of the given size. */
+void read_kernels_benchmark(FILE *Stream, const size_t Length, const uint32_t Rounds)
+{
+	static const char alphabet[] = "ACGTACGTACGTacgtNnRYKM";
+	char *source = NULL;
+	char *work = NULL;
+	double start = 0;
+	double qualityTime = 0;
+	double basesTime = 0;
+	double mismatchesTime = 0;
+	uint32_t positions[16];
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_malloc(Length, (void **)&source);
+	if (ret == ERR_SUCCESS) {
+		ret = utils_malloc(Length, (void **)&work);
+		if (ret == ERR_SUCCESS) {
+			for (size_t i = 0; i < Length; ++i)
+				source[i] = alphabet[(i * 7 + i / 13) % (sizeof(alphabet) - 1)];
+
+			for (int i = rkiScalar; i < rkiMax; ++i) {
+				if (!_cpu_supports((EReadKernelsImplementation)i))
+					continue;
+
+				qualityTime = 0;
+				basesTime = 0;
+				memcpy(work, source, Length);
+				for (uint32_t j = 0; j < Rounds; ++j) {
+					start = omp_get_wtime();
+					_kernels[i].QualityAdd((uint8_t *)work, Length, (j % 2 == 0) ? (uint8_t)-33 : 33);
+					qualityTime += omp_get_wtime() - start;
+				}
+
+				for (uint32_t j = 0; j < Rounds; ++j) {
+					memcpy(work, source, Length);
+					start = omp_get_wtime();
+					_kernels[i].NormalizeBases(work, Length);
+					basesTime += omp_get_wtime() - start;
+				}
+
+				mismatchesTime = 0;
+				memcpy(work, source, Length);
+				for (uint32_t j = 0; j < Rounds; ++j) {
+					start = omp_get_wtime();
+					_kernels[i].Mismatches(source, work, Length, positions, sizeof(positions) / sizeof(positions[0]));
+					mismatchesTime += omp_get_wtime() - start;
+				}
+
+				fprintf(Stream, "[INFO]: %-6s quality conversion %6.2lf GB/s, base normalization %6.2lf GB/s, mismatch counting %6.2lf GB/s\n", _kernels[i].Name,
+					(qualityTime > 0) ? (double)Length * Rounds / qualityTime / 1e9 : 0,
+					(basesTime > 0) ? (double)Length * Rounds / basesTime / 1e9 : 0,
+					(mismatchesTime > 0) ? (double)Length * Rounds / mismatchesTime / 1e9 : 0);
+			}
+
+			fprintf(Stream, "[INFO]: The %s implementation is used\n", _kernels[_implementation].Name);
+			utils_free(work);
+		}
+
+		utils_free(source);
+	}
+
+	if (ret != ERR_SUCCESS)
+		fprintf(Stream, "[ERROR]: Cannot allocate the benchmark buffers (%zu bytes)\n", Length);
+
+	return;
+}
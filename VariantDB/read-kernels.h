@@ -0,0 +1,38 @@
+
+#ifndef __READ_KERNELS_H__
+#define __READ_KERNELS_H__
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include "utils.h"
+
+
+/** Implementations of the kernels, in the order of preference. */
+typedef enum _EReadKernelsImplementation {
+	rkiScalar,
+	rkiSSE2,
+	rkiAVX2,
+	rkiMax,
+} EReadKernelsImplementation, *PEReadKernelsImplementation;
+
+
+/** Selects the fastest implementation the CPU supports. Until called, the scalar one is used. */
+void read_kernels_init(void);
+EReadKernelsImplementation read_kernels_implementation(void);
+const char *read_kernels_implementation_name(const EReadKernelsImplementation Implementation);
+
+/** Adds Value to every byte (modulo 256), i.e. converts Phred qualities to ASCII (33) or back (-33). */
+void read_kernels_quality_add(uint8_t *Quality, const size_t Length, const uint8_t Value);
+/** Converts bases to upper case and replaces letters other than A, C, G, T and N (IUPAC codes) by N.
+    Other characters are left intact. */
+void read_kernels_normalize_bases(char *Bases, const size_t Length);
+/** Counts positions where A and B differ and stores the first MaxPositions of them. Counting stops once more
+    than MaxPositions mismatches are found, so the result is at most MaxPositions + 1. */
+size_t read_kernels_mismatches(const char *A, const char *B, const size_t Length, uint32_t *Positions, const size_t MaxPositions);
+
+void read_kernels_benchmark(FILE *Stream, const size_t Length, const uint32_t Rounds);
+
+
+
+#endif
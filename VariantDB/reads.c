@@ -5,6 +5,7 @@
 #include "utils.h"
 #include "file-utils.h"
 #include "reads.h"
+#include "read-kernels.h"
 
 
 
@@ -24,75 +25,87 @@ static const char *_sam_read_field(const char *Start)
 }
 
 
-static const char *_sam_read_string_field(const char *Start, char **String, size_t *Length)
+/** Terminates the field at the cursor in place and moves the cursor to the next field. */
+static boolean _sam_view_field(char **pCursor, char **Field, size_t *Length)
 {
-	char *tmpString = NULL;
-	const char *end = NULL;
-	size_t len = 0;
-
-	end = _sam_read_field(Start);
-	len = (end - Start);
-	if (len > 0) {
-		if (utils_malloc((len + 1)*sizeof(char), &tmpString) == ERR_SUCCESS) {
-			memcpy(tmpString, Start, len*sizeof(char));
-			tmpString[len] = '\0';
-			if (String != NULL) {
-				*String = tmpString;
-				*Length = len;
-			} else utils_free(tmpString);
-		} else end = NULL;
-	} else end = NULL;
+	char *start = *pCursor;
+	char *end = NULL;
+	boolean ret = FALSE;
+
+	end = (char *)_sam_read_field(start);
+	ret = (end != start);
+	if (ret) {
+		*Field = start;
+		if (Length != NULL)
+			*Length = end - start;
+
+		if (*end == '\t') {
+			*end = '\0';
+			++end;
+		} else if (*end != '\0')
+			*end = '\0';
+
+		*pCursor = end;
+	}
 
-	return end;
+	return ret;
 }
 
 
-static const char *_sam_read_uint_field(const char *Start, uint32_t *Value)
+static boolean _sam_view_uint_field(char **pCursor, uint32_t *Value)
 {
-	uint32_t tmpValue = 0;
-	const char *end = NULL;
-	size_t len = 0;
-
-	end = _sam_read_field(Start);
-	len = (end - Start);
-	if (len > 0) {
-		char *tmpEnd = NULL;
-
-		tmpValue = (uint32_t)strtoul(Start, &tmpEnd, 0);
-		if (end == tmpEnd) {
-			if (Value != NULL)
-				*Value = tmpValue;
-		} else end = NULL;
-	} else end = NULL;
+	char *field = NULL;
+	char *tmpEnd = NULL;
+	boolean ret = FALSE;
+
+	ret = _sam_view_field(pCursor, &field, NULL);
+	if (ret) {
+		*Value = (uint32_t)strtoul(field, &tmpEnd, 0);
+		ret = (*tmpEnd == '\0');
+	}
 
-	return end;
+	return ret;
 }
 
 
-static const char *_sam_read_int_field(const char *Start, int32_t *Value)
+static boolean _sam_view_int_field(char **pCursor, int32_t *Value)
 {
-	int32_t tmpValue = 0;
-	const char *end = NULL;
-	size_t len = 0;
+	char *field = NULL;
+	char *tmpEnd = NULL;
+	boolean ret = FALSE;
+
+	ret = _sam_view_field(pCursor, &field, NULL);
+	if (ret) {
+		*Value = (int32_t)strtol(field, &tmpEnd, 0);
+		ret = (*tmpEnd == '\0');
+	}
+
+	return ret;
+}
 
-	end = _sam_read_field(Start);
-	len = (end - Start);
-	if (len > 0) {
-		char *tmpEnd = NULL;
 
-		tmpValue = (int32_t)strtol(Start, &tmpEnd, 0);
-		if (end == tmpEnd) {
-			if (Value != NULL)
-				*Value = tmpValue;
-		} else end = NULL;
+/** Picks the MD and NM tags from the optional fields of a SAM line. */
+static void _sam_view_tags(char *Cursor, PONE_READ_EXTENSION Extension)
+{
+	char *field = NULL;
+	char *tmpEnd = NULL;
+	size_t length = 0;
+
+	while ((Extension->MD == NULL || !Extension->HasNM) && _sam_view_field(&Cursor, &field, &length)) {
+		if (length >= 5 && field[2] == ':' && field[4] == ':') {
+			if (field[0] == 'M' && field[1] == 'D' && field[3] == 'Z')
+				Extension->MD = field + 5;
+			else if (field[0] == 'N' && field[1] == 'M' && field[3] == 'i') {
+				Extension->NM = (int32_t)strtol(field + 5, &tmpEnd, 10);
+				Extension->HasNM = (tmpEnd != field + 5 && *tmpEnd == '\0' && Extension->NM >= 0);
+			}
+		}
 	}
-	else end = NULL;
 
-	return end;
+	return;
 }
 
 
-
 void _read_destroy_structure(PONE_READ Read)
 {
 	Read->Quality -= Read->Offset;
@@ -116,6 +129,9 @@ void _read_destroy_structure(PONE_READ Read)
 	if (Read->Extension->TemplateName != NULL)
 		utils_free(Read->Extension->TemplateName);
 
+	if (Read->Extension->MD != NULL)
+		utils_free(Read->Extension->MD);
+
 	utils_free(Read->Extension);
 
 	return;
@@ -130,8 +146,7 @@ void _read_destroy_structure(PONE_READ Read)
 
 void read_quality_encode(PONE_READ Read)
 {
-	for (size_t i = 0; i < Read->ReadSequenceLen; ++i)
-		Read->Quality[i] += 33;
+	read_kernels_quality_add(Read->Quality, Read->ReadSequenceLen, 33);
 
 	return;
 }
@@ -139,8 +154,7 @@ void read_quality_encode(PONE_READ Read)
 
 void read_quality_decode(PONE_READ Read)
 {
-	for (size_t i = 0; i < Read->ReadSequenceLen; ++i)
-		Read->Quality[i] -= 33;
+	read_kernels_quality_add(Read->Quality, Read->ReadSequenceLen, (uint8_t)-33);
 
 	return;
 }
@@ -261,123 +275,287 @@ void read_write_sam(FILE *Stream, const ONE_READ *Read)
 }
 
 
-ERR_VALUE read_create_from_sam_line(const char *Line, PONE_READ Read)
+ERR_VALUE read_view_from_sam_line_core(char *Line, PONE_READ Read, PONE_READ_EXTENSION Extension, char **Rest)
 {
-	uint32_t tmp32;
-	size_t tmpStringLen = 0;
+	uint32_t tmp32 = 0;
 	ERR_VALUE ret = ERR_INTERNAL_ERROR;
 
 	memset(Read, 0, sizeof(ONE_READ));
-	ret = utils_malloc(sizeof(ONE_READ_EXTENSION), &Read->Extension);
-	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_string_field(Line, &Read->Extension->TemplateName, &tmpStringLen);
-		if (Line != NULL && *Line == '\t')
-			++Line;
-		else ret = ERR_SAM_INVALID_RNAME;
-	}
+	memset(Extension, 0, sizeof(ONE_READ_EXTENSION));
+	Read->Extension = Extension;
+	ret = ERR_SUCCESS;
+	if (!_sam_view_field(&Line, &Extension->TemplateName, NULL))
+		ret = ERR_SAM_INVALID_QNAME;
 
 	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_uint_field(Line, &tmp32);
-		if (Line != NULL && *Line == '\t') {
-			++Line;
-			Read->Extension->Flags.Value = tmp32;
-		} else ret = ERR_SAM_INVALID_FLAG;
+		if (_sam_view_uint_field(&Line, &tmp32))
+			Extension->Flags.Value = (uint16_t)tmp32;
+		else ret = ERR_SAM_INVALID_FLAG;
 	}
 
-	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_string_field(Line, &Read->Extension->RName, &tmpStringLen);
-		if (Line != NULL && *Line == '\t')
-			++Line;
-		else ret = ERR_SAM_INVALID_RNAME;
-	}
+	if (ret == ERR_SUCCESS && !_sam_view_field(&Line, &Extension->RName, NULL))
+		ret = ERR_SAM_INVALID_RNAME;
 
 	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_uint_field(Line, &tmp32);
-		if (Line != NULL && *Line == '\t') {
-			++Line;
+		if (_sam_view_uint_field(&Line, &tmp32)) {
 			Read->Pos = tmp32;
 			Read->Pos--;
 		} else ret = ERR_SAM_INVALID_POS;
 	}
 
 	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_uint_field(Line, &tmp32);
-		if (Line != NULL && *Line == '\t') {
-			++Line;
+		if (_sam_view_uint_field(&Line, &tmp32))
 			Read->PosQuality = (uint8_t)tmp32;
-		} else ret = ERR_SAM_INVALID_MAPQ;
+		else ret = ERR_SAM_INVALID_MAPQ;
 	}
 
+	if (ret == ERR_SUCCESS)
+		*Rest = Line;
+
+	return ret;
+}
+
+
+ERR_VALUE read_view_from_sam_line_rest(char *Rest, PONE_READ Read, PONE_READ_EXTENSION Extension)
+{
+	uint32_t tmp32 = 0;
+	int32_t tmpInt32 = 0;
+	size_t qualityLen = 0;
+	size_t seqLen = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	if (!_sam_view_field(&Rest, &Extension->CIGAR, NULL))
+		ret = ERR_SAM_INVALID_CIGAR;
+
+	if (ret == ERR_SUCCESS && !_sam_view_field(&Rest, &Extension->RNext, NULL))
+		ret = ERR_SAM_INVALID_RNEXT;
+
 	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_string_field(Line, &Read->Extension->CIGAR, &tmpStringLen);
-		if (Line != NULL && *Line == '\t')
-			++Line;
-		else ret = ERR_SAM_INVALID_CIGAR;
+		if (_sam_view_uint_field(&Rest, &tmp32))
+			Extension->PNext = tmp32;
+		else ret = ERR_SAM_INVALID_PNEXT;
 	}
 
 	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_string_field(Line, &Read->Extension->RNext, &tmpStringLen);
-		if (Line != NULL && *Line == '\t')
-			++Line;
-		else ret = ERR_SAM_INVALID_RNEXT;
+		if (_sam_view_int_field(&Rest, &tmpInt32))
+			Extension->TLen = tmpInt32;
+		else ret = ERR_SAM_INVALID_TLEN;
 	}
 
 	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_uint_field(Line, &tmp32);
-		if (Line != NULL && *Line == '\t') {
-			++Line;
-			Read->Extension->PNext = tmp32;
-		} else ret = ERR_SAM_INVALID_PNEXT;
+		if (_sam_view_field(&Rest, &Read->ReadSequence, &seqLen))
+			Read->ReadSequenceLen = (uint32_t)seqLen;
+		else ret = ERR_SAM_INVALID_SEQ;
 	}
 
+	if (ret == ERR_SUCCESS && !_sam_view_field(&Rest, (char **)&Read->Quality, &qualityLen))
+		ret = ERR_SAM_INVALID_QUAL;
+
 	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_int_field(Line, &tmp32);
-		if (Line != NULL && *Line == '\t') {
-			++Line;
-			Read->Extension->TLen = tmp32;
-		} else ret = ERR_SAM_INVALID_TLEN;
+		if (Read->ReadSequenceLen == qualityLen)
+			read_quality_decode(Read);
+		else ret = ERR_SAM_SEQ_QUAL_LEN_MISMATCH;
 	}
 
+	if (ret == ERR_SUCCESS)
+		_sam_view_tags(Rest, Extension);
+
+	return ret;
+}
+
+
+ERR_VALUE read_view_from_sam_line(char *Line, PONE_READ Read, PONE_READ_EXTENSION Extension)
+{
+	char *rest = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = read_view_from_sam_line_core(Line, Read, Extension, &rest);
+	if (ret == ERR_SUCCESS)
+		ret = read_view_from_sam_line_rest(rest, Read, Extension);
+
+	return ret;
+}
+
+
+ERR_VALUE read_materialize(const ONE_READ *View, const uint32_t Fields, PONE_READ Read)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+	PONE_READ_EXTENSION ext = NULL;
+
+	ret = utils_calloc(1, sizeof(ONE_READ_EXTENSION), (void **)&ext);
 	if (ret == ERR_SUCCESS) {
-		size_t len = 0;
+		*Read = *View;
+		*ext = *View->Extension;
+		Read->Extension = ext;
+		Read->Offset = 0;
+		Read->ReadSequence = NULL;
+		Read->Quality = NULL;
+		ext->TemplateName = NULL;
+		ext->RName = NULL;
+		ext->CIGAR = NULL;
+		ext->RNext = NULL;
+		ext->MD = NULL;
+		if (flag_on(Fields, READ_FIELD_TEMPLATE_NAME))
+			ret = utils_copy_string(View->Extension->TemplateName, &ext->TemplateName);
+
+		if (ret == ERR_SUCCESS && flag_on(Fields, READ_FIELD_RNAME))
+			ret = utils_copy_string(View->Extension->RName, &ext->RName);
+
+		if (ret == ERR_SUCCESS && flag_on(Fields, READ_FIELD_CIGAR))
+			ret = utils_copy_string(View->Extension->CIGAR, &ext->CIGAR);
+
+		if (ret == ERR_SUCCESS && flag_on(Fields, READ_FIELD_RNEXT))
+			ret = utils_copy_string(View->Extension->RNext, &ext->RNext);
+
+		if (ret == ERR_SUCCESS && flag_on(Fields, READ_FIELD_MD) && View->Extension->MD != NULL)
+			ret = utils_copy_string(View->Extension->MD, &ext->MD);
+
+		if (ret == ERR_SUCCESS && flag_on(Fields, READ_FIELD_SEQUENCE)) {
+			ret = utils_calloc_char(View->ReadSequenceLen + 1, &Read->ReadSequence);
+			if (ret == ERR_SUCCESS)
+				memcpy(Read->ReadSequence, View->ReadSequence, View->ReadSequenceLen*sizeof(char));
+		}
 
-		Line = _sam_read_string_field(Line, &Read->ReadSequence, &len);
-		Read->ReadSequenceLen = (uint32_t)len;
-		if (Line != NULL && *Line == '\t') {
-			++Line;
-		} else ret = ERR_SAM_INVALID_SEQ;
+		if (ret == ERR_SUCCESS && flag_on(Fields, READ_FIELD_QUALITY)) {
+			ret = utils_calloc_uint8_t(View->ReadSequenceLen + 1, &Read->Quality);
+			if (ret == ERR_SUCCESS)
+				memcpy(Read->Quality, View->Quality, View->ReadSequenceLen*sizeof(uint8_t));
+		}
+
+		if (ret != ERR_SUCCESS)
+			_read_destroy_structure(Read);
 	}
 
-	if (ret == ERR_SUCCESS) {
-		Line = _sam_read_string_field(Line, (char **)&Read->Quality, &tmpStringLen);
-		if (Line == NULL)
-			ret = ERR_SAM_INVALID_QUAL;
+	return ret;
+}
+
+
+/** Parses the next item of an MD tag: the number of matching bases followed either by a mismatching
+    reference base (Deletion = FALSE) or by the deleted reference bases (Deletion = TRUE, their count in Bases).
+    Bases is zero for the last item of the tag. */
+boolean read_md_next_item(const char **MD, uint32_t *Matches, boolean *Deletion, uint32_t *Bases)
+{
+	const char *md = *MD;
+	uint32_t matches = 0;
+	uint32_t bases = 0;
+	boolean ret = FALSE;
+
+	while (*md >= '0' && *md <= '9') {
+		matches = matches * 10 + (*md - '0');
+		++md;
 	}
 
-	if (ret == ERR_SUCCESS) {
-		if (Read->ReadSequenceLen == tmpStringLen)
-			read_quality_decode(Read);
-		else ret = ERR_SAM_SEQ_QUAL_LEN_MISMATCH;
+	ret = (md != *MD);
+	if (ret) {
+		*Deletion = (*md == '^');
+		if (*Deletion)
+			++md;
+
+		while (((*md >= 'A' && *md <= 'Z') || (*md >= 'a' && *md <= 'z')) && (*Deletion || bases == 0)) {
+			++bases;
+			++md;
+		}
+
+		ret = (!*Deletion || bases > 0);
+		*Matches = matches;
+		*Bases = bases;
+		*MD = md;
 	}
 
-	if (ret != ERR_SUCCESS) {
-		if (Read->Quality != NULL)
-			utils_free(Read->Quality);
+	return ret;
+}
 
-		if (Read->ReadSequence != NULL)
-			utils_free(Read->ReadSequence);
 
-		if (Read->Extension->RNext != NULL)
-			utils_free(Read->Extension->RNext);
-		
-		if (Read->Extension->CIGAR != NULL)
-			utils_free(Read->Extension->CIGAR);
-			
-		if (Read->Extension->RName != NULL)
-			utils_free(Read->Extension->RName);
+/** Classifies the edits of a read by its CIGAR and its MD and NM tags, without looking at the reference. A read
+    without indels is reference-matching or substitution-only if its MD tag (or an NM of zero, if MD is missing)
+    says so; the tags must agree with the CIGAR and with each other. */
+EReadEditClass read_edit_class(const ONE_READ *Read)
+{
+	const ONE_READ_EXTENSION *ext = Read->Extension;
+	const char *cigar = (ext != NULL) ? ext->CIGAR : NULL;
+	const char *md = NULL;
+	uint32_t aligned = 0;
+	uint32_t indels = 0;
+	uint32_t mismatches = 0;
+	uint32_t length = 0;
+	uint32_t matches = 0;
+	uint32_t bases = 0;
+	boolean deletion = FALSE;
+	EReadEditClass ret = recUnknown;
+
+	if (cigar != NULL && *cigar != '*' && *cigar != '\0') {
+		ret = recReferenceMatch;
+		while (ret != recUnknown && *cigar != '\0') {
+			length = 0;
+			while (*cigar >= '0' && *cigar <= '9') {
+				length = length * 10 + (*cigar - '0');
+				++cigar;
+			}
+
+			switch (*cigar) {
+				case 'M':
+				case '=':
+				case 'X':
+					aligned += length;
+					break;
+				case 'I':
+				case 'D':
+					indels += length;
+					break;
+				case 'S':
+				case 'H':
+					break;
+				default:
+					ret = recUnknown;
+					break;
+			}
+
+			if (*cigar != '\0')
+				++cigar;
+		}
+	}
+
+	if (ret != recUnknown) {
+		if (indels > 0)
+			ret = (!ext->HasNM || (uint32_t)ext->NM >= indels) ? recIndels : recUnknown;
+		else if (ext->MD != NULL) {
+			md = ext->MD;
+			length = 0;
+			while (ret != recUnknown && read_md_next_item(&md, &matches, &deletion, &bases)) {
+				length += matches + bases;
+				mismatches += bases;
+				if (deletion)
+					ret = recUnknown;
+			}
+
+			if (ret != recUnknown && (*md != '\0' || length != aligned || (ext->HasNM && (uint32_t)ext->NM != mismatches)))
+				ret = recUnknown;
+
+			if (ret != recUnknown && mismatches > 0)
+				ret = recSubstitutionsOnly;
+		} else if (!ext->HasNM || ext->NM != 0)
+			ret = recUnknown;
+	}
+
+	return ret;
+}
+
+
+ERR_VALUE read_create_from_sam_line(const char *Line, PONE_READ Read)
+{
+	char *tmpLine = NULL;
+	ONE_READ view;
+	ONE_READ_EXTENSION viewExtension;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_copy_string(Line, &tmpLine);
+	if (ret == ERR_SUCCESS) {
+		ret = read_view_from_sam_line(tmpLine, &view, &viewExtension);
+		if (ret == ERR_SUCCESS)
+			ret = read_materialize(&view, READ_FIELD_ALL, Read);
 
-		if (Read->Extension->TemplateName != NULL)
-			utils_free(Read->Extension->TemplateName);
+		utils_free(tmpLine);
 	}
 
 	return ret;
@@ -59,6 +59,10 @@ typedef struct _ONE_READ_EXTENSION {
 	int32_t TLen;
 	uint64_t PNext;
 	char *TemplateName;
+	/** The MD tag (NULL if the read has none) and the NM tag (valid only if HasNM is set). */
+	char *MD;
+	int32_t NM;
+	boolean HasNM;
 } ONE_READ_EXTENSION, *PONE_READ_EXTENSION;
 
 typedef struct _ONE_READ {
@@ -111,12 +115,43 @@ typedef struct _BAD_READS_STATISTICS {
 } BAD_READS_STATISTICS, *PBAD_READS_STATISTICS;
 
 
+/** Fields of a read view that are copied by read_materialize(). */
+#define READ_FIELD_TEMPLATE_NAME				0x1
+#define READ_FIELD_RNAME						0x2
+#define READ_FIELD_CIGAR						0x4
+#define READ_FIELD_RNEXT						0x8
+#define READ_FIELD_SEQUENCE						0x10
+#define READ_FIELD_QUALITY						0x20
+#define READ_FIELD_MD							0x40
+#define READ_FIELD_ALL							0x7f
+
+/** Edits of an aligned read as described by its CIGAR and its MD and NM tags. */
+typedef enum _EReadEditClass {
+	/** The tags are missing or do not agree with the CIGAR. */
+	recUnknown,
+	/** The aligned bases match the reference. */
+	recReferenceMatch,
+	/** The read differs from the reference only by substitutions. */
+	recSubstitutionsOnly,
+	/** The CIGAR contains insertions or deletions. */
+	recIndels,
+} EReadEditClass, *PEReadEditClass;
+
+
 void read_quality_decode(PONE_READ Read);
 void read_quality_encode(PONE_READ Read);
 
 void read_write_fastq(FILE *Stream, const ONE_READ *Read);
 void read_write_sam(FILE *Stream, const ONE_READ *Read);
 ERR_VALUE read_create_from_sam_line(const char *Line, PONE_READ Read);
+/** Parses QNAME, FLAG, RNAME, POS and MAPQ of a SAM line into a view; Rest receives the position of the CIGAR
+    field, so the remaining fields can be parsed by read_view_from_sam_line_rest() only for accepted reads. */
+ERR_VALUE read_view_from_sam_line_core(char *Line, PONE_READ Read, PONE_READ_EXTENSION Extension, char **Rest);
+ERR_VALUE read_view_from_sam_line_rest(char *Rest, PONE_READ Read, PONE_READ_EXTENSION Extension);
+ERR_VALUE read_view_from_sam_line(char *Line, PONE_READ Read, PONE_READ_EXTENSION Extension);
+ERR_VALUE read_materialize(const ONE_READ *View, const uint32_t Fields, PONE_READ Read);
+boolean read_md_next_item(const char **MD, uint32_t *Matches, boolean *Deletion, uint32_t *Bases);
+EReadEditClass read_edit_class(const ONE_READ *Read);
 ERR_VALUE read_create_from_fastq(const char *Block, const char **NewBlock, PONE_READ Read);
 
 void read_destroy(PONE_READ Read);
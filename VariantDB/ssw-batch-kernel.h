@@ -0,0 +1,179 @@
+
+/* Body of an inter-sequence alignment kernel. The file is included by ssw-batch.c once for every combination
+   of instruction set and score width; the including code defines the SSW_* macros below and this file
+   undefines them at its end. Lanes are unsigned and saturate, so the scores never drop below zero.
+
+   SSW_KERNEL_NAME, SSW_FUNCTION (target attribute), SSW_ELEMENT, SSW_ELEMENT_MAX, SSW_LANES, SSW_VECTOR,
+   SSW_LOAD, SSW_STORE, SSW_SET1, SSW_ZERO, SSW_ADD, SSW_ADDS, SSW_SUBS, SSW_MAX, SSW_CMPEQ, SSW_AND,
+   SSW_ANDNOT, SSW_BLEND, SSW_STEP_WORDS (32-bit words of traceback masks per cell), SSW_STORE_STEPS (stores
+   the masks of diagonal and left moves), SSW_DIAG_WORD, SSW_DIAG_BIT, SSW_LEFT_WORD and SSW_LEFT_BIT
+   (position of a lane within the stored masks). */
+
+
+SSW_FUNCTION
+static ERR_VALUE SSW_KERNEL_NAME(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, PSSW_BATCH_RESULT Result)
+{
+	size_t maxA = 0;
+	size_t maxB = 0;
+	size_t rowSize = 0;
+	SSW_ELEMENT *work = NULL;
+	SSW_ELEMENT *hPrev = NULL;
+	SSW_ELEMENT *hCur = NULL;
+	SSW_ELEMENT *colMaxes = NULL;
+	SSW_ELEMENT *aChars = NULL;
+	SSW_ELEMENT *bChars = NULL;
+	SSW_ELEMENT *tmp = NULL;
+	uint32_t *steps = NULL;
+	uint32_t *stepRow = NULL;
+	SSW_ELEMENT lanes[SSW_LANES];
+	SSW_ELEMENT rows[SSW_LANES];
+	const SSW_VECTOR vOne = SSW_SET1(1);
+	const SSW_VECTOR vMatch = SSW_SET1(min(Match, SSW_ELEMENT_MAX));
+	const SSW_VECTOR vMismatch = SSW_SET1(min(-Mismatch, SSW_ELEMENT_MAX));
+	const SSW_VECTOR vGap = SSW_SET1(min(-Indel, SSW_ELEMENT_MAX));
+	SSW_VECTOR vB;
+	SSW_VECTOR vI;
+	SSW_VECTOR vJ;
+	SSW_VECTOR vEq;
+	SSW_VECTOR vRowMax;
+	SSW_VECTOR vColMax;
+	SSW_VECTOR vD;
+	SSW_VECTOR vL;
+	SSW_VECTOR vU;
+	SSW_VECTOR vH;
+	SSW_VECTOR vUpdate;
+	SSW_VECTOR vBest;
+	SSW_VECTOR vBestRow;
+	SSW_VECTOR vBestCol;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	for (size_t k = 0; k < Count; ++k) {
+		maxA = max(maxA, ALens[k]);
+		maxB = max(maxB, BLens[k]);
+	}
+
+	rowSize = (maxA + 1)*SSW_LANES;
+	ret = ssw_buffer_reserve(&Context->Scores, (3 * rowSize + maxA*SSW_LANES + maxB*SSW_LANES)*sizeof(SSW_ELEMENT));
+	if (ret == ERR_SUCCESS)
+		ret = ssw_buffer_reserve(&Context->Steps, maxA*maxB*SSW_STEP_WORDS*sizeof(uint32_t));
+
+	if (ret == ERR_SUCCESS) {
+		work = (SSW_ELEMENT *)Context->Scores.Data;
+		steps = (uint32_t *)Context->Steps.Data;
+		hPrev = work;
+		hCur = hPrev + rowSize;
+		colMaxes = hCur + rowSize;
+		aChars = colMaxes + rowSize;
+		bChars = aChars + maxA*SSW_LANES;
+		memset(work, 0, 3 * rowSize*sizeof(SSW_ELEMENT));
+		/* Positions past the end of a sequence hold values that never match, so cells outside of a pair
+		   score zero or less than the maximum of its cells (both penalties are negative). */
+		for (size_t j = 0; j < maxA; ++j) {
+			for (size_t k = 0; k < SSW_LANES; ++k)
+				aChars[j*SSW_LANES + k] = (k < Count && j < ALens[k]) ? (SSW_ELEMENT)(unsigned char)A[k][j] : SSW_ELEMENT_MAX;
+		}
+
+		for (size_t i = 0; i < maxB; ++i) {
+			for (size_t k = 0; k < SSW_LANES; ++k)
+				bChars[i*SSW_LANES + k] = (k < Count && i < BLens[k]) ? (SSW_ELEMENT)(unsigned char)B[k][i] : SSW_ELEMENT_MAX - 1;
+		}
+
+#if SSW_ELEMENT_MAX == UINT8_MAX
+		/* 8-bit lanes have no spare values for the padding if the sequences contain the two highest bytes. */
+		for (size_t k = 0; k < Count; ++k) {
+			for (size_t j = 0; j < ALens[k]; ++j) {
+				if ((unsigned char)A[k][j] >= SSW_ELEMENT_MAX - 1)
+					ret = ERR_NOT_IMPLEMENTED;
+			}
+
+			for (size_t i = 0; i < BLens[k]; ++i) {
+				if ((unsigned char)B[k][i] >= SSW_ELEMENT_MAX - 1)
+					ret = ERR_NOT_IMPLEMENTED;
+			}
+		}
+#endif
+	}
+
+	if (ret == ERR_SUCCESS) {
+		vBest = SSW_ZERO;
+		vBestRow = SSW_ZERO;
+		vBestCol = SSW_ZERO;
+		vI = SSW_ZERO;
+		for (size_t i = 1; i <= maxB; ++i) {
+			vB = SSW_LOAD(bChars + (i - 1)*SSW_LANES);
+			vI = SSW_ADD(vI, vOne);
+			vJ = SSW_ZERO;
+			vRowMax = SSW_ZERO;
+			stepRow = steps + (i - 1)*maxA*SSW_STEP_WORDS;
+			for (size_t j = 1; j <= maxA; ++j) {
+				vJ = SSW_ADD(vJ, vOne);
+				vEq = SSW_CMPEQ(vB, SSW_LOAD(aChars + (j - 1)*SSW_LANES));
+				vD = SSW_SUBS(SSW_ADDS(SSW_LOAD(hPrev + (j - 1)*SSW_LANES), SSW_AND(vEq, vMatch)), SSW_ANDNOT(vEq, vMismatch));
+				vColMax = SSW_LOAD(colMaxes + j*SSW_LANES);
+				vU = SSW_SUBS(vColMax, vGap);
+				vL = SSW_SUBS(vRowMax, vGap);
+				vH = SSW_MAX(SSW_MAX(vU, vD), vL);
+				SSW_STORE(hCur + j*SSW_LANES, vH);
+				/* The maxima are replaced by scores exceeding the gap moves, as in the scalar implementation. */
+				SSW_STORE(colMaxes + j*SSW_LANES, SSW_BLEND(vH, vColMax, SSW_CMPEQ(vH, vU)));
+				vRowMax = SSW_BLEND(vH, vRowMax, SSW_CMPEQ(vH, vL));
+				SSW_STORE_STEPS(stepRow + (j - 1)*SSW_STEP_WORDS, SSW_CMPEQ(vH, vD), SSW_CMPEQ(vH, vL));
+				/* The last cell (row by row) with the maximum score is taken. */
+				vUpdate = SSW_CMPEQ(SSW_MAX(vBest, vH), vH);
+				vBest = SSW_MAX(vBest, vH);
+				vBestRow = SSW_BLEND(vBestRow, vI, vUpdate);
+				vBestCol = SSW_BLEND(vBestCol, vJ, vUpdate);
+			}
+
+			tmp = hPrev;
+			hPrev = hCur;
+			hCur = tmp;
+		}
+
+		Result->Steps = steps;
+		Result->RowSize = maxA;
+		Result->StepWords = SSW_STEP_WORDS;
+		SSW_STORE(lanes, vBest);
+		SSW_STORE(rows, vBestRow);
+		for (size_t k = 0; k < Count; ++k) {
+			Result->DiagWords[k] = SSW_DIAG_WORD(k);
+			Result->DiagBits[k] = SSW_DIAG_BIT(k);
+			Result->LeftWords[k] = SSW_LEFT_WORD(k);
+			Result->LeftBits[k] = SSW_LEFT_BIT(k);
+			/* If all cells score zero, the last one is taken. */
+			Result->MaxRow[k] = (lanes[k] > 0) ? rows[k] : BLens[k];
+		}
+
+		SSW_STORE(rows, vBestCol);
+		for (size_t k = 0; k < Count; ++k)
+			Result->MaxCol[k] = (lanes[k] > 0) ? rows[k] : ALens[k];
+	}
+
+	return ret;
+}
+
+
+#undef SSW_KERNEL_NAME
+#undef SSW_FUNCTION
+#undef SSW_ELEMENT
+#undef SSW_ELEMENT_MAX
+#undef SSW_LANES
+#undef SSW_VECTOR
+#undef SSW_LOAD
+#undef SSW_STORE
+#undef SSW_SET1
+#undef SSW_ZERO
+#undef SSW_ADD
+#undef SSW_ADDS
+#undef SSW_SUBS
+#undef SSW_MAX
+#undef SSW_CMPEQ
+#undef SSW_AND
+#undef SSW_ANDNOT
+#undef SSW_BLEND
+#undef SSW_STEP_WORDS
+#undef SSW_STORE_STEPS
+#undef SSW_DIAG_WORD
+#undef SSW_DIAG_BIT
+#undef SSW_LEFT_WORD
+#undef SSW_LEFT_BIT
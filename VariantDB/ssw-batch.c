@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <string.h>
+#include "err.h"
+#include "utils.h"
+#include "ssw-batch.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SSW_BATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define SSW_SSE41_FUNCTION
+#define SSW_AVX2_FUNCTION
+#else
+#define SSW_SSE41_FUNCTION					__attribute__((target("sse4.1")))
+#define SSW_AVX2_FUNCTION					__attribute__((target("avx2")))
+#endif
+#endif
+
+
+/************************************************************************/
+/*                             HELPER TYPES                             */
+/************************************************************************/
+
+
+typedef struct _SSW_BATCH_RESULT {
+	/** Lane masks of every cell, row by row (in the context): lanes whose cell was reached by a diagonal move,
+	    and lanes whose cell was reached by a left one. A cell takes StepWords words, lane k is represented by
+	    bit DiagBits[k] of word DiagWords[k] and by bit LeftBits[k] of word LeftWords[k]. */
+	const uint32_t *Steps;
+	size_t RowSize;
+	size_t StepWords;
+	size_t DiagWords[SSW_BATCH_MAX_LANES];
+	uint32_t DiagBits[SSW_BATCH_MAX_LANES];
+	size_t LeftWords[SSW_BATCH_MAX_LANES];
+	uint32_t LeftBits[SSW_BATCH_MAX_LANES];
+	/** Cells with the maximum score (1-based, as in the scalar score matrix). */
+	size_t MaxRow[SSW_BATCH_MAX_LANES];
+	size_t MaxCol[SSW_BATCH_MAX_LANES];
+} SSW_BATCH_RESULT, *PSSW_BATCH_RESULT;
+
+
+/************************************************************************/
+/*                             HELPER FUNCTIONS                         */
+/************************************************************************/
+
+
+static void _ssw_batch_op_string(const char *A, const char *B, const SSW_BATCH_RESULT *Result, const size_t Lane, char *Output, const char **OperationString, size_t *OperationStringLen)
+{
+	size_t row = Result->MaxRow[Lane];
+	size_t col = Result->MaxCol[Lane];
+	const size_t opStringMax = row + col;
+	size_t opStringIndex = opStringMax;
+	const uint32_t *cell = NULL;
+
+	Output[opStringMax] = '\0';
+	while (row > 0 && col > 0) {
+		cell = Result->Steps + ((row - 1)*Result->RowSize + col - 1)*Result->StepWords;
+		--opStringIndex;
+		if ((cell[Result->DiagWords[Lane]] & Result->DiagBits[Lane]) != 0) {
+			Output[opStringIndex] = (B[row - 1] == A[col - 1]) ? 'M' : 'X';
+			--row;
+			--col;
+		} else if ((cell[Result->LeftWords[Lane]] & Result->LeftBits[Lane]) != 0) {
+			Output[opStringIndex] = 'D';
+			--col;
+		} else {
+			Output[opStringIndex] = 'I';
+			--row;
+		}
+	}
+
+	while (col > 0) {
+		--opStringIndex;
+		Output[opStringIndex] = 'D';
+		--col;
+	}
+
+	while (row > 0) {
+		--opStringIndex;
+		Output[opStringIndex] = 'I';
+		--row;
+	}
+
+	*OperationString = Output + opStringIndex;
+	*OperationStringLen = opStringMax - opStringIndex;
+
+	return;
+}
+
+
+typedef ERR_VALUE (SSW_BATCH_KERNEL)(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, PSSW_BATCH_RESULT Result);
+
+
+/** Pairs whose scores and lengths fit 8-bit lanes. */
+static boolean _ssw_batch_8bit(const size_t ALen, const size_t BLen, const int Match)
+{
+	return (max(ALen, BLen) < UINT8_MAX && (size_t)Match*min(ALen, BLen) < UINT8_MAX);
+}
+
+
+static ERR_VALUE _ssw_batch(PSSW_CONTEXT Context, SSW_BATCH_KERNEL *Kernel8, const size_t Lanes8, SSW_BATCH_KERNEL *Kernel16, const size_t Lanes16, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, char *Output, const char **OperationStrings, size_t *OperationStringLens)
+{
+	SSW_BATCH_RESULT result;
+	size_t index = 0;
+	size_t groupSize = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = (Count <= SSW_BATCH_MAX_LANES) ? ERR_SUCCESS : ERR_NOT_IMPLEMENTED;
+	for (size_t k = 0; ret == ERR_SUCCESS && k < Count; ++k) {
+		if (!ssw_batch_supported(ALens[k], BLens[k], Match, Mismatch, Indel))
+			ret = ERR_NOT_IMPLEMENTED;
+	}
+
+	/* Runs of pairs fitting 8-bit lanes are aligned by the 8-bit kernel, the others by the 16-bit one. */
+	while (ret == ERR_SUCCESS && index < Count) {
+		groupSize = 0;
+		while (groupSize < Lanes8 && index + groupSize < Count && _ssw_batch_8bit(ALens[index + groupSize], BLens[index + groupSize], Match))
+			++groupSize;
+
+		memset(&result, 0, sizeof(result));
+		ret = ERR_NOT_IMPLEMENTED;
+		if (groupSize > Lanes16 || index + groupSize == Count)
+			ret = Kernel8(Context, groupSize, A + index, ALens + index, B + index, BLens + index, Match, Mismatch, Indel, &result);
+
+		if (ret == ERR_NOT_IMPLEMENTED) {
+			groupSize = min(Lanes16, Count - index);
+			ret = Kernel16(Context, groupSize, A + index, ALens + index, B + index, BLens + index, Match, Mismatch, Indel, &result);
+		}
+
+		if (ret == ERR_SUCCESS) {
+			for (size_t k = index; k < index + groupSize; ++k) {
+				_ssw_batch_op_string(A[k], B[k], &result, k - index, Output, OperationStrings + k, OperationStringLens + k);
+				Output += ALens[k] + BLens[k] + 1;
+			}
+
+			index += groupSize;
+		}
+	}
+
+	return ret;
+}
+
+
+#ifdef SSW_BATCH_X86
+
+
+#define SSW_KERNEL_NAME						_ssw_batch_sse41_8
+#define SSW_FUNCTION						SSW_SSE41_FUNCTION
+#define SSW_ELEMENT							uint8_t
+#define SSW_ELEMENT_MAX						UINT8_MAX
+#define SSW_LANES							16
+#define SSW_VECTOR							__m128i
+#define SSW_LOAD(aP)						_mm_loadu_si128((const __m128i *)(aP))
+#define SSW_STORE(aP, aV)					_mm_storeu_si128((__m128i *)(aP), (aV))
+#define SSW_SET1(aX)						_mm_set1_epi8((char)(aX))
+#define SSW_ZERO							_mm_setzero_si128()
+#define SSW_ADD								_mm_add_epi8
+#define SSW_ADDS							_mm_adds_epu8
+#define SSW_SUBS							_mm_subs_epu8
+#define SSW_MAX								_mm_max_epu8
+#define SSW_CMPEQ							_mm_cmpeq_epi8
+#define SSW_AND								_mm_and_si128
+#define SSW_ANDNOT							_mm_andnot_si128
+#define SSW_BLEND							_mm_blendv_epi8
+#define SSW_STEP_WORDS						1
+#define SSW_STORE_STEPS(aP, aDiag, aLeft)	(*(aP) = (uint32_t)_mm_movemask_epi8(aDiag) | ((uint32_t)_mm_movemask_epi8(aLeft) << 16))
+#define SSW_DIAG_WORD(aLane)				0
+#define SSW_DIAG_BIT(aLane)					(1U << (aLane))
+#define SSW_LEFT_WORD(aLane)				0
+#define SSW_LEFT_BIT(aLane)					(1U << ((aLane) + 16))
+#include "ssw-batch-kernel.h"
+
+#define SSW_KERNEL_NAME						_ssw_batch_sse41_16
+#define SSW_FUNCTION						SSW_SSE41_FUNCTION
+#define SSW_ELEMENT							uint16_t
+#define SSW_ELEMENT_MAX						UINT16_MAX
+#define SSW_LANES							8
+#define SSW_VECTOR							__m128i
+#define SSW_LOAD(aP)						_mm_loadu_si128((const __m128i *)(aP))
+#define SSW_STORE(aP, aV)					_mm_storeu_si128((__m128i *)(aP), (aV))
+#define SSW_SET1(aX)						_mm_set1_epi16((short)(aX))
+#define SSW_ZERO							_mm_setzero_si128()
+#define SSW_ADD								_mm_add_epi16
+#define SSW_ADDS							_mm_adds_epu16
+#define SSW_SUBS							_mm_subs_epu16
+#define SSW_MAX								_mm_max_epu16
+#define SSW_CMPEQ							_mm_cmpeq_epi16
+#define SSW_AND								_mm_and_si128
+#define SSW_ANDNOT							_mm_andnot_si128
+#define SSW_BLEND							_mm_blendv_epi8
+#define SSW_STEP_WORDS						1
+#define SSW_STORE_STEPS(aP, aDiag, aLeft)	(*(aP) = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16((aDiag), (aLeft))))
+#define SSW_DIAG_WORD(aLane)				0
+#define SSW_DIAG_BIT(aLane)					(1U << (aLane))
+#define SSW_LEFT_WORD(aLane)				0
+#define SSW_LEFT_BIT(aLane)					(1U << ((aLane) + 8))
+#include "ssw-batch-kernel.h"
+
+#define SSW_KERNEL_NAME						_ssw_batch_avx2_8
+#define SSW_FUNCTION						SSW_AVX2_FUNCTION
+#define SSW_ELEMENT							uint8_t
+#define SSW_ELEMENT_MAX						UINT8_MAX
+#define SSW_LANES							32
+#define SSW_VECTOR							__m256i
+#define SSW_LOAD(aP)						_mm256_loadu_si256((const __m256i *)(aP))
+#define SSW_STORE(aP, aV)					_mm256_storeu_si256((__m256i *)(aP), (aV))
+#define SSW_SET1(aX)						_mm256_set1_epi8((char)(aX))
+#define SSW_ZERO							_mm256_setzero_si256()
+#define SSW_ADD								_mm256_add_epi8
+#define SSW_ADDS							_mm256_adds_epu8
+#define SSW_SUBS							_mm256_subs_epu8
+#define SSW_MAX								_mm256_max_epu8
+#define SSW_CMPEQ							_mm256_cmpeq_epi8
+#define SSW_AND								_mm256_and_si256
+#define SSW_ANDNOT							_mm256_andnot_si256
+#define SSW_BLEND							_mm256_blendv_epi8
+#define SSW_STEP_WORDS						2
+#define SSW_STORE_STEPS(aP, aDiag, aLeft)	((aP)[0] = (uint32_t)_mm256_movemask_epi8(aDiag), (aP)[1] = (uint32_t)_mm256_movemask_epi8(aLeft))
+#define SSW_DIAG_WORD(aLane)				0
+#define SSW_DIAG_BIT(aLane)					(1U << (aLane))
+#define SSW_LEFT_WORD(aLane)				1
+#define SSW_LEFT_BIT(aLane)					(1U << (aLane))
+#include "ssw-batch-kernel.h"
+
+#define SSW_KERNEL_NAME						_ssw_batch_avx2_16
+#define SSW_FUNCTION						SSW_AVX2_FUNCTION
+#define SSW_ELEMENT							uint16_t
+#define SSW_ELEMENT_MAX						UINT16_MAX
+#define SSW_LANES							16
+#define SSW_VECTOR							__m256i
+#define SSW_LOAD(aP)						_mm256_loadu_si256((const __m256i *)(aP))
+#define SSW_STORE(aP, aV)					_mm256_storeu_si256((__m256i *)(aP), (aV))
+#define SSW_SET1(aX)						_mm256_set1_epi16((short)(aX))
+#define SSW_ZERO							_mm256_setzero_si256()
+#define SSW_ADD								_mm256_add_epi16
+#define SSW_ADDS							_mm256_adds_epu16
+#define SSW_SUBS							_mm256_subs_epu16
+#define SSW_MAX								_mm256_max_epu16
+#define SSW_CMPEQ							_mm256_cmpeq_epi16
+#define SSW_AND								_mm256_and_si256
+#define SSW_ANDNOT							_mm256_andnot_si256
+#define SSW_BLEND							_mm256_blendv_epi8
+/* The packing interleaves the 128-bit halves: lanes 0-7 of the diagonal mask, 0-7 of the left one, 8-15 of
+   the diagonal and 8-15 of the left one. */
+#define SSW_STEP_WORDS						1
+#define SSW_STORE_STEPS(aP, aDiag, aLeft)	(*(aP) = (uint32_t)_mm256_movemask_epi8(_mm256_packs_epi16((aDiag), (aLeft))))
+#define SSW_DIAG_WORD(aLane)				0
+#define SSW_DIAG_BIT(aLane)					(1U << ((aLane) + (((aLane) < 8) ? 0 : 8)))
+#define SSW_LEFT_WORD(aLane)				0
+#define SSW_LEFT_BIT(aLane)					(1U << ((aLane) + (((aLane) < 8) ? 8 : 16)))
+#include "ssw-batch-kernel.h"
+
+
+#endif
+
+
+/************************************************************************/
+/*                           PUBLIC FUNCTIONS                           */
+/************************************************************************/
+
+
+boolean ssw_batch_supported(const size_t ALen, const size_t BLen, const int Match, const int Mismatch, const int Indel)
+{
+	return (ALen > 0 && BLen > 0 && ALen <= SSW_BATCH_MAX_LENGTH && BLen <= SSW_BATCH_MAX_LENGTH &&
+		Match > 0 && Mismatch < 0 && Indel < 0 && (size_t)Match*min(ALen, BLen) < UINT16_MAX);
+}
+
+
+ERR_VALUE ssw_batch_sse41(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, char *Output, const char **OperationStrings, size_t *OperationStringLens)
+{
+#ifdef SSW_BATCH_X86
+	return _ssw_batch(Context, _ssw_batch_sse41_8, 16, _ssw_batch_sse41_16, 8, Count, A, ALens, B, BLens, Match, Mismatch, Indel, Output, OperationStrings, OperationStringLens);
+#else
+	return ERR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+ERR_VALUE ssw_batch_avx2(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, char *Output, const char **OperationStrings, size_t *OperationStringLens)
+{
+#ifdef SSW_BATCH_X86
+	return _ssw_batch(Context, _ssw_batch_avx2_8, 32, _ssw_batch_avx2_16, 16, Count, A, ALens, B, BLens, Match, Mismatch, Indel, Output, OperationStrings, OperationStringLens);
+#else
+	return ERR_NOT_IMPLEMENTED;
+#endif
+}
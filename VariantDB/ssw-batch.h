@@ -0,0 +1,34 @@
+
+#ifndef __SSW_BATCH_H__
+#define __SSW_BATCH_H__
+
+
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+#include "ssw.h"
+
+
+/** Inter-sequence implementations of ssw_clever(). Every lane of a vector register holds a cell of a different
+    pair of sequences, so the cells of up to 32 pairs are computed by one instruction. Scores are held in 8-bit
+    lanes when the pairs are short enough, in 16-bit lanes otherwise. Pairs aligned together are padded to the
+    longest one, so they should be of similar lengths. The resulting operation strings are identical to those
+    of the scalar implementation. */
+
+#define SSW_BATCH_MAX_LANES					32
+/** Longer sequences are not supported, the traceback steps take up to 8 bytes per cell. */
+#define SSW_BATCH_MAX_LENGTH				1024
+
+
+/** Returns TRUE if the pair can be aligned within a batch, i.e. it is not longer than SSW_BATCH_MAX_LENGTH,
+    the match score is positive, the mismatch and indel penalties are negative and the scores fit 16-bit lanes. */
+boolean ssw_batch_supported(const size_t ALen, const size_t BLen, const int Match, const int Mismatch, const int Indel);
+
+/** Align at most SSW_BATCH_MAX_LANES supported pairs. The operation strings are stored within Output, which
+    must hold the sum of ALens[i] + BLens[i] + 1 characters over the pairs. */
+ERR_VALUE ssw_batch_sse41(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, char *Output, const char **OperationStrings, size_t *OperationStringLens);
+ERR_VALUE ssw_batch_avx2(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, char *Output, const char **OperationStrings, size_t *OperationStringLens);
+
+
+
+#endif
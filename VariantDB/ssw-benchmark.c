@@ -0,0 +1,327 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "err.h"
+#include "utils.h"
+#include "ssw.h"
+#include "ssw-benchmark.h"
+
+
+/************************************************************************/
+/*                             HELPER TYPES                             */
+/************************************************************************/
+
+/* Scoring used by variantdb when realigning reads. */
+#define SSW_BENCHMARK_MATCH					2
+#define SSW_BENCHMARK_MISMATCH				-1
+#define SSW_BENCHMARK_INDEL					-1
+#define SSW_BENCHMARK_MAX_INDEL				8
+#define SSW_BENCHMARK_BANDWIDTH				16
+/* Number of reads of one length is chosen to align about this many matrix cells, between 1 and
+   SSW_BENCHMARK_MAX_READS reads. */
+#define SSW_BENCHMARK_CELLS					100000000
+#define SSW_BENCHMARK_MAX_READS				1000
+/* Reads passed to one ssw_clever_batch() call. */
+#define SSW_BENCHMARK_BATCH					256
+
+
+typedef ERR_VALUE (SSW_BENCHMARK_ALIGN)(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen);
+
+typedef ERR_VALUE (SSW_BENCHMARK_ALIGN_BATCH)(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const char **OperationStrings, size_t *OperationStringLens);
+
+typedef struct _SSW_BENCHMARK_ENGINE {
+	const char *Name;
+	/** Exactly one of the functions is set. */
+	SSW_BENCHMARK_ALIGN *Align;
+	SSW_BENCHMARK_ALIGN_BATCH *AlignBatch;
+	/** Implementation of ssw_clever() the engine runs with, sswiMax for the default one. */
+	ESSWImplementation Implementation;
+	/** Longer reads are skipped, the engine would need too much time or memory. */
+	size_t MaxLength;
+} SSW_BENCHMARK_ENGINE, *PSSW_BENCHMARK_ENGINE;
+
+
+/************************************************************************/
+/*                             HELPER FUNCTIONS                         */
+/************************************************************************/
+
+
+static uint64_t _random_next(uint64_t *State)
+{
+	uint64_t x = *State;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*State = x;
+
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+
+static double _random_uniform(uint64_t *State)
+{
+	return (double)(_random_next(State) >> 11) / 9007199254740992.0;
+}
+
+
+static char _random_base(uint64_t *State)
+{
+	return "ACGT"[_random_next(State) & 3];
+}
+
+
+static ERR_VALUE _align_simple(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen)
+{
+	char *opString = NULL;
+	size_t opStringLen = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ssw_simple(A, ALen, B, BLen, SSW_BENCHMARK_MATCH, SSW_BENCHMARK_MISMATCH, SSW_BENCHMARK_INDEL, &opString, &opStringLen);
+	if (ret == ERR_SUCCESS) {
+		ret = ssw_buffer_reserve(&Context->OpString, opStringLen + 1);
+		if (ret == ERR_SUCCESS) {
+			memcpy(Context->OpString.Data, opString, opStringLen + 1);
+			*OperationString = (char *)Context->OpString.Data;
+			*OperationStringLen = opStringLen;
+		}
+
+		utils_free(opString);
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _align_clever(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen)
+{
+	return ssw_clever_ctx(Context, A, ALen, B, BLen, SSW_BENCHMARK_MATCH, SSW_BENCHMARK_MISMATCH, SSW_BENCHMARK_INDEL, OperationString, OperationStringLen);
+}
+
+
+static ERR_VALUE _align_banded(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen)
+{
+	return ssw_banded_ctx(Context, A, ALen, B, BLen, SSW_BENCHMARK_MATCH, SSW_BENCHMARK_MISMATCH, SSW_BENCHMARK_INDEL, SSW_BENCHMARK_BANDWIDTH, 0, OperationString, OperationStringLen);
+}
+
+
+static ERR_VALUE _align_linear(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen)
+{
+	return ssw_clever_linear_ctx(Context, A, ALen, B, BLen, SSW_BENCHMARK_MATCH, SSW_BENCHMARK_MISMATCH, SSW_BENCHMARK_INDEL, OperationString, OperationStringLen);
+}
+
+
+static ERR_VALUE _align_batch(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const char **OperationStrings, size_t *OperationStringLens)
+{
+	return ssw_clever_batch(Context, Count, A, ALens, B, BLens, SSW_BENCHMARK_MATCH, SSW_BENCHMARK_MISMATCH, SSW_BENCHMARK_INDEL, OperationStrings, OperationStringLens);
+}
+
+
+static const SSW_BENCHMARK_ENGINE _engines[] = {
+	{"simple", _align_simple, NULL, sswiScalar, 500},
+	{"scalar", _align_clever, NULL, sswiScalar, 20000},
+	{"sse4.1", _align_clever, NULL, sswiSSE41, 10000},
+	{"avx2", _align_clever, NULL, sswiAVX2, 10000},
+	{"banded", _align_banded, NULL, sswiMax, 20000},
+	{"batch", NULL, _align_batch, sswiMax, 1000},
+	{"linear", _align_linear, NULL, sswiMax, 20000},
+};
+
+static const SSW_BENCHMARK_PROFILE _profiles[] = {
+	{"close", 0.005, 0.0005},
+	{"divergent", 0.03, 0.005},
+};
+
+static const size_t _lengths[] = {100, 250, 1000, 5000, 20000};
+
+
+static ERR_VALUE _benchmark_engine(FILE *Stream, PSSW_CONTEXT Context, const SSW_BENCHMARK_ENGINE *Engine, const SSW_BENCHMARK_PROFILE *Profile, const size_t Length, const char *Refs, const char *Reads, const size_t Count, const char *Expected, const size_t *ExpectedLens, const double MaxSeconds)
+{
+	double start = 0;
+	double elapsed = 0;
+	size_t aligned = 0;
+	size_t agreeing = 0;
+	size_t step = 0;
+	const char *a[SSW_BENCHMARK_BATCH];
+	const char *b[SSW_BENCHMARK_BATCH];
+	size_t lengths[SSW_BENCHMARK_BATCH];
+	const char *opStrings[SSW_BENCHMARK_BATCH];
+	size_t opStringLens[SSW_BENCHMARK_BATCH];
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	while (ret == ERR_SUCCESS && aligned < Count && (aligned == 0 || elapsed < MaxSeconds)) {
+		step = 1;
+		if (Engine->AlignBatch != NULL) {
+			step = min(SSW_BENCHMARK_BATCH, Count - aligned);
+			for (size_t i = 0; i < step; ++i) {
+				a[i] = Refs + (aligned + i)*Length;
+				b[i] = Reads + (aligned + i)*Length;
+				lengths[i] = Length;
+			}
+
+			start = omp_get_wtime();
+			ret = Engine->AlignBatch(Context, step, a, lengths, b, lengths, opStrings, opStringLens);
+		} else {
+			start = omp_get_wtime();
+			ret = Engine->Align(Context, Refs + aligned*Length, Length, Reads + aligned*Length, Length, opStrings, opStringLens);
+		}
+
+		elapsed += omp_get_wtime() - start;
+		for (size_t i = 0; ret == ERR_SUCCESS && i < step; ++i) {
+			if (opStringLens[i] == ExpectedLens[aligned] && memcmp(opStrings[i], Expected + aligned * 2 * Length, opStringLens[i]) == 0)
+				++agreeing;
+
+			++aligned;
+		}
+	}
+
+	if (ret == ERR_SUCCESS) {
+		fprintf(Stream, "[INFO]: %-9s %6zu bp %-6s %4zu reads %9.2lf Mcells/s %10.1lf reads/s, %6.2lf %% agree\n", Profile->Name, Length, Engine->Name, aligned,
+			(elapsed > 0) ? (double)Length * Length * aligned / elapsed / 1e6 : 0,
+			(elapsed > 0) ? aligned / elapsed : 0,
+			100.0 * agreeing / aligned);
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _benchmark_length(FILE *Stream, PSSW_CONTEXT Context, const SSW_BENCHMARK_PROFILE *Profile, const size_t Length, uint64_t *State, const ESSWImplementation DefaultImplementation, const double MaxSeconds)
+{
+	const size_t count = max(1, min(SSW_BENCHMARK_MAX_READS, SSW_BENCHMARK_CELLS / (Length*Length)));
+	char *refs = NULL;
+	char *reads = NULL;
+	char *expected = NULL;
+	size_t *expectedLens = NULL;
+	const char *opString = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = utils_malloc(count*Length, (void **)&refs);
+	if (ret == ERR_SUCCESS) {
+		ret = utils_malloc(count*Length, (void **)&reads);
+		if (ret == ERR_SUCCESS) {
+			ret = utils_malloc(count * 2 * Length, (void **)&expected);
+			if (ret == ERR_SUCCESS) {
+				ret = utils_malloc(count*sizeof(size_t), (void **)&expectedLens);
+				if (ret == ERR_SUCCESS) {
+					for (size_t i = 0; i < count; ++i)
+						ssw_benchmark_generate(State, Profile, Length, refs + i*Length, reads + i*Length);
+
+					ssw_set_implementation(sswiScalar);
+					for (size_t i = 0; i < count; ++i) {
+						ret = _align_clever(Context, refs + i*Length, Length, reads + i*Length, Length, &opString, expectedLens + i);
+						if (ret != ERR_SUCCESS)
+							break;
+
+						memcpy(expected + i * 2 * Length, opString, expectedLens[i]);
+					}
+
+					for (size_t i = 0; ret == ERR_SUCCESS && i < sizeof(_engines) / sizeof(_engines[0]); ++i) {
+						const SSW_BENCHMARK_ENGINE *e = _engines + i;
+
+						if (Length > e->MaxLength)
+							continue;
+
+						if (!ssw_set_implementation((e->Implementation != sswiMax) ? e->Implementation : DefaultImplementation))
+							continue;
+
+						ret = _benchmark_engine(Stream, Context, e, Profile, Length, refs, reads, count, expected, expectedLens, MaxSeconds);
+					}
+
+					ssw_set_implementation(DefaultImplementation);
+					utils_free(expectedLens);
+				}
+
+				utils_free(expected);
+			}
+
+			utils_free(reads);
+		}
+
+		utils_free(refs);
+	}
+
+	return ret;
+}
+
+
+/************************************************************************/
+/*                           PUBLIC FUNCTIONS                           */
+/************************************************************************/
+
+
+void ssw_benchmark_generate(uint64_t *State, const SSW_BENCHMARK_PROFILE *Profile, const size_t Length, char *Ref, char *Read)
+{
+	size_t refIndex = 0;
+	size_t readIndex = 0;
+	size_t indelLength = 0;
+	double r = 0;
+
+	for (size_t i = 0; i < Length; ++i)
+		Ref[i] = _random_base(State);
+
+	while (readIndex < Length) {
+		if (refIndex == Length) {
+			Read[readIndex++] = _random_base(State);
+			continue;
+		}
+
+		r = _random_uniform(State);
+		if (r < Profile->IndelRate) {
+			indelLength = 1;
+			while (indelLength < SSW_BENCHMARK_MAX_INDEL && (_random_next(State) & 1) != 0)
+				++indelLength;
+
+			if (r < Profile->IndelRate / 2)
+				refIndex = min(Length, refIndex + indelLength);
+			else {
+				for (size_t i = 0; i < indelLength && readIndex < Length; ++i)
+					Read[readIndex++] = _random_base(State);
+			}
+		} else if (r < Profile->IndelRate + Profile->SNVRate) {
+			Read[readIndex] = "ACGT"[(strchr("ACGT", Ref[refIndex]) - "ACGT" + 1 + _random_next(State) % 3) % 4];
+			++readIndex;
+			++refIndex;
+		} else Read[readIndex++] = Ref[refIndex++];
+	}
+
+	return;
+}
+
+
+void ssw_benchmark(FILE *Stream, const uint64_t Seed, const size_t MaxLength, const double MaxSeconds)
+{
+	const ESSWImplementation defaultImplementation = ssw_implementation();
+	const size_t linearSpaceLength = ssw_linear_space_length();
+	SSW_CONTEXT context;
+	uint64_t state = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	fprintf(Stream, "[INFO]: Scoring %d/%d/%d, banded aligner starts at %u bases, cells of the full matrix are counted\n",
+		SSW_BENCHMARK_MATCH, SSW_BENCHMARK_MISMATCH, SSW_BENCHMARK_INDEL, SSW_BENCHMARK_BANDWIDTH);
+	ssw_context_init(&context);
+	/* The engines measure their own implementations, long sequences are not redirected to the linear-space one. */
+	ssw_set_linear_space_length(0);
+	ret = ERR_SUCCESS;
+	for (size_t i = 0; ret == ERR_SUCCESS && i < sizeof(_profiles) / sizeof(_profiles[0]); ++i) {
+		fprintf(Stream, "[INFO]: Profile %s: SNV rate %.4lf, indel rate %.4lf\n", _profiles[i].Name, _profiles[i].SNVRate, _profiles[i].IndelRate);
+		for (size_t j = 0; ret == ERR_SUCCESS && j < sizeof(_lengths) / sizeof(_lengths[0]); ++j) {
+			if (_lengths[j] > MaxLength)
+				break;
+
+			/* Every profile and length has its own sequences, regardless of which ones run. */
+			state = (Seed + 1) * 0x9E3779B97F4A7C15ULL ^ ((uint64_t)i << 32) ^ _lengths[j];
+			ret = _benchmark_length(Stream, &context, _profiles + i, _lengths[j], &state, defaultImplementation, MaxSeconds);
+		}
+	}
+
+	ssw_context_finit(&context);
+	ssw_set_linear_space_length(linearSpaceLength);
+	fprintf(Stream, "[INFO]: The %s implementation is used\n", ssw_implementation_name(ssw_implementation()));
+	if (ret != ERR_SUCCESS)
+		fprintf(Stream, "[ERROR]: The alignment benchmark failed with an error code %u\n", ret);
+
+	return;
+}
@@ -0,0 +1,32 @@
+
+#ifndef __SSW_BENCHMARK_H__
+#define __SSW_BENCHMARK_H__
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+
+
+/** Mutation rates of synthetic reads, per base of the reference window. */
+typedef struct _SSW_BENCHMARK_PROFILE {
+	const char *Name;
+	double SNVRate;
+	double IndelRate;
+} SSW_BENCHMARK_PROFILE, *PSSW_BENCHMARK_PROFILE;
+
+
+/** Generates a random reference window of Length bases and a read of the same length derived from it by
+    substitutions and short (1-8 bp) insertions and deletions. Read bases past the end of the window, left
+    by deletions, are random. The output depends only on the State, which is updated. */
+void ssw_benchmark_generate(uint64_t *State, const SSW_BENCHMARK_PROFILE *Profile, const size_t Length, char *Ref, char *Read);
+
+/** Aligns synthetic reads of 100 bp to MaxLength with every aligner, spending at most about MaxSeconds
+    on one aligner, read length and mutation profile. Reports matrix cells and reads per second, and the
+    share of operation strings identical to the scalar ssw_clever() ones. */
+void ssw_benchmark(FILE *Stream, const uint64_t Seed, const size_t MaxLength, const double MaxSeconds);
+
+
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+#include "err.h"
+#include "utils.h"
+#include "ssw-myers.h"
+
+
+/************************************************************************/
+/*                             HELPER TYPES                             */
+/************************************************************************/
+
+
+#define SSW_MYERS_WORD_BITS					64
+
+
+/************************************************************************/
+/*                             HELPER FUNCTIONS                         */
+/************************************************************************/
+
+
+/** Advances a block of vertical differences (Pv positive, Mv negative) by one column of A. Eq holds the
+    positions of the block matching the base of the column, HIn the horizontal difference entering the
+    block from above (-1, 0, +1) and Last the bit of the bottom row. Returns the horizontal difference of
+    the bottom row. */
+static int _ssw_myers_block(uint64_t *Pv, uint64_t *Mv, uint64_t Eq, const int HIn, const uint64_t Last)
+{
+	const uint64_t hInNegative = (HIn < 0) ? 1 : 0;
+	const uint64_t xv = Eq | *Mv;
+	uint64_t xh = 0;
+	uint64_t ph = 0;
+	uint64_t mh = 0;
+	int ret = 0;
+
+	Eq |= hInNegative;
+	xh = (((Eq & *Pv) + *Pv) ^ *Pv) | Eq;
+	ph = *Mv | ~(xh | *Pv);
+	mh = *Pv & xh;
+	if (ph & Last)
+		ret = 1;
+	else if (mh & Last)
+		ret = -1;
+
+	ph = (ph << 1) | ((HIn > 0) ? 1 : 0);
+	mh = (mh << 1) | hInNegative;
+	*Pv = mh | ~(xv | ph);
+	*Mv = ph & xv;
+
+	return ret;
+}
+
+
+/************************************************************************/
+/*                       PUBLIC FUNCTIONS                               */
+/************************************************************************/
+
+
+ERR_VALUE ssw_myers_distance(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, size_t *Distance)
+{
+	const size_t blockCount = (BLen + SSW_MYERS_WORD_BITS - 1) / SSW_MYERS_WORD_BITS;
+	/* Bits above the last base of B do not affect the lower ones, the last block is just not full. */
+	const uint64_t lastBit = (uint64_t)1 << ((BLen + SSW_MYERS_WORD_BITS - 1) % SSW_MYERS_WORD_BITS);
+	uint64_t *peq = NULL;
+	uint64_t *pv = NULL;
+	uint64_t *mv = NULL;
+	const uint64_t *eq = NULL;
+	size_t score = BLen;
+	size_t best = BLen;
+	int h = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (BLen == 0) {
+		*Distance = 0;
+		return ERR_SUCCESS;
+	}
+
+	ret = ssw_buffer_reserve(&Context->Profile, (256 + 2)*blockCount*sizeof(uint64_t));
+	if (ret == ERR_SUCCESS) {
+		peq = (uint64_t *)Context->Profile.Data;
+		pv = peq + 256 * blockCount;
+		mv = pv + blockCount;
+		memset(peq, 0, 256 * blockCount*sizeof(uint64_t));
+		for (size_t i = 0; i < BLen; ++i)
+			peq[(unsigned char)B[i] * blockCount + i / SSW_MYERS_WORD_BITS] |= (uint64_t)1 << (i % SSW_MYERS_WORD_BITS);
+
+		/* The first column scores the rows by their indices. */
+		for (size_t b = 0; b < blockCount; ++b) {
+			pv[b] = ~(uint64_t)0;
+			mv[b] = 0;
+		}
+
+		for (size_t j = 0; j < ALen; ++j) {
+			eq = peq + (unsigned char)A[j] * blockCount;
+			/* The alignment starts at the beginning of A, the top row scores the columns by their indices. */
+			h = 1;
+			for (size_t b = 0; b < blockCount; ++b)
+				h = _ssw_myers_block(pv + b, mv + b, eq[b], h, (b + 1 < blockCount) ? ((uint64_t)1 << (SSW_MYERS_WORD_BITS - 1)) : lastBit);
+
+			score += h;
+			best = min(best, score);
+		}
+
+		*Distance = best;
+	}
+
+	return ret;
+}
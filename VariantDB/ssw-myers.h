@@ -0,0 +1,23 @@
+
+#ifndef __SSW_MYERS_H__
+#define __SSW_MYERS_H__
+
+
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+#include "ssw.h"
+
+
+/** Bit-parallel (Myers, Hyyro) edit distance. B is split into blocks of 64 bases, every block held in
+    a pair of 64-bit words of vertical score differences, so a column of the edit distance matrix takes a
+    few word operations per block regardless of the length of B. */
+
+/** Computes the edit distance (unit costs of mismatches and gaps) between B and the best prefix of A,
+    i.e. the alignment starts at the beginning of both sequences, covers all of B and ends anywhere
+    in A. The match masks are kept in the Profile buffer of the context. */
+ERR_VALUE ssw_myers_distance(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, size_t *Distance);
+
+
+
+#endif
@@ -0,0 +1,201 @@
+
+/* Body of a striped alignment kernel. The file is included by ssw-striped.c once for every combination of
+   instruction set and score width; the including code defines the SSW_* macros below and this file undefines
+   them at its end.
+
+   SSW_KERNEL_NAME, SSW_FUNCTION (target attribute), SSW_ELEMENT, SSW_ELEMENT_MAX, SSW_LANES, SSW_VECTOR,
+   SSW_LOAD, SSW_STORE, SSW_SET1, SSW_ZERO, SSW_ADDS, SSW_SUBS, SSW_MAX, SSW_CMPEQ, SSW_AND,
+   SSW_MOVEMASK, SSW_MASK_BITS_PER_LANE, SSW_LANE_MASK (one bit per lane), SSW_SHIFT1 (by one lane towards
+   the higher ones), SSW_PREFIX_MAX (inclusive maximum scan over the lanes), SSW_HMAX (maximum of the lanes).
+
+   Steps of a segment are stored as two SSW_LANES-bit planes (see _ssw_striped_op_string()), SSW_LANES / 4
+   bytes, so every cell takes two bits. */
+
+
+SSW_FUNCTION
+static ERR_VALUE SSW_KERNEL_NAME(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, PSSW_STRIPED_RESULT Result)
+{
+	const size_t segLen = (BLen + SSW_LANES - 1) / SSW_LANES;
+	const size_t colSize = segLen*SSW_LANES;
+	int16_t slots[256];
+	size_t slotCount = 0;
+	SSW_ELEMENT *profile = NULL;
+	SSW_ELEMENT *work = NULL;
+	uint8_t *steps = NULL;
+	SSW_ELEMENT *hPrev = NULL;
+	SSW_ELEMENT *hCur = NULL;
+	SSW_ELEMENT *rowMaxes = NULL;
+	SSW_ELEMENT *xCol = NULL;
+	SSW_ELEMENT *valid = NULL;
+	SSW_ELEMENT *diagCol = NULL;
+	SSW_ELEMENT *tmp = NULL;
+	uint32_t *bits = NULL;
+	const SSW_VECTOR vGap = SSW_SET1(-Indel);
+	const uint64_t laneBits = ((uint64_t)1 << SSW_LANES) - 1;
+	SSW_VECTOR vD;
+	SSW_VECTOR vL;
+	SSW_VECTOR vU;
+	SSW_VECTOR vX;
+	SSW_VECTOR vH;
+	SSW_VECTOR vDiag;
+	SSW_VECTOR vRun;
+	SSW_VECTOR vTotal;
+	SSW_VECTOR vColMax;
+	const SSW_ELEMENT *prof = NULL;
+	uint8_t *stepCol = NULL;
+	uint64_t diagMask = 0;
+	uint64_t xMask = 0;
+	uint64_t packed = 0;
+	uint32_t colMax = 0;
+	uint32_t best = 0;
+	uint32_t lanesWithMax = 0;
+	uint32_t bit = 0;
+	size_t q = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(Result, 0, sizeof(SSW_STRIPED_RESULT));
+	_ssw_striped_slots(A, ALen, slots, &slotCount);
+	ret = ssw_buffer_reserve(&Context->Profile, slotCount*2*colSize*sizeof(SSW_ELEMENT));
+	if (ret == ERR_SUCCESS)
+		ret = ssw_buffer_reserve(&Context->Scores, 6*colSize*sizeof(SSW_ELEMENT) + segLen*sizeof(uint32_t));
+
+	if (ret == ERR_SUCCESS)
+		ret = ssw_buffer_reserve(&Context->Steps, ALen*colSize / 4);
+
+	if (ret == ERR_SUCCESS) {
+		profile = (SSW_ELEMENT *)Context->Profile.Data;
+		work = (SSW_ELEMENT *)Context->Scores.Data;
+		steps = (uint8_t *)Context->Steps.Data;
+		bits = (uint32_t *)(work + 6*colSize);
+		memset(profile, 0, slotCount*2*colSize*sizeof(SSW_ELEMENT));
+		memset(work, 0, 6*colSize*sizeof(SSW_ELEMENT));
+		hPrev = work;
+		hCur = hPrev + colSize;
+		rowMaxes = hCur + colSize;
+		xCol = rowMaxes + colSize;
+		valid = xCol + colSize;
+		diagCol = valid + colSize;
+		for (size_t c = 0; c < 256; ++c) {
+			if (slots[c] < 0)
+				continue;
+
+			for (size_t s = 0; s < segLen; ++s) {
+				SSW_ELEMENT *plus = profile + ((slots[c] * segLen + s) * 2)*SSW_LANES;
+				SSW_ELEMENT *minus = plus + SSW_LANES;
+
+				for (size_t l = 0; l < SSW_LANES; ++l) {
+					const size_t pos = l*segLen + s;
+					int score = 0;
+
+					if (pos < BLen) {
+						score = ((unsigned char)B[pos] == c) ? Match : Mismatch;
+						plus[l] = (SSW_ELEMENT)max(score, 0);
+						minus[l] = (SSW_ELEMENT)max(-score, 0);
+					} else minus[l] = SSW_ELEMENT_MAX;
+				}
+			}
+		}
+
+		for (size_t s = 0; s < segLen; ++s) {
+			for (size_t l = 0; l < SSW_LANES; ++l)
+				valid[s*SSW_LANES + l] = (l*segLen + s < BLen) ? SSW_ELEMENT_MAX : 0;
+		}
+
+		for (size_t j = 0; j < ALen; ++j) {
+			prof = profile + slots[(unsigned char)A[j]] * segLen * 2 * SSW_LANES;
+			stepCol = steps + j*colSize / 4;
+			/* Diagonal and left moves, and the maximum of every lane for the vertical (up) moves. */
+			vDiag = SSW_SHIFT1(SSW_LOAD(hPrev + (segLen - 1)*SSW_LANES));
+			vTotal = SSW_ZERO;
+			for (size_t s = 0; s < segLen; ++s) {
+				vD = SSW_SUBS(SSW_ADDS(vDiag, SSW_LOAD(prof + 2*s*SSW_LANES)), SSW_LOAD(prof + (2*s + 1)*SSW_LANES));
+				vDiag = SSW_LOAD(hPrev + s*SSW_LANES);
+				vL = SSW_SUBS(SSW_LOAD(rowMaxes + s*SSW_LANES), vGap);
+				vX = SSW_MAX(vD, vL);
+				SSW_STORE(xCol + s*SSW_LANES, vX);
+				SSW_STORE(diagCol + s*SSW_LANES, SSW_CMPEQ(vX, vD));
+				vTotal = SSW_MAX(vTotal, vX);
+			}
+
+			/* An up move can start at any earlier cell of the column, so it depends on a prefix maximum
+			   of the diagonal and left moves; the maxima of the lanes below are carried into every lane. */
+			vRun = SSW_PREFIX_MAX(SSW_SHIFT1(vTotal));
+			vColMax = SSW_ZERO;
+			for (size_t s = 0; s < segLen; ++s) {
+				vX = SSW_LOAD(xCol + s*SSW_LANES);
+				vU = SSW_SUBS(vRun, vGap);
+				vH = SSW_MAX(vX, vU);
+				/* The low plane marks diagonal and up moves, the high one left and up moves. */
+				diagMask = SSW_LANE_MASK(SSW_LOAD(diagCol + s*SSW_LANES));
+				xMask = SSW_LANE_MASK(SSW_CMPEQ(vH, vX));
+				packed = (diagMask | (~xMask & laneBits)) | ((~(diagMask & xMask) & laneBits) << SSW_LANES);
+				memcpy(stepCol + s*SSW_LANES / 4, &packed, SSW_LANES / 4);
+				SSW_STORE(hCur + s*SSW_LANES, vH);
+				SSW_STORE(rowMaxes + s*SSW_LANES, SSW_MAX(SSW_LOAD(rowMaxes + s*SSW_LANES), vH));
+				vColMax = SSW_MAX(vColMax, SSW_AND(vH, SSW_LOAD(valid + s*SSW_LANES)));
+				vRun = SSW_MAX(vRun, vX);
+			}
+
+			colMax = SSW_HMAX(vColMax);
+			if (colMax == SSW_ELEMENT_MAX) {
+				Result->Overflow = TRUE;
+				break;
+			}
+
+			/* The maximum is taken from the last row reaching it, and from the last column within that row. */
+			if (colMax >= best) {
+				vH = SSW_SET1(colMax);
+				lanesWithMax = 0;
+				for (size_t s = 0; s < segLen; ++s) {
+					bits[s] = SSW_MOVEMASK(SSW_AND(SSW_CMPEQ(SSW_LOAD(hCur + s*SSW_LANES), vH), SSW_LOAD(valid + s*SSW_LANES)));
+					lanesWithMax |= bits[s];
+				}
+
+				bit = _ssw_highest_bit(lanesWithMax);
+				q = segLen;
+				while (q > 0 && (bits[q - 1] & (1U << bit)) == 0)
+					--q;
+
+				q = (bit / SSW_MASK_BITS_PER_LANE)*segLen + q;
+				if (colMax > best || q >= Result->MaxRow) {
+					best = colMax;
+					Result->MaxRow = q;
+					Result->MaxCol = j + 1;
+				}
+			}
+
+			tmp = hPrev;
+			hPrev = hCur;
+			hCur = tmp;
+		}
+
+		Result->Steps = steps;
+		Result->SegmentLength = segLen;
+		Result->Lanes = SSW_LANES;
+	}
+
+	return ret;
+}
+
+
+#undef SSW_KERNEL_NAME
+#undef SSW_FUNCTION
+#undef SSW_ELEMENT
+#undef SSW_ELEMENT_MAX
+#undef SSW_LANES
+#undef SSW_VECTOR
+#undef SSW_LOAD
+#undef SSW_STORE
+#undef SSW_SET1
+#undef SSW_ZERO
+#undef SSW_ADDS
+#undef SSW_SUBS
+#undef SSW_MAX
+#undef SSW_CMPEQ
+#undef SSW_AND
+#undef SSW_MOVEMASK
+#undef SSW_MASK_BITS_PER_LANE
+#undef SSW_LANE_MASK
+#undef SSW_SHIFT1
+#undef SSW_PREFIX_MAX
+#undef SSW_HMAX
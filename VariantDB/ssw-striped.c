@@ -0,0 +1,423 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include "err.h"
+#include "utils.h"
+#include "ssw-striped.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SSW_STRIPED_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define SSW_SSE41_FUNCTION
+#define SSW_AVX2_FUNCTION
+#else
+#define SSW_SSE41_FUNCTION					__attribute__((target("sse4.1")))
+#define SSW_AVX2_FUNCTION					__attribute__((target("avx2")))
+#endif
+#endif
+
+
+/************************************************************************/
+/*                             HELPER TYPES                             */
+/************************************************************************/
+
+
+/** Step codes of the cells; they correspond to msDiagMatch/msDiagMisMatch, msLeft and msUp of ssw.c. Bit 0
+    of a code is stored in the low plane of a segment, bit 1 in the high one. */
+#define SSW_STEP_DIAGONAL					1
+#define SSW_STEP_LEFT						2
+#define SSW_STEP_UP							3
+
+
+typedef struct _SSW_STRIPED_RESULT {
+	/** Step codes of the cells, two bits per cell, column by column (in the context). Every segment of a
+	    column takes Lanes / 4 bytes, the low bit plane of its lanes followed by the high one. */
+	const uint8_t *Steps;
+	size_t Lanes;
+	size_t SegmentLength;
+	/** Cell with the maximum score (1-based, as in the scalar score matrix). */
+	size_t MaxRow;
+	size_t MaxCol;
+	/** The scores saturated the lanes and the steps are not valid. */
+	boolean Overflow;
+} SSW_STRIPED_RESULT, *PSSW_STRIPED_RESULT;
+
+
+/************************************************************************/
+/*                             HELPER FUNCTIONS                         */
+/************************************************************************/
+
+
+/** Assigns a query profile slot to every character present in the reference. */
+static void _ssw_striped_slots(const char *A, const size_t ALen, int16_t Slots[256], size_t *SlotCount)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < 256; ++i)
+		Slots[i] = -1;
+
+	for (size_t i = 0; i < ALen; ++i) {
+		if (Slots[(unsigned char)A[i]] < 0) {
+			Slots[(unsigned char)A[i]] = (int16_t)count;
+			++count;
+		}
+	}
+
+	*SlotCount = count;
+
+	return;
+}
+
+
+static uint32_t _ssw_highest_bit(uint32_t Value)
+{
+	uint32_t ret = 0;
+
+	while (Value > 1) {
+		Value >>= 1;
+		++ret;
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _ssw_striped_op_string(PSSW_CONTEXT Context, const char *A, const char *B, const SSW_STRIPED_RESULT *Result, const char **OperationString, size_t *OperationStringLen)
+{
+	char *opString = NULL;
+	size_t row = Result->MaxRow;
+	size_t col = Result->MaxCol;
+	const size_t opStringMax = row + col;
+	size_t opStringIndex = opStringMax;
+	const size_t colSize = Result->SegmentLength*Result->Lanes;
+	const uint8_t *segment = NULL;
+	size_t lane = 0;
+	uint32_t step = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ssw_buffer_reserve(&Context->OpString, (opStringMax + 1)*sizeof(char));
+	if (ret == ERR_SUCCESS) {
+		opString = (char *)Context->OpString.Data;
+		opString[opStringMax] = '\0';
+		while (ret == ERR_SUCCESS && row > 0 && col > 0) {
+			segment = Result->Steps + ((col - 1)*colSize + ((row - 1) % Result->SegmentLength)*Result->Lanes) / 4;
+			lane = (row - 1) / Result->SegmentLength;
+			step = ((segment[lane / 8] >> (lane % 8)) & 1) |
+				(((segment[(Result->Lanes + lane) / 8] >> ((Result->Lanes + lane) % 8)) & 1) << 1);
+			--opStringIndex;
+			switch (step) {
+				case SSW_STEP_DIAGONAL:
+					opString[opStringIndex] = (B[row - 1] == A[col - 1]) ? 'M' : 'X';
+					--row;
+					--col;
+					break;
+				case SSW_STEP_LEFT:
+					opString[opStringIndex] = 'D';
+					--col;
+					break;
+				case SSW_STEP_UP:
+					opString[opStringIndex] = 'I';
+					--row;
+					break;
+				default:
+					ret = ERR_INTERNAL_ERROR;
+					break;
+			}
+		}
+
+		while (col > 0) {
+			--opStringIndex;
+			opString[opStringIndex] = 'D';
+			--col;
+		}
+
+		while (row > 0) {
+			--opStringIndex;
+			opString[opStringIndex] = 'I';
+			--row;
+		}
+
+		if (ret == ERR_SUCCESS) {
+			*OperationString = opString + opStringIndex;
+			*OperationStringLen = opStringMax - opStringIndex;
+		}
+	}
+
+	return ret;
+}
+
+
+typedef ERR_VALUE (SSW_STRIPED_KERNEL)(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, PSSW_STRIPED_RESULT Result);
+
+
+static size_t _ssw_striped_score_bound(const size_t ALen, const size_t BLen, const int Match, const int Mismatch)
+{
+	return (size_t)max(max(Match, Mismatch), 0)*min(ALen, BLen);
+}
+
+
+static ERR_VALUE _ssw_striped(PSSW_CONTEXT Context, SSW_STRIPED_KERNEL *Kernel8, SSW_STRIPED_KERNEL *Kernel16, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen)
+{
+	SSW_STRIPED_RESULT result;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	memset(&result, 0, sizeof(result));
+	if (ssw_striped_supported(ALen, BLen, Match, Mismatch, Indel)) {
+		ret = ERR_SUCCESS;
+		result.Overflow = TRUE;
+		if (_ssw_striped_score_bound(ALen, BLen, Match, Mismatch) < UINT8_MAX)
+			ret = Kernel8(Context, A, ALen, B, BLen, Match, Mismatch, Indel, &result);
+
+		if (ret == ERR_SUCCESS && result.Overflow)
+			ret = Kernel16(Context, A, ALen, B, BLen, Match, Mismatch, Indel, &result);
+
+		if (ret == ERR_SUCCESS && result.Overflow)
+			ret = ERR_NOT_IMPLEMENTED;
+
+		if (ret == ERR_SUCCESS)
+			ret = _ssw_striped_op_string(Context, A, B, &result, OperationString, OperationStringLen);
+	} else ret = ERR_NOT_IMPLEMENTED;
+
+	return ret;
+}
+
+
+#ifdef SSW_STRIPED_X86
+
+
+SSW_SSE41_FUNCTION
+static uint32_t _ssw_hmax_sse41_8(__m128i v)
+{
+	v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+	v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+	v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+	v = _mm_max_epu8(v, _mm_srli_si128(v, 1));
+
+	return (uint32_t)_mm_cvtsi128_si32(v) & 0xff;
+}
+
+
+SSW_SSE41_FUNCTION
+static uint32_t _ssw_hmax_sse41_16(__m128i v)
+{
+	v = _mm_max_epu16(v, _mm_srli_si128(v, 8));
+	v = _mm_max_epu16(v, _mm_srli_si128(v, 4));
+	v = _mm_max_epu16(v, _mm_srli_si128(v, 2));
+
+	return (uint32_t)_mm_cvtsi128_si32(v) & 0xffff;
+}
+
+
+SSW_SSE41_FUNCTION
+static __m128i _ssw_prefix_max_sse41_8(__m128i v)
+{
+	v = _mm_max_epu8(v, _mm_slli_si128(v, 1));
+	v = _mm_max_epu8(v, _mm_slli_si128(v, 2));
+	v = _mm_max_epu8(v, _mm_slli_si128(v, 4));
+	v = _mm_max_epu8(v, _mm_slli_si128(v, 8));
+
+	return v;
+}
+
+
+SSW_SSE41_FUNCTION
+static __m128i _ssw_prefix_max_sse41_16(__m128i v)
+{
+	v = _mm_max_epu16(v, _mm_slli_si128(v, 2));
+	v = _mm_max_epu16(v, _mm_slli_si128(v, 4));
+	v = _mm_max_epu16(v, _mm_slli_si128(v, 8));
+
+	return v;
+}
+
+
+/** One bit per 16-bit lane of a comparison result, the lanes saturate to bytes. */
+SSW_SSE41_FUNCTION
+static uint32_t _ssw_lane_mask_sse41_16(__m128i v)
+{
+	return (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(v, _mm_setzero_si128()));
+}
+
+
+/** Shifts the 256-bit vector by aBytes (less than 16) towards the higher lanes, across the 128-bit halves. */
+#define _ssw_avx2_shift(aV, aBytes)			_mm256_alignr_epi8((aV), _mm256_permute2x128_si256((aV), (aV), 0x08), 16 - (aBytes))
+#define _ssw_avx2_shift16(aV)				_mm256_permute2x128_si256((aV), (aV), 0x08)
+
+
+SSW_AVX2_FUNCTION
+static uint32_t _ssw_hmax_avx2_8(__m256i v)
+{
+	return _ssw_hmax_sse41_8(_mm_max_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+
+SSW_AVX2_FUNCTION
+static uint32_t _ssw_hmax_avx2_16(__m256i v)
+{
+	return _ssw_hmax_sse41_16(_mm_max_epu16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+
+SSW_AVX2_FUNCTION
+static __m256i _ssw_prefix_max_avx2_8(__m256i v)
+{
+	v = _mm256_max_epu8(v, _ssw_avx2_shift(v, 1));
+	v = _mm256_max_epu8(v, _ssw_avx2_shift(v, 2));
+	v = _mm256_max_epu8(v, _ssw_avx2_shift(v, 4));
+	v = _mm256_max_epu8(v, _ssw_avx2_shift(v, 8));
+	v = _mm256_max_epu8(v, _ssw_avx2_shift16(v));
+
+	return v;
+}
+
+
+SSW_AVX2_FUNCTION
+static __m256i _ssw_prefix_max_avx2_16(__m256i v)
+{
+	v = _mm256_max_epu16(v, _ssw_avx2_shift(v, 2));
+	v = _mm256_max_epu16(v, _ssw_avx2_shift(v, 4));
+	v = _mm256_max_epu16(v, _ssw_avx2_shift(v, 8));
+	v = _mm256_max_epu16(v, _ssw_avx2_shift16(v));
+
+	return v;
+}
+
+
+/** Packing works within the 128-bit halves, their lanes end up in bytes 0-7 and 16-23. */
+SSW_AVX2_FUNCTION
+static uint32_t _ssw_lane_mask_avx2_16(__m256i v)
+{
+	const uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_packs_epi16(v, _mm256_setzero_si256()));
+
+	return (mask & 0xff) | ((mask >> 8) & 0xff00);
+}
+
+
+#define SSW_KERNEL_NAME						_ssw_striped_sse41_8
+#define SSW_FUNCTION						SSW_SSE41_FUNCTION
+#define SSW_ELEMENT							uint8_t
+#define SSW_ELEMENT_MAX						UINT8_MAX
+#define SSW_LANES							16
+#define SSW_VECTOR							__m128i
+#define SSW_LOAD(aP)						_mm_loadu_si128((const __m128i *)(aP))
+#define SSW_STORE(aP, aV)					_mm_storeu_si128((__m128i *)(aP), (aV))
+#define SSW_SET1(aX)						_mm_set1_epi8((char)(aX))
+#define SSW_ZERO							_mm_setzero_si128()
+#define SSW_ADDS							_mm_adds_epu8
+#define SSW_SUBS							_mm_subs_epu8
+#define SSW_MAX								_mm_max_epu8
+#define SSW_CMPEQ							_mm_cmpeq_epi8
+#define SSW_AND								_mm_and_si128
+#define SSW_MOVEMASK(aV)					((uint32_t)_mm_movemask_epi8(aV))
+#define SSW_MASK_BITS_PER_LANE				1
+#define SSW_LANE_MASK						SSW_MOVEMASK
+#define SSW_SHIFT1(aV)						_mm_slli_si128((aV), 1)
+#define SSW_PREFIX_MAX						_ssw_prefix_max_sse41_8
+#define SSW_HMAX							_ssw_hmax_sse41_8
+#include "ssw-striped-kernel.h"
+
+#define SSW_KERNEL_NAME						_ssw_striped_sse41_16
+#define SSW_FUNCTION						SSW_SSE41_FUNCTION
+#define SSW_ELEMENT							uint16_t
+#define SSW_ELEMENT_MAX						UINT16_MAX
+#define SSW_LANES							8
+#define SSW_VECTOR							__m128i
+#define SSW_LOAD(aP)						_mm_loadu_si128((const __m128i *)(aP))
+#define SSW_STORE(aP, aV)					_mm_storeu_si128((__m128i *)(aP), (aV))
+#define SSW_SET1(aX)						_mm_set1_epi16((short)(aX))
+#define SSW_ZERO							_mm_setzero_si128()
+#define SSW_ADDS							_mm_adds_epu16
+#define SSW_SUBS							_mm_subs_epu16
+#define SSW_MAX								_mm_max_epu16
+#define SSW_CMPEQ							_mm_cmpeq_epi16
+#define SSW_AND								_mm_and_si128
+#define SSW_MOVEMASK(aV)					((uint32_t)_mm_movemask_epi8(aV))
+#define SSW_MASK_BITS_PER_LANE				2
+#define SSW_LANE_MASK						_ssw_lane_mask_sse41_16
+#define SSW_SHIFT1(aV)						_mm_slli_si128((aV), 2)
+#define SSW_PREFIX_MAX						_ssw_prefix_max_sse41_16
+#define SSW_HMAX							_ssw_hmax_sse41_16
+#include "ssw-striped-kernel.h"
+
+#define SSW_KERNEL_NAME						_ssw_striped_avx2_8
+#define SSW_FUNCTION						SSW_AVX2_FUNCTION
+#define SSW_ELEMENT							uint8_t
+#define SSW_ELEMENT_MAX						UINT8_MAX
+#define SSW_LANES							32
+#define SSW_VECTOR							__m256i
+#define SSW_LOAD(aP)						_mm256_loadu_si256((const __m256i *)(aP))
+#define SSW_STORE(aP, aV)					_mm256_storeu_si256((__m256i *)(aP), (aV))
+#define SSW_SET1(aX)						_mm256_set1_epi8((char)(aX))
+#define SSW_ZERO							_mm256_setzero_si256()
+#define SSW_ADDS							_mm256_adds_epu8
+#define SSW_SUBS							_mm256_subs_epu8
+#define SSW_MAX								_mm256_max_epu8
+#define SSW_CMPEQ							_mm256_cmpeq_epi8
+#define SSW_AND								_mm256_and_si256
+#define SSW_MOVEMASK(aV)					((uint32_t)_mm256_movemask_epi8(aV))
+#define SSW_MASK_BITS_PER_LANE				1
+#define SSW_LANE_MASK						SSW_MOVEMASK
+#define SSW_SHIFT1(aV)						_ssw_avx2_shift((aV), 1)
+#define SSW_PREFIX_MAX						_ssw_prefix_max_avx2_8
+#define SSW_HMAX							_ssw_hmax_avx2_8
+#include "ssw-striped-kernel.h"
+
+#define SSW_KERNEL_NAME						_ssw_striped_avx2_16
+#define SSW_FUNCTION						SSW_AVX2_FUNCTION
+#define SSW_ELEMENT							uint16_t
+#define SSW_ELEMENT_MAX						UINT16_MAX
+#define SSW_LANES							16
+#define SSW_VECTOR							__m256i
+#define SSW_LOAD(aP)						_mm256_loadu_si256((const __m256i *)(aP))
+#define SSW_STORE(aP, aV)					_mm256_storeu_si256((__m256i *)(aP), (aV))
+#define SSW_SET1(aX)						_mm256_set1_epi16((short)(aX))
+#define SSW_ZERO							_mm256_setzero_si256()
+#define SSW_ADDS							_mm256_adds_epu16
+#define SSW_SUBS							_mm256_subs_epu16
+#define SSW_MAX								_mm256_max_epu16
+#define SSW_CMPEQ							_mm256_cmpeq_epi16
+#define SSW_AND								_mm256_and_si256
+#define SSW_MOVEMASK(aV)					((uint32_t)_mm256_movemask_epi8(aV))
+#define SSW_MASK_BITS_PER_LANE				2
+#define SSW_LANE_MASK						_ssw_lane_mask_avx2_16
+#define SSW_SHIFT1(aV)						_ssw_avx2_shift((aV), 2)
+#define SSW_PREFIX_MAX						_ssw_prefix_max_avx2_16
+#define SSW_HMAX							_ssw_hmax_avx2_16
+#include "ssw-striped-kernel.h"
+
+
+#endif
+
+
+/************************************************************************/
+/*                       PUBLIC FUNCTIONS                               */
+/************************************************************************/
+
+
+boolean ssw_striped_supported(const size_t ALen, const size_t BLen, const int Match, const int Mismatch, const int Indel)
+{
+	return (ALen > 0 && BLen > 0 && (Indel == 0 || Indel == -1) &&
+		Match <= UINT8_MAX && Mismatch >= -UINT8_MAX &&
+		_ssw_striped_score_bound(ALen, BLen, Match, Mismatch) < UINT16_MAX);
+}
+
+
+ERR_VALUE ssw_striped_sse41(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen)
+{
+#ifdef SSW_STRIPED_X86
+	return _ssw_striped(Context, _ssw_striped_sse41_8, _ssw_striped_sse41_16, A, ALen, B, BLen, Match, Mismatch, Indel, OperationString, OperationStringLen);
+#else
+	return ERR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+ERR_VALUE ssw_striped_avx2(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen)
+{
+#ifdef SSW_STRIPED_X86
+	return _ssw_striped(Context, _ssw_striped_avx2_8, _ssw_striped_avx2_16, A, ALen, B, BLen, Match, Mismatch, Indel, OperationString, OperationStringLen);
+#else
+	return ERR_NOT_IMPLEMENTED;
+#endif
+}
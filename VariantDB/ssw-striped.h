@@ -0,0 +1,26 @@
+
+#ifndef __SSW_STRIPED_H__
+#define __SSW_STRIPED_H__
+
+
+#include <stdint.h>
+#include "err.h"
+#include "utils.h"
+#include "ssw.h"
+
+
+/** Striped (Farrar) implementations of ssw_clever(). The reference (A) is processed column by column and
+    every column of the read (B) is split into segments that are computed in parallel by vector lanes.
+    Scores are held in 8-bit lanes when they cannot exceed 255, falling back to 16-bit lanes on saturation.
+    The resulting operation strings are identical to those of the scalar implementation. */
+
+/** Returns TRUE if the striped implementations can compute the alignment, i.e. the indel penalty is 0 or
+    -1 and the score bound fits 16-bit lanes. Other inputs make the functions return ERR_NOT_IMPLEMENTED. */
+boolean ssw_striped_supported(const size_t ALen, const size_t BLen, const int Match, const int Mismatch, const int Indel);
+
+ERR_VALUE ssw_striped_sse41(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen);
+ERR_VALUE ssw_striped_avx2(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen);
+
+
+
+#endif
@@ -5,6 +5,8 @@
 #include "err.h"
 #include "utils.h"
 #include "ssw.h"
+#include "ssw-striped.h"
+#include "ssw-batch.h"
 
 /************************************************************************/
 /*                             HELPER TYPES                             */
@@ -18,6 +20,23 @@ typedef enum _EMatrixStep {
 	msLeft,
 } EMatrixStep, *PEMatrixStep;
 
+/** State of the linear-space traceback of ssw_clever_linear_ctx(). The operation string is filled from
+    its end; Row and Col hold the current cell. */
+typedef struct _SSW_LINEAR_TRACEBACK {
+	const char *A;
+	const char *B;
+	int Match;
+	int Mismatch;
+	int Indel;
+	/** Columns of the matrix that can lie on the path. */
+	size_t Cols;
+	uint8_t *Steps;
+	char *OpString;
+	size_t OpStringIndex;
+	size_t Row;
+	size_t Col;
+} SSW_LINEAR_TRACEBACK, *PSSW_LINEAR_TRACEBACK;
+
 /************************************************************************/
 /*                             HELPER FUNCTIONS                         */
 /************************************************************************/
@@ -123,32 +142,6 @@ static ERR_VALUE _op_string_from_step_matrix(const EMatrixStep *StepMatrix, cons
 }
 
 
-#define _compute_one_cell(aMatrix, aA, aB, aStepMatrix, aRowIndex, aColIndex, aColCount, aMatch, aMismatch, aIndel, aRowMaxes, aColMaxes, aResult)	\
-{	\
-	const boolean matches = ((aB)[(aRowIndex)] == (aA)[(aColIndex)]);	\
-	const int32_t diag = max(0, item_2d((aMatrix), (aColCount), (aRowIndex) - 1, (aColIndex) - 1) + ((matches) ? (aMatch) : (aMismatch)));			\
-	const int32_t left = max(0, (aRowMaxes)[(aRowIndex)] + (aIndel));	\
-	const int32_t up = max(0, (aColMaxes)[(aColIndex)] + (aIndel));		\
-	\
-	(aResult) = max(0, max(max(up, left), diag));	\
-	item_2d((aMatrix), (aColCount), (aRowIndex), (aColIndex)) = (aResult);	\
-	if ((aResult) > up)	\
-		(aColMaxes)[(aColIndex)] = (aResult);	\
-																		\
-	if ((aResult) > left)	\
-		(aRowMaxes)[(aRowIndex)] = (aResult);	\
-																		\
-	if ((aResult) == diag)	\
-		item_2d((aStepMatrix), (aColCount), (aRowIndex), (aColIndex)) = (matches) ? msDiagMatch : msDiagMisMatch;	\
-	else if ((aResult) == left)	\
-		item_2d((aStepMatrix), (aColCount), (aRowIndex), (aColIndex)) = msLeft;	\
-	else if ((aResult) == up)	\
-		item_2d((aStepMatrix), (aColCount), (aRowIndex), (aColIndex)) = msUp;	\
-	else item_2d((aStepMatrix), (aColCount), (aRowIndex), (aColIndex)) = msNone;	\
-	\
-}	\
-
-
 #define _update_maximum_cell(aMaxRow, aMaxCol, aMaxValue, aNewRow, aNewCol, aNewValue)	\
 	{																					\
 		if ((aNewValue) >= (aMaxValue)) {												\
@@ -159,11 +152,414 @@ static ERR_VALUE _op_string_from_step_matrix(const EMatrixStep *StepMatrix, cons
 	}																					\
 
 
+/** Traceback directions of _ssw_scalar_pass(), packed four cells per byte. Whether a diagonal step is
+    a match or a mismatch is decided by comparing the sequences again. */
+typedef enum _EPackedStep {
+	psNone = 0,
+	psDiag,
+	psLeft,
+	psUp,
+} EPackedStep, *PEPackedStep;
+
+/** Index of cell (aI, aJ) among the packed steps. Rows hold aRowSize cells; within a band (aBandwidth > 0)
+    cell (aI, aJ) is stored at column aJ - aI + aBandwidth. */
+#define _packed_step_index(aRowSize, aBandwidth, aI, aJ)		((aRowSize)*(aI) + (aJ) + (((aBandwidth) > 0) ? (aBandwidth) - (aI) : 0))
+#define _packed_step_get(aSteps, aIndex)						((EPackedStep)(((aSteps)[(aIndex) / 4] >> (2 * ((aIndex) % 4))) & 3))
+#define _packed_step_set(aSteps, aIndex, aStep)					((aSteps)[(aIndex) / 4] |= (uint8_t)((aStep) << (2 * ((aIndex) % 4))))
+
+
+static ERR_VALUE _op_string_from_packed_steps(PSSW_CONTEXT Context, const char *A, const char *B, const uint8_t *Steps, const size_t RowSize, const size_t Bandwidth, size_t MaxValueRow, size_t MaxValueCol, const char **OperationString, size_t *OperationStringLen, size_t *Deviation)
+{
+	char *opString = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+	size_t opStringMax = MaxValueCol + MaxValueRow;
+	size_t index = 0;
+	EPackedStep step = psNone;
+
+	*Deviation = 0;
+	ret = ssw_buffer_reserve(&Context->OpString, (opStringMax + 1)*sizeof(char));
+	if (ret == ERR_SUCCESS) {
+		size_t opStringIndex = opStringMax;
+
+		opString = (char *)Context->OpString.Data;
+		opString[opStringMax] = '\0';
+		while (MaxValueRow > 0 && MaxValueCol > 0) {
+			index = _packed_step_index(RowSize, Bandwidth, MaxValueRow, MaxValueCol);
+			step = _packed_step_get(Steps, index);
+			*Deviation = max(*Deviation, (MaxValueRow > MaxValueCol) ? MaxValueRow - MaxValueCol : MaxValueCol - MaxValueRow);
+			/* Cells outside of the band have no steps; the path ends at the boundary as if the next cell
+			   scored zero. */
+			if (Bandwidth > 0 && ((step == psLeft && MaxValueCol + Bandwidth == MaxValueRow) || (step == psUp && MaxValueRow + Bandwidth == MaxValueCol)))
+				break;
+
+			--opStringIndex;
+			switch (step) {
+				case psDiag:
+					opString[opStringIndex] = (A[MaxValueCol - 1] == B[MaxValueRow - 1]) ? 'M' : 'X';
+					--MaxValueCol;
+					--MaxValueRow;
+					break;
+				case psLeft:
+					opString[opStringIndex] = 'D';
+					--MaxValueCol;
+					break;
+				case psUp:
+					opString[opStringIndex] = 'I';
+					--MaxValueRow;
+					break;
+				default:
+					assert(FALSE);
+					break;
+			}
+		}
+
+		while (MaxValueCol > 0) {
+			--opStringIndex;
+			opString[opStringIndex] = 'D';
+			--MaxValueCol;
+		}
+
+		while (MaxValueRow > 0) {
+			--opStringIndex;
+			opString[opStringIndex] = 'I';
+			--MaxValueRow;
+		}
+
+		*OperationString = opString + opStringIndex;
+		*OperationStringLen = opStringMax - opStringIndex;
+	}
+
+	return ret;
+}
+
+
+/** Computes the alignment of ssw_clever() keeping only two rows of scores and packed traceback steps.
+    If Bandwidth is nonzero, only cells at most Bandwidth diagonals away from the main one are filled;
+    the others take no part in the row and column maxima, as if they scored minus infinity. The traceback
+    never leaves the band. Deviation receives the largest distance of the traceback from the main
+    diagonal. */
+static ERR_VALUE _ssw_scalar_pass(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const size_t Bandwidth, const char **OperationString, size_t *OperationStringLen, size_t *Deviation)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+	const size_t width = (Bandwidth > 0) ? 2 * Bandwidth + 1 : ALen + 1;
+	const size_t stepCount = (BLen + 1)*width;
+	uint8_t *steps = NULL;
+	int32_t *rows = NULL;
+	int32_t *prevRow = NULL;
+	int32_t *curRow = NULL;
+	int32_t *colMaxes = NULL;
+	int32_t *tmp = NULL;
+	int32_t maxValue = 0;
+	size_t maxValueRow = 0;
+	size_t maxValueCol = 0;
+
+	ret = ssw_buffer_reserve(&Context->Steps, (stepCount + 3) / 4);
+	if (ret == ERR_SUCCESS) {
+		ret = ssw_buffer_reserve(&Context->Scores, (2 * width + ALen + 1)*sizeof(int32_t));
+		if (ret == ERR_SUCCESS) {
+			steps = (uint8_t *)Context->Steps.Data;
+			rows = (int32_t *)Context->Scores.Data;
+			memset(steps, 0, (stepCount + 3) / 4);
+			memset(rows, 0, (2 * width + ALen + 1)*sizeof(int32_t));
+			prevRow = rows;
+			curRow = prevRow + width;
+			colMaxes = curRow + width;
+			for (size_t i = 1; i <= BLen; ++i) {
+				const size_t jLow = (Bandwidth > 0 && i > Bandwidth) ? i - Bandwidth : 1;
+				const size_t jHigh = (Bandwidth > 0) ? min(ALen, i + Bandwidth) : ALen;
+				/* Column of cell j within the row, and of the diagonal predecessor within the previous row
+				   (modulo size_t arithmetic within a band). */
+				const size_t shift = (Bandwidth > 0) ? Bandwidth - i : 0;
+				const int32_t *diagRow = (Bandwidth > 0) ? prevRow : prevRow - 1;
+				const size_t rowIndex = _packed_step_index(width, Bandwidth, i, 0);
+				const char b = B[i - 1];
+				/* Every score is at least zero, so a zero maximum starts no gap, like one of minus infinity;
+				   columns entering the band start from the zero they were initialized to. */
+				int32_t rowMax = 0;
+
+				if (Bandwidth > 0)
+					memset(curRow, 0, width*sizeof(int32_t));
+
+				for (size_t j = jLow; j <= jHigh; ++j) {
+					const size_t d = j + shift;
+					const boolean matches = (b == A[j - 1]);
+					const int32_t diag = max(0, diagRow[d] + ((matches) ? Match : Mismatch));
+					const int32_t left = max(0, rowMax + Indel);
+					const int32_t up = max(0, colMaxes[j] + Indel);
+					const int32_t newValue = max(max(up, left), diag);
+					const size_t index = rowIndex + j;
+
+					curRow[d] = newValue;
+					if (newValue > up)
+						colMaxes[j] = newValue;
+
+					if (newValue > left)
+						rowMax = newValue;
+
+					_packed_step_set(steps, index, (newValue == diag) ? psDiag : ((newValue == left) ? psLeft : psUp));
+
+					_update_maximum_cell(maxValueRow, maxValueCol, maxValue, i, j, newValue);
+				}
+
+				tmp = prevRow;
+				prevRow = curRow;
+				curRow = tmp;
+			}
+
+			ret = _op_string_from_packed_steps(Context, A, B, steps, width, Bandwidth, maxValueRow, maxValueCol, OperationString, OperationStringLen, Deviation);
+		}
+	}
+
+	return ret;
+}
+
+
+/** Packed steps of at most this many cells are kept by the linear-space traceback (1 MB). */
+#define SSW_LINEAR_BLOCK_CELLS				((size_t)1 << 22)
+/** Saved scores of the rows a group of rows is split at, at most this many (8 MB). */
+#define SSW_LINEAR_STATE_CELLS				((size_t)1 << 21)
+
+
+/** Advances the scores of row First (Scores and ColMaxes, columns 0..ALen) to row Last by the recurrences
+    of _ssw_scalar_pass(). Packed steps of rows First + 1..Last are stored into Steps (zeroed by the caller)
+    unless it is NULL, the maximum cell is tracked unless MaxValue is NULL. */
+static void _ssw_linear_rows(const char *A, const size_t ALen, const char *B, const size_t First, const size_t Last, const int Match, const int Mismatch, const int Indel, int32_t *Scores, int32_t *ColMaxes, uint8_t *Steps, int32_t *MaxValue, size_t *MaxRow, size_t *MaxCol)
+{
+	for (size_t i = First + 1; i <= Last; ++i) {
+		const char b = B[i - 1];
+		const size_t rowIndex = (i - First - 1)*(ALen + 1);
+		int32_t diagScore = Scores[0];
+		int32_t rowMax = 0;
+
+		for (size_t j = 1; j <= ALen; ++j) {
+			const boolean matches = (b == A[j - 1]);
+			const int32_t diag = max(0, diagScore + ((matches) ? Match : Mismatch));
+			const int32_t left = max(0, rowMax + Indel);
+			const int32_t up = max(0, ColMaxes[j] + Indel);
+			const int32_t newValue = max(max(up, left), diag);
+
+			diagScore = Scores[j];
+			Scores[j] = newValue;
+			if (newValue > up)
+				ColMaxes[j] = newValue;
+
+			if (newValue > left)
+				rowMax = newValue;
+
+			if (Steps != NULL)
+				_packed_step_set(Steps, rowIndex + j, (newValue == diag) ? psDiag : ((newValue == left) ? psLeft : psUp));
+
+			if (MaxValue != NULL)
+				_update_maximum_cell(*MaxRow, *MaxCol, *MaxValue, i, j, newValue);
+		}
+	}
+
+	return;
+}
+
+
+/** Follows the path through rows First + 1..Last, whose scores are computed from those of row First.
+    Groups of rows with too many cells are split, the scores at the split rows are saved by one pass and
+    the parts are processed from the last one. If MaxValue is not NULL, the rows are First = 0..B length,
+    the pass also finds the maximum cell and the path starts there. */
+static ERR_VALUE _ssw_linear_traceback(PSSW_LINEAR_TRACEBACK Traceback, const int32_t *Scores, const int32_t *ColMaxes, const size_t First, const size_t Last, int32_t *MaxValue)
+{
+	const size_t cols = Traceback->Cols;
+	const size_t rows = Last - First;
+	size_t parts = 0;
+	size_t partFirst = 0;
+	size_t partLast = 0;
+	size_t index = 0;
+	int32_t *states = NULL;
+	int32_t *state = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (rows*(cols + 1) <= SSW_LINEAR_BLOCK_CELLS)
+		parts = 1;
+	else {
+		parts = (rows*(cols + 1) + SSW_LINEAR_BLOCK_CELLS - 1) / SSW_LINEAR_BLOCK_CELLS;
+		parts = min(parts, max(SSW_LINEAR_STATE_CELLS / (2 * (cols + 1)), 2));
+	}
+
+	/* One more state holds the scores of the last part while looking for the maximum cell. */
+	ret = utils_malloc((parts + 1) * 2 * (cols + 1)*sizeof(int32_t), (void **)&states);
+	if (ret == ERR_SUCCESS) {
+		memcpy(states, Scores, (cols + 1)*sizeof(int32_t));
+		memcpy(states + cols + 1, ColMaxes, (cols + 1)*sizeof(int32_t));
+		if (parts == 1) {
+			memset(Traceback->Steps, 0, (rows*(cols + 1) + 3) / 4);
+			_ssw_linear_rows(Traceback->A, cols, Traceback->B, First, Last, Traceback->Match, Traceback->Mismatch, Traceback->Indel, states, states + cols + 1, Traceback->Steps, MaxValue, &Traceback->Row, &Traceback->Col);
+			while (Traceback->Row > First && Traceback->Col > 0) {
+				index = (Traceback->Row - First - 1)*(cols + 1) + Traceback->Col;
+				--Traceback->OpStringIndex;
+				switch (_packed_step_get(Traceback->Steps, index)) {
+					case psDiag:
+						Traceback->OpString[Traceback->OpStringIndex] = (Traceback->A[Traceback->Col - 1] == Traceback->B[Traceback->Row - 1]) ? 'M' : 'X';
+						--Traceback->Col;
+						--Traceback->Row;
+						break;
+					case psLeft:
+						Traceback->OpString[Traceback->OpStringIndex] = 'D';
+						--Traceback->Col;
+						break;
+					case psUp:
+						Traceback->OpString[Traceback->OpStringIndex] = 'I';
+						--Traceback->Row;
+						break;
+					default:
+						assert(FALSE);
+						break;
+				}
+			}
+		} else {
+			for (size_t k = 1; k < parts; ++k) {
+				state = states + k * 2 * (cols + 1);
+				memcpy(state, state - 2 * (cols + 1), 2 * (cols + 1)*sizeof(int32_t));
+				_ssw_linear_rows(Traceback->A, cols, Traceback->B, First + (k - 1)*rows / parts, First + k*rows / parts, Traceback->Match, Traceback->Mismatch, Traceback->Indel, state, state + cols + 1, NULL, MaxValue, &Traceback->Row, &Traceback->Col);
+			}
+
+			if (MaxValue != NULL) {
+				state = states + parts * 2 * (cols + 1);
+				memcpy(state, state - 2 * (cols + 1), 2 * (cols + 1)*sizeof(int32_t));
+				_ssw_linear_rows(Traceback->A, cols, Traceback->B, First + (parts - 1)*rows / parts, Last, Traceback->Match, Traceback->Mismatch, Traceback->Indel, state, state + cols + 1, NULL, MaxValue, &Traceback->Row, &Traceback->Col);
+				/* Columns right of the maximum cell do not influence the cells on the path. */
+				Traceback->Cols = Traceback->Col;
+			}
+
+			for (size_t k = parts; ret == ERR_SUCCESS && k > 0; --k) {
+				partFirst = First + (k - 1)*rows / parts;
+				partLast = First + k*rows / parts;
+				state = states + (k - 1) * 2 * (cols + 1);
+				if (Traceback->Row > partFirst && Traceback->Row <= partLast && Traceback->Col > 0)
+					ret = _ssw_linear_traceback(Traceback, state, state + cols + 1, partFirst, min(partLast, Traceback->Row), NULL);
+			}
+		}
+
+		utils_free(states);
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _ssw_copy_op_string(PSSW_CONTEXT Context, ERR_VALUE Result, const char *View, const size_t ViewLen, char **OperationString, size_t *OperationStringLen)
+{
+	ERR_VALUE ret = Result;
+	char *opString = NULL;
+
+	if (ret == ERR_SUCCESS) {
+		ret = utils_calloc_char(ViewLen + 1, &opString);
+		if (ret == ERR_SUCCESS) {
+			memcpy(opString, View, (ViewLen + 1)*sizeof(char));
+			*OperationString = opString;
+			*OperationStringLen = ViewLen;
+		}
+	}
+
+	ssw_context_finit(Context);
+
+	return ret;
+}
+
+
+static boolean _cpu_supports(const ESSWImplementation Implementation)
+{
+	boolean ret = FALSE;
+
+	switch (Implementation) {
+		case sswiScalar:
+			ret = TRUE;
+			break;
+		case sswiSSE41:
+			ret = utils_cpu_has_feature(ucfSSE41);
+			break;
+		case sswiAVX2:
+			ret = utils_cpu_has_feature(ucfAVX2);
+			break;
+		default:
+			ret = FALSE;
+			break;
+	}
+
+	return ret;
+}
+
+
+static const char *_implementationNames[sswiMax] = {
+	"scalar",
+	"SSE4.1",
+	"AVX2",
+};
+
+static ESSWImplementation _implementation = sswiScalar;
+static size_t _linearSpaceLength = SSW_LINEAR_SPACE_DEFAULT_LENGTH;
+
+/** Approximate ratio of the cell throughput of the striped kernels and of ssw_banded(). */
+#define SSW_BANDED_VECTOR_SPEEDUP			12
+/** Narrowest band of ssw_banded(); cells off narrower bands change the scores near the main diagonal too often. */
+#define SSW_BANDED_MIN_BANDWIDTH			16
+/** Shorter runs of pairs do not fill enough lanes of the inter-sequence kernels to beat the striped ones. */
+#define SSW_BATCH_MIN_PAIRS					8
+
+
 /************************************************************************/
 /*                       PUBLIC FUNCTIONS                               */
 /************************************************************************/
 
 
+void ssw_init(void)
+{
+	ESSWImplementation best = sswiScalar;
+
+	for (int i = sswiScalar; i < sswiMax; ++i) {
+		if (_cpu_supports((ESSWImplementation)i))
+			best = (ESSWImplementation)i;
+	}
+
+	_implementation = best;
+
+	return;
+}
+
+
+ESSWImplementation ssw_implementation(void)
+{
+	return _implementation;
+}
+
+
+const char *ssw_implementation_name(const ESSWImplementation Implementation)
+{
+	return (Implementation < sswiMax) ? _implementationNames[Implementation] : "unknown";
+}
+
+
+boolean ssw_set_implementation(const ESSWImplementation Implementation)
+{
+	boolean ret = FALSE;
+
+	ret = (Implementation < sswiMax && _cpu_supports(Implementation));
+	if (ret)
+		_implementation = Implementation;
+
+	return ret;
+}
+
+
+size_t ssw_linear_space_length(void)
+{
+	return _linearSpaceLength;
+}
+
+
+void ssw_set_linear_space_length(const size_t Length)
+{
+	_linearSpaceLength = Length;
+
+	return;
+}
+
+
 ERR_VALUE ssw_simple(const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, char **OperationString, size_t *OperationStringLen)
 {
 	ERR_VALUE ret = ERR_INTERNAL_ERROR;
@@ -238,27 +634,75 @@ ERR_VALUE ssw_simple(const char *A, const size_t ALen, const char *B, const size
 }
 
 
-ERR_VALUE ssw_clever(const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, char **OperationString, size_t *OperationStringLen)
+void ssw_context_init(PSSW_CONTEXT Context)
+{
+	memset(Context, 0, sizeof(SSW_CONTEXT));
+
+	return;
+}
+
+
+void ssw_context_finit(PSSW_CONTEXT Context)
+{
+	if (Context->Scores.Data != NULL)
+		utils_free(Context->Scores.Data);
+
+	if (Context->Steps.Data != NULL)
+		utils_free(Context->Steps.Data);
+
+	if (Context->Profile.Data != NULL)
+		utils_free(Context->Profile.Data);
+
+	if (Context->OpString.Data != NULL)
+		utils_free(Context->OpString.Data);
+
+	if (Context->OpStrings.Data != NULL)
+		utils_free(Context->OpStrings.Data);
+
+	memset(Context, 0, sizeof(SSW_CONTEXT));
+
+	return;
+}
+
+
+/** Makes the buffer at least Size bytes long. The buffer never shrinks and its content is not preserved. */
+ERR_VALUE ssw_buffer_reserve(PSSW_BUFFER Buffer, const size_t Size)
 {
 	ERR_VALUE ret = ERR_INTERNAL_ERROR;
-	int32_t *matrix = NULL;
-	EMatrixStep *steps = NULL;
-	size_t rows = BLen + 1;
-	size_t cols = ALen + 1;
-	int32_t maxValue = 0;
-	size_t maxValueRow = 0;
-	size_t maxValueCol = 0;
-	int32_t *rowMaxes = NULL;
-	int32_t *colMaxes = NULL;
+	void *data = NULL;
+	size_t newSize = 0;
+
+	ret = ERR_SUCCESS;
+	if (Size > Buffer->Size) {
+		newSize = max(Size, 2 * Buffer->Size);
+		ret = utils_malloc(newSize, &data);
+		if (ret == ERR_SUCCESS) {
+			if (Buffer->Data != NULL)
+				utils_free(Buffer->Data);
+
+			Buffer->Data = data;
+			Buffer->Size = newSize;
+		}
+	}
+
+	return ret;
+}
+
+
+ERR_VALUE ssw_clever_ctx(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+	size_t deviation = 0;
 
 	if (ALen == 0 || BLen == 0) {
 		char *tmpOpString = NULL;
 		size_t tmpOpStringLen = max(ALen, BLen);
 
-		ret = utils_calloc_char(tmpOpStringLen + 1, &tmpOpString);
+		ret = ssw_buffer_reserve(&Context->OpString, tmpOpStringLen + 1);
 		if (ret == ERR_SUCCESS) {
 			char zn = (ALen == 0) ? 'I' : 'D';
-			
+
+			tmpOpString = (char *)Context->OpString.Data;
 			tmpOpString[tmpOpStringLen] = '\0';
 			for (size_t i = 0; i < tmpOpStringLen; ++i)
 				tmpOpString[i] = zn;
@@ -270,44 +714,209 @@ ERR_VALUE ssw_clever(const char *A, const size_t ALen, const char *B, const size
 		return ret;
 	}
 
-	ret = utils_calloc_int32_t(rows*cols, &matrix);
+	if (_linearSpaceLength > 0 && max(ALen, BLen) > _linearSpaceLength)
+		return ssw_clever_linear_ctx(Context, A, ALen, B, BLen, Match, Mismatch, Indel, OperationString, OperationStringLen);
+
+	if (_implementation != sswiScalar && ssw_striped_supported(ALen, BLen, Match, Mismatch, Indel)) {
+		ret = (_implementation == sswiAVX2) ?
+			ssw_striped_avx2(Context, A, ALen, B, BLen, Match, Mismatch, Indel, OperationString, OperationStringLen) :
+			ssw_striped_sse41(Context, A, ALen, B, BLen, Match, Mismatch, Indel, OperationString, OperationStringLen);
+		if (ret != ERR_NOT_IMPLEMENTED)
+			return ret;
+	}
+
+	ret = _ssw_scalar_pass(Context, A, ALen, B, BLen, Match, Mismatch, Indel, 0, OperationString, OperationStringLen, &deviation);
+
+	return ret;
+}
+
+
+ERR_VALUE ssw_clever_linear_ctx(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen)
+{
+	SSW_LINEAR_TRACEBACK traceback;
+	int32_t *rows = NULL;
+	int32_t maxValue = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	if (ALen == 0 || BLen == 0)
+		return ssw_clever_ctx(Context, A, ALen, B, BLen, Match, Mismatch, Indel, OperationString, OperationStringLen);
+
+	ret = ssw_buffer_reserve(&Context->Scores, 2 * (ALen + 1)*sizeof(int32_t));
+	if (ret == ERR_SUCCESS)
+		ret = ssw_buffer_reserve(&Context->Steps, (SSW_LINEAR_BLOCK_CELLS + 3) / 4);
+
+	if (ret == ERR_SUCCESS)
+		ret = ssw_buffer_reserve(&Context->OpString, ALen + BLen + 1);
+
 	if (ret == ERR_SUCCESS) {
-		ret = utils_calloc_EMatrixStep(rows*cols, &steps);
+		rows = (int32_t *)Context->Scores.Data;
+		memset(rows, 0, 2 * (ALen + 1)*sizeof(int32_t));
+		memset(&traceback, 0, sizeof(traceback));
+		traceback.A = A;
+		traceback.B = B;
+		traceback.Match = Match;
+		traceback.Mismatch = Mismatch;
+		traceback.Indel = Indel;
+		traceback.Cols = ALen;
+		traceback.Steps = (uint8_t *)Context->Steps.Data;
+		traceback.OpString = (char *)Context->OpString.Data;
+		traceback.OpStringIndex = ALen + BLen;
+		traceback.OpString[traceback.OpStringIndex] = '\0';
+		ret = _ssw_linear_traceback(&traceback, rows, rows + ALen + 1, 0, BLen, &maxValue);
 		if (ret == ERR_SUCCESS) {
-			ret = utils_calloc_int32_t(cols + rows, &rowMaxes);
-			if (ret == ERR_SUCCESS) {
-				colMaxes = rowMaxes + rows;
-				memset(rowMaxes, 0, (cols + rows)*sizeof(int32_t));
-				for (size_t j = 0; j < cols; ++j) {
-					item_2d(matrix, cols, 0, j) = 0;
-					item_2d(steps, cols, 0, j) = msNone;
-				}
+			while (traceback.Col > 0) {
+				traceback.OpString[--traceback.OpStringIndex] = 'D';
+				--traceback.Col;
+			}
 
-				for (size_t i = 0; i < rows; ++i) {
-					item_2d(matrix, cols, i, 0) = 0;
-					item_2d(steps, cols, i, 0) = msNone;
-				}
+			while (traceback.Row > 0) {
+				traceback.OpString[--traceback.OpStringIndex] = 'I';
+				--traceback.Row;
+			}
 
-				--A;
-				--B;
-				for (size_t i = 1; i < rows; ++i) {
-					for (size_t j = 1; j < cols; ++j) {
-						int32_t newValue = 0;
-						
-						_compute_one_cell(matrix, A, B, steps, i, j, cols, Match, Mismatch, Indel, rowMaxes, colMaxes, newValue);
-						_update_maximum_cell(maxValueRow, maxValueCol, maxValue, i, j, newValue);
-					}
-				}
+			*OperationString = traceback.OpString + traceback.OpStringIndex;
+			*OperationStringLen = ALen + BLen - traceback.OpStringIndex;
+		}
+	}
 
-				ret = _op_string_from_step_matrix(steps, cols, maxValueRow, maxValueCol, OperationString, OperationStringLen);
-				utils_free(rowMaxes);
-			}
+	return ret;
+}
 
-			utils_free(steps);
+
+/** Aligns B to A like ssw_clever() but fills only a band of cells around the main diagonal, for sequences
+    that are already placed at the right position. The band is at least SSW_BANDED_MIN_BANDWIDTH diagonals
+    wide; it is doubled and the alignment recomputed while the traceback leaves its inner half. MaxCells
+    (0 = no limit) bounds the number of cells computed over all passes; when a wider band does not fit, the
+    last result is kept, and ERR_TOO_COMPLEX is returned when even the first pass does not fit.
+
+    Gaps starting off the band are not seen inside it, so the scores near the boundary may be lower than
+    those of ssw_clever(). The outer half of the band keeps such cells away from the path; the result then
+    equals that of ssw_clever() except for rare sequences with high-scoring alignments just off the band.
+    A kept result from a band that was too narrow may end at the band boundary. */
+ERR_VALUE ssw_banded_ctx(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const size_t Bandwidth, const size_t MaxCells, const char **OperationString, size_t *OperationStringLen)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+	const size_t maxBandwidth = max(ALen, BLen);
+	/* Once the band covers a large part of the matrix, computing the full matrix is cheaper; the vectorized
+	   implementations process cells about SSW_BANDED_VECTOR_SPEEDUP times faster than the banded loop. */
+	const size_t fullBandwidth = ALen / ((_implementation == sswiScalar) ? 2 : 2 * SSW_BANDED_VECTOR_SPEEDUP);
+	size_t bandwidth = max(Bandwidth, SSW_BANDED_MIN_BANDWIDTH);
+	size_t cells = 0;
+	size_t passCells = 0;
+	boolean full = FALSE;
+	size_t deviation = 0;
+	boolean widen = TRUE;
+	const char *opString = NULL;
+	size_t opStringLen = 0;
+
+	if (ALen == 0 || BLen == 0)
+		bandwidth = maxBandwidth;
+
+	ret = ERR_SUCCESS;
+	while (ret == ERR_SUCCESS && widen) {
+		full = (bandwidth >= maxBandwidth ||
+			(bandwidth >= fullBandwidth && (MaxCells == 0 || cells + ALen*BLen <= MaxCells)));
+		passCells = (full) ? ALen*BLen : BLen*min(ALen, 2 * bandwidth + 1);
+		if (MaxCells > 0 && cells + passCells > MaxCells) {
+			if (opString == NULL)
+				ret = ERR_TOO_COMPLEX;
+
+			break;
 		}
 
-		utils_free(matrix);
+		if (!full)
+			ret = _ssw_scalar_pass(Context, A, ALen, B, BLen, Match, Mismatch, Indel, bandwidth, &opString, &opStringLen, &deviation);
+		else ret = ssw_clever_ctx(Context, A, ALen, B, BLen, Match, Mismatch, Indel, &opString, &opStringLen);
+
+		widen = (!full && deviation > bandwidth / 2);
+
+		cells += passCells;
+		bandwidth = min(2 * bandwidth, maxBandwidth);
 	}
 
+	if (ret == ERR_SUCCESS) {
+		*OperationString = opString;
+		*OperationStringLen = opStringLen;
+	}
+
+	return ret;
+}
+
+
+ERR_VALUE ssw_clever_batch(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, const char **OperationStrings, size_t *OperationStringLens)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+	char *output = NULL;
+	size_t total = 0;
+	size_t index = 0;
+	size_t groupSize = 0;
+	size_t groupLen = 0;
+	const char *opString = NULL;
+
+	for (size_t i = 0; i < Count; ++i)
+		total += ALens[i] + BLens[i] + 1;
+
+	/* The buffer is reserved at once, so the operation strings stored so far do not move. */
+	ret = ssw_buffer_reserve(&Context->OpStrings, total);
+	if (ret == ERR_SUCCESS) {
+		output = (char *)Context->OpStrings.Data;
+		while (ret == ERR_SUCCESS && index < Count) {
+			groupSize = 0;
+			groupLen = 0;
+			while (_implementation != sswiScalar && groupSize < SSW_BATCH_MAX_LANES && index + groupSize < Count &&
+				ssw_batch_supported(ALens[index + groupSize], BLens[index + groupSize], Match, Mismatch, Indel)) {
+				groupLen += ALens[index + groupSize] + BLens[index + groupSize] + 1;
+				++groupSize;
+			}
+
+			if (groupSize >= SSW_BATCH_MIN_PAIRS) {
+				ret = (_implementation == sswiAVX2) ?
+					ssw_batch_avx2(Context, groupSize, A + index, ALens + index, B + index, BLens + index, Match, Mismatch, Indel, output, OperationStrings + index, OperationStringLens + index) :
+					ssw_batch_sse41(Context, groupSize, A + index, ALens + index, B + index, BLens + index, Match, Mismatch, Indel, output, OperationStrings + index, OperationStringLens + index);
+			} else {
+				groupSize = 1;
+				groupLen = ALens[index] + BLens[index] + 1;
+				ret = ssw_clever_ctx(Context, A[index], ALens[index], B[index], BLens[index], Match, Mismatch, Indel, &opString, OperationStringLens + index);
+				if (ret == ERR_SUCCESS) {
+					memcpy(output, opString, (OperationStringLens[index] + 1)*sizeof(char));
+					OperationStrings[index] = output;
+				}
+			}
+
+			output += groupLen;
+			index += groupSize;
+		}
+	}
+
+	return ret;
+}
+
+
+ERR_VALUE ssw_clever(const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, char **OperationString, size_t *OperationStringLen)
+{
+	SSW_CONTEXT context;
+	const char *view = NULL;
+	size_t viewLen = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ssw_context_init(&context);
+	ret = ssw_clever_ctx(&context, A, ALen, B, BLen, Match, Mismatch, Indel, &view, &viewLen);
+	ret = _ssw_copy_op_string(&context, ret, view, viewLen, OperationString, OperationStringLen);
+
+	return ret;
+}
+
+
+ERR_VALUE ssw_banded(const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const size_t Bandwidth, const size_t MaxCells, char **OperationString, size_t *OperationStringLen)
+{
+	SSW_CONTEXT context;
+	const char *view = NULL;
+	size_t viewLen = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ssw_context_init(&context);
+	ret = ssw_banded_ctx(&context, A, ALen, B, BLen, Match, Mismatch, Indel, Bandwidth, MaxCells, &view, &viewLen);
+	ret = _ssw_copy_op_string(&context, ret, view, viewLen, OperationString, OperationStringLen);
+
 	return ret;
 }
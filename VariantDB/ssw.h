@@ -4,6 +4,7 @@
 
 
 #include "err.h"
+#include "utils.h"
 
 
 typedef struct _SSW_STATISTICS {
@@ -24,8 +25,67 @@ typedef enum _EGapType {
 } EGapType, *PEGapType;
 
 
+/** Implementations of ssw_clever(), in the order of preference. */
+typedef enum _ESSWImplementation {
+	sswiScalar,
+	sswiSSE41,
+	sswiAVX2,
+	sswiMax,
+} ESSWImplementation, *PESSWImplementation;
+
+
 ERR_VALUE ssw_simple(const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, char **OperationString, size_t *OperationStringLen);
+/** Grow-only buffer of an alignment context. */
+typedef struct _SSW_BUFFER {
+	void *Data;
+	size_t Size;
+} SSW_BUFFER, *PSSW_BUFFER;
+
+/** Scratch memory of the alignment functions, reused across calls. Every thread aligning reads owns its
+    own context; operation strings returned by the *_ctx functions point into the context and remain valid
+    until its next use. */
+typedef struct _SSW_CONTEXT {
+	SSW_BUFFER Scores;
+	SSW_BUFFER Steps;
+	SSW_BUFFER Profile;
+	SSW_BUFFER OpString;
+	/** Operation strings of ssw_clever_batch(), kept until its next call. */
+	SSW_BUFFER OpStrings;
+} SSW_CONTEXT, *PSSW_CONTEXT;
+
+
+/** Selects the fastest implementation of ssw_clever() the CPU supports. Until called, the scalar one is used. */
+void ssw_init(void);
+ESSWImplementation ssw_implementation(void);
+const char *ssw_implementation_name(const ESSWImplementation Implementation);
+/** Returns FALSE if the CPU does not support the implementation. */
+boolean ssw_set_implementation(const ESSWImplementation Implementation);
+
+/** ssw_clever_ctx() aligns sequences longer than this by ssw_clever_linear_ctx() (0 = never). */
+#define SSW_LINEAR_SPACE_DEFAULT_LENGTH		10000
+
+size_t ssw_linear_space_length(void);
+void ssw_set_linear_space_length(const size_t Length);
+
+void ssw_context_init(PSSW_CONTEXT Context);
+void ssw_context_finit(PSSW_CONTEXT Context);
+ERR_VALUE ssw_buffer_reserve(PSSW_BUFFER Buffer, const size_t Size);
+
+ERR_VALUE ssw_clever_ctx(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen);
+/** Computes the alignment of ssw_clever_ctx() in memory linear in the sequence lengths; the traceback
+    recomputes the rows it passes through from scores saved at some of the rows, so the time is about three
+    times that of the scalar implementation. */
+ERR_VALUE ssw_clever_linear_ctx(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const char **OperationString, size_t *OperationStringLen);
+/** Banded alignment for sequences placed at the right position; the result may differ from that of
+    ssw_clever_ctx() (see ssw.c). */
+ERR_VALUE ssw_banded_ctx(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const size_t Bandwidth, const size_t MaxCells, const char **OperationString, size_t *OperationStringLen);
+/** Computes Count alignments of ssw_clever_ctx(), pairs A[i] and B[i]. Runs of consecutive short pairs are
+    aligned by the inter-sequence kernels, many pairs at once. Operation strings are valid until the next call
+    of ssw_clever_batch() with the context; other functions do not overwrite them. */
+ERR_VALUE ssw_clever_batch(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const int Match, const int Mismatch, const int Indel, const char **OperationStrings, size_t *OperationStringLens);
+/** Variants allocating the operation string; the caller frees it by utils_free(). */
 ERR_VALUE ssw_clever(const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, char **OperationString, size_t *OperationStringLen);
+ERR_VALUE ssw_banded(const char *A, const size_t ALen, const char *B, const size_t BLen, const int Match, const int Mismatch, const int Indel, const size_t Bandwidth, const size_t MaxCells, char **OperationString, size_t *OperationStringLen);
 
 
 
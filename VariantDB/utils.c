@@ -10,6 +10,9 @@
 #ifdef WIN32
 #include <windows.h>
 #endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 #include "err.h"
 #include "utils.h"
 
@@ -368,3 +371,45 @@ size_t utils_pow_mod(const size_t Base, const size_t Power, const size_t Modulus
 	return ret;
 }
 
+
+boolean utils_cpu_has_feature(const EUtilsCPUFeature Feature)
+{
+	boolean ret = FALSE;
+#if defined(_M_X64) || defined(_M_IX86)
+	int info[4];
+	int maxLeaf = 0;
+
+	__cpuid(info, 0);
+	maxLeaf = info[0];
+	__cpuid(info, 1);
+	switch (Feature) {
+		case ucfSSE2:
+			ret = ((info[3] & (1 << 26)) != 0);
+			break;
+		case ucfSSE41:
+			ret = ((info[2] & (1 << 19)) != 0);
+			break;
+		case ucfAVX2:
+			if (maxLeaf >= 7 && (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6) {
+				__cpuidex(info, 7, 0);
+				ret = ((info[1] & (1 << 5)) != 0);
+			}
+			break;
+	}
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	switch (Feature) {
+		case ucfSSE2:
+			ret = (__builtin_cpu_supports("sse2") != 0);
+			break;
+		case ucfSSE41:
+			ret = (__builtin_cpu_supports("sse4.1") != 0);
+			break;
+		case ucfAVX2:
+			ret = (__builtin_cpu_supports("avx2") != 0);
+			break;
+	}
+#endif
+
+	return ret;
+}
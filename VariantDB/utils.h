@@ -68,6 +68,15 @@ size_t utils_next_prime(const size_t Number);
 ERR_VALUE utils_mul_inverse(const size_t Number, const size_t Modulus, size_t *Result);
 size_t utils_pow_mod(const size_t Base, const size_t Power, const size_t Modulus);
 
+/** Instruction set extensions that vectorized code paths can use. */
+typedef enum _EUtilsCPUFeature {
+	ucfSSE2,
+	ucfSSE41,
+	ucfAVX2,
+} EUtilsCPUFeature, *PEUtilsCPUFeature;
+
+boolean utils_cpu_has_feature(const EUtilsCPUFeature Feature);
+
 ERR_VALUE _utils_malloc(const size_t Size, void **Address);
 ERR_VALUE _utils_calloc(const size_t Count, const size_t Size, void **Address);
 void _utils_free(void *Address);
@@ -6,7 +6,11 @@
 #include "options.h"
 #include "khash.h"
 #include "input-file.h"
+#include "bgzf.h"
 #include "ssw.h"
+#include "ssw-myers.h"
+#include "read-kernels.h"
+#include "ssw-benchmark.h"
 #include "variantdb.h"
 
 
@@ -21,6 +25,18 @@ static boolean _help = FALSE;
 static boolean _verbose = FALSE;
 static boolean _noNormalization = FALSE;
 static uint32_t _maxMs = 1;
+static uint32_t _threads = 1;
+static uint8_t _minMapQ = INPUT_READ_DEFAULT_MIN_MAPQ;
+static uint16_t _flagMask = INPUT_READ_DEFAULT_FLAG_MASK;
+static boolean _useCigar = FALSE;
+static uint32_t _realignDistance = 10;
+static boolean _benchmarkKernels = FALSE;
+static uint32_t _bandwidth = 0;
+static uint32_t _maxCells = 4000000;
+static uint32_t _ungappedMismatches = 0;
+static boolean _benchmarkAlignment = FALSE;
+static uint32_t _screenDistance = 0;
+static uint32_t _linearSpaceLength = SSW_LINEAR_SPACE_DEFAULT_LENGTH;
 
 
 static void _cmd_option_init(void)
@@ -36,6 +52,18 @@ static void _cmd_option_init(void)
 	CMD_OPTION_INIT(VDB_OPTION_VERBOSE, Boolean, FALSE);
 	CMD_OPTION_INIT(VDB_OPTION_DONT_NORMALIZE, Boolean, FALSE);
 	CMD_OPTION_INIT(VDB_OPTION_MAX_MS, UInt32, 1);
+	CMD_OPTION_INIT(VDB_OPTION_THREADS, UInt32, 1);
+	CMD_OPTION_INIT(VDB_OPTION_MIN_MAPQ, UInt8, INPUT_READ_DEFAULT_MIN_MAPQ);
+	CMD_OPTION_INIT(VDB_OPTION_FLAG_MASK, UInt16, INPUT_READ_DEFAULT_FLAG_MASK);
+	CMD_OPTION_INIT(VDB_OPTION_USE_CIGAR, Boolean, FALSE);
+	CMD_OPTION_INIT(VDB_OPTION_REALIGN_DISTANCE, UInt32, 10);
+	CMD_OPTION_INIT(VDB_OPTION_BENCHMARK_KERNELS, Boolean, FALSE);
+	CMD_OPTION_INIT(VDB_OPTION_BANDWIDTH, UInt32, 0);
+	CMD_OPTION_INIT(VDB_OPTION_MAX_CELLS, UInt32, 4000000);
+	CMD_OPTION_INIT(VDB_OPTION_UNGAPPED_MISMATCHES, UInt32, 0);
+	CMD_OPTION_INIT(VDB_OPTION_BENCHMARK_ALIGNMENT, Boolean, FALSE);
+	CMD_OPTION_INIT(VDB_OPTION_SCREEN_DISTANCE, UInt32, 0);
+	CMD_OPTION_INIT(VDB_OPTION_LINEAR_SPACE_LENGTH, UInt32, SSW_LINEAR_SPACE_DEFAULT_LENGTH);
 
 	return;
 }
@@ -54,7 +82,19 @@ static ERR_VALUE _cmd_optiion_parse(void)
 	CMD_OPTION_GET(VDB_OPTION_VERBOSE, Boolean, &_verbose);
 	CMD_OPTION_GET(VDB_OPTION_DONT_NORMALIZE, Boolean, &_noNormalization);
 	CMD_OPTION_GET(VDB_OPTION_MAX_MS, UInt32, &_maxMs);
-	if (_help)
+	CMD_OPTION_GET(VDB_OPTION_THREADS, UInt32, &_threads);
+	CMD_OPTION_GET(VDB_OPTION_MIN_MAPQ, UInt8, &_minMapQ);
+	CMD_OPTION_GET(VDB_OPTION_FLAG_MASK, UInt16, &_flagMask);
+	CMD_OPTION_GET(VDB_OPTION_USE_CIGAR, Boolean, &_useCigar);
+	CMD_OPTION_GET(VDB_OPTION_REALIGN_DISTANCE, UInt32, &_realignDistance);
+	CMD_OPTION_GET(VDB_OPTION_BENCHMARK_KERNELS, Boolean, &_benchmarkKernels);
+	CMD_OPTION_GET(VDB_OPTION_BANDWIDTH, UInt32, &_bandwidth);
+	CMD_OPTION_GET(VDB_OPTION_MAX_CELLS, UInt32, &_maxCells);
+	CMD_OPTION_GET(VDB_OPTION_UNGAPPED_MISMATCHES, UInt32, &_ungappedMismatches);
+	CMD_OPTION_GET(VDB_OPTION_BENCHMARK_ALIGNMENT, Boolean, &_benchmarkAlignment);
+	CMD_OPTION_GET(VDB_OPTION_SCREEN_DISTANCE, UInt32, &_screenDistance);
+	CMD_OPTION_GET(VDB_OPTION_LINEAR_SPACE_LENGTH, UInt32, &_linearSpaceLength);
+	if (_help || _benchmarkKernels || _benchmarkAlignment)
 		return ERR_SUCCESS;
 
 	if (*_refFile == '\0') {
@@ -75,6 +115,16 @@ static ERR_VALUE _cmd_optiion_parse(void)
 	if (*_bedFile == '\0')
 		fprintf(stderr, "[WARNING]: The BED file was not specified (--%s). Treating all regions as confident\n", VDB_OPTION_BED_FILE);
 
+	if (_ungappedMismatches > VDB_UNGAPPED_MAX_MISMATCHES) {
+		fprintf(stderr, "[ERROR]: At most %u mismatches can be accepted without alignment (--%s)\n", VDB_UNGAPPED_MAX_MISMATCHES, VDB_OPTION_UNGAPPED_MISMATCHES);
+		return ERR_INTERNAL_ERROR;
+	}
+
+	if (_screenDistance > VDB_UNGAPPED_MAX_MISMATCHES) {
+		fprintf(stderr, "[ERROR]: Reads at most %u edits away from the reference can skip the alignment (--%s)\n", VDB_UNGAPPED_MAX_MISMATCHES, VDB_OPTION_SCREEN_DISTANCE);
+		return ERR_INTERNAL_ERROR;
+	}
+
 	if (_regionStart >= _regionEnd) {
 		fprintf(stderr, "[ERROR]: The specified region (--%s, --%s) is not an interval\n", VDB_OPTION_START, VDB_OPTION_STOP);
 		return ERR_INTERNAL_ERROR;
@@ -89,6 +139,11 @@ static REFSEQ_DATA refData;
 static boolean _fastaLoaded = FALSE;
 static VCF_VARIANT_FILTER variantFilter;
 static CONFIDENT_REGION region;
+static INPUT_READ_OPTIONS readOptions;
+static INPUT_READ_BATCH readBatch;
+static SSW_CONTEXT alignContext;
+/** Arrays of _on_read_batch_callback(), reused by all batches. */
+static SSW_BUFFER batchBuffer;
 static GEN_ARRAY_VCF_VARIANT variants;
 static boolean _variantsLoaded = FALSE;
 static GEN_ARRAY_CONFIDENT_REGION confidentRegions;
@@ -100,13 +155,405 @@ khash_t(VariantTableType) *_variantTable = NULL;
 khash_t(VariantTableType) *_nearVariantTable = NULL;
 
 static size_t _readsProcessed = 0;
+static size_t _readsRealigned = 0;
+static size_t _readsReferenceMatching = 0;
+static size_t _readsSubstitutionsOnly = 0;
+static size_t _readsOverBudget = 0;
+static size_t _readsUngapped = 0;
+static size_t _readsScreened = 0;
 
-static ERR_VALUE _on_read_callback(const ONE_READ *Read, void *Context)
+
+/** Parses the next operation of a CIGAR string. Returns FALSE at its end or if it is malformed. */
+static boolean _cigar_next_op(const char **Cigar, uint32_t *Length, char *Op)
 {
+	const char *c = *Cigar;
+	uint32_t length = 0;
+	boolean ret = FALSE;
+
+	while (*c >= '0' && *c <= '9') {
+		length = length * 10 + (*c - '0');
+		++c;
+	}
+
+	ret = (c != *Cigar && *c != '\0');
+	if (ret) {
+		*Length = length;
+		*Op = *c;
+		*Cigar = c + 1;
+	}
+
+	return ret;
+}
+
+
+/** Checks whether a known variant lies within the realignment distance of the reference interval [Start, End]. */
+static boolean _known_variant_near(const uint64_t Start, const uint64_t End)
+{
+	const uint64_t first = (Start > _realignDistance) ? Start - _realignDistance : 0;
+	boolean ret = FALSE;
+
+	for (uint64_t pos = first; !ret && pos <= End + _realignDistance; ++pos)
+		ret = (kh_get(VariantTableType, _variantTable, pos) != kh_end(_variantTable));
+
+	return ret;
+}
+
+
+/** Decides whether the CIGAR of the read can replace its realignment. This is the case if the read was not
+    clipped to the region, its CIGAR describes the whole sequence within the reference, and none of its
+    indels and soft clips lies near a known variant. */
+static boolean _read_cigar_usable(const ONE_READ *Read)
+{
+	const char *cigar = (Read->Extension != NULL) ? Read->Extension->CIGAR : NULL;
+	uint64_t refPos = Read->Pos;
+	size_t readLength = 0;
+	uint32_t length = 0;
+	char op = '\0';
+	boolean ret = FALSE;
+
+	ret = (cigar != NULL && *cigar != '*' && *cigar != '\0' && Read->Offset == 0 && Read->Pos >= refData.StartPos);
+	while (ret && _cigar_next_op(&cigar, &length, &op)) {
+		switch (op) {
+			case 'M':
+			case '=':
+			case 'X':
+				readLength += length;
+				refPos += length;
+				break;
+			case 'I':
+			case 'S':
+				readLength += length;
+				ret = !_known_variant_near(refPos, refPos);
+				break;
+			case 'D':
+				ret = (length == 0 || !_known_variant_near(refPos, refPos + length - 1));
+				refPos += length;
+				break;
+			case 'H':
+			case 'P':
+				break;
+			default:
+				ret = FALSE;
+				break;
+		}
+	}
+
+	if (ret)
+		ret = (*cigar == '\0' && readLength == Read->ReadSequenceLen && refPos - refData.StartPos <= refData.Length);
+
+	return ret;
+}
+
+
+/** Builds the operation string (M, X, I, D and S for soft-clipped bases) of the read from its CIGAR, in the
+    format produced by the aligner. The string is stored in the alignment context. */
+static ERR_VALUE _op_string_from_cigar(PSSW_CONTEXT Context, const ONE_READ *Read, const char *Ref, const char **OpString, size_t *OpStringSize)
+{
+	const char *cigar = Read->Extension->CIGAR;
+	const char *readSeq = Read->ReadSequence;
+	char *opString = NULL;
+	size_t opStringSize = 0;
+	uint32_t length = 0;
+	char op = '\0';
 	ERR_VALUE ret = ERR_INTERNAL_ERROR;
-	const char *ref = refData.Sequence + Read->Pos - refData.StartPos;
+
+	while (_cigar_next_op(&cigar, &length, &op)) {
+		if (op != 'H' && op != 'P')
+			opStringSize += length;
+	}
+
+	ret = ssw_buffer_reserve(&Context->OpString, opStringSize + 1);
+	if (ret == ERR_SUCCESS) {
+		opString = (char *)Context->OpString.Data;
+		*OpString = opString;
+		*OpStringSize = opStringSize;
+		cigar = Read->Extension->CIGAR;
+		while (_cigar_next_op(&cigar, &length, &op)) {
+			switch (op) {
+				case 'M':
+				case '=':
+				case 'X':
+					for (uint32_t i = 0; i < length; ++i) {
+						*opString++ = (*readSeq == *Ref) ? 'M' : 'X';
+						++readSeq;
+						++Ref;
+					}
+					break;
+				case 'I':
+				case 'S':
+					memset(opString, op, length);
+					opString += length;
+					readSeq += length;
+					break;
+				case 'D':
+					memset(opString, 'D', length);
+					opString += length;
+					Ref += length;
+					break;
+			}
+		}
+
+		*opString = '\0';
+	}
+
+	return ret;
+}
+
+
+/** Builds the operation string of a read differing from the reference only by substitutions from its CIGAR and
+    MD tag, so the read sequence is not compared to the reference. */
+static ERR_VALUE _op_string_from_md(PSSW_CONTEXT Context, const ONE_READ *Read, const char **OpString, size_t *OpStringSize)
+{
+	const char *cigar = Read->Extension->CIGAR;
+	const char *md = Read->Extension->MD;
 	char *opString = NULL;
 	size_t opStringSize = 0;
+	uint32_t length = 0;
+	uint32_t matches = 0;
+	uint32_t bases = 0;
+	boolean deletion = FALSE;
+	boolean mismatch = FALSE;
+	char op = '\0';
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	while (_cigar_next_op(&cigar, &length, &op)) {
+		if (op != 'H')
+			opStringSize += length;
+	}
+
+	ret = ssw_buffer_reserve(&Context->OpString, opStringSize + 1);
+	if (ret == ERR_SUCCESS) {
+		opString = (char *)Context->OpString.Data;
+		*OpString = opString;
+		*OpStringSize = opStringSize;
+		cigar = Read->Extension->CIGAR;
+		while (_cigar_next_op(&cigar, &length, &op)) {
+			switch (op) {
+				case 'M':
+				case '=':
+				case 'X':
+					for (uint32_t i = 0; i < length; ++i) {
+						while (matches == 0 && !mismatch && read_md_next_item(&md, &matches, &deletion, &bases))
+							mismatch = (bases > 0);
+
+						if (matches > 0) {
+							*opString++ = 'M';
+							--matches;
+						} else {
+							*opString++ = 'X';
+							mismatch = FALSE;
+						}
+					}
+					break;
+				case 'S':
+					memset(opString, 'S', length);
+					opString += length;
+					break;
+			}
+		}
+
+		*opString = '\0';
+	}
+
+	return ret;
+}
+
+
+/** Counts[i] receives the number of positions K < Ends[i] + Offset of the read with Read[K] != Ref[K + Shift];
+    positions whose reference base lies outside of the read are not counted. Ends are in ascending order. */
+static void _shifted_mismatch_counts(const char *Read, const char *Ref, const int64_t Length, const int64_t Shift, const int64_t *Ends, const size_t EndCount, const int64_t Offset, int64_t *Counts)
+{
+	int64_t k = 0;
+	int64_t count = 0;
+
+	for (size_t i = 0; i < EndCount; ++i) {
+		for (; k < Ends[i] + Offset && k < Length; ++k) {
+			if (k + Shift >= 0 && k + Shift < Length && Read[k] != Ref[k + Shift])
+				++count;
+		}
+
+		Counts[i] = count;
+	}
+
+	return;
+}
+
+
+/** Tells whether the DP may prefer gaps to some of the Count mismatches of an ungapped read. Such an
+    alignment pairs the bases between an insertion and a deletion of Shift bases, placed at mismatches or
+    at the read ends, with the reference bases Shift positions away; in a homopolymer or a tandem repeat it
+    can score at least as much as the ungapped one. Each window starting and ending at a mismatch or a read
+    end is checked for both directions and all shifts that can pay for the gaps. Alignments with several
+    such gap pairs are not recognized. */
+static boolean _read_ungapped_ambiguous(const ONE_READ *Read, const char *Ref, const uint32_t *Positions, const size_t Count)
+{
+	boolean ret = FALSE;
+	const int64_t length = Read->ReadSequenceLen;
+	const size_t boundCount = Count + 2;
+	const int64_t maxShift = (int64_t)(3 * Count) / 2;
+	int64_t bounds[VDB_UNGAPPED_MAX_MISMATCHES + 2];
+	int64_t delayedStarts[VDB_UNGAPPED_MAX_MISMATCHES + 2];
+	int64_t delayedEnds[VDB_UNGAPPED_MAX_MISMATCHES + 2];
+	int64_t advancedStarts[VDB_UNGAPPED_MAX_MISMATCHES + 2];
+	int64_t advancedEnds[VDB_UNGAPPED_MAX_MISMATCHES + 2];
+
+	bounds[0] = 0;
+	for (size_t i = 0; i < Count; ++i)
+		bounds[i + 1] = Positions[i];
+
+	bounds[Count + 1] = length - 1;
+	for (int64_t shift = 1; !ret && shift <= maxShift; ++shift) {
+		/* Window [a, b] aligns Read[k] to Ref[k - shift] for k in [a + shift, b] (delayed), or to
+		   Ref[k + shift] for k in [a, b - shift] (advanced). */
+		_shifted_mismatch_counts(Read->ReadSequence, Ref, length, -shift, bounds, boundCount, shift, delayedStarts);
+		_shifted_mismatch_counts(Read->ReadSequence, Ref, length, -shift, bounds, boundCount, 1, delayedEnds);
+		_shifted_mismatch_counts(Read->ReadSequence, Ref, length, shift, bounds, boundCount, 0, advancedStarts);
+		_shifted_mismatch_counts(Read->ReadSequence, Ref, length, shift, bounds, boundCount, 1 - shift, advancedEnds);
+		for (size_t i = 0; !ret && i < boundCount; ++i) {
+			for (size_t j = i + 1; !ret && j < boundCount; ++j) {
+				/* Gaps at the read ends are free, the others cost one each; every mismatch turned into
+				   a match gains three. */
+				const int64_t gaps = (i > 0) + (j < Count + 1);
+				const int64_t mismatches = (int64_t)(j - i + 1) - (i == 0) - (j == Count + 1);
+				const int64_t delayed = delayedEnds[j] - delayedStarts[i];
+				const int64_t advanced = advancedEnds[j] - advancedStarts[i];
+
+				if (shift <= bounds[j] - bounds[i] + 1)
+					ret = (3 * (mismatches - delayed) >= 2 * shift + gaps || 3 * (mismatches - advanced) >= 2 * shift + gaps);
+			}
+		}
+	}
+
+	return ret;
+}
+
+
+/** Compares the read to the reference at its position without gaps. The read does not need to be aligned
+    if it matches the reference exactly, or if it differs by at most --ungapped-mismatches substitutions at
+    least VDB_UNGAPPED_MIN_SPACING bases apart for which _read_ungapped_ambiguous() finds no gapped
+    alternative. Positions receive the mismatches. */
+static boolean _read_ungapped(const ONE_READ *Read, const char *Ref, const size_t MaxMismatches, uint32_t *Positions, size_t *Count)
+{
+	boolean ret = FALSE;
+	size_t count = 0;
+
+	count = read_kernels_mismatches(Ref, Read->ReadSequence, Read->ReadSequenceLen, Positions, MaxMismatches);
+	ret = (count <= MaxMismatches);
+	for (size_t i = 1; ret && i < count; ++i)
+		ret = (Positions[i] - Positions[i - 1] >= VDB_UNGAPPED_MIN_SPACING);
+
+	if (ret && count > 0)
+		ret = !_read_ungapped_ambiguous(Read, Ref, Positions, count);
+
+	*Count = count;
+
+	return ret;
+}
+
+
+/** Result of _read_ungapped() for a read of a batch, computed by _on_read_batch_callback() before the batch
+    is aligned and passed to _on_read_callback(). */
+typedef struct _VDB_UNGAPPED_READ {
+	boolean Checked;
+	boolean Ungapped;
+	size_t MismatchCount;
+	const uint32_t *Mismatches;
+} VDB_UNGAPPED_READ, *PVDB_UNGAPPED_READ;
+
+
+/** Returns the result of _read_ungapped(), unless it is known already. */
+static boolean _read_ungapped_known(const ONE_READ *Read, const char *Ref, const VDB_UNGAPPED_READ *Known, uint32_t *Positions, size_t *Count)
+{
+	boolean ret = FALSE;
+
+	if (Known != NULL && Known->Checked) {
+		ret = Known->Ungapped;
+		*Count = Known->MismatchCount;
+		memcpy(Positions, Known->Mismatches, min(Known->MismatchCount, _ungappedMismatches)*sizeof(uint32_t));
+	} else ret = _read_ungapped(Read, Ref, _ungappedMismatches, Positions, Count);
+
+	return ret;
+}
+
+
+/** Computes the edit distance of the read to the reference at its position, which may end up to
+    --screen-distance bases past the read. Reads at most --screen-distance edits away whose edits are all
+    substitutions (spaced as in _read_ungapped()) need no alignment. Distance receives the edit distance,
+    0 if it could not be computed; it replaces --bandwidth as the initial band of the read. */
+static boolean _read_screen(PSSW_CONTEXT Context, const ONE_READ *Read, const char *Ref, uint32_t *Positions, size_t *Count, size_t *Distance)
+{
+	boolean ret = FALSE;
+	const uint64_t refEnd = refData.StartPos + refData.Length;
+	size_t refLen = Read->ReadSequenceLen;
+
+	if (Read->Pos + refLen < refEnd)
+		refLen = min(refLen + _screenDistance, refEnd - Read->Pos);
+
+	*Distance = 0;
+	if (ssw_myers_distance(Context, Ref, refLen, Read->ReadSequence, Read->ReadSequenceLen, Distance) != ERR_SUCCESS)
+		*Distance = 0;
+	else if (*Distance <= _screenDistance)
+		ret = _read_ungapped(Read, Ref, *Distance, Positions, Count);
+
+	return ret;
+}
+
+
+static ERR_VALUE _op_string_ungapped(PSSW_CONTEXT Context, const ONE_READ *Read, const uint32_t *Positions, const size_t Count, const char **OpString, size_t *OpStringSize)
+{
+	char *opString = NULL;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ssw_buffer_reserve(&Context->OpString, Read->ReadSequenceLen + 1);
+	if (ret == ERR_SUCCESS) {
+		opString = (char *)Context->OpString.Data;
+		memset(opString, 'M', Read->ReadSequenceLen);
+		opString[Read->ReadSequenceLen] = '\0';
+		for (size_t i = 0; i < Count; ++i)
+			opString[Positions[i]] = 'X';
+
+		*OpString = opString;
+		*OpStringSize = Read->ReadSequenceLen;
+	}
+
+	return ret;
+}
+
+
+/** Adds a read matching the reference to the coverage of the known variants it spans. */
+static void _read_add_coverage(const ONE_READ *Read)
+{
+	const char *cigar = Read->Extension->CIGAR;
+	uint64_t pos = Read->Pos;
+	uint32_t length = 0;
+	char op = '\0';
+	khiter_t it;
+
+	while (_cigar_next_op(&cigar, &length, &op)) {
+		if (op == 'M' || op == '=' || op == 'X') {
+			for (uint32_t i = 0; i < length; ++i) {
+				++pos;
+				it = kh_get(VariantTableType, _variantTable, pos);
+				if (it != kh_end(_variantTable))
+					kh_value(_variantTable, it)->TotalReadsAtPosition++;
+			}
+		}
+	}
+
+	return;
+}
+
+
+static ERR_VALUE _on_read_callback(const ONE_READ *Read, const char *AlignedOpString, const size_t AlignedOpStringSize, const VDB_UNGAPPED_READ *Ungapped, void *Context)
+{
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+	const char *ref = refData.Sequence + Read->Pos - refData.StartPos;
+	PSSW_CONTEXT sswContext = (PSSW_CONTEXT)Context;
+	uint32_t mismatches[VDB_UNGAPPED_MAX_MISMATCHES];
+	size_t mismatchCount = 0;
+	size_t distance = 0;
+	const char *opString = NULL;
+	size_t opStringSize = 0;
 	unsigned long long currentPos = Read->Pos;
 	unsigned long long variantPos = 0;
 	const char *currentOp = NULL;
@@ -117,11 +564,49 @@ static ERR_VALUE _on_read_callback(const ONE_READ *Read, void *Context)
 	khiter_t it;
 	size_t matchLength = 0;
 	uint8_t qual = 0;
+	const boolean fromCigar = (_useCigar && _read_cigar_usable(Read));
+	const EReadEditClass editClass = (fromCigar) ? read_edit_class(Read) : recUnknown;
 
 	dym_array_init_char(&refArray, 140);
 	dym_array_init_char(&altArray, 140);
+	if (!fromCigar)
+		++_readsRealigned;
+	else if (editClass == recSubstitutionsOnly)
+		++_readsSubstitutionsOnly;
+	else if (editClass == recReferenceMatch) {
+		++_readsReferenceMatching;
+		_read_add_coverage(Read);
+		readSeqIndex = Read->ReadSequenceLen;
+		ret = ERR_SUCCESS;
+	}
+
 	while (readSeqIndex < Read->ReadSequenceLen) {
-		ret = ssw_clever(ref, Read->ReadSequenceLen - readSeqIndex, Read->ReadSequence + readSeqIndex, Read->ReadSequenceLen - readSeqIndex, 2, -1, -1, &opString, &opStringSize);
+		if (editClass == recSubstitutionsOnly)
+			ret = _op_string_from_md(sswContext, Read, &opString, &opStringSize);
+		else if (fromCigar)
+			ret = _op_string_from_cigar(sswContext, Read, ref, &opString, &opStringSize);
+		else if (readSeqIndex == 0 && AlignedOpString != NULL) {
+			opString = AlignedOpString;
+			opStringSize = AlignedOpStringSize;
+			ret = ERR_SUCCESS;
+		} else if (readSeqIndex == 0 && _read_ungapped_known(Read, ref, Ungapped, mismatches, &mismatchCount)) {
+			++_readsUngapped;
+			ret = _op_string_ungapped(sswContext, Read, mismatches, mismatchCount, &opString, &opStringSize);
+		} else if (readSeqIndex == 0 && _screenDistance > 0 && _read_screen(sswContext, Read, ref, mismatches, &mismatchCount, &distance)) {
+			++_readsScreened;
+			ret = _op_string_ungapped(sswContext, Read, mismatches, mismatchCount, &opString, &opStringSize);
+		} else if (_bandwidth > 0) {
+			/* The edit distance bounds the diagonals an optimal alignment can leave. */
+			ret = ssw_banded_ctx(sswContext, ref, Read->ReadSequenceLen - readSeqIndex, Read->ReadSequence + readSeqIndex, Read->ReadSequenceLen - readSeqIndex, 2, -1, -1, (distance > 0) ? distance : _bandwidth, _maxCells, &opString, &opStringSize);
+			if (ret == ERR_TOO_COMPLEX) {
+				fprintf(stderr, "[WARNING]: Read %s at %s:%llu skipped, its alignment exceeds %u cells (--%s)\n", Read->Extension->TemplateName, Read->Extension->RName, (unsigned long long)Read->Pos + 1, _maxCells, VDB_OPTION_MAX_CELLS);
+				++_readsOverBudget;
+				readSeqIndex = Read->ReadSequenceLen;
+				ret = ERR_SUCCESS;
+				continue;
+			}
+		} else ret = ssw_clever_ctx(sswContext, ref, Read->ReadSequenceLen - readSeqIndex, Read->ReadSequence + readSeqIndex, Read->ReadSequenceLen - readSeqIndex, 2, -1, -1, &opString, &opStringSize);
+
 		if (ret == ERR_SUCCESS) {
 			currentOp = opString;
 			while (*currentOp != '\0') {
@@ -166,6 +651,9 @@ static ERR_VALUE _on_read_callback(const ONE_READ *Read, void *Context)
 					if (it != kh_end(_variantTable))
 						kh_value(_variantTable, it)->TotalReadsAtPosition++;
 					break;
+				case 'S':
+					++readSeqIndex;
+					break;
 				case 'M':
 					if (variantPos != 0) {
 						++matchLength;
@@ -256,8 +744,6 @@ static ERR_VALUE _on_read_callback(const ONE_READ *Read, void *Context)
 
 				++currentOp;
 			}
-
-			utils_free(opString);
 		}
 	}
 
@@ -273,10 +759,78 @@ static ERR_VALUE _on_read_callback(const ONE_READ *Read, void *Context)
 }
 
 
+/** Reads whose first alignment needs the full dynamic programming are aligned together by ssw_clever_batch(),
+    the rest of the processing is done by _on_read_callback() read by read. The arrays are kept in batchBuffer. */
+static ERR_VALUE _on_read_batch_callback(const INPUT_READ_BATCH *Batch, void *Context)
+{
+	PSSW_CONTEXT sswContext = (PSSW_CONTEXT)Context;
+	const ONE_READ *read = NULL;
+	const char **refs = NULL;
+	const char **reads = NULL;
+	const char **opStrings = NULL;
+	size_t *lens = NULL;
+	size_t *opStringLens = NULL;
+	size_t *indices = NULL;
+	PVDB_UNGAPPED_READ ungapped = NULL;
+	uint32_t *mismatches = NULL;
+	size_t count = 0;
+	size_t next = 0;
+	const size_t n = Batch->Count;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	if (_bandwidth == 0 && _screenDistance == 0 && n > 0) {
+		ret = ssw_buffer_reserve(&batchBuffer, n*(3 * sizeof(const char *) + 3 * sizeof(size_t) + sizeof(VDB_UNGAPPED_READ) + _ungappedMismatches*sizeof(uint32_t)));
+		if (ret == ERR_SUCCESS) {
+			refs = (const char **)batchBuffer.Data;
+			reads = refs + n;
+			opStrings = reads + n;
+			lens = (size_t *)(opStrings + n);
+			opStringLens = lens + n;
+			indices = opStringLens + n;
+			ungapped = (PVDB_UNGAPPED_READ)(indices + n);
+			mismatches = (uint32_t *)(ungapped + n);
+			for (size_t i = 0; i < n; ++i) {
+				read = Batch->Reads + i;
+				ungapped[i].Checked = FALSE;
+				if (read->ReadSequenceLen == 0 || (_useCigar && _read_cigar_usable(read)))
+					continue;
+
+				refs[count] = refData.Sequence + read->Pos - refData.StartPos;
+				ungapped[i].Checked = TRUE;
+				ungapped[i].Mismatches = mismatches + i*_ungappedMismatches;
+				ungapped[i].Ungapped = _read_ungapped(read, refs[count], _ungappedMismatches, mismatches + i*_ungappedMismatches, &ungapped[i].MismatchCount);
+				if (ungapped[i].Ungapped)
+					continue;
+
+				reads[count] = read->ReadSequence;
+				lens[count] = read->ReadSequenceLen;
+				indices[count] = i;
+				++count;
+			}
+
+			if (count > 0)
+				ret = ssw_clever_batch(sswContext, count, refs, lens, reads, lens, 2, -1, -1, opStrings, opStringLens);
+		}
+	}
+
+	for (size_t i = 0; ret == ERR_SUCCESS && i < n; ++i) {
+		if (next < count && indices[next] == i) {
+			ret = _on_read_callback(Batch->Reads + i, opStrings[next], opStringLens[next], ungapped + i, Context);
+			++next;
+		} else ret = _on_read_callback(Batch->Reads + i, NULL, 0, (ungapped != NULL) ? ungapped + i : NULL, Context);
+	}
+
+	return ret;
+}
+
+
 int main(int argc, char **argv)
 {
 	ERR_VALUE ret = ERR_INTERNAL_ERROR;
 
+	read_kernels_init();
+	ssw_init();
 	_variantTable = kh_init(VariantTableType);
 	_nearVariantTable = kh_init(VariantTableType);
 	ret = utils_allocator_init(1);
@@ -288,7 +842,13 @@ int main(int argc, char **argv)
 			if (ret == ERR_SUCCESS)
 				ret = _cmd_optiion_parse();
 
-			if (ret == ERR_SUCCESS && !_help) {
+			if (ret == ERR_SUCCESS) {
+				ssw_set_linear_space_length(_linearSpaceLength);
+				input_set_verbose(_verbose);
+			}
+
+			if (ret == ERR_SUCCESS && !_help && !_benchmarkKernels && !_benchmarkAlignment) {
+				bgzf_set_workers(_threads);
 				fprintf(stderr, "[INFO]: Loading the reference...\n");
 				ret = fasta_load(_refFile, &refFile);
 				if (ret == ERR_SUCCESS) {
@@ -353,7 +913,34 @@ int main(int argc, char **argv)
 
 				if (ret == ERR_SUCCESS) {
 					fprintf(stderr, "[INFO]: Processing the reads...\n");
-					ret = input_get_reads(_samFile, &region, _on_read_callback, NULL);
+					input_read_options_init(&readOptions);
+					readOptions.Threads = _threads;
+					readOptions.MinMapQ = _minMapQ;
+					readOptions.FlagMask = _flagMask;
+					readOptions.Reference = &refData;
+					ret = input_read_batch_init(INPUT_READ_BATCH_DEFAULT_CAPACITY, &readBatch);
+					if (ret == ERR_SUCCESS) {
+						readBatch.NormalizeBases = TRUE;
+						ssw_context_init(&alignContext);
+						ret = input_get_read_batches(_samFile, &region, &readOptions, &readBatch, _on_read_batch_callback, &alignContext);
+						ssw_context_finit(&alignContext);
+						if (batchBuffer.Data != NULL)
+							utils_free(batchBuffer.Data);
+
+						input_read_batch_finit(&readBatch);
+					}
+
+					if (ret == ERR_SUCCESS && _verbose)
+						fprintf(stderr, "\n[INFO]: %zu reads compared to the reference without alignment\n", _readsUngapped);
+
+					if (ret == ERR_SUCCESS && _verbose && _screenDistance > 0)
+						fprintf(stderr, "[INFO]: %zu reads within %u edits of the reference not aligned (--%s)\n", _readsScreened, _screenDistance, VDB_OPTION_SCREEN_DISTANCE);
+
+					if (ret == ERR_SUCCESS && _verbose && _useCigar)
+						fprintf(stderr, "[INFO]: %zu reads processed, %zu matching the reference, %zu with substitutions only, %zu realigned\n", _readsProcessed, _readsReferenceMatching, _readsSubstitutionsOnly, _readsRealigned);
+
+					if (ret == ERR_SUCCESS && _readsOverBudget > 0)
+						fprintf(stderr, "[WARNING]: %zu reads skipped, their alignment exceeded %u cells (--%s)\n", _readsOverBudget, _maxCells, VDB_OPTION_MAX_CELLS);
 				}
 
 				if (ret == ERR_SUCCESS) {
@@ -397,6 +984,10 @@ int main(int argc, char **argv)
 				}
 			} else if (_help)
 				options_print_help();
+			else if (ret == ERR_SUCCESS && _benchmarkKernels)
+				read_kernels_benchmark(stderr, 64 * 1024 * 1024, 20);
+			else if (ret == ERR_SUCCESS && _benchmarkAlignment)
+				ssw_benchmark(stderr, 1, 20000, 2.0);
 			else fprintf(stderr, "[INFO]: Use variantdb -h for help\n");
 
 			options_module_finit();
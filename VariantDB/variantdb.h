@@ -14,6 +14,18 @@
 #define VDB_OPTION_MAX_MS				"max-ms"
 #define VDB_OPTION_HELP					"help"
 #define VDB_OPTION_VERBOSE				"verbose"
+#define VDB_OPTION_THREADS				"threads"
+#define VDB_OPTION_MIN_MAPQ				"min-mapq"
+#define VDB_OPTION_FLAG_MASK			"flag-mask"
+#define VDB_OPTION_USE_CIGAR			"use-cigar"
+#define VDB_OPTION_REALIGN_DISTANCE		"realign-distance"
+#define VDB_OPTION_BENCHMARK_KERNELS	"benchmark-kernels"
+#define VDB_OPTION_BANDWIDTH			"bandwidth"
+#define VDB_OPTION_MAX_CELLS			"max-cells"
+#define VDB_OPTION_UNGAPPED_MISMATCHES	"ungapped-mismatches"
+#define VDB_OPTION_BENCHMARK_ALIGNMENT	"benchmark-alignment"
+#define VDB_OPTION_SCREEN_DISTANCE		"screen-distance"
+#define VDB_OPTION_LINEAR_SPACE_LENGTH	"linear-space-length"
 
 #define VDB_OPTION_REF_FILE_DESC		"ref-file"
 #define VDB_OPTION_SAM_FILE_DESC		"sam-file"
@@ -26,6 +38,18 @@
 #define VDB_OPTION_MAX_MS_DESC			"max-ms"
 #define VDB_OPTION_HELP_DESC			"help"
 #define VDB_OPTION_VERBOSE_DESC			"verbose"
+#define VDB_OPTION_THREADS_DESC			"threads"
+#define VDB_OPTION_MIN_MAPQ_DESC		"min-mapq"
+#define VDB_OPTION_FLAG_MASK_DESC		"flag-mask"
+#define VDB_OPTION_USE_CIGAR_DESC		"use-cigar"
+#define VDB_OPTION_REALIGN_DISTANCE_DESC	"realign-distance"
+#define VDB_OPTION_BENCHMARK_KERNELS_DESC	"benchmark-kernels"
+#define VDB_OPTION_BANDWIDTH_DESC		"bandwidth"
+#define VDB_OPTION_MAX_CELLS_DESC		"max-cells"
+#define VDB_OPTION_UNGAPPED_MISMATCHES_DESC	"ungapped-mismatches"
+#define VDB_OPTION_BENCHMARK_ALIGNMENT_DESC	"benchmark-alignment"
+#define VDB_OPTION_SCREEN_DISTANCE_DESC	"screen-distance"
+#define VDB_OPTION_LINEAR_SPACE_LENGTH_DESC	"linear-space-length"
 
 #define VDB_OPTION_REF_FILE_SHORT		'f'
 #define VDB_OPTION_SAM_FILE_SHORT		's'
@@ -38,6 +62,23 @@
 #define VDB_OPTION_VERBOSE_SHORT		'V'
 #define VDB_OPTION_DONT_NORMALIZE_SHORT	'n'
 #define VDB_OPTION_MAX_MS_SHORT			'm'
+#define VDB_OPTION_THREADS_SHORT		'T'
+#define VDB_OPTION_MIN_MAPQ_SHORT		'q'
+#define VDB_OPTION_FLAG_MASK_SHORT		'F'
+#define VDB_OPTION_USE_CIGAR_SHORT		'C'
+#define VDB_OPTION_REALIGN_DISTANCE_SHORT	'd'
+#define VDB_OPTION_BENCHMARK_KERNELS_SHORT	'K'
+#define VDB_OPTION_BANDWIDTH_SHORT		'w'
+#define VDB_OPTION_MAX_CELLS_SHORT		'M'
+#define VDB_OPTION_UNGAPPED_MISMATCHES_SHORT	'u'
+#define VDB_OPTION_BENCHMARK_ALIGNMENT_SHORT	'A'
+#define VDB_OPTION_SCREEN_DISTANCE_SHORT	'D'
+#define VDB_OPTION_LINEAR_SPACE_LENGTH_SHORT	'L'
+
+/** Upper bound of --ungapped-mismatches. */
+#define VDB_UNGAPPED_MAX_MISMATCHES		64
+/** Mismatches of a read accepted without alignment must be at least this many bases apart. */
+#define VDB_UNGAPPED_MIN_SPACING		8
 
 
 
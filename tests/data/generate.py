@@ -0,0 +1,831 @@
+#!/usr/bin/env python3
+"""Generates the regression inputs of VariantDB: a reference, known variants and reads aligned to it.
+
+The reads are written as SAM, BGZF-compressed SAM, BAM (with a BAI index) and CRAM 3.0. The CRAM writer follows the CRAM 3.0 specification and the
+htslib conventions: rANS 4x8 order-0 and order-1, gzip and raw blocks, Huffman and beta codes in the core
+block, external blocks for the other data series, and X, B, I, i, D and S read features. samtools was not
+available when the files were made; given samtools, an equivalent file can be made by
+
+    samtools view -C -T ref.fa -o reads.cram --output-fmt-option store_md=1,store_nm=1 reads.sam
+
+Output of VariantDB must not depend on which of the files it reads. The script is deterministic, run it in
+this directory to regenerate the files.
+"""
+
+import hashlib
+import random
+import struct
+import zlib
+
+
+REF_LENGTHS = (("chr1", 20000), ("chr2", 5000))
+READ_LENGTH = 100
+READ_COUNTS = {"chr1": 1500, "chr2": 150}
+VARIANT_COUNT = 60
+SLICE_RECORDS = 150
+CONTAINER_SLICES = 2
+BASES = "ACGT"
+
+
+# ---------------------------------------------------------------------------
+# Reference, variants and reads
+# ---------------------------------------------------------------------------
+
+def make_reference(rnd):
+    return {name: "".join(rnd.choice(BASES) for _ in range(length)) for name, length in REF_LENGTHS}
+
+
+def make_variants(rnd, ref):
+    seq = ref["chr1"]
+    variants = {}
+    while len(variants) < VARIANT_COUNT:
+        pos = rnd.randrange(500, len(seq) - 500)
+        if any(abs(pos - p) < 20 for p in variants):
+            continue
+
+        kind = rnd.random()
+        if kind < 0.6:
+            variants[pos] = (seq[pos], rnd.choice([b for b in BASES if b != seq[pos]]))
+        elif kind < 0.8:
+            variants[pos] = (seq[pos], seq[pos] + "".join(rnd.choice(BASES) for _ in range(rnd.randint(1, 4))))
+        else:
+            variants[pos] = (seq[pos:pos + rnd.randint(2, 5)], seq[pos])
+
+    return variants
+
+
+def make_read(rnd, seq, pos, variants):
+    """Returns (CIGAR operations, read bases) of a read aligned at the 0-based pos. The read carries some of the
+    variants, random substitutions, occasional N bases and soft clips."""
+    ops = []
+    bases = []
+
+    def push(op, count):
+        if ops and ops[-1][0] == op:
+            ops[-1][1] += count
+        else:
+            ops.append([op, count])
+
+    left_clip = rnd.randint(3, 8) if rnd.random() < 0.05 else 0
+    right_clip = rnd.randint(3, 8) if rnd.random() < 0.05 else 0
+    if left_clip:
+        bases.extend(rnd.choice(BASES) for _ in range(left_clip))
+        push("S", left_clip)
+
+    aligned = READ_LENGTH - left_clip - right_clip
+    i = pos
+    while len(bases) < left_clip + aligned and i < len(seq):
+        left = left_clip + aligned - len(bases)
+        if i in variants and rnd.random() < 0.6 and left > 6:
+            ref_allele, alt = variants[i]
+            bases.append(alt[0])
+            push("M", 1)
+            if len(ref_allele) == 1 and len(alt) == 1:
+                i += 1
+            elif len(alt) > 1:
+                bases.extend(alt[1:])
+                push("I", len(alt) - 1)
+                i += 1
+            else:
+                push("D", len(ref_allele) - 1)
+                i += len(ref_allele)
+            continue
+
+        base = seq[i]
+        r = rnd.random()
+        if r < 0.001:
+            base = "N"
+        elif r < 0.01:
+            base = rnd.choice([b for b in BASES if b != seq[i]])
+
+        bases.append(base)
+        push("M", 1)
+        i += 1
+
+    del bases[left_clip + aligned:]
+    if right_clip:
+        bases.extend(rnd.choice(BASES) for _ in range(right_clip))
+        push("S", right_clip)
+
+    return [tuple(op) for op in ops], "".join(bases)
+
+
+def md_nm(seq, pos, ops, bases):
+    md = []
+    run = 0
+    nm = 0
+    ref_pos = pos
+    read_pos = 0
+    for op, count in ops:
+        if op == "M":
+            for k in range(count):
+                if bases[read_pos + k] != seq[ref_pos + k]:
+                    md.append("%d%s" % (run, seq[ref_pos + k]))
+                    run = 0
+                    nm += 1
+                else:
+                    run += 1
+            ref_pos += count
+            read_pos += count
+        elif op == "I":
+            read_pos += count
+            nm += count
+        elif op == "D":
+            md.append("%d^%s" % (run, seq[ref_pos:ref_pos + count]))
+            run = 0
+            ref_pos += count
+            nm += count
+        elif op == "S":
+            read_pos += count
+
+    md.append(str(run))
+    return "".join(md), nm
+
+
+def make_reads(rnd, ref, variants):
+    reads = []
+    for name, _ in REF_LENGTHS:
+        seq = ref[name]
+        for _ in range(READ_COUNTS[name]):
+            pos = rnd.randrange(0, len(seq) - 2 * READ_LENGTH)
+            ops, bases = make_read(rnd, seq, pos, variants if name == "chr1" else {})
+            flag = 0
+            if rnd.random() < 0.3:
+                flag |= 0x10
+            if rnd.random() < 0.03:
+                flag |= 0x400
+
+            mapq = 60 if rnd.random() > 0.08 else rnd.choice((0, 3, 15))
+            qual = "".join(chr(33 + rnd.randint(12, 40)) for _ in bases)
+            tags = []
+            if rnd.random() < 0.9:
+                md, nm = md_nm(seq, pos, ops, bases)
+                tags = [("NM", "i", nm), ("MD", "Z", md)]
+
+            reads.append({"rname": name, "pos": pos, "flag": flag, "mapq": mapq, "ops": ops, "seq": bases, "qual": qual, "tags": tags})
+
+    order = {name: i for i, (name, _) in enumerate(REF_LENGTHS)}
+    reads.sort(key=lambda r: (order[r["rname"]], r["pos"]))
+    for i, r in enumerate(reads):
+        r["name"] = "read%04d" % (i + 1)
+
+    return reads
+
+
+def sam_header():
+    return "@HD\tVN:1.6\tSO:coordinate\n" + "".join("@SQ\tSN:%s\tLN:%d\n" % (n, l) for n, l in REF_LENGTHS)
+
+
+def write_reference(fn, ref):
+    with open(fn, "w", newline="\n") as f:
+        for name, _ in REF_LENGTHS:
+            f.write(">%s\n" % name)
+            for i in range(0, len(ref[name]), 60):
+                f.write(ref[name][i:i + 60] + "\n")
+
+
+def write_variants(fn, variants):
+    with open(fn, "w", newline="\n") as f:
+        f.write("##fileformat=VCFv4.2\n#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n")
+        for pos in sorted(variants):
+            f.write("chr1\t%d\t.\t%s\t%s\t50\tPASS\t.\n" % (pos + 1, variants[pos][0], variants[pos][1]))
+
+
+def sam_line(r):
+    cigar = "".join("%d%s" % (c, op) for op, c in r["ops"])
+    fields = [r["name"], str(r["flag"]), r["rname"], str(r["pos"] + 1), str(r["mapq"]), cigar, "*", "0", "0", r["seq"], r["qual"]]
+    fields += ["%s:%s:%s" % t for t in r["tags"]]
+    return "\t".join(fields) + "\n"
+
+
+def write_sam(fn, reads):
+    with open(fn, "w", newline="\n") as f:
+        f.write(sam_header())
+        for r in reads:
+            f.write(sam_line(r))
+
+
+# ---------------------------------------------------------------------------
+# CRAM 3.0
+# ---------------------------------------------------------------------------
+
+def itf8(value):
+    v = value & 0xffffffff
+    if v < 0x80:
+        return bytes([v])
+    if v < 0x4000:
+        return bytes([0x80 | (v >> 8), v & 0xff])
+    if v < 0x200000:
+        return bytes([0xc0 | (v >> 16), (v >> 8) & 0xff, v & 0xff])
+    if v < 0x10000000:
+        return bytes([0xe0 | (v >> 24), (v >> 16) & 0xff, (v >> 8) & 0xff, v & 0xff])
+    return bytes([0xf0 | (v >> 28), (v >> 20) & 0xff, (v >> 12) & 0xff, (v >> 4) & 0xff, v & 0x0f])
+
+
+def ltf8(value):
+    v = value & 0xffffffffffffffff
+    for extra in range(8):
+        if v < (1 << (7 * (extra + 1))):
+            data = v.to_bytes(extra + 1, "big")
+            return bytes([data[0] | ((0xff00 >> extra) & 0xff)]) + data[1:]
+    return b"\xff" + v.to_bytes(8, "big")
+
+
+def itf8_array(values):
+    return itf8(len(values)) + b"".join(itf8(v) for v in values)
+
+
+RANS_TOTAL = 4096
+RANS_LOWER_BOUND = 1 << 23
+
+
+def rans_normalize(counts):
+    total = sum(counts.values())
+    freqs = {s: max(1, c * RANS_TOTAL // total) for s, c in counts.items()}
+    top = max(freqs, key=lambda s: (freqs[s], -s))
+    freqs[top] += RANS_TOTAL - sum(freqs.values())
+    assert freqs[top] > 0
+    return freqs
+
+
+def rans_table(freqs):
+    """Run-length coded frequency table; a symbol following its predecessor is followed by the number of
+    further consecutive symbols, written without their values."""
+    out = bytearray()
+    rle = 0
+    for s in range(256):
+        if s not in freqs:
+            continue
+        if rle:
+            rle -= 1
+        else:
+            out.append(s)
+            if s > 0 and (s - 1) in freqs:
+                rle = 0
+                while s + 1 + rle < 256 and (s + 1 + rle) in freqs:
+                    rle += 1
+                out.append(rle)
+        f = freqs[s]
+        out += bytes([f]) if f < 128 else bytes([0x80 | (f >> 8), f & 0xff])
+    out.append(0)
+    return bytes(out)
+
+
+def rans_encode(steps, tables):
+    """Encodes (state, context, symbol) steps given in the decoding order. Encoding runs backwards, so the
+    bytes are collected reversed."""
+    cumulative = {}
+    for ctx, freqs in tables.items():
+        c = 0
+        cumulative[ctx] = {}
+        for s in sorted(freqs):
+            cumulative[ctx][s] = c
+            c += freqs[s]
+
+    states = [RANS_LOWER_BOUND] * 4
+    out = bytearray()
+    for state, ctx, sym in reversed(steps):
+        f = tables[ctx][sym]
+        x = states[state]
+        x_max = ((RANS_LOWER_BOUND >> 12) << 8) * f
+        while x >= x_max:
+            out.append(x & 0xff)
+            x >>= 8
+        states[state] = ((x // f) << 12) + (x % f) + cumulative[ctx][sym]
+
+    for state in (3, 2, 1, 0):
+        out += struct.pack("<I", states[state])[::-1]
+
+    return bytes(out[::-1])
+
+
+def rans_compress(data, order):
+    n = len(data)
+    if order == 0:
+        counts = {}
+        for b in data:
+            counts[b] = counts.get(b, 0) + 1
+        tables = {0: rans_normalize(counts)} if n else {}
+        body = rans_table(tables[0]) if n else b"\0"
+        steps = [(i % 4, 0, b) for i, b in enumerate(data)]
+    else:
+        quarter = n // 4
+        steps = []
+        previous = [0, 0, 0, 0]
+        for i in range(quarter):
+            for j in range(4):
+                sym = data[j * quarter + i]
+                steps.append((j, previous[j], sym))
+                previous[j] = sym
+        for i in range(4 * quarter, n):
+            sym = data[i]
+            steps.append((3, previous[3], sym))
+            previous[3] = sym
+
+        counts = {}
+        for _, ctx, sym in steps:
+            counts.setdefault(ctx, {})
+            counts[ctx][sym] = counts[ctx].get(sym, 0) + 1
+        tables = {ctx: rans_normalize(c) for ctx, c in counts.items()}
+        body = bytearray()
+        rle = 0
+        for ctx in range(256):
+            if ctx not in tables:
+                continue
+            if rle:
+                rle -= 1
+            else:
+                body.append(ctx)
+                if ctx > 0 and (ctx - 1) in tables:
+                    while ctx + 1 + rle < 256 and (ctx + 1 + rle) in tables:
+                        rle += 1
+                    body.append(rle)
+            body += rans_table(tables[ctx])
+        body.append(0)
+
+    body = bytes(body) + rans_encode(steps, tables)
+    return bytes([order]) + struct.pack("<II", len(body), n) + body
+
+
+METHOD_RAW, METHOD_GZIP, METHOD_RANS = 0, 1, 4
+CONTENT_FILE_HEADER, CONTENT_COMPRESSION_HEADER, CONTENT_SLICE_HEADER, CONTENT_EXTERNAL, CONTENT_CORE = 0, 1, 2, 4, 5
+
+
+def block(content_type, content_id, data, method=METHOD_RAW, order=0):
+    if method == METHOD_GZIP:
+        c = zlib.compressobj(9, zlib.DEFLATED, 31)
+        packed = c.compress(data) + c.flush()
+    elif method == METHOD_RANS:
+        packed = rans_compress(data, order)
+    else:
+        packed = data
+
+    b = bytes([method, content_type]) + itf8(content_id) + itf8(len(packed)) + itf8(len(data)) + packed
+    return b + struct.pack("<I", zlib.crc32(b) & 0xffffffff)
+
+
+def container(ref_id, start, span, records, counter, bases, blocks, landmarks):
+    body = b"".join(blocks)
+    h = struct.pack("<i", len(body)) + itf8(ref_id) + itf8(start) + itf8(span) + itf8(records)
+    h += ltf8(counter) + ltf8(bases) + itf8(len(blocks)) + itf8_array(landmarks)
+    return h + struct.pack("<I", zlib.crc32(h) & 0xffffffff) + body
+
+
+EOF_CONTAINER = bytes.fromhex("0f000000ffffffff0fe0454f46000000000100" "05bdd94f" "0001000606" "010001000100" "ee63014b")
+
+ENC_EXTERNAL, ENC_HUFFMAN, ENC_BYTE_ARRAY_LEN, ENC_BYTE_ARRAY_STOP, ENC_BETA = 1, 3, 4, 5, 6
+
+
+def encoding(codec, params):
+    return itf8(codec) + itf8(len(params)) + params
+
+
+def huffman_lengths(counts):
+    """Code lengths of a Huffman code; a single symbol gets a code of length 0."""
+    if len(counts) == 1:
+        return {s: 0 for s in counts}
+
+    nodes = [(c, i, {s: 0}) for i, (s, c) in enumerate(sorted(counts.items()))]
+    serial = len(nodes)
+    while len(nodes) > 1:
+        nodes.sort(key=lambda n: (n[0], n[1]))
+        a, b = nodes[0], nodes[1]
+        merged = {s: l + 1 for s, l in list(a[2].items()) + list(b[2].items())}
+        nodes = nodes[2:] + [(a[0] + b[0], serial, merged)]
+        serial += 1
+    return nodes[0][2]
+
+
+def huffman_codes(lengths):
+    """Canonical code, assigned in the order of the code length and the symbol value."""
+    codes = {}
+    code = 0
+    previous = None
+    for s in sorted(lengths, key=lambda s: (lengths[s], s)):
+        if previous is not None:
+            code = (code + 1) << (lengths[s] - lengths[previous])
+        codes[s] = code
+        previous = s
+    return codes
+
+
+class BitWriter:
+    def __init__(self):
+        self.data = bytearray()
+        self.bits = 0
+
+    def write(self, value, count):
+        for k in range(count - 1, -1, -1):
+            if self.bits % 8 == 0:
+                self.data.append(0)
+            if (value >> k) & 1:
+                self.data[-1] |= 0x80 >> (self.bits % 8)
+            self.bits += 1
+
+
+class DataSeries:
+    """One data series: its encoding in the compression header and how its values are written."""
+
+    def __init__(self, key, kind, block_id=None, stop=0):
+        self.key = key
+        self.kind = kind
+        self.block_id = block_id
+        self.stop = stop
+        self.values = []
+        self.codes = None
+        self.lengths = None
+        self.bits = 0
+
+    def header(self):
+        if self.kind == "huffman":
+            symbols = sorted(self.lengths)
+            params = itf8_array(symbols) + itf8_array([self.lengths[s] for s in symbols])
+            return encoding(ENC_HUFFMAN, params)
+        if self.kind == "beta":
+            return encoding(ENC_BETA, itf8(0) + itf8(self.bits))
+        if self.kind == "stop":
+            return encoding(ENC_BYTE_ARRAY_STOP, bytes([self.stop]) + itf8(self.block_id))
+        return encoding(ENC_EXTERNAL, itf8(self.block_id))
+
+
+# Content IDs of the external blocks, the tags use their keys.
+EXTERNAL_IDS = {"AP": 1, "RN": 2, "MF": 3, "NS": 4, "NP": 5, "TS": 6, "FN": 7, "FC": 8, "FP": 9, "BS": 10, "IN": 11, "DL": 12, "SC": 13, "MQ": 14, "QS": 15, "BA": 16}
+TAG_NM = (ord("N") << 16) | (ord("M") << 8) | ord("C")
+TAG_MD = (ord("M") << 16) | (ord("D") << 8) | ord("Z")
+# Compression of the external blocks, the others are raw. The core block is raw.
+BLOCK_METHODS = {
+    EXTERNAL_IDS["QS"]: (METHOD_RANS, 1),
+    EXTERNAL_IDS["SC"]: (METHOD_RANS, 1),
+    EXTERNAL_IDS["AP"]: (METHOD_RANS, 1),
+    EXTERNAL_IDS["RN"]: (METHOD_RANS, 0),
+    EXTERNAL_IDS["FC"]: (METHOD_RANS, 0),
+    EXTERNAL_IDS["FP"]: (METHOD_RANS, 0),
+    TAG_MD: (METHOD_GZIP, 0),
+}
+CRAM_FLAG_QUALITY, CRAM_FLAG_DETACHED = 0x1, 0x2
+
+
+def read_features(seq, pos, r, sub_codes):
+    """Read features (code, 1-based read position, data) of a mapped read. Read positions are turned into
+    deltas by the caller."""
+    features = []
+    read_pos = 0
+    ref_pos = pos
+    for op, count in r["ops"]:
+        if op == "S":
+            features.append(("S", read_pos + 1, r["seq"][read_pos:read_pos + count].encode()))
+            read_pos += count
+        elif op == "I":
+            if count == 1:
+                features.append(("i", read_pos + 1, r["seq"][read_pos].encode()))
+            else:
+                features.append(("I", read_pos + 1, r["seq"][read_pos:read_pos + count].encode()))
+            read_pos += count
+        elif op == "D":
+            features.append(("D", read_pos + 1, count))
+            ref_pos += count
+        elif op == "M":
+            for k in range(count):
+                base = r["seq"][read_pos + k]
+                ref_base = seq[ref_pos + k]
+                if base == ref_base:
+                    continue
+                if base in BASES and ref_base in BASES:
+                    features.append(("X", read_pos + k + 1, sub_codes[ref_base][base]))
+                else:
+                    features.append(("B", read_pos + k + 1, (base.encode(), ord(r["qual"][read_pos + k]) - 33)))
+            read_pos += count
+            ref_pos += count
+    return features
+
+
+def substitution_matrix(reads, ref):
+    """Codes of substitutions, the most frequent substitution of a reference base gets the code 0. Returns the
+    five bytes of the SM preservation key and the codes."""
+    counts = {rb: {b: 0 for b in "ACGTN" if b != rb} for rb in "ACGTN"}
+    for r in reads:
+        seq = ref[r["rname"]]
+        read_pos, ref_pos = 0, r["pos"]
+        for op, count in r["ops"]:
+            if op == "M":
+                for k in range(count):
+                    b, rb = r["seq"][read_pos + k], seq[ref_pos + k]
+                    if b != rb and b in BASES:
+                        counts[rb][b] += 1
+            if op in "MIS":
+                read_pos += count
+            if op in "MD":
+                ref_pos += count
+
+    matrix = bytearray()
+    codes = {}
+    for rb in "ACGTN":
+        others = [b for b in "ACGTN" if b != rb]
+        ranked = sorted(others, key=lambda b: (-counts[rb][b], others.index(b)))
+        codes[rb] = {b: ranked.index(b) for b in others}
+        value = 0
+        for k, b in enumerate(others):
+            value |= codes[rb][b] << (6 - 2 * k)
+        matrix.append(value)
+    return bytes(matrix), codes
+
+
+def write_cram(fn, reads, ref):
+    header_text = sam_header().encode()
+    sm, sub_codes = substitution_matrix(reads, ref)
+    out = bytearray(b"CRAM" + bytes([3, 0]) + b"reads.sam".ljust(20, b"\0"))
+    header_block = block(CONTENT_FILE_HEADER, 0, struct.pack("<i", len(header_text)) + header_text, METHOD_GZIP)
+    out += container(0, 0, 0, 0, 0, 0, [header_block], [0])
+
+    ref_ids = {name: i for i, (name, _) in enumerate(REF_LENGTHS)}
+    groups = []
+    for name, _ in REF_LENGTHS:
+        rs = [r for r in reads if r["rname"] == name]
+        for i in range(0, len(rs), SLICE_RECORDS * CONTAINER_SLICES):
+            groups.append(rs[i:i + SLICE_RECORDS * CONTAINER_SLICES])
+
+    counter = 0
+    for group in groups:
+        slices = [group[i:i + SLICE_RECORDS] for i in range(0, len(group), SLICE_RECORDS)]
+        out += _cram_container(slices, ref, ref_ids, sm, sub_codes, counter)
+        counter += len(group)
+
+    out += EOF_CONTAINER
+    with open(fn, "wb") as f:
+        f.write(out)
+
+
+def _cram_container(slices, ref, ref_ids, sm, sub_codes, counter):
+    records = [r for s in slices for r in s]
+    tag_lines = [[], [TAG_NM, TAG_MD]]
+    ds = {
+        "BF": DataSeries("BF", "huffman"),
+        "CF": DataSeries("CF", "huffman"),
+        "RL": DataSeries("RL", "beta"),
+        "RG": DataSeries("RG", "huffman"),
+        "TL": DataSeries("TL", "huffman"),
+        "RN": DataSeries("RN", "stop", EXTERNAL_IDS["RN"]),
+        "IN": DataSeries("IN", "stop", EXTERNAL_IDS["IN"]),
+        "SC": DataSeries("SC", "stop", EXTERNAL_IDS["SC"]),
+    }
+    for key in ("AP", "MF", "NS", "NP", "TS", "FN", "FC", "FP", "BS", "DL", "MQ", "QS", "BA"):
+        ds[key] = DataSeries(key, "external", EXTERNAL_IDS[key])
+
+    # Huffman codes and the beta width come from the values of the whole container.
+    counts = {"BF": {}, "CF": {}, "RG": {-1: 1}, "TL": {}}
+    for r in records:
+        counts["BF"][r["flag"]] = counts["BF"].get(r["flag"], 0) + 1
+        counts["CF"][CRAM_FLAG_QUALITY | CRAM_FLAG_DETACHED] = 1
+        line = 1 if r["tags"] else 0
+        counts["TL"][line] = counts["TL"].get(line, 0) + 1
+    for key, c in counts.items():
+        ds[key].lengths = huffman_lengths(c)
+        ds[key].codes = huffman_codes(ds[key].lengths)
+    ds["RL"].bits = max(r["seq"].__len__() for r in records).bit_length()
+
+    preservation = b"RN\x01" + b"AP\x01" + b"RR\x01" + b"SM" + sm
+    dictionary = b"".join(b"".join(struct.pack(">I", k)[1:] for k in line) + b"\0" for line in tag_lines)
+    preservation += b"TD" + itf8(len(dictionary)) + dictionary
+    preservation = itf8(5) + preservation
+    series = itf8(len(ds)) + b"".join(key.encode() + ds[key].header() for key in ds)
+    tag_map = itf8(2)
+    tag_map += itf8(TAG_NM) + encoding(ENC_BYTE_ARRAY_LEN, encoding(ENC_HUFFMAN, itf8_array([1]) + itf8_array([0])) + encoding(ENC_EXTERNAL, itf8(TAG_NM)))
+    tag_map += itf8(TAG_MD) + encoding(ENC_BYTE_ARRAY_STOP, b"\0" + itf8(TAG_MD))
+    compression = itf8(len(preservation)) + preservation + itf8(len(series)) + series + itf8(len(tag_map)) + tag_map
+
+    blocks = [block(CONTENT_COMPRESSION_HEADER, 0, compression)]
+    landmarks = []
+    offset = len(blocks[0])
+    slice_counter = counter
+    for records_of_slice in slices:
+        slice_blocks = _cram_slice(records_of_slice, ref, ref_ids, ds, sub_codes, slice_counter)
+        landmarks.append(offset)
+        offset += sum(len(b) for b in slice_blocks)
+        blocks += slice_blocks
+        slice_counter += len(records_of_slice)
+
+    start = records[0]["pos"] + 1
+    end = max(_alignment_end(r) for r in records)
+    return container(ref_ids[records[0]["rname"]], start, end - start + 1, len(records), counter, sum(len(r["seq"]) for r in records), blocks, landmarks)
+
+
+def _alignment_end(r):
+    return r["pos"] + sum(c for op, c in r["ops"] if op in "MD")
+
+
+def _cram_slice(records, ref, ref_ids, ds, sub_codes, counter):
+    core = BitWriter()
+    external = {i: bytearray() for i in EXTERNAL_IDS.values()}
+    external[TAG_NM] = bytearray()
+    external[TAG_MD] = bytearray()
+
+    def put(key, value):
+        s = ds[key]
+        if s.kind == "huffman":
+            core.write(s.codes[value], s.lengths[value])
+        elif s.kind == "beta":
+            core.write(value, s.bits)
+        elif s.kind == "stop":
+            external[s.block_id] += value + bytes([s.stop])
+        elif isinstance(value, bytes):
+            external[s.block_id] += value
+        else:
+            external[s.block_id] += itf8(value)
+
+    seq = ref[records[0]["rname"]]
+    start = records[0]["pos"] + 1
+    last_pos = start
+    for r in records:
+        put("BF", r["flag"])
+        put("CF", CRAM_FLAG_QUALITY | CRAM_FLAG_DETACHED)
+        put("RL", len(r["seq"]))
+        put("AP", r["pos"] + 1 - last_pos)
+        last_pos = r["pos"] + 1
+        put("RG", -1)
+        put("RN", r["name"].encode())
+        put("MF", 0)
+        put("NS", -1)
+        put("NP", 0)
+        put("TS", 0)
+        put("TL", 1 if r["tags"] else 0)
+        if r["tags"]:
+            nm = dict((t[0], t[2]) for t in r["tags"])
+            external[TAG_NM] += bytes([nm["NM"]])
+            external[TAG_MD] += nm["MD"].encode() + b"\0"
+
+        features = read_features(seq, r["pos"], r, sub_codes)
+        put("FN", len(features))
+        previous = 0
+        for code, read_pos, data in features:
+            put("FC", code.encode())
+            put("FP", read_pos - previous)
+            previous = read_pos
+            if code == "X":
+                put("BS", bytes([data]))
+            elif code == "B":
+                put("BA", data[0])
+                put("QS", bytes([data[1]]))
+            elif code == "i":
+                put("BA", data)
+            elif code == "I":
+                put("IN", data)
+            elif code == "S":
+                put("SC", data)
+            elif code == "D":
+                put("DL", data)
+        put("MQ", r["mapq"])
+        put("QS", bytes(ord(q) - 33 for q in r["qual"]))
+
+    end = max(_alignment_end(r) for r in records)
+    span = end - start + 1
+    ids = sorted(i for i, data in external.items() if data)
+    data_blocks = [block(CONTENT_CORE, 0, bytes(core.data))]
+    for i in ids:
+        method, order = BLOCK_METHODS.get(i, (METHOD_RAW, 0))
+        data_blocks.append(block(CONTENT_EXTERNAL, i, bytes(external[i]), method, order))
+
+    md5 = hashlib.md5(seq[start - 1:start - 1 + span].encode()).digest()
+    header = itf8(ref_ids[records[0]["rname"]]) + itf8(start) + itf8(span) + itf8(len(records)) + ltf8(counter)
+    header += itf8(len(data_blocks)) + itf8_array([0] + ids) + itf8(-1) + md5
+    return [block(CONTENT_SLICE_HEADER, 0, header)] + data_blocks
+
+# ---------------------------------------------------------------------------
+# BGZF, BAM and BAI
+# ---------------------------------------------------------------------------
+
+BGZF_EOF = bytes.fromhex("1f8b08040000000000ff0600424302001b0003000000000000000000")
+# Records written between flushes of a BGZF block, so that the reads span many blocks.
+BGZF_RECORDS = 37
+
+
+def bgzf_block(data):
+    c = zlib.compressobj(6, zlib.DEFLATED, -15)
+    packed = c.compress(data) + c.flush()
+    header = struct.pack("<BBBBIBBHBBHH", 31, 139, 8, 4, 0, 0, 255, 6, 66, 67, 2, len(packed) + 25)
+    return header + packed + struct.pack("<II", zlib.crc32(data) & 0xffffffff, len(data))
+
+
+class BGZFWriter:
+    def __init__(self, fn):
+        self.f = open(fn, "wb")
+        self.data = b""
+        self.offset = 0
+
+    def virtual_offset(self):
+        return (self.offset << 16) | len(self.data)
+
+    def write(self, data):
+        self.data += data
+        while len(self.data) >= 0xff00:
+            self.flush(0xff00)
+
+    def flush(self, length=None):
+        length = len(self.data) if length is None else length
+        b = bgzf_block(self.data[:length])
+        self.f.write(b)
+        self.offset += len(b)
+        self.data = self.data[length:]
+
+    def close(self):
+        if self.data:
+            self.flush()
+        self.f.write(BGZF_EOF)
+        self.f.close()
+
+
+def reg2bin(beg, end):
+    end -= 1
+    for shift, offset in ((14, 4681), (17, 585), (20, 73), (23, 9), (26, 1)):
+        if beg >> shift == end >> shift:
+            return offset + (beg >> shift)
+    return 0
+
+
+def write_bgzf_sam(fn, reads):
+    w = BGZFWriter(fn)
+    w.write(sam_header().encode())
+    for i, r in enumerate(reads):
+        w.write(sam_line(r).encode())
+        if i % BGZF_RECORDS == 0:
+            w.flush()
+    w.close()
+
+
+def write_bam(fn, reads):
+    """Writes the BAM file and its BAI index (bins and the linear index)."""
+    text = sam_header().encode()
+    w = BGZFWriter(fn)
+    data = b"BAM\1" + struct.pack("<i", len(text)) + text + struct.pack("<i", len(REF_LENGTHS))
+    for name, length in REF_LENGTHS:
+        data += struct.pack("<i", len(name) + 1) + name.encode() + b"\0" + struct.pack("<i", length)
+    w.write(data)
+    w.flush()
+
+    ref_ids = {name: i for i, (name, _) in enumerate(REF_LENGTHS)}
+    bins = [{} for _ in REF_LENGTHS]
+    linear = [{} for _ in REF_LENGTHS]
+    codes = {c: i for i, c in enumerate("=ACMGRSVTWYHKDBN")}
+    for i, r in enumerate(reads):
+        rid = ref_ids[r["rname"]]
+        end = _alignment_end(r)
+        bin_ = reg2bin(r["pos"], end)
+        name = r["name"].encode() + b"\0"
+        cigar = b"".join(struct.pack("<I", c << 4 | "MIDNSHP=X".index(op)) for op, c in r["ops"])
+        seq = bytearray((len(r["seq"]) + 1) // 2)
+        for k, c in enumerate(r["seq"]):
+            seq[k // 2] |= codes[c] << (4 if k % 2 == 0 else 0)
+        qual = bytes(ord(q) - 33 for q in r["qual"])
+        tags = b""
+        for key, kind, value in r["tags"]:
+            if kind == "i":
+                tags += key.encode() + b"C" + struct.pack("<B", value)
+            else:
+                tags += key.encode() + b"Z" + value.encode() + b"\0"
+        body = struct.pack("<iiBBHHHIiii", rid, r["pos"], len(name), r["mapq"], bin_, len(r["ops"]), r["flag"], len(r["seq"]), -1, -1, 0)
+        body += name + cigar + bytes(seq) + qual + tags
+
+        begin = w.virtual_offset()
+        w.write(struct.pack("<i", len(body)) + body)
+        finish = w.virtual_offset()
+        chunks = bins[rid].setdefault(bin_, [])
+        if chunks and chunks[-1][1] == begin:
+            chunks[-1][1] = finish
+        else:
+            chunks.append([begin, finish])
+        for window in range(r["pos"] >> 14, ((end - 1) >> 14) + 1):
+            linear[rid].setdefault(window, begin)
+        if i % BGZF_RECORDS == 0:
+            w.flush()
+    w.close()
+
+    with open(fn + ".bai", "wb") as f:
+        f.write(b"BAI\1" + struct.pack("<i", len(REF_LENGTHS)))
+        for rid in range(len(REF_LENGTHS)):
+            f.write(struct.pack("<i", len(bins[rid])))
+            for bin_, chunks in sorted(bins[rid].items()):
+                f.write(struct.pack("<Ii", bin_, len(chunks)))
+                for chunk in chunks:
+                    f.write(struct.pack("<QQ", *chunk))
+            count = max(linear[rid]) + 1 if linear[rid] else 0
+            f.write(struct.pack("<i", count))
+            last = 0
+            for window in range(count):
+                last = linear[rid].get(window, last)
+                f.write(struct.pack("<Q", last))
+
+
+def main():
+    rnd = random.Random(20161017)
+    ref = make_reference(rnd)
+    variants = make_variants(rnd, ref)
+    reads = make_reads(rnd, ref, variants)
+    write_reference("ref.fa", ref)
+    write_variants("variants.vcf", variants)
+    write_sam("reads.sam", reads)
+    write_bgzf_sam("reads.sam.gz", reads)
+    write_bam("reads.bam", reads)
+    write_cram("reads.cram", reads, ref)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Regression tests of variantdb. The inputs in data/ are made by data/generate.py, the expected outputs in
+# expected/ were made by variantdb from reads.sam; expected/reads.txt and expected/region.txt are identical
+# to the output of the code before the alternative readers and aligners were added.
+#
+# Usage: tests/run-tests.sh <variantdb binary> [<ssw-check binary>]
+
+if [ $# -lt 1 ] || [ $# -gt 2 ]; then
+	echo "Usage: $0 <variantdb binary> [<ssw-check binary>]" >&2
+	exit 2
+fi
+
+absolute() {
+	echo "$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+}
+
+VDB=$(absolute "$1")
+CHECK=
+if [ $# -eq 2 ]; then
+	CHECK=$(absolute "$2")
+fi
+
+cd "$(dirname "$0")/data" || exit 2
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+FAILED=0
+
+# expect <name> <expected output> <args>: runs variantdb on the test data, its output must equal the file in expected/.
+expect() {
+	name=$1
+	expected=../expected/$2
+	shift 2
+	if ! "$VDB" -f ref.fa -v variants.vcf -c chr1 "$@" > "$OUT/out.txt" 2> "$OUT/err.txt"; then
+		echo "FAIL $name: variantdb failed"
+		tail -3 "$OUT/err.txt"
+		FAILED=1
+	elif ! cmp -s "$expected" "$OUT/out.txt"; then
+		echo "FAIL $name: output differs from $expected"
+		diff "$expected" "$OUT/out.txt" | head -20
+		FAILED=1
+	else
+		echo "ok   $name"
+	fi
+}
+
+# Input formats and readers
+expect sam reads.txt -s reads.sam
+expect sam-threads reads.txt -s reads.sam -T 4
+expect sam-stdin reads.txt -s - < reads.sam
+expect sam-region region.txt -s reads.sam --start 5000 --stop 15000
+expect gz reads.txt -s reads.sam.gz
+expect gz-threads reads.txt -s reads.sam.gz -T 4
+expect gz-stdin reads.txt -s - < reads.sam.gz
+expect bam reads.txt -s reads.bam
+expect bam-threads reads.txt -s reads.bam -T 4
+expect bam-region region.txt -s reads.bam --start 5000 --stop 15000
+expect cram reads.txt -s reads.cram
+expect cram-region region.txt -s reads.cram --start 5000 --stop 15000
+
+# Aligners and read classification; only --use-cigar changes the output
+expect bandwidth reads.txt -s reads.sam -w 8
+expect ungapped reads.txt -s reads.sam -u 2
+expect screen-distance reads.txt -s reads.sam -D 3
+expect linear-space reads.txt -s reads.sam -L 50
+expect use-cigar use-cigar.txt -s reads.sam --use-cigar
+expect use-cigar-bam use-cigar.txt -s reads.bam --use-cigar
+expect use-cigar-cram use-cigar.txt -s reads.cram --use-cigar
+
+if [ -n "$CHECK" ]; then
+	if "$CHECK" > "$OUT/check.txt" 2>&1; then
+		echo "ok   ssw-check"
+	else
+		echo "FAIL ssw-check"
+		grep ERROR "$OUT/check.txt" | head -20
+		FAILED=1
+	fi
+fi
+
+exit $FAILED
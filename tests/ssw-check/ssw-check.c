@@ -0,0 +1,372 @@
+
+#include <stdio.h>
+#include <string.h>
+#include "err.h"
+#include "utils.h"
+#include "ssw.h"
+#include "ssw-benchmark.h"
+
+
+/************************************************************************/
+/*                             HELPER TYPES                             */
+/************************************************************************/
+
+/* Scoring used by variantdb when realigning reads. */
+#define SSW_CHECK_MATCH						2
+#define SSW_CHECK_MISMATCH					-1
+#define SSW_CHECK_INDEL						-1
+#define SSW_CHECK_BANDWIDTH					16
+/* Generated pairs of every profile and length. */
+#define SSW_CHECK_GENERATED_PAIRS			8
+#define SSW_CHECK_SEED						1
+/* Longer operation strings are not printed. */
+#define SSW_CHECK_MAX_PRINTED_LENGTH		200
+
+
+typedef ERR_VALUE (SSW_CHECK_ALIGN)(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen);
+
+typedef ERR_VALUE (SSW_CHECK_ALIGN_BATCH)(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const char **OperationStrings, size_t *OperationStringLens);
+
+typedef struct _SSW_CHECK_ENGINE {
+	const char *Name;
+	/** Exactly one of the functions is set. */
+	SSW_CHECK_ALIGN *Align;
+	SSW_CHECK_ALIGN_BATCH *AlignBatch;
+	/** Implementation of ssw_clever() the engine runs with, sswiMax for the default one. */
+	ESSWImplementation Implementation;
+	/** Longer pairs are skipped, the engine would need too much time. */
+	size_t MaxLength;
+	/** The engine must return the operation strings of ssw_clever(); differences of the others are only counted. */
+	boolean Exact;
+} SSW_CHECK_ENGINE, *PSSW_CHECK_ENGINE;
+
+/** Reference window (A) and read (B). */
+typedef struct _SSW_CHECK_PAIR {
+	const char *A;
+	const char *B;
+} SSW_CHECK_PAIR, *PSSW_CHECK_PAIR;
+
+
+/************************************************************************/
+/*                             HELPER FUNCTIONS                         */
+/************************************************************************/
+
+
+static ERR_VALUE _align_simple(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen)
+{
+	char *opString = NULL;
+	size_t opStringLen = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ssw_simple(A, ALen, B, BLen, SSW_CHECK_MATCH, SSW_CHECK_MISMATCH, SSW_CHECK_INDEL, &opString, &opStringLen);
+	if (ret == ERR_SUCCESS) {
+		ret = ssw_buffer_reserve(&Context->OpString, opStringLen + 1);
+		if (ret == ERR_SUCCESS) {
+			memcpy(Context->OpString.Data, opString, opStringLen + 1);
+			*OperationString = (char *)Context->OpString.Data;
+			*OperationStringLen = opStringLen;
+		}
+
+		utils_free(opString);
+	}
+
+	return ret;
+}
+
+
+static ERR_VALUE _align_clever(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen)
+{
+	return ssw_clever_ctx(Context, A, ALen, B, BLen, SSW_CHECK_MATCH, SSW_CHECK_MISMATCH, SSW_CHECK_INDEL, OperationString, OperationStringLen);
+}
+
+
+static ERR_VALUE _align_banded(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen)
+{
+	return ssw_banded_ctx(Context, A, ALen, B, BLen, SSW_CHECK_MATCH, SSW_CHECK_MISMATCH, SSW_CHECK_INDEL, SSW_CHECK_BANDWIDTH, 0, OperationString, OperationStringLen);
+}
+
+
+static ERR_VALUE _align_linear(PSSW_CONTEXT Context, const char *A, const size_t ALen, const char *B, const size_t BLen, const char **OperationString, size_t *OperationStringLen)
+{
+	return ssw_clever_linear_ctx(Context, A, ALen, B, BLen, SSW_CHECK_MATCH, SSW_CHECK_MISMATCH, SSW_CHECK_INDEL, OperationString, OperationStringLen);
+}
+
+
+static ERR_VALUE _align_batch(PSSW_CONTEXT Context, const size_t Count, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, const char **OperationStrings, size_t *OperationStringLens)
+{
+	return ssw_clever_batch(Context, Count, A, ALens, B, BLens, SSW_CHECK_MATCH, SSW_CHECK_MISMATCH, SSW_CHECK_INDEL, OperationStrings, OperationStringLens);
+}
+
+
+static const SSW_CHECK_ENGINE _engines[] = {
+	{"simple", _align_simple, NULL, sswiScalar, 250, FALSE},
+	{"scalar", _align_clever, NULL, sswiScalar, 1000, TRUE},
+	{"sse4.1", _align_clever, NULL, sswiSSE41, 1000, TRUE},
+	{"avx2", _align_clever, NULL, sswiAVX2, 1000, TRUE},
+	{"banded", _align_banded, NULL, sswiMax, 1000, TRUE},
+	{"batch", NULL, _align_batch, sswiMax, 1000, TRUE},
+	{"linear", _align_linear, NULL, sswiMax, 1000, TRUE},
+};
+
+static const SSW_CHECK_PAIR _pairs[] = {
+	/* identical */
+	{"GTGATGATGTAGAGGTATGTCAACTTAAATTGAGTGATCAATGTGAACATTTCGTCACCATCTACATCGCGGGGATTTTT",
+	 "GTGATGATGTAGAGGTATGTCAACTTAAATTGAGTGATCAATGTGAACATTTCGTCACCATCTACATCGCGGGGATTTTT"},
+	/* one SNV */
+	{"CTTCCCTTGACGGCGAGCCCTGCACGAGTATACTCCCGGTGTACCTGCTTAAATGCCACGGGGTTGGCGAAATAGACTCC",
+	 "CTTCCCTTGACGGCGAGCCCTGCACGAGTATACTCCCGGTATACCTGCTTAAATGCCACGGGGTTGGCGAAATAGACTCC"},
+	/* two SNVs */
+	{"TAAATAATACCGTAGTCACGGCGGCTACGAGTTTAAATGGTGAGCTCGCGGGGAGGACGCGGAACTTCATGTACAATTAC",
+	 "TAAATAATACCGTAGTCACGACGGCTACGAGTTTAAATGGTGAGCTCGCGGGGAGGACGCTGAACTTCATGTACAATTAC"},
+	/* 1 bp deletion */
+	{"CTTGCTCAATATTCTTTCTCAGTGCCTTGACAACCCAGATACGGTATGGTGGCATCTGCGCATTAGTAAATATCTAACTT",
+	 "CTTGCTCAATATTCTTTCTCAGTGCCTTGACAACCAGATACGGTATGGTGGCATCTGCGCATTAGTAAATATCTAACTTA"},
+	/* 3 bp deletion */
+	{"TAATTCACGTCGAGTGAGAAGAAGTGTGCCACTATGTGCTCTCAGTTGCCGTGGCACTCGTAAAGATAGCGAGCAGAAGC",
+	 "TAATTCACGTCGAGTGAGAAGAAGTGTGCCATGTGCTCTCAGTTGCCGTGGCACTCGTAAAGATAGCGAGCAGAAGCACG"},
+	/* 1 bp insertion */
+	{"AGCTTTAATCTCGATTAAACCTGTCCGACATAGATTGCCATCTGTGAGAGTTTCACGTGCAGGTCGCTAATGTTTGATGC",
+	 "AGCTTTAATCTCGATTAAACCTGTCCGACATAGATTGCCATCTGTTGAGAGTTTCACGTGCAGGTCGCTAATGTTTGATG"},
+	/* 4 bp insertion */
+	{"GAGTTCACGTACCGGTTGGCACAGCGGAGTATAATCTGCCTTAATATTGTGGACTCTTACATGAGATGTGACCTTGTTAC",
+	 "GAGTTCACGTACCGGTTGGCACAGCGGAGTATAATCTGCCTTAATATTGTGATTGGACTCTTACATGAGATGTGACCTTG"},
+	/* SNV next to a deletion */
+	{"AGACTGCTGAACCCCACCCTTCTAGGTCGCTAGAGCAATGTTCACGGATTATTAGGCCAAACATACGGGCTATGGATGAA",
+	 "AGACTGCTGAACCCCACCCTTCTAGGTCGCTAGAGCAATGAACGGATTATTAGGCCAAACATACGGGCTATGGATGAATTG"},
+	/* deletion near the start */
+	{"GAGGGATTGGTTGCCACTGAATCAGCTATAGCGAAACGCATGCTCAGACCTTAGTGCCGGGACCCTTATCTTAATACACC",
+	 "GAGGTTGGTTGCCACTGAATCAGCTATAGCGAAACGCATGCTCAGACCTTAGTGCCGGGACCCTTATCTTAATACACCCA"},
+	/* insertion near the end */
+	{"AAGTGGTTGATGTATCAAGGCTTCAGTCGACTTGACGTTGTCGAACAAGCATTCCCAGCATAGACGTTGCCAATCAGCAA",
+	 "AAGTGGTTGATGTATCAAGGCTTCAGTCGACTTGACGTTGTCGAACAAGCATTCCCAGCATAGACGTTGCCAATCCCAGC"},
+	/* two close deletions */
+	{"GCGGGTCTCTATATGGTCGCGGTCCGCTAAGATTCTTATGAAGGCCCTAAAATGTACCGCACACCATAAACAGGCCTCTC",
+	 "GCGGGTCTCTATATGGTCGCGGTCCGCTAATTCTTAAAGGCCCTAAAATGTACCGCACACCATAAACAGGCCTCTCACGT"},
+	/* deletion and insertion */
+	{"TGACGATTGATTCAGTTCCAAGGGTTATGAACCTCGGGTAGCGGTTCTGGGAGCTAGAGCCCGGTAATTTCCGGTAGGTA",
+	 "TGACGATTGATTCAGTTCCAAGGGTGAACCTCGGGTAGCGGTTCTGGGAGCTAATAGAGCCCGGTAATTTCCGGTAGGTA"},
+	/* homopolymer deletion */
+	{"GTTAGTTGTCTTAGCACCATTCACAAGGTGAAAAAAATGAAGGGCTCGAGGCTGGATGAGCACAGTTAATAAAGTATCCA",
+	 "GTTAGTTGTCTTAGCACCATTCACAAGGTGAAAAATGAAGGGCTCGAGGCTGGATGAGCACAGTTAATAAAGTATCCAGC"},
+	/* homopolymer insertion */
+	{"TGCTCATAGTCGCCGCATCTAACAGGTACTCCCCCCATAGAGTTTCCCCACTGAGTACACGGTGCCAGACTCCATGAAAT",
+	 "TGCTCATAGTCGCCGCATCTAACAGGTACTCCCCCCCCATAGAGTTTCCCCACTGAGTACACGGTGCCAGACTCCATGAA"},
+	/* dinucleotide repeat deletion */
+	{"CATAGCGATACGGACAATCTGATATGTGACACACACACCGTTAACTTTCGACCAACAGCGCTCCCGTATAACACTGGAAC",
+	 "CATAGCGATACGGACAATCTGATATGTGACACACACCGTTAACTTTCGACCAACAGCGCTCCCGTATAACACTGGAACTG"},
+	/* trinucleotide repeat insertion */
+	{"TGTCGTCGAAACGCAAATCACATTTGACGTTGTTGTTCTGTGCACCATTAAGCCTGAGTGATCGGAGGCGGTAGGTAACG",
+	 "TGTCGTCGAAACGCAAATCACATTTGACGTTGTTGTTGTTCTGTGCACCATTAAGCCTGAGTGATCGGAGGCGGTAGGTA"},
+	/* random, 6 % substitutions and 3 % indels */
+	{"GGGTAACCCGGAAGCTAGAAACAAAGTTTTGTAGCAATTGCTTATCGGTCTCGCTCGGTTATTGTCACTTCAGTGCTAGC",
+	 "GGTTAACACGGCTATAGAAACAATTGTAGCAATTGCTTATCGTCTCGCTCGTTATTGTCACCTCAGTGCTAACCCAGAAG"},
+	/* random, 6 % substitutions and 3 % indels */
+	{"TATCACTCGTCTATTCATCTAGGCGGTCGAATTTCCTCGCATGCTCGTCTTGCAGGGGCGCTTCAGCGGTTAGCATTAGT",
+	 "TATTCCGTAAATCTATTCCTAGGTGGTCGAATTTCCTCGCATGCTCGTCCTGCAGGGGCGCTTCAGCGGTTAGCATTACT"},
+	/* random, 6 % substitutions and 3 % indels */
+	{"CCTGTGTGGTATTAGGACAGACATCTAACAAAACGTTACGGACGCAGCAGTCCGCGGGGTTCGCGAACCTATTAGGAGTT",
+	 "CCACCCGGTGTGGTATATTATGGACAGACCAACAAGACGTTACGGACAGCAGTCCGCGGGGTTCGGAACCTATTAGGAAT"},
+	/* random, 6 % substitutions and 3 % indels */
+	{"ACTAACTTCTCCCCGAAGGCCTCCTGAAGGATTTACAAACCCACACCCCGGGAAGCCGACTCATGGGTATGCTATAACAT",
+	 "ACTAACTCCTGAAGGCCTCAATTTACAACGACCCAAACCCCGGGAAGCCGACTCATGGGTATGCTATAACATAGCAACAA"},
+	/* random, 6 % substitutions and 3 % indels */
+	{"CTCTACGTAGTCCCACCGACACGAGTTTTCGTTATATCAACGCACGCGGTAATGAACCAGAGACGATCGGTACGGTGTCC",
+	 "TCTACGTAGTCCCTCCGACACGAGTTTTCGTTATATCAACGCACGACTGAACCAGAGATTGGTACGATCCGTGCTGTCCG"},
+	/* random, 6 % substitutions and 3 % indels */
+	{"CACTTAGAGCAAGAGAATGGATGTTCAAACTCCCGTGTCTAGTGTCACCTATCTTGCAGCTAGAGTCTCTGTGTGAGATC",
+	 "CACTTAGACCAGCAAGAGAATGTATGTCCAAACCACCGTGTCTAGTGCGTATCACCTATCTGCACTAGAGTCTCTGTGTG"},
+	/* random, 6 % substitutions and 3 % indels */
+	{"CAGAGGTCGGAGCAGGCCCTTGTACATACAAGGGTCTGCTATAATAGTGGCATGCCCGGATACGACTCTCTCAGTTTAGT",
+	 "CAGAGGTCGGAGCAGGCCCTTGTACATACAATGTGCTTTAATGCATGCCCGGATACGACTCCCTCAGTTTAGTATTTAGC"},
+	/* random, 6 % substitutions and 3 % indels */
+	{"GTCAATCACTCACATAGACTACCGGCTCCTCTCAATGTAGCTAAGATCAGCAACTCATACGCATTCCGGGCGGGGACATC",
+	 "AATCGCTCCATGCTAAGACTACCGGCCTCTCAACGTAGCTAAGATCAACTCATACGCACTCGTCGGGGATATCTAGTGCG"},
+};
+
+static const SSW_BENCHMARK_PROFILE _profiles[] = {
+	{"close", 0.005, 0.0005},
+	{"divergent", 0.03, 0.005},
+};
+
+static const size_t _lengths[] = {100, 250, 1000};
+
+#define SSW_CHECK_FIXED_COUNT		(sizeof(_pairs) / sizeof(_pairs[0]))
+#define SSW_CHECK_PAIR_COUNT		(SSW_CHECK_FIXED_COUNT + sizeof(_profiles) / sizeof(_profiles[0]) * sizeof(_lengths) / sizeof(_lengths[0]) * SSW_CHECK_GENERATED_PAIRS)
+
+
+/** Fills the sequence arrays by the fixed pairs followed by pairs made by the benchmark generator. */
+static ERR_VALUE _check_pairs_create(char **A, size_t *ALens, char **B, size_t *BLens)
+{
+	uint64_t state = 0;
+	size_t index = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ret = ERR_SUCCESS;
+	for (size_t i = 0; ret == ERR_SUCCESS && i < SSW_CHECK_FIXED_COUNT; ++i) {
+		ALens[index] = strlen(_pairs[i].A);
+		BLens[index] = strlen(_pairs[i].B);
+		ret = utils_copy_string(_pairs[i].A, A + index);
+		if (ret == ERR_SUCCESS) {
+			ret = utils_copy_string(_pairs[i].B, B + index);
+			if (ret != ERR_SUCCESS)
+				utils_free(A[index]);
+		}
+
+		if (ret == ERR_SUCCESS)
+			++index;
+	}
+
+	for (size_t i = 0; ret == ERR_SUCCESS && i < sizeof(_profiles) / sizeof(_profiles[0]); ++i) {
+		for (size_t j = 0; ret == ERR_SUCCESS && j < sizeof(_lengths) / sizeof(_lengths[0]); ++j) {
+			state = (SSW_CHECK_SEED + 1) * 0x9E3779B97F4A7C15ULL ^ ((uint64_t)i << 32) ^ _lengths[j];
+			for (size_t k = 0; ret == ERR_SUCCESS && k < SSW_CHECK_GENERATED_PAIRS; ++k) {
+				ret = utils_calloc(_lengths[j] + 1, sizeof(char), (void **)(A + index));
+				if (ret == ERR_SUCCESS) {
+					ret = utils_calloc(_lengths[j] + 1, sizeof(char), (void **)(B + index));
+					if (ret == ERR_SUCCESS) {
+						ssw_benchmark_generate(&state, _profiles + i, _lengths[j], A[index], B[index]);
+						ALens[index] = _lengths[j];
+						BLens[index] = _lengths[j];
+						++index;
+					} else utils_free(A[index]);
+				}
+			}
+		}
+	}
+
+	if (ret != ERR_SUCCESS) {
+		for (size_t i = 0; i < index; ++i) {
+			utils_free(A[i]);
+			utils_free(B[i]);
+		}
+	}
+
+	return ret;
+}
+
+
+/** Aligns all pairs by every engine the CPU supports and compares the operation strings with those of the
+    scalar ssw_clever(). Differences of the exact engines are reported as errors. */
+static ERR_VALUE _check(FILE *Stream, PSSW_CONTEXT Context, const ESSWImplementation DefaultImplementation, const char * const *A, const size_t *ALens, const char * const *B, const size_t *BLens, boolean *Passed)
+{
+	const size_t count = SSW_CHECK_PAIR_COUNT;
+	char *expected[SSW_CHECK_PAIR_COUNT];
+	const char *a[SSW_CHECK_PAIR_COUNT];
+	const char *b[SSW_CHECK_PAIR_COUNT];
+	size_t aLens[SSW_CHECK_PAIR_COUNT];
+	size_t bLens[SSW_CHECK_PAIR_COUNT];
+	size_t indices[SSW_CHECK_PAIR_COUNT];
+	const char *opStrings[SSW_CHECK_PAIR_COUNT];
+	size_t opStringLens[SSW_CHECK_PAIR_COUNT];
+	size_t expectedLen = 0;
+	size_t aligned = 0;
+	size_t agreeing = 0;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	*Passed = TRUE;
+	memset(expected, 0, sizeof(expected));
+	ssw_set_implementation(sswiScalar);
+	ret = ERR_SUCCESS;
+	for (size_t i = 0; ret == ERR_SUCCESS && i < count; ++i)
+		ret = ssw_clever(A[i], ALens[i], B[i], BLens[i], SSW_CHECK_MATCH, SSW_CHECK_MISMATCH, SSW_CHECK_INDEL, expected + i, &expectedLen);
+
+	for (size_t i = 0; ret == ERR_SUCCESS && i < sizeof(_engines) / sizeof(_engines[0]); ++i) {
+		const SSW_CHECK_ENGINE *e = _engines + i;
+
+		if (!ssw_set_implementation((e->Implementation != sswiMax) ? e->Implementation : DefaultImplementation)) {
+			fprintf(Stream, "[INFO]: %-6s not supported by the CPU\n", e->Name);
+			continue;
+		}
+
+		aligned = 0;
+		for (size_t j = 0; j < count; ++j) {
+			if (ALens[j] <= e->MaxLength && BLens[j] <= e->MaxLength) {
+				indices[aligned] = j;
+				a[aligned] = A[j];
+				b[aligned] = B[j];
+				aLens[aligned] = ALens[j];
+				bLens[aligned] = BLens[j];
+				++aligned;
+			}
+		}
+
+		/* The operation strings of a batch stay valid until the next batch. */
+		if (e->AlignBatch != NULL)
+			ret = e->AlignBatch(Context, aligned, a, aLens, b, bLens, opStrings, opStringLens);
+
+		agreeing = 0;
+		for (size_t j = 0; ret == ERR_SUCCESS && j < aligned; ++j) {
+			const size_t index = indices[j];
+
+			if (e->Align != NULL)
+				ret = e->Align(Context, a[j], aLens[j], b[j], bLens[j], opStrings + j, opStringLens + j);
+
+			if (ret != ERR_SUCCESS)
+				break;
+
+			if (strcmp(opStrings[j], expected[index]) == 0)
+				++agreeing;
+			else if (e->Exact) {
+				if (strlen(expected[index]) <= SSW_CHECK_MAX_PRINTED_LENGTH)
+					fprintf(Stream, "[ERROR]: Pair %zu: %s returns %s instead of %s\n", index, e->Name, opStrings[j], expected[index]);
+				else fprintf(Stream, "[ERROR]: Pair %zu (%zu bp): %s returns a different operation string\n", index, aLens[j], e->Name);
+
+				*Passed = FALSE;
+			}
+		}
+
+		if (ret == ERR_SUCCESS)
+			fprintf(Stream, "[INFO]: %-6s %3zu of %zu operation strings identical to ssw_clever()\n", e->Name, agreeing, aligned);
+	}
+
+	ssw_set_implementation(DefaultImplementation);
+	for (size_t i = 0; i < count; ++i) {
+		if (expected[i] != NULL)
+			utils_free(expected[i]);
+	}
+
+	return ret;
+}
+
+
+/************************************************************************/
+/*                           MAIN                                       */
+/************************************************************************/
+
+
+/** Checks that the alignment engines return the operation strings of the scalar ssw_clever(). Exits with 0 if
+    they do, 1 if they do not and 2 on an error. */
+int main(int argc, char **argv)
+{
+	char *a[SSW_CHECK_PAIR_COUNT];
+	char *b[SSW_CHECK_PAIR_COUNT];
+	size_t aLens[SSW_CHECK_PAIR_COUNT];
+	size_t bLens[SSW_CHECK_PAIR_COUNT];
+	SSW_CONTEXT context;
+	boolean passed = FALSE;
+	ERR_VALUE ret = ERR_INTERNAL_ERROR;
+
+	ssw_init();
+	ret = utils_allocator_init(1);
+	if (ret == ERR_SUCCESS) {
+		/* The engines check their own implementations, long sequences are not redirected to the linear-space one. */
+		ssw_set_linear_space_length(0);
+		ret = _check_pairs_create(a, aLens, b, bLens);
+		if (ret == ERR_SUCCESS) {
+			ssw_context_init(&context);
+			ret = _check(stdout, &context, ssw_implementation(), (const char * const *)a, aLens, (const char * const *)b, bLens, &passed);
+			ssw_context_finit(&context);
+			for (size_t i = 0; i < SSW_CHECK_PAIR_COUNT; ++i) {
+				utils_free(a[i]);
+				utils_free(b[i]);
+			}
+		}
+	}
+
+	if (ret != ERR_SUCCESS)
+		fprintf(stderr, "[ERROR]: The check failed with an error code %u\n", ret);
+	else if (!passed)
+		fprintf(stdout, "[ERROR]: Some operation strings differ from those of ssw_clever()\n");
+
+	return (ret != ERR_SUCCESS) ? 2 : (passed ? 0 : 1);
+}